@@ -0,0 +1,272 @@
+#include "allocators.hpp"
+#include <cstring>
+#include <stdexcept>
+
+namespace pxe {
+    namespace {
+        const size_t blockAlignment = 64;
+        const size_t growGranularity = 4096;
+
+        bool powerOfTwo(size_t value) {
+            return value != 0 && (value & (value - 1)) == 0;
+        }
+
+        uint8_t *allocateBlock(size_t size) {
+            return static_cast<uint8_t *>(::operator new(size, std::align_val_t(blockAlignment)));
+        }
+
+        void freeBlock(uint8_t *block) {
+            ::operator delete(block, std::align_val_t(blockAlignment));
+        }
+    } // namespace
+
+    PixieLinearArena::PixieLinearArena(size_t capacity)
+        : block(nullptr)
+        , capacity(capacity)
+        , offset(0)
+        , arenaStats {} {
+
+        if (capacity != 0)
+            block = allocateBlock(capacity);
+        arenaStats.capacity = capacity;
+    }
+
+    PixieLinearArena::~PixieLinearArena() {
+        for (const Spill &spill : spills)
+            ::operator delete(spill.memory, std::align_val_t(spill.alignment));
+        if (block)
+            freeBlock(block);
+    }
+
+    void *PixieLinearArena::allocate(size_t size, size_t alignment) {
+        if (!powerOfTwo(alignment))
+            throw std::invalid_argument("PixieLinearArena: alignment has to be a power of two");
+
+        const size_t tail = PIXIE_MEMORY_DEBUG ? guardBytes : 0;
+        if (size > SIZE_MAX - tail - alignment)
+            throw std::bad_alloc();
+#if PIXIE_MEMORY_DEBUG
+        guards.reserve(guards.size() + 1);
+#endif
+
+        // aligned on the address rather than the offset, so alignments past the block's own work too
+        const uintptr_t base = reinterpret_cast<uintptr_t>(block);
+        const size_t start = ((base + offset + alignment - 1) & ~uintptr_t(alignment - 1)) - base;
+
+        uint8_t *memory;
+        if (block && start <= capacity && size + tail <= capacity - start) {
+            memory = block + start;
+            arenaStats.used += start + size + tail - offset;
+            offset = start + size + tail;
+        } else {
+            const size_t spillAlignment = alignment > alignof(std::max_align_t) ? alignment : alignof(std::max_align_t);
+            spills.reserve(spills.size() + 1);
+            memory = static_cast<uint8_t *>(::operator new(size + tail, std::align_val_t(spillAlignment)));
+            spills.push_back({memory, size + tail, spillAlignment});
+            arenaStats.used += size + tail;
+            arenaStats.spilled += size + tail;
+        }
+
+#if PIXIE_MEMORY_DEBUG
+        std::memset(memory, cleanByte, size);
+        std::memset(memory + size, guardByte, guardBytes);
+        guards.push_back(memory + size);
+#endif
+
+        arenaStats.allocations++;
+        if (arenaStats.used > arenaStats.peak)
+            arenaStats.peak = arenaStats.used;
+        return memory;
+    }
+
+    void PixieLinearArena::rewind(const PixieArenaMarker &marker) {
+        if (marker.offset > offset || marker.spills > spills.size() || marker.guards > guards.size())
+            throw std::invalid_argument("PixieLinearArena: marker taken after the arena was last rewound or reset");
+
+#if PIXIE_MEMORY_DEBUG
+        for (size_t i = marker.guards; i < guards.size(); ++i) {
+            for (size_t k = 0; k < guardBytes; ++k) {
+                if (guards[i][k] != guardByte)
+                    throw std::runtime_error("PixieLinearArena: write past the end of an allocation");
+            }
+        }
+        guards.resize(marker.guards);
+#endif
+
+        release(marker.offset, marker.spills);
+    }
+
+    void PixieLinearArena::reset() {
+#if PIXIE_MEMORY_DEBUG
+        checkGuards();
+        guards.clear();
+#endif
+
+        // everything that spilled has to fit in the block next time round
+        const bool grow = !spills.empty();
+        release(0, 0);
+        if (grow) {
+            const size_t wanted = (arenaStats.peak + growGranularity - 1) & ~(growGranularity - 1);
+            if (block)
+                freeBlock(block);
+            block = nullptr;
+            capacity = 0;
+            block = allocateBlock(wanted);
+            capacity = wanted;
+            arenaStats.capacity = wanted;
+        }
+
+        arenaStats.resets++;
+    }
+
+    void PixieLinearArena::checkGuards() const {
+        for (const uint8_t *guard : guards) {
+            for (size_t k = 0; k < guardBytes; ++k) {
+                if (guard[k] != guardByte)
+                    throw std::runtime_error("PixieLinearArena: write past the end of an allocation");
+            }
+        }
+    }
+
+    void PixieLinearArena::release(size_t toOffset, size_t toSpills) {
+#if PIXIE_MEMORY_DEBUG
+        if (offset != toOffset)
+            std::memset(block + toOffset, deadByte, offset - toOffset);
+#endif
+        arenaStats.used -= offset - toOffset;
+        offset = toOffset;
+
+        while (spills.size() > toSpills) {
+            const Spill &spill = spills.back();
+            arenaStats.used -= spill.size;
+            arenaStats.spilled -= spill.size;
+            ::operator delete(spill.memory, std::align_val_t(spill.alignment));
+            spills.pop_back();
+        }
+    }
+
+    PixieLinearArena &scratchArena() {
+        thread_local PixieLinearArena arena(256 * 1024);
+        return arena;
+    }
+
+    PixieFrameArena::PixieFrameArena(size_t bytesPerFrame, uint32_t framesInFlight) : current(0) {
+        if (framesInFlight == 0)
+            throw std::invalid_argument("PixieFrameArena: needs at least one frame");
+
+        for (uint32_t i = 0; i < framesInFlight; ++i)
+            arenas.push_back(std::make_unique<PixieLinearArena>(bytesPerFrame));
+    }
+
+    void PixieFrameArena::beginFrame(uint32_t slot) {
+        if (slot >= arenas.size())
+            throw std::out_of_range("PixieFrameArena: no such frame slot");
+
+        current = slot;
+        arenas[slot]->reset();
+    }
+
+    PixieArenaStats PixieFrameArena::stats() const {
+        PixieArenaStats result = arenas[current]->stats();
+        for (const std::unique_ptr<PixieLinearArena> &arena : arenas) {
+            if (arena->stats().peak > result.peak)
+                result.peak = arena->stats().peak;
+        }
+        return result;
+    }
+
+    PixieFixedPool::PixieFixedPool(size_t slotSize, size_t alignment, size_t slotsPerBlock)
+        : slotAlignment(alignment < alignof(void *) ? alignof(void *) : alignment)
+        , slotsPerBlock(slotsPerBlock)
+        , freeList(nullptr)
+        , poolStats {} {
+
+        if (!powerOfTwo(alignment))
+            throw std::invalid_argument("PixieFixedPool: alignment has to be a power of two");
+        if (slotsPerBlock == 0)
+            throw std::invalid_argument("PixieFixedPool: blocks need at least one slot");
+
+        // a free slot holds the list link, and every slot keeps the next one aligned
+        const size_t bytes = slotSize < sizeof(void *) ? sizeof(void *) : slotSize;
+        slotBytes = (bytes + slotAlignment - 1) & ~(slotAlignment - 1);
+        if (slotBytes > SIZE_MAX / slotsPerBlock)
+            throw std::invalid_argument("PixieFixedPool: block too large");
+    }
+
+    PixieFixedPool::~PixieFixedPool() {
+        for (const Block &block : blocks)
+            ::operator delete(block.memory, std::align_val_t(slotAlignment));
+    }
+
+    void *PixieFixedPool::allocate() {
+        if (!freeList)
+            grow();
+
+        void *slot = freeList;
+        std::memcpy(&freeList, slot, sizeof(void *));
+
+#if PIXIE_MEMORY_DEBUG
+        Block &block = const_cast<Block &>(*find(slot));
+        block.live[(static_cast<uint8_t *>(slot) - block.memory) / slotBytes] = true;
+        std::memset(slot, PixieLinearArena::cleanByte, slotBytes);
+#endif
+
+        poolStats.allocations++;
+        if (++poolStats.live > poolStats.peak)
+            poolStats.peak = poolStats.live;
+        return slot;
+    }
+
+    void PixieFixedPool::deallocate(void *slot) {
+        if (!slot)
+            return;
+
+#if PIXIE_MEMORY_DEBUG
+        Block *block = const_cast<Block *>(find(slot));
+        if (!block)
+            throw std::invalid_argument("PixieFixedPool: slot isn't from this pool");
+        const size_t index = (static_cast<uint8_t *>(slot) - block->memory) / slotBytes;
+        if (!block->live[index])
+            throw std::logic_error("PixieFixedPool: slot freed twice");
+        block->live[index] = false;
+        std::memset(slot, PixieLinearArena::deadByte, slotBytes);
+#endif
+
+        std::memcpy(slot, &freeList, sizeof(void *));
+        freeList = slot;
+        poolStats.live--;
+    }
+
+    bool PixieFixedPool::owns(const void *slot) const {
+        return find(slot) != nullptr;
+    }
+
+    void PixieFixedPool::grow() {
+        blocks.reserve(blocks.size() + 1);
+        uint8_t *memory = static_cast<uint8_t *>(::operator new(slotBytes * slotsPerBlock, std::align_val_t(slotAlignment)));
+        blocks.push_back({memory, {}});
+
+#if PIXIE_MEMORY_DEBUG
+        blocks.back().live.assign(slotsPerBlock, false);
+        std::memset(memory, PixieLinearArena::deadByte, slotBytes * slotsPerBlock);
+#endif
+
+        // threaded back to front so slots come out in address order
+        for (size_t i = slotsPerBlock; i-- > 0;) {
+            void *slot = memory + i * slotBytes;
+            std::memcpy(slot, &freeList, sizeof(void *));
+            freeList = slot;
+        }
+        poolStats.blocks++;
+    }
+
+    const PixieFixedPool::Block *PixieFixedPool::find(const void *slot) const {
+        const auto address = reinterpret_cast<uintptr_t>(slot);
+        for (const Block &block : blocks) {
+            const auto begin = reinterpret_cast<uintptr_t>(block.memory);
+            if (address >= begin && address < begin + slotBytes * slotsPerBlock)
+                return (address - begin) % slotBytes == 0 ? &block : nullptr;
+        }
+        return nullptr;
+    }
+} // namespace pxe
@@ -0,0 +1,264 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+// debug builds poison memory and put a guard after every arena allocation, build with PIXIE_MEMORY_DEBUG=0 or 1 to override
+#ifndef PIXIE_MEMORY_DEBUG
+#ifdef NDEBUG
+#define PIXIE_MEMORY_DEBUG 0
+#else
+#define PIXIE_MEMORY_DEBUG 1
+#endif
+#endif
+
+namespace pxe {
+    struct PixieArenaStats {
+        size_t used; // since the last reset, alignment padding included
+        size_t peak; // the most used between any two resets
+        size_t capacity;
+        size_t spilled; // part of used that didn't fit and went to the heap
+        uint64_t allocations;
+        uint64_t resets;
+    };
+
+    // where an arena was, rewinding to it releases everything allocated after
+    struct PixieArenaMarker {
+        size_t offset;
+        size_t spills;
+        size_t guards;
+    };
+
+    // bump allocator over one block, everything is freed at once by reset. when the block runs out allocations spill
+    // to the heap instead of failing, and the next reset grows the block so the same load fits without spilling
+    class PixieLinearArena {
+    public:
+        static const uint8_t cleanByte = 0xcd; // allocated, not yet written
+        static const uint8_t deadByte = 0xdd; // released by a reset or rewind
+        static const uint8_t guardByte = 0xfd; // just past the end of an allocation
+        static const size_t guardBytes = 16;
+
+        explicit PixieLinearArena(size_t capacity = 64 * 1024);
+        ~PixieLinearArena();
+
+        PixieLinearArena(const PixieLinearArena &) = delete;
+        PixieLinearArena &operator=(const PixieLinearArena &) = delete;
+
+        void *allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+        template <typename T>
+        T *allocateArray(size_t count) {
+            if (count > SIZE_MAX / sizeof(T))
+                throw std::bad_array_new_length();
+            return static_cast<T *>(allocate(sizeof(T) * count, alignof(T)));
+        }
+
+        PixieArenaMarker marker() const { return {offset, spills.size(), guards.size()}; }
+        void rewind(const PixieArenaMarker &marker);
+        void reset();
+
+        // throws when something wrote past the end of an allocation, reset and rewind check on their own in debug builds
+        void checkGuards() const;
+        const PixieArenaStats &stats() const { return arenaStats; }
+
+    private:
+        struct Spill {
+            void *memory;
+            size_t size;
+            size_t alignment;
+        };
+
+        void release(size_t toOffset, size_t toSpills);
+
+        uint8_t *block;
+        size_t capacity;
+        size_t offset;
+        std::vector<Spill> spills;
+        std::vector<const uint8_t *> guards; // debug builds only, where each guard starts
+        PixieArenaStats arenaStats;
+    };
+
+    // thread local arena for temporaries that don't outlive a call, on any thread including the job pool's
+    PixieLinearArena &scratchArena();
+
+    // gives back everything taken from the calling thread's scratch arena while it was alive, scopes nest.
+    // a guard found overwritten on the way out terminates in debug builds
+    class PixieScratchScope {
+    public:
+        PixieScratchScope()
+            : scratch(scratchArena())
+            , mark(scratch.marker()) {
+        }
+        ~PixieScratchScope() { scratch.rewind(mark); }
+
+        PixieScratchScope(const PixieScratchScope &) = delete;
+        PixieScratchScope &operator=(const PixieScratchScope &) = delete;
+
+        PixieLinearArena &arena() { return scratch; }
+
+    private:
+        PixieLinearArena &scratch;
+        PixieArenaMarker mark;
+    };
+
+    // one linear arena per frame slot, reset when the slot comes round again. PixieFrameRing only hands a slot back
+    // once the gpu is done with it, so frame memory can hold anything the frame's command lists point at.
+    // for the thread running the frame, jobs use scratch
+    class PixieFrameArena {
+    public:
+        PixieFrameArena(size_t bytesPerFrame, uint32_t framesInFlight);
+
+        void beginFrame(uint32_t slot);
+        void *allocate(size_t size, size_t alignment = alignof(std::max_align_t)) { return arenas[current]->allocate(size, alignment); }
+        PixieLinearArena &arena() { return *arenas[current]; }
+
+        // the current frame so far, with peak over every slot
+        PixieArenaStats stats() const;
+
+    private:
+        std::vector<std::unique_ptr<PixieLinearArena>> arenas;
+        uint32_t current;
+    };
+
+    struct PixiePoolStats {
+        size_t live;
+        size_t peak;
+        size_t blocks;
+        uint64_t allocations;
+    };
+
+    // equal sized slots carved out of blocks that are kept until the pool dies, free slots are a list threaded
+    // through themselves so allocate and deallocate are a pointer swap. not thread safe
+    class PixieFixedPool {
+    public:
+        PixieFixedPool(size_t slotSize, size_t alignment = alignof(std::max_align_t), size_t slotsPerBlock = 256);
+        ~PixieFixedPool();
+
+        PixieFixedPool(const PixieFixedPool &) = delete;
+        PixieFixedPool &operator=(const PixieFixedPool &) = delete;
+
+        void *allocate();
+        // debug builds throw on slots from elsewhere and on double frees
+        void deallocate(void *slot);
+        bool owns(const void *slot) const;
+
+        size_t slotSize() const { return slotBytes; }
+        size_t alignment() const { return slotAlignment; }
+        const PixiePoolStats &stats() const { return poolStats; }
+
+    private:
+        struct Block {
+            uint8_t *memory;
+            std::vector<bool> live; // debug builds only
+        };
+
+        void grow();
+        const Block *find(const void *slot) const;
+
+        size_t slotBytes;
+        size_t slotAlignment;
+        size_t slotsPerBlock;
+        std::vector<Block> blocks;
+        void *freeList;
+        PixiePoolStats poolStats;
+    };
+
+    // typed pool, objects still alive when it dies are released without running their destructors
+    template <typename T>
+    class PixieObjectPool {
+    public:
+        explicit PixieObjectPool(size_t objectsPerBlock = 256)
+            : pool(sizeof(T), alignof(T), objectsPerBlock) {
+        }
+
+        template <typename... Args>
+        T *create(Args &&...args) {
+            void *slot = pool.allocate();
+            try {
+                return new (slot) T(std::forward<Args>(args)...);
+            } catch (...) {
+                pool.deallocate(slot);
+                throw;
+            }
+        }
+
+        void destroy(T *object) {
+            if (!object)
+                return;
+            object->~T();
+            pool.deallocate(object);
+        }
+
+        const PixiePoolStats &stats() const { return pool.stats(); }
+
+    private:
+        PixieFixedPool pool;
+    };
+
+    // std allocator over an arena, deallocate is a no op so containers should reserve instead of growing
+    template <typename T>
+    class PixieArenaAllocator {
+    public:
+        using value_type = T;
+
+        explicit PixieArenaAllocator(PixieLinearArena &arena) noexcept : arena(&arena) {}
+        template <typename U>
+        PixieArenaAllocator(const PixieArenaAllocator<U> &other) noexcept : arena(other.arena) {}
+
+        T *allocate(size_t count) { return arena->template allocateArray<T>(count); }
+        void deallocate(T *, size_t) noexcept {}
+
+        template <typename U>
+        bool operator==(const PixieArenaAllocator<U> &other) const noexcept { return arena == other.arena; }
+
+    private:
+        template <typename U>
+        friend class PixieArenaAllocator;
+
+        PixieLinearArena *arena;
+    };
+
+    template <typename T>
+    using PixieArenaVector = std::vector<T, PixieArenaAllocator<T>>;
+
+    // std allocator handing out single objects from a pool, meant for node based containers like std::list and
+    // std::map with the pool sized for their node. anything that doesn't fit a slot comes from the heap
+    template <typename T>
+    class PixiePoolAllocator {
+    public:
+        using value_type = T;
+
+        explicit PixiePoolAllocator(PixieFixedPool &pool) noexcept : pool(&pool) {}
+        template <typename U>
+        PixiePoolAllocator(const PixiePoolAllocator<U> &other) noexcept : pool(other.pool) {}
+
+        T *allocate(size_t count) {
+            if (fits(count))
+                return static_cast<T *>(pool->allocate());
+            if (count > SIZE_MAX / sizeof(T))
+                throw std::bad_array_new_length();
+            return static_cast<T *>(::operator new(sizeof(T) * count, std::align_val_t(alignof(T))));
+        }
+
+        void deallocate(T *pointer, size_t count) noexcept {
+            if (fits(count))
+                pool->deallocate(pointer);
+            else
+                ::operator delete(pointer, std::align_val_t(alignof(T)));
+        }
+
+        template <typename U>
+        bool operator==(const PixiePoolAllocator<U> &other) const noexcept { return pool == other.pool; }
+
+    private:
+        template <typename U>
+        friend class PixiePoolAllocator;
+
+        bool fits(size_t count) const { return count == 1 && sizeof(T) <= pool->slotSize() && alignof(T) <= pool->alignment(); }
+
+        PixieFixedPool *pool;
+    };
+} // namespace pxe
@@ -2,22 +2,30 @@ struct PSInput
 {
     float4 position : SV_POSITION;
     float2 uv : TEXCOORD;
+    nointerpolation float4 color : COLOR;
 };
 
-Texture2D g_texture : register(t0);
+// bindless, every texture view lives in one heap and each draw says which one it samples
+cbuffer DrawConstants : register(b0)
+{
+    uint g_textureIndex;
+};
+
+Texture2D g_textures[] : register(t0);
 SamplerState g_sampler : register(s0);
 
-PSInput VSMain(float4 position : POSITION, float4 uv : TEXCOORD)
+PSInput VSMain(float4 position : POSITION, float4 uv : TEXCOORD, float4 color : COLOR)
 {
     PSInput result;
 
     result.position = position;
     result.uv = uv;
+    result.color = color;
 
     return result;
 }
 
 float4 PSMain(PSInput input) : SV_TARGET
 {
-    return g_texture.Sample(g_sampler, input.uv);
+    return g_textures[g_textureIndex].Sample(g_sampler, input.uv) * input.color;
 }
@@ -0,0 +1,355 @@
+#include "atlas.hpp"
+#include "hash.hpp"
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <stdexcept>
+
+namespace pxe {
+    // index layout: header, page sizes, entries sorted by name hash, then the name strings
+    static const char atlasMagic[4] = {'P', 'X', 'A', 'T'};
+    static const uint32_t atlasVersion = 1;
+
+    struct AtlasHeader {
+        char magic[4];
+        uint32_t version;
+        uint32_t pageCount;
+        uint32_t entryCount;
+        uint32_t stringBytes;
+    };
+
+    struct AtlasPageInfo {
+        uint32_t width;
+        uint32_t height;
+    };
+
+    struct AtlasEntry {
+        uint64_t hash;
+        uint32_t nameOffset;
+        uint16_t nameLength;
+        uint16_t page;
+        uint16_t x;
+        uint16_t y;
+        uint16_t width;
+        uint16_t height;
+    };
+
+    static_assert(sizeof(AtlasHeader) == 20 && sizeof(AtlasPageInfo) == 8 && sizeof(AtlasEntry) == 24, "atlas index layout changed");
+
+    struct AtlasRect {
+        uint32_t x;
+        uint32_t y;
+        uint32_t width;
+        uint32_t height;
+    };
+
+    // free rectangle bookkeeping for one page
+    class MaxRectsPage {
+    public:
+        MaxRectsPage(uint32_t width, uint32_t height)
+            : freeRects {{0, 0, width, height}} {
+        }
+
+        bool insert(uint32_t width, uint32_t height, AtlasRect &placed) {
+            uint32_t bestShort = UINT32_MAX;
+            uint32_t bestLong = UINT32_MAX;
+
+            for (const auto &free : freeRects) {
+                if (free.width < width || free.height < height)
+                    continue;
+
+                const uint32_t leftoverX = free.width - width;
+                const uint32_t leftoverY = free.height - height;
+                const uint32_t shortSide = std::min(leftoverX, leftoverY);
+                const uint32_t longSide = std::max(leftoverX, leftoverY);
+
+                if (shortSide < bestShort || (shortSide == bestShort && longSide < bestLong)) {
+                    placed = {free.x, free.y, width, height};
+                    bestShort = shortSide;
+                    bestLong = longSide;
+                }
+            }
+
+            if (bestShort == UINT32_MAX)
+                return false;
+
+            split(placed);
+            prune();
+            return true;
+        }
+
+    private:
+        void split(const AtlasRect &used) {
+            splitRects.clear();
+
+            for (auto &free : freeRects) {
+                if (used.x >= free.x + free.width || used.x + used.width <= free.x || used.y >= free.y + free.height || used.y + used.height <= free.y)
+                    continue;
+
+                // keep whatever is left of the free rect on each side of the used one
+                if (used.x > free.x)
+                    splitRects.push_back({free.x, free.y, used.x - free.x, free.height});
+                if (used.x + used.width < free.x + free.width)
+                    splitRects.push_back({used.x + used.width, free.y, free.x + free.width - used.x - used.width, free.height});
+                if (used.y > free.y)
+                    splitRects.push_back({free.x, free.y, free.width, used.y - free.y});
+                if (used.y + used.height < free.y + free.height)
+                    splitRects.push_back({free.x, used.y + used.height, free.width, free.y + free.height - used.y - used.height});
+
+                free.width = 0; // removed below
+            }
+
+            std::erase_if(freeRects, [](const AtlasRect &rect) { return rect.width == 0; });
+        }
+
+        // the untouched rects were already pruned against each other, and a piece of a split rect
+        // can't contain one of them, so only the new pieces need checking
+        void prune() {
+            auto contains = [](const AtlasRect &outer, const AtlasRect &inner) {
+                return inner.x >= outer.x && inner.y >= outer.y && inner.x + inner.width <= outer.x + outer.width && inner.y + inner.height <= outer.y + outer.height;
+            };
+
+            for (size_t i = 0; i < splitRects.size(); ++i) {
+                bool redundant = false;
+
+                for (const auto &free : freeRects) {
+                    if (contains(free, splitRects[i])) {
+                        redundant = true;
+                        break;
+                    }
+                }
+
+                for (size_t j = 0; j < splitRects.size() && !redundant; ++j) {
+                    // of two identical pieces keep the first
+                    if (i != j && contains(splitRects[j], splitRects[i]) && (j < i || !contains(splitRects[i], splitRects[j])))
+                        redundant = true;
+                }
+
+                if (!redundant)
+                    keptRects.push_back(splitRects[i]);
+            }
+
+            freeRects.insert(freeRects.end(), keptRects.begin(), keptRects.end());
+            keptRects.clear();
+        }
+
+        std::vector<AtlasRect> splitRects;
+        std::vector<AtlasRect> keptRects;
+        std::vector<AtlasRect> freeRects;
+    };
+
+    PixieAtlasBuilder::PixieAtlasBuilder(const PixieAtlasSettings &settings)
+        : settings(settings) {
+
+        if (settings.pageWidth == 0 || settings.pageHeight == 0 || settings.pageWidth > UINT16_MAX || settings.pageHeight > UINT16_MAX)
+            throw std::invalid_argument("PixieAtlasBuilder: page size out of range");
+    }
+
+    void PixieAtlasBuilder::add(PixieAtlasImage image) {
+        const uint32_t border = settings.extrude * 2 + settings.padding;
+        if (image.width == 0 || image.height == 0 || image.texels == nullptr)
+            throw std::invalid_argument("PixieAtlasBuilder: empty image " + image.name);
+        if (image.width + border > settings.pageWidth || image.height + border > settings.pageHeight)
+            throw std::invalid_argument("PixieAtlasBuilder: image larger than a page " + image.name);
+
+        images.push_back(std::move(image));
+    }
+
+    void PixieAtlasBuilder::build() {
+        const uint32_t border = settings.extrude * 2 + settings.padding;
+
+        // big and long images first, they are the hardest to fit late
+        std::vector<size_t> order(images.size());
+        std::iota(order.begin(), order.end(), size_t(0));
+        std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+            const auto sideA = std::max(images[a].width, images[a].height);
+            const auto sideB = std::max(images[b].width, images[b].height);
+            if (sideA != sideB)
+                return sideA > sideB;
+            return images[a].width * images[a].height > images[b].width * images[b].height;
+        });
+
+        std::vector<MaxRectsPage> packers;
+        placements.assign(images.size(), {});
+        atlasPages.clear();
+
+        for (const size_t index : order) {
+            const auto &image = images[index];
+            AtlasRect placed = {};
+            uint32_t page = 0;
+
+            while (page < packers.size() && !packers[page].insert(image.width + border, image.height + border, placed))
+                page++;
+
+            if (page == packers.size()) {
+                packers.emplace_back(settings.pageWidth, settings.pageHeight);
+                atlasPages.push_back({settings.pageWidth, settings.pageHeight, std::vector<uint32_t>(static_cast<size_t>(settings.pageWidth) * settings.pageHeight)});
+                packers.back().insert(image.width + border, image.height + border, placed);
+            }
+
+            placements[index] = {page, placed.x + settings.extrude, placed.y + settings.extrude};
+            blit(image, placements[index]);
+        }
+    }
+
+    void PixieAtlasBuilder::blit(const PixieAtlasImage &image, const Placement &placement) {
+        PixieAtlasPage &page = atlasPages[placement.page];
+        const auto extrude = static_cast<int64_t>(settings.extrude);
+
+        // clamp source coordinates so the border rows and columns repeat the edge texels
+        for (int64_t y = -extrude; y < image.height + extrude; ++y) {
+            const auto srcY = static_cast<uint32_t>(std::clamp<int64_t>(y, 0, image.height - 1));
+            const uint32_t *src = image.texels + static_cast<size_t>(srcY) * image.width;
+            uint32_t *dst = page.texels.data() + static_cast<size_t>(placement.y + y) * page.width + placement.x;
+
+            for (int64_t x = -extrude; x < 0; ++x)
+                dst[x] = src[0];
+            std::memcpy(dst, src, static_cast<size_t>(image.width) * sizeof(uint32_t));
+            for (int64_t x = image.width; x < image.width + extrude; ++x)
+                dst[x] = src[image.width - 1];
+        }
+    }
+
+    std::vector<uint8_t> PixieAtlasBuilder::serializeIndex() const {
+        if (placements.size() != images.size())
+            throw std::logic_error("PixieAtlasBuilder: build() has to run before serializeIndex()");
+
+        std::vector<AtlasEntry> entries;
+        std::string strings;
+        entries.reserve(images.size());
+
+        for (size_t i = 0; i < images.size(); ++i) {
+            const auto &image = images[i];
+            const auto &placement = placements[i];
+
+            AtlasEntry entry = {};
+            entry.hash = hashString(image.name);
+            entry.nameOffset = static_cast<uint32_t>(strings.size());
+            entry.nameLength = static_cast<uint16_t>(std::min<size_t>(image.name.size(), UINT16_MAX));
+            entry.page = static_cast<uint16_t>(placement.page);
+            entry.x = static_cast<uint16_t>(placement.x);
+            entry.y = static_cast<uint16_t>(placement.y);
+            entry.width = static_cast<uint16_t>(image.width);
+            entry.height = static_cast<uint16_t>(image.height);
+            entries.push_back(entry);
+
+            strings.append(image.name, 0, entry.nameLength);
+        }
+
+        std::sort(entries.begin(), entries.end(), [](const AtlasEntry &a, const AtlasEntry &b) { return a.hash < b.hash; });
+
+        AtlasHeader header = {};
+        std::memcpy(header.magic, atlasMagic, sizeof(atlasMagic));
+        header.version = atlasVersion;
+        header.pageCount = static_cast<uint32_t>(atlasPages.size());
+        header.entryCount = static_cast<uint32_t>(entries.size());
+        header.stringBytes = static_cast<uint32_t>(strings.size());
+
+        std::vector<uint8_t> index(sizeof(header) + atlasPages.size() * sizeof(AtlasPageInfo) + entries.size() * sizeof(AtlasEntry) + strings.size());
+        uint8_t *cursor = index.data();
+
+        std::memcpy(cursor, &header, sizeof(header));
+        cursor += sizeof(header);
+
+        for (const auto &page : atlasPages) {
+            const AtlasPageInfo info = {page.width, page.height};
+            std::memcpy(cursor, &info, sizeof(info));
+            cursor += sizeof(info);
+        }
+
+        std::memcpy(cursor, entries.data(), entries.size() * sizeof(AtlasEntry));
+        cursor += entries.size() * sizeof(AtlasEntry);
+        std::memcpy(cursor, strings.data(), strings.size());
+
+        return index;
+    }
+
+    double PixieAtlasBuilder::efficiency() const {
+        double used = 0.0;
+        for (const auto &image : images)
+            used += static_cast<double>(image.width) * image.height;
+
+        double total = 0.0;
+        for (const auto &page : atlasPages)
+            total += static_cast<double>(page.width) * page.height;
+
+        return total > 0.0 ? used / total : 0.0;
+    }
+
+    PixieAtlas::PixieAtlas(std::vector<uint8_t> index)
+        : blob(std::move(index)) {
+
+        AtlasHeader header = {};
+        if (blob.size() < sizeof(header))
+            throw std::runtime_error("PixieAtlas: index truncated");
+
+        std::memcpy(&header, blob.data(), sizeof(header));
+        if (std::memcmp(header.magic, atlasMagic, sizeof(atlasMagic)) != 0 || header.version != atlasVersion)
+            throw std::runtime_error("PixieAtlas: not a version 1 atlas index");
+
+        const uint64_t expected = sizeof(header) + uint64_t(header.pageCount) * sizeof(AtlasPageInfo) + uint64_t(header.entryCount) * sizeof(AtlasEntry) + header.stringBytes;
+        if (blob.size() != expected)
+            throw std::runtime_error("PixieAtlas: index size mismatch");
+
+        pageTotal = header.pageCount;
+        entryTotal = header.entryCount;
+
+        // check every entry once here so lookups can trust the blob
+        const uint8_t *entries = blob.data() + sizeof(header) + size_t(pageTotal) * sizeof(AtlasPageInfo);
+        for (uint32_t i = 0; i < entryTotal; ++i) {
+            AtlasEntry entry;
+            std::memcpy(&entry, entries + size_t(i) * sizeof(AtlasEntry), sizeof(entry));
+
+            if (entry.page >= pageTotal || uint64_t(entry.nameOffset) + entry.nameLength > header.stringBytes)
+                throw std::runtime_error("PixieAtlas: corrupt index entry");
+        }
+    }
+
+    bool PixieAtlas::find(std::string_view name, PixieAtlasSprite &sprite) const {
+        const uint8_t *pages = blob.data() + sizeof(AtlasHeader);
+        const uint8_t *entries = pages + size_t(pageTotal) * sizeof(AtlasPageInfo);
+        const auto *strings = reinterpret_cast<const char *>(entries + size_t(entryTotal) * sizeof(AtlasEntry));
+
+        auto entryAt = [entries](uint32_t i) {
+            AtlasEntry entry;
+            std::memcpy(&entry, entries + size_t(i) * sizeof(AtlasEntry), sizeof(entry));
+            return entry;
+        };
+
+        const uint64_t hash = hashString(name);
+
+        // lower bound on the hash, then walk the (almost always single) matches
+        uint32_t first = 0;
+        uint32_t count = entryTotal;
+        while (count > 0) {
+            const uint32_t step = count / 2;
+            if (entryAt(first + step).hash < hash) {
+                first += step + 1;
+                count -= step + 1;
+            } else {
+                count = step;
+            }
+        }
+
+        for (uint32_t i = first; i < entryTotal; ++i) {
+            const AtlasEntry entry = entryAt(i);
+            if (entry.hash != hash)
+                break;
+            if (std::string_view(strings + entry.nameOffset, entry.nameLength) != name)
+                continue;
+
+            AtlasPageInfo info;
+            std::memcpy(&info, pages + size_t(entry.page) * sizeof(AtlasPageInfo), sizeof(info));
+
+            const float invWidth = 1.0f / static_cast<float>(info.width);
+            const float invHeight = 1.0f / static_cast<float>(info.height);
+            sprite.page = entry.page;
+            sprite.uv = {entry.x * invWidth, entry.y * invHeight, entry.width * invWidth, entry.height * invHeight};
+            sprite.width = entry.width;
+            sprite.height = entry.height;
+            return true;
+        }
+
+        return false;
+    }
+} // namespace pxe
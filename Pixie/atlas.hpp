@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "spritebatch.hpp"
+
+namespace pxe {
+    struct PixieAtlasSettings {
+        uint32_t pageWidth = 2048;
+        uint32_t pageHeight = 2048;
+        uint32_t padding = 2; // empty texels between neighbours
+        uint32_t extrude = 1; // edge texels repeated around each sprite
+    };
+
+    struct PixieAtlasImage {
+        std::string name;
+        uint32_t width;
+        uint32_t height;
+        const uint32_t *texels; // R8G8B8A8, has to outlive build()
+    };
+
+    struct PixieAtlasPage {
+        uint32_t width;
+        uint32_t height;
+        std::vector<uint32_t> texels;
+    };
+
+    struct PixieAtlasSprite {
+        uint32_t page;
+        PixieRect uv; // ready for drawSprite
+        uint32_t width;
+        uint32_t height;
+    };
+
+    // offline side, packs images into pages with MaxRects (best short side fit) and writes the lookup index
+    class PixieAtlasBuilder {
+    public:
+        explicit PixieAtlasBuilder(const PixieAtlasSettings &settings = {});
+
+        void add(PixieAtlasImage image);
+        void build();
+
+        const std::vector<PixieAtlasPage> &pages() const { return atlasPages; }
+        std::vector<uint8_t> serializeIndex() const;
+        // sprite texels over page texels, padding and extrusion count as waste
+        double efficiency() const;
+
+    private:
+        struct Placement {
+            uint32_t page;
+            uint32_t x; // inner rect, extrusion excluded
+            uint32_t y;
+        };
+
+        void blit(const PixieAtlasImage &image, const Placement &placement);
+
+        PixieAtlasSettings settings;
+        std::vector<PixieAtlasImage> images;
+        std::vector<Placement> placements;
+        std::vector<PixieAtlasPage> atlasPages;
+    };
+
+    // runtime side, maps a sprite name to its page and uv rect
+    class PixieAtlas {
+    public:
+        PixieAtlas() = default;
+        explicit PixieAtlas(std::vector<uint8_t> index);
+
+        bool find(std::string_view name, PixieAtlasSprite &sprite) const;
+
+        uint32_t pageCount() const { return pageTotal; }
+        uint32_t spriteCount() const { return entryTotal; }
+
+    private:
+        std::vector<uint8_t> blob;
+        uint32_t pageTotal = 0;
+        uint32_t entryTotal = 0;
+    };
+} // namespace pxe
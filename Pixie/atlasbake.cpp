@@ -0,0 +1,81 @@
+#include "atlas.hpp"
+#include "surfaceconvert.hpp"
+#include <SDL.h>
+#include <SDL_image.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// offline atlas bake for CI, usage: atlasbake <output prefix> <page size> <image.png>...
+// writes <prefix>.pxat plus <prefix>_<page>.png and prints packing time and efficiency
+
+using namespace pxe;
+
+int main(int argc, char **argv) {
+    if (argc < 4) {
+        std::fprintf(stderr, "usage: %s <output prefix> <page size> <image.png>...\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    const std::string prefix = argv[1];
+    const auto pageSize = static_cast<uint32_t>(std::strtoul(argv[2], nullptr, 10));
+
+    PixieAtlasSettings settings;
+    settings.pageWidth = pageSize;
+    settings.pageHeight = pageSize;
+
+    PixieAtlasBuilder builder(settings);
+    const PixiePixelConverter converter;
+    std::vector<std::vector<uint32_t>> images; // the builder reads texels in place until build
+
+    const auto loadBegin = std::chrono::steady_clock::now();
+    for (int i = 3; i < argc; ++i) {
+        SDL_Surface *loaded = IMG_Load(argv[i]);
+        if (loaded == nullptr) {
+            std::fprintf(stderr, "failed to load %s: %s\n", argv[i], IMG_GetError());
+            return EXIT_FAILURE;
+        }
+
+        // R8G8B8A8 in memory, tightly packed so the builder can read rows directly
+        images.push_back(convertSurface(loaded, converter));
+        builder.add({std::filesystem::path(argv[i]).stem().string(), static_cast<uint32_t>(loaded->w), static_cast<uint32_t>(loaded->h), images.back().data()});
+        SDL_FreeSurface(loaded);
+    }
+
+    const auto packBegin = std::chrono::steady_clock::now();
+    builder.build();
+    const auto packEnd = std::chrono::steady_clock::now();
+
+    const auto index = builder.serializeIndex();
+    std::ofstream indexFile(prefix + ".pxat", std::ios::binary);
+    indexFile.write(reinterpret_cast<const char *>(index.data()), index.size());
+    indexFile.close();
+    if (!indexFile) {
+        std::fprintf(stderr, "failed to write %s.pxat\n", prefix.c_str());
+        return EXIT_FAILURE;
+    }
+
+    // a page that didn't make it to disk fails the bake, CI shouldn't ship a partial atlas
+    for (size_t i = 0; i < builder.pages().size(); ++i) {
+        const auto &page = builder.pages()[i];
+        const std::string pagePath = prefix + "_" + std::to_string(i) + ".png";
+        SDL_Surface *out = SDL_CreateRGBSurfaceWithFormatFrom(const_cast<uint32_t *>(page.texels.data()), page.width, page.height, 32, page.width * 4, SDL_PIXELFORMAT_RGBA32);
+        const bool saved = out != nullptr && IMG_SavePNG(out, pagePath.c_str()) == 0;
+        SDL_FreeSurface(out);
+        if (!saved) {
+            std::fprintf(stderr, "failed to write %s: %s\n", pagePath.c_str(), IMG_GetError());
+            return EXIT_FAILURE;
+        }
+    }
+
+    const auto decodeMs = std::chrono::duration<double, std::milli>(packBegin - loadBegin).count();
+    const auto packMs = std::chrono::duration<double, std::milli>(packEnd - packBegin).count();
+    std::printf("%d images, %zu pages, decode %.2f ms, pack %.2f ms, efficiency %.1f%%, index %zu bytes\n",
+        argc - 3, builder.pages().size(), decodeMs, packMs, builder.efficiency() * 100.0, index.size());
+
+    return 0;
+}
@@ -0,0 +1,545 @@
+#include "audio.hpp"
+#include "audiostream.hpp"
+#include "profiler.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace pxe {
+    static const uint32_t generationMask = UINT32_MAX >> PixieVoiceHandle::slotBits;
+
+    // inside a span positions are relative to its first source frame, 12.20 fixed point. the 32.32 voice position
+    // only gets truncated for the length of one block, so the error never builds up
+    static const uint32_t fracBits = 20;
+    static const uint32_t fracOne = 1u << fracBits;
+    static const uint32_t fracMask = fracOne - 1;
+    static const float fracScale = 1.0f / float(fracOne);
+    static const float quarterPi = 0.785398163397448f;
+
+    struct MixSpan {
+        const float *left;
+        const float *right; // same as left for mono sounds
+        bool stereo;
+        uint32_t position;
+        uint32_t step;
+        uint32_t frames;
+        float gainLeft; // gain at frame k is gain + k * step
+        float stepLeft;
+        float gainRight;
+        float stepRight;
+        float *dstLeft;
+        float *dstRight;
+
+        // whole source frames one after the other, no interpolation needed
+        bool contiguous() const { return position == 0 && step == fracOne; }
+    };
+
+    // from frame `first` on, the simd paths finish their spans with it
+    static void mixSpanScalar(const MixSpan &span, uint32_t first) {
+        for (uint32_t k = first; k < span.frames; ++k) {
+            const uint32_t position = span.position + k * span.step;
+            const uint32_t index = position >> fracBits;
+            const float fraction = float(position & fracMask) * fracScale;
+
+            const float left = span.left[index] + (span.left[index + 1] - span.left[index]) * fraction;
+            const float right = span.stereo ? span.right[index] + (span.right[index + 1] - span.right[index]) * fraction : left;
+            span.dstLeft[k] += left * (span.gainLeft + float(k) * span.stepLeft);
+            span.dstRight[k] += right * (span.gainRight + float(k) * span.stepRight);
+        }
+    }
+
+    static void mixSpanSSE2(const MixSpan &span) {
+        const __m128 lanes = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+        __m128 gainLeft = _mm_add_ps(_mm_set1_ps(span.gainLeft), _mm_mul_ps(lanes, _mm_set1_ps(span.stepLeft)));
+        __m128 gainRight = _mm_add_ps(_mm_set1_ps(span.gainRight), _mm_mul_ps(lanes, _mm_set1_ps(span.stepRight)));
+        const __m128 advanceLeft = _mm_set1_ps(span.stepLeft * 4.0f);
+        const __m128 advanceRight = _mm_set1_ps(span.stepRight * 4.0f);
+        const __m128 scale = _mm_set1_ps(fracScale);
+        const bool contiguous = span.contiguous();
+
+        uint32_t k = 0;
+        for (; k + 4 <= span.frames; k += 4) {
+            __m128 left;
+            __m128 right;
+            if (contiguous) {
+                left = _mm_loadu_ps(span.left + k);
+                right = span.stereo ? _mm_loadu_ps(span.right + k) : left;
+            } else {
+                // no gather before avx2, the four taps are loaded one by one
+                uint32_t index[4];
+                uint32_t fraction[4];
+                for (uint32_t j = 0; j < 4; ++j) {
+                    const uint32_t position = span.position + (k + j) * span.step;
+                    index[j] = position >> fracBits;
+                    fraction[j] = position & fracMask;
+                }
+                const __m128 f = _mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128(reinterpret_cast<const __m128i *>(fraction))), scale);
+
+                const float *l = span.left;
+                const __m128 a = _mm_setr_ps(l[index[0]], l[index[1]], l[index[2]], l[index[3]]);
+                const __m128 b = _mm_setr_ps(l[index[0] + 1], l[index[1] + 1], l[index[2] + 1], l[index[3] + 1]);
+                left = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), f));
+                if (span.stereo) {
+                    const float *r = span.right;
+                    const __m128 c = _mm_setr_ps(r[index[0]], r[index[1]], r[index[2]], r[index[3]]);
+                    const __m128 d = _mm_setr_ps(r[index[0] + 1], r[index[1] + 1], r[index[2] + 1], r[index[3] + 1]);
+                    right = _mm_add_ps(c, _mm_mul_ps(_mm_sub_ps(d, c), f));
+                } else {
+                    right = left;
+                }
+            }
+
+            _mm_storeu_ps(span.dstLeft + k, _mm_add_ps(_mm_loadu_ps(span.dstLeft + k), _mm_mul_ps(left, gainLeft)));
+            _mm_storeu_ps(span.dstRight + k, _mm_add_ps(_mm_loadu_ps(span.dstRight + k), _mm_mul_ps(right, gainRight)));
+            gainLeft = _mm_add_ps(gainLeft, advanceLeft);
+            gainRight = _mm_add_ps(gainRight, advanceRight);
+        }
+        mixSpanScalar(span, k);
+    }
+
+    PIXIE_TARGET_AVX2 static void mixSpanAVX2(const MixSpan &span) {
+        const __m256 lanes = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+        __m256 gainLeft = _mm256_fmadd_ps(lanes, _mm256_set1_ps(span.stepLeft), _mm256_set1_ps(span.gainLeft));
+        __m256 gainRight = _mm256_fmadd_ps(lanes, _mm256_set1_ps(span.stepRight), _mm256_set1_ps(span.gainRight));
+        const __m256 advanceLeft = _mm256_set1_ps(span.stepLeft * 8.0f);
+        const __m256 advanceRight = _mm256_set1_ps(span.stepRight * 8.0f);
+
+        __m256i position = _mm256_add_epi32(_mm256_set1_epi32(static_cast<int>(span.position)),
+            _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(static_cast<int>(span.step))));
+        const __m256i advance = _mm256_set1_epi32(static_cast<int>(span.step * 8));
+        const __m256i mask = _mm256_set1_epi32(static_cast<int>(fracMask));
+        const __m256 scale = _mm256_set1_ps(fracScale);
+        const bool contiguous = span.contiguous();
+
+        uint32_t k = 0;
+        for (; k + 8 <= span.frames; k += 8) {
+            __m256 left;
+            __m256 right;
+            if (contiguous) {
+                left = _mm256_loadu_ps(span.left + k);
+                right = span.stereo ? _mm256_loadu_ps(span.right + k) : left;
+            } else {
+                const __m256i index = _mm256_srli_epi32(position, fracBits);
+                const __m256 f = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(position, mask)), scale);
+
+                const __m256 a = _mm256_i32gather_ps(span.left, index, 4);
+                const __m256 b = _mm256_i32gather_ps(span.left + 1, index, 4);
+                left = _mm256_fmadd_ps(_mm256_sub_ps(b, a), f, a);
+                if (span.stereo) {
+                    const __m256 c = _mm256_i32gather_ps(span.right, index, 4);
+                    const __m256 d = _mm256_i32gather_ps(span.right + 1, index, 4);
+                    right = _mm256_fmadd_ps(_mm256_sub_ps(d, c), f, c);
+                } else {
+                    right = left;
+                }
+                position = _mm256_add_epi32(position, advance);
+            }
+
+            _mm256_storeu_ps(span.dstLeft + k, _mm256_fmadd_ps(left, gainLeft, _mm256_loadu_ps(span.dstLeft + k)));
+            _mm256_storeu_ps(span.dstRight + k, _mm256_fmadd_ps(right, gainRight, _mm256_loadu_ps(span.dstRight + k)));
+            gainLeft = _mm256_add_ps(gainLeft, advanceLeft);
+            gainRight = _mm256_add_ps(gainRight, advanceRight);
+        }
+        // the scalar tail is plain sse code, dirty upper halves would slow it and everything after it down
+        _mm256_zeroupper();
+        mixSpanScalar(span, k);
+    }
+
+    PixieSound::PixieSound(uint32_t sampleRate, uint32_t channels, const float *interleaved, uint32_t frames)
+        : rate(sampleRate)
+        , channelCount(channels)
+        , frameCount(frames)
+        , samples(size_t(channels) * (size_t(frames) + 1), 0.0f) {
+
+        if (channels != 1 && channels != 2)
+            throw std::invalid_argument("PixieSound: only mono and stereo sounds are supported");
+        if (sampleRate == 0 || frames == 0)
+            throw std::invalid_argument("PixieSound: empty sound");
+
+        for (uint32_t c = 0; c < channels; ++c) {
+            float *dst = samples.data() + size_t(c) * (size_t(frames) + 1);
+            for (uint32_t i = 0; i < frames; ++i)
+                dst[i] = interleaved[size_t(i) * channels + c];
+        }
+    }
+
+    PixieAudioMixer::PixieAudioMixer(uint32_t sampleRate, uint32_t maxVoices, uint32_t commandCapacity, PixieSIMDLevel level)
+        : rate(sampleRate)
+        , simdLevel(level)
+        , commands(commandCapacity)
+        , finished(maxVoices)
+        , owners(maxVoices)
+        , generations(maxVoices, 0)
+        , played(0)
+        , rejected(0)
+        , droppedCommands(0)
+        , voices(maxVoices)
+        , mixLeft(blockFrames)
+        , mixRight(blockFrames)
+        , masterGain(1.0f)
+        , activeCount(0)
+        , peakVoices(0)
+        , framesRendered(0) {
+
+        if (sampleRate == 0)
+            throw std::invalid_argument("PixieAudioMixer: sample rate has to be positive");
+        // the top slot is never handed out so no live handle can equal invalidVoice
+        if (maxVoices == 0 || maxVoices >= PixieVoiceHandle::slotMask)
+            throw std::invalid_argument("PixieAudioMixer: voice count out of range");
+
+        // popped from the back, so a fresh mixer hands out slot 0 first
+        freeSlots.reserve(maxVoices);
+        for (uint32_t slot = maxVoices; slot-- > 0;)
+            freeSlots.push_back(slot);
+        active.reserve(maxVoices);
+        for (Voice &voice : voices)
+            voice = {};
+    }
+
+    bool PixieAudioMixer::send(const Command &command) {
+        if (commands.push(command))
+            return true;
+        droppedCommands++;
+        return false;
+    }
+
+    PixieVoiceHandle PixieAudioMixer::play(std::shared_ptr<const PixieSound> sound, const PixieVoiceParams &params) {
+        if (!sound)
+            throw std::invalid_argument("PixieAudioMixer: no sound to play");
+        const PixieSound *source = sound.get();
+        return start(std::move(sound), source, nullptr, params);
+    }
+
+    PixieVoiceHandle PixieAudioMixer::play(std::shared_ptr<PixieAudioStream> stream, const PixieVoiceParams &params) {
+        if (!stream)
+            throw std::invalid_argument("PixieAudioMixer: no stream to play");
+        PixieAudioStream *source = stream.get();
+        return start(std::move(stream), nullptr, source, params);
+    }
+
+    PixieVoiceHandle PixieAudioMixer::start(std::shared_ptr<const void> owner, const PixieSound *sound, PixieAudioStream *stream, const PixieVoiceParams &params) {
+        if (freeSlots.empty()) {
+            rejected++;
+            return invalidVoice;
+        }
+
+        const uint32_t slot = freeSlots.back();
+        const uint32_t generation = (generations[slot] + 1) & generationMask;
+        if (!send({CommandType::Play, slot, generation, 0.0f, sound, stream, params}))
+            return invalidVoice;
+
+        freeSlots.pop_back();
+        generations[slot] = generation;
+        owners[slot] = std::move(owner);
+        played++;
+        return {slot | (generation << PixieVoiceHandle::slotBits)};
+    }
+
+    bool PixieAudioMixer::playing(PixieVoiceHandle voice) const {
+        const uint32_t slot = voice.slot();
+        return slot < owners.size() && owners[slot] && generations[slot] == voice.generation();
+    }
+
+    void PixieAudioMixer::setGain(PixieVoiceHandle voice, float gain) {
+        if (playing(voice))
+            send({CommandType::SetGain, voice.slot(), voice.generation(), gain, nullptr, nullptr, {}});
+    }
+
+    void PixieAudioMixer::setPan(PixieVoiceHandle voice, float pan) {
+        if (playing(voice))
+            send({CommandType::SetPan, voice.slot(), voice.generation(), pan, nullptr, nullptr, {}});
+    }
+
+    void PixieAudioMixer::setPitch(PixieVoiceHandle voice, float pitch) {
+        if (playing(voice))
+            send({CommandType::SetPitch, voice.slot(), voice.generation(), pitch, nullptr, nullptr, {}});
+    }
+
+    void PixieAudioMixer::stop(PixieVoiceHandle voice) {
+        if (playing(voice))
+            send({CommandType::Stop, voice.slot(), voice.generation(), 0.0f, nullptr, nullptr, {}});
+    }
+
+    void PixieAudioMixer::setMasterGain(float gain) {
+        send({CommandType::SetMasterGain, 0, 0, gain, nullptr, nullptr, {}});
+    }
+
+    void PixieAudioMixer::update() {
+        // the last reference to a sound or stream can go here, where freeing it is allowed to take its time
+        uint32_t slot = 0;
+        while (finished.pop(slot)) {
+            owners[slot].reset();
+            freeSlots.push_back(slot);
+        }
+    }
+
+    PixieAudioStats PixieAudioMixer::stats() const {
+        PixieAudioStats result = {};
+        result.voices = activeCount.load(std::memory_order_relaxed);
+        result.peakVoices = peakVoices.load(std::memory_order_relaxed);
+        result.framesRendered = framesRendered.load(std::memory_order_relaxed);
+        result.played = played;
+        result.rejected = rejected;
+        result.droppedCommands = droppedCommands;
+        return result;
+    }
+
+    void PixieAudioMixer::apply(const Command &command) {
+        if (command.type == CommandType::SetMasterGain) {
+            masterGain = command.value;
+            return;
+        }
+
+        Voice &voice = voices[command.slot];
+        if (command.type == CommandType::Play) {
+            voice = {command.sound, command.stream, 0, command.params, 0.0f, 0.0f, 0, 0, command.generation, false};
+            voice.sampleRate = command.sound ? command.sound->sampleRate() : command.stream->sampleRate();
+            voice.channels = command.sound ? command.sound->channels() : command.stream->channels();
+            // a new voice starts at its gain, ramping in would soften the attack
+            targetGains(voice, voice.gainLeft, voice.gainRight);
+            active.push_back(command.slot);
+            if (active.size() > peakVoices.load(std::memory_order_relaxed))
+                peakVoices.store(static_cast<uint32_t>(active.size()), std::memory_order_relaxed);
+            return;
+        }
+
+        // the voice may have finished since the game thread sent this
+        if ((!voice.sound && !voice.stream) || voice.generation != command.generation)
+            return;
+
+        switch (command.type) {
+            case CommandType::SetGain:
+                voice.params.gain = command.value;
+                break;
+            case CommandType::SetPan:
+                voice.params.pan = command.value;
+                break;
+            case CommandType::SetPitch:
+                voice.params.pitch = command.value;
+                break;
+            case CommandType::Stop:
+                voice.stopping = true;
+                break;
+            default:
+                break;
+        }
+    }
+
+    void PixieAudioMixer::targetGains(const Voice &voice, float &left, float &right) const {
+        const float pan = std::clamp(voice.params.pan, -1.0f, 1.0f);
+        if (voice.channels == 1) {
+            // equal power, a mono sound keeps its loudness as it moves across
+            const float angle = (pan + 1.0f) * quarterPi;
+            left = voice.params.gain * std::cos(angle);
+            right = voice.params.gain * std::sin(angle);
+        } else {
+            // balance, centred stereo plays as recorded
+            left = voice.params.gain * std::min(1.0f, 1.0f - pan);
+            right = voice.params.gain * std::min(1.0f, 1.0f + pan);
+        }
+    }
+
+    uint64_t PixieAudioMixer::step(const Voice &voice) const {
+        const double ratio = double(voice.params.pitch) * voice.sampleRate / rate;
+        // the low end keeps the span's 20 bit step from truncating to nothing
+        return static_cast<uint64_t>(std::clamp(ratio, 1.0 / 1024.0, double(maxStep)) * 4294967296.0);
+    }
+
+    bool PixieAudioMixer::mixVoice(Voice &voice, uint32_t frames) {
+        float targetLeft = 0.0f;
+        float targetRight = 0.0f;
+        if (!voice.stopping)
+            targetGains(voice, targetLeft, targetRight);
+        const float stepLeft = (targetLeft - voice.gainLeft) / float(frames);
+        const float stepRight = (targetRight - voice.gainRight) / float(frames);
+
+        if (!(voice.stream ? mixStream(voice, frames, stepLeft, stepRight) : mixSound(voice, frames, stepLeft, stepRight)))
+            return false;
+
+        voice.gainLeft = targetLeft;
+        voice.gainRight = targetRight;
+        return !voice.stopping;
+    }
+
+    bool PixieAudioMixer::mixSound(Voice &voice, uint32_t frames, float stepLeft, float stepRight) {
+        const PixieSound &sound = *voice.sound;
+        const bool stereo = voice.channels == 2;
+        const float *left = sound.channel(0);
+        const float *right = sound.channel(stereo ? 1 : 0);
+        const uint64_t length = uint64_t(sound.frames()) << 32;
+        const uint64_t advance = step(voice);
+
+        // spans of a looping voice end before its last frame, that one interpolates towards the first frame instead of the padding
+        const uint64_t spanEnd = voice.params.loop ? length - (uint64_t(1) << 32) : length;
+        uint32_t done = 0;
+        while (done < frames) {
+            if (voice.position < spanEnd) {
+                const uint64_t reach = (spanEnd - voice.position + advance - 1) / advance;
+                const uint32_t count = reach < frames - done ? static_cast<uint32_t>(reach) : frames - done;
+                mixSpan(left, right, stereo, voice.position, advance, count, voice.gainLeft + float(done) * stepLeft, stepLeft,
+                    voice.gainRight + float(done) * stepRight, stepRight, mixLeft.data() + done, mixRight.data() + done);
+                voice.position += count * advance;
+                done += count;
+                continue;
+            }
+
+            if (!voice.params.loop)
+                return false;
+
+            if (voice.position < length) {
+                const auto index = static_cast<uint32_t>(voice.position >> 32);
+                const float fraction = float(voice.position & 0xffffffff) * (1.0f / 4294967296.0f);
+                const float l = left[index] + (left[0] - left[index]) * fraction;
+                const float r = stereo ? right[index] + (right[0] - right[index]) * fraction : l;
+                mixLeft[done] += l * (voice.gainLeft + float(done) * stepLeft);
+                mixRight[done] += r * (voice.gainRight + float(done) * stepRight);
+                voice.position += advance;
+                done++;
+            }
+            if (voice.position >= length)
+                voice.position %= length;
+        }
+        return true;
+    }
+
+    bool PixieAudioMixer::mixStream(Voice &voice, uint32_t frames, float stepLeft, float stepRight) {
+        PixieAudioStream &stream = *voice.stream;
+        const bool stereo = voice.channels == 2;
+        const uint64_t advance = step(voice);
+
+        uint32_t done = 0;
+        while (done < frames) {
+            // decoding fell behind, the rest of this block stays silent and playback picks up where it stopped
+            const PixieAudioBlock *block = stream.acquire();
+            if (!block) {
+                stream.underrun();
+                return true;
+            }
+
+            // every block carries the frame its first one interpolates from, so spans never cross a block
+            const uint64_t length = uint64_t(block->frames) << 32;
+            if (voice.position < length) {
+                const uint64_t reach = (length - voice.position + advance - 1) / advance;
+                const uint32_t count = reach < frames - done ? static_cast<uint32_t>(reach) : frames - done;
+                mixSpan(block->channel(0), block->channel(stereo ? 1 : 0), stereo, voice.position, advance, count, voice.gainLeft + float(done) * stepLeft,
+                    stepLeft, voice.gainRight + float(done) * stepRight, stepRight, mixLeft.data() + done, mixRight.data() + done);
+                voice.position += count * advance;
+                done += count;
+                continue;
+            }
+
+            voice.position -= length;
+            const bool last = block->last;
+            stream.release();
+            if (last)
+                return false;
+        }
+        return true;
+    }
+
+    void PixieAudioMixer::mixSpan(const float *left, const float *right, bool stereo, uint64_t position, uint64_t step, uint32_t frames, float gainLeft,
+        float stepLeft, float gainRight, float stepRight, float *dstLeft, float *dstRight) const {
+
+        const auto first = static_cast<size_t>(position >> 32);
+        const MixSpan span = {left + first, right + first, stereo, static_cast<uint32_t>((position & 0xffffffff) >> (32 - fracBits)),
+            static_cast<uint32_t>(step >> (32 - fracBits)), frames, gainLeft, stepLeft, gainRight, stepRight, dstLeft, dstRight};
+
+        switch (simdLevel) {
+            case PixieSIMDLevel::AVX2:
+                mixSpanAVX2(span);
+                break;
+            case PixieSIMDLevel::SSE2:
+                mixSpanSSE2(span);
+                break;
+            default:
+                mixSpanScalar(span, 0);
+                break;
+        }
+    }
+
+    void PixieAudioMixer::interleave(float *out, uint32_t frames) const {
+        uint32_t k = 0;
+        // bound by the stores, sse2 is as good as it gets here
+        if (simdLevel != PixieSIMDLevel::Scalar) {
+            const __m128 gain = _mm_set1_ps(masterGain);
+            const __m128 low = _mm_set1_ps(-1.0f);
+            const __m128 high = _mm_set1_ps(1.0f);
+            for (; k + 4 <= frames; k += 4) {
+                const __m128 left = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(mixLeft.data() + k), gain), low), high);
+                const __m128 right = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(mixRight.data() + k), gain), low), high);
+                _mm_storeu_ps(out + 2 * k, _mm_unpacklo_ps(left, right));
+                _mm_storeu_ps(out + 2 * k + 4, _mm_unpackhi_ps(left, right));
+            }
+        }
+        for (; k < frames; ++k) {
+            out[2 * k] = std::clamp(mixLeft[k] * masterGain, -1.0f, 1.0f);
+            out[2 * k + 1] = std::clamp(mixRight[k] * masterGain, -1.0f, 1.0f);
+        }
+    }
+
+    void PixieAudioMixer::render(float *out, uint32_t frames) {
+        PIXIE_ZONE("audio render");
+
+        Command command;
+        while (commands.pop(command))
+            apply(command);
+
+        const uint32_t total = frames;
+        while (frames != 0) {
+            const uint32_t count = frames < blockFrames ? frames : blockFrames;
+            std::fill_n(mixLeft.data(), count, 0.0f);
+            std::fill_n(mixRight.data(), count, 0.0f);
+
+            for (size_t i = 0; i < active.size();) {
+                Voice &voice = voices[active[i]];
+                if (mixVoice(voice, count)) {
+                    ++i;
+                    continue;
+                }
+
+                // can't fail, the queue holds every slot
+                finished.push(active[i]);
+                voice.sound = nullptr;
+                voice.stream = nullptr;
+                active[i] = active.back();
+                active.pop_back();
+            }
+
+            interleave(out, count);
+            out += size_t(count) * outputChannels;
+            frames -= count;
+        }
+
+        activeCount.store(static_cast<uint32_t>(active.size()), std::memory_order_relaxed);
+        framesRendered.fetch_add(total, std::memory_order_relaxed);
+    }
+
+    PixieOfflineAudioBackend::PixieOfflineAudioBackend(uint32_t periodFrames)
+        : periodFrames(periodFrames)
+        , mixer(nullptr) {
+
+        if (periodFrames == 0)
+            throw std::invalid_argument("PixieOfflineAudioBackend: period has to be positive");
+    }
+
+    void PixieOfflineAudioBackend::start(PixieAudioMixer &target) {
+        mixer = &target;
+    }
+
+    void PixieOfflineAudioBackend::stop() {
+        mixer = nullptr;
+    }
+
+    void PixieOfflineAudioBackend::render(uint32_t frames) {
+        if (!mixer)
+            throw std::logic_error("PixieOfflineAudioBackend: render before start");
+
+        while (frames != 0) {
+            const uint32_t count = std::min(frames, periodFrames);
+            const size_t offset = samples.size();
+            samples.resize(offset + size_t(count) * PixieAudioMixer::outputChannels);
+            mixer->render(samples.data() + offset, count);
+            frames -= count;
+        }
+    }
+} // namespace pxe
@@ -0,0 +1,199 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "simd.hpp"
+#include "spscqueue.hpp"
+
+namespace pxe {
+    class PixieAudioStream;
+
+    // decoded pcm kept planar, each channel carries one silent frame past its end so interpolation never reads out of bounds
+    class PixieSound {
+    public:
+        // 1 or 2 channels of interleaved floats in [-1, 1]
+        PixieSound(uint32_t sampleRate, uint32_t channels, const float *interleaved, uint32_t frames);
+
+        uint32_t sampleRate() const { return rate; }
+        uint32_t channels() const { return channelCount; }
+        uint32_t frames() const { return frameCount; }
+        const float *channel(uint32_t index) const { return samples.data() + size_t(index) * (frameCount + 1); }
+
+    private:
+        uint32_t rate;
+        uint32_t channelCount;
+        uint32_t frameCount;
+        std::vector<float> samples;
+    };
+
+    struct PixieVoiceParams {
+        float gain = 1.0f;
+        float pan = 0.0f; // -1 left to 1 right, equal power for mono sounds and balance for stereo ones
+        float pitch = 1.0f; // playback speed on top of the sound's own rate
+        bool loop = false;
+    };
+
+    // slot plus a generation, a handle stops doing anything once its voice has finished and the slot is reused
+    struct PixieVoiceHandle {
+        static const uint32_t slotBits = 16;
+        static const uint32_t slotMask = (1u << slotBits) - 1;
+
+        uint32_t value = UINT32_MAX;
+
+        uint32_t slot() const { return value & slotMask; }
+        uint32_t generation() const { return value >> slotBits; }
+        bool operator==(const PixieVoiceHandle &other) const { return value == other.value; }
+    };
+
+    static const PixieVoiceHandle invalidVoice = {};
+
+    struct PixieAudioStats {
+        uint32_t voices; // playing on the audio thread
+        uint32_t peakVoices;
+        uint64_t framesRendered;
+        uint64_t played;
+        uint64_t rejected; // every voice was busy
+        uint64_t droppedCommands; // the command queue was full
+    };
+
+    // software mixer with a fixed voice pool. one game thread drives it through play and the setters, which only
+    // queue commands, and one audio thread pulls stereo frames with render. neither side locks or waits on the other,
+    // the audio thread also never allocates or drops the last reference to a sound or stream, finished voices go back
+    // through a second queue and update() releases them on the game thread
+    class PixieAudioMixer {
+    public:
+        static const uint32_t blockFrames = 256; // gains ramp over a block, which is also the mixing granularity
+        static const uint32_t outputChannels = 2;
+        static constexpr float maxStep = 4.0f; // pitch times rate ratio clamps here, keeps a block's positions in 32 bits
+
+        PixieAudioMixer(uint32_t sampleRate, uint32_t maxVoices, uint32_t commandCapacity = 1024, PixieSIMDLevel level = detectSIMDLevel());
+
+        PixieAudioMixer(const PixieAudioMixer &) = delete;
+        PixieAudioMixer &operator=(const PixieAudioMixer &) = delete;
+
+        // game thread. invalidVoice when every voice is busy or the command queue is full
+        PixieVoiceHandle play(std::shared_ptr<const PixieSound> sound, const PixieVoiceParams &params = {});
+        // plays a stream from wherever its decoder is, the voice ends with the stream
+        PixieVoiceHandle play(std::shared_ptr<PixieAudioStream> stream, const PixieVoiceParams &params = {});
+        void setGain(PixieVoiceHandle voice, float gain);
+        void setPan(PixieVoiceHandle voice, float pan);
+        void setPitch(PixieVoiceHandle voice, float pitch);
+        // fades out over one block
+        void stop(PixieVoiceHandle voice);
+        void setMasterGain(float gain);
+        // true until update() sees the voice finish
+        bool playing(PixieVoiceHandle voice) const;
+        // takes finished voices back into the pool, once a frame
+        void update();
+
+        // audio thread, frames of interleaved stereo clamped to [-1, 1]
+        void render(float *out, uint32_t frames);
+
+        uint32_t sampleRate() const { return rate; }
+        uint32_t maxVoices() const { return static_cast<uint32_t>(voices.size()); }
+        void setSIMDLevel(PixieSIMDLevel level) { simdLevel = level; }
+        PixieSIMDLevel getSIMDLevel() const { return simdLevel; }
+        PixieAudioStats stats() const;
+
+    private:
+        enum class CommandType : uint8_t {
+            Play,
+            SetGain,
+            SetPan,
+            SetPitch,
+            Stop,
+            SetMasterGain
+        };
+
+        struct Command {
+            CommandType type;
+            uint32_t slot;
+            uint32_t generation;
+            float value;
+            const PixieSound *sound; // these two are kept alive by the game side's reference until the slot comes back
+            PixieAudioStream *stream;
+            PixieVoiceParams params;
+        };
+
+        // audio thread only
+        struct Voice {
+            const PixieSound *sound; // one of the two, null in a free slot
+            PixieAudioStream *stream;
+            uint64_t position; // source frames in 32.32 fixed point, from the start of the current block for streams
+            PixieVoiceParams params;
+            float gainLeft; // where the last block's ramp ended
+            float gainRight;
+            uint32_t sampleRate;
+            uint32_t channels;
+            uint32_t generation;
+            bool stopping;
+        };
+
+        PixieVoiceHandle start(std::shared_ptr<const void> owner, const PixieSound *sound, PixieAudioStream *stream, const PixieVoiceParams &params);
+        bool send(const Command &command);
+        void apply(const Command &command);
+        void targetGains(const Voice &voice, float &left, float &right) const;
+        uint64_t step(const Voice &voice) const;
+        // false once the voice ran off the end of its sound or finished stopping
+        bool mixVoice(Voice &voice, uint32_t frames);
+        bool mixSound(Voice &voice, uint32_t frames, float stepLeft, float stepRight);
+        bool mixStream(Voice &voice, uint32_t frames, float stepLeft, float stepRight);
+        void mixSpan(const float *left, const float *right, bool stereo, uint64_t position, uint64_t step, uint32_t frames, float gainLeft,
+            float stepLeft, float gainRight, float stepRight, float *dstLeft, float *dstRight) const;
+        void interleave(float *out, uint32_t frames) const;
+
+        uint32_t rate;
+        PixieSIMDLevel simdLevel;
+
+        PixieSPSCQueue<Command> commands;
+        PixieSPSCQueue<uint32_t> finished; // slots, as large as the pool so it can't fill
+
+        // game side
+        std::vector<std::shared_ptr<const void>> owners; // the sound or stream per slot, null while it's free
+        std::vector<uint32_t> generations;
+        std::vector<uint32_t> freeSlots;
+        uint64_t played;
+        uint64_t rejected;
+        uint64_t droppedCommands;
+
+        // audio side
+        std::vector<Voice> voices;
+        std::vector<uint32_t> active; // reserved for the whole pool up front
+        std::vector<float> mixLeft;
+        std::vector<float> mixRight;
+        float masterGain;
+        std::atomic<uint32_t> activeCount;
+        std::atomic<uint32_t> peakVoices;
+        std::atomic<uint64_t> framesRendered;
+    };
+
+    // where the mixer's output goes, the backend's own thread calls render
+    class PixieAudioBackend {
+    public:
+        virtual ~PixieAudioBackend() = default;
+
+        virtual void start(PixieAudioMixer &mixer) = 0;
+        virtual void stop() = 0;
+    };
+
+    // renders on the calling thread into memory, for tests, benchmarks and bouncing audio to disk
+    class PixieOfflineAudioBackend : public PixieAudioBackend {
+    public:
+        explicit PixieOfflineAudioBackend(uint32_t periodFrames = 512);
+
+        void start(PixieAudioMixer &mixer) override;
+        void stop() override;
+
+        // pulls frames in device sized periods and appends them to the output
+        void render(uint32_t frames);
+        const std::vector<float> &output() const { return samples; }
+        void clear() { samples.clear(); }
+
+    private:
+        uint32_t periodFrames;
+        PixieAudioMixer *mixer;
+        std::vector<float> samples;
+    };
+} // namespace pxe
@@ -0,0 +1,175 @@
+#include "audiostream.hpp"
+#include "profiler.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace pxe {
+    PixieAudioStream::PixieAudioStream(std::unique_ptr<PixieAudioDecoder> decoder, const PixieAudioStreamSettings &settings)
+        : decoder(std::move(decoder))
+        , settings(settings)
+        , blocks(settings.blockCount)
+        , freeBlocks(settings.blockCount)
+        , readyBlocks(settings.blockCount)
+        , ended(false)
+        , current(nullptr)
+        , blocksDecoded(0)
+        , framesDecoded(0)
+        , underruns(0) {
+
+        if (!this->decoder)
+            throw std::invalid_argument("PixieAudioStream: no decoder");
+        const uint32_t channels = this->decoder->channels();
+        if (channels != 1 && channels != 2)
+            throw std::invalid_argument("PixieAudioStream: only mono and stereo tracks can be played");
+        if (settings.blockFrames == 0 || settings.blockCount == 0)
+            throw std::invalid_argument("PixieAudioStream: empty block ring");
+
+        scratch.resize(size_t(settings.blockFrames) * channels);
+        carry.assign(channels, 0.0f);
+        for (PixieAudioBlock &block : blocks) {
+            block.stride = settings.blockFrames + 1;
+            block.samples.assign(size_t(block.stride) * channels, 0.0f);
+            block.frames = 0;
+            block.last = false;
+            freeBlocks.push(&block);
+        }
+
+        fill();
+    }
+
+    bool PixieAudioStream::fill() {
+        PixieAudioBlock *block = nullptr;
+        if (ended || !freeBlocks.pop(block))
+            return false;
+
+        PIXIE_ZONE("audio decode");
+        const uint32_t channels = decoder->channels();
+        uint32_t frames = 0;
+        while (frames < settings.blockFrames) {
+            frames += decoder->decode(scratch.data() + size_t(frames) * channels, settings.blockFrames - frames);
+            if (frames == settings.blockFrames)
+                break;
+            // short means the end of the track
+            if (!settings.loop || decoder->frames() == 0) {
+                ended = true;
+                break;
+            }
+            decoder->seek(0);
+        }
+
+        for (uint32_t c = 0; c < channels; ++c) {
+            float *dst = block->samples.data() + size_t(c) * block->stride;
+            dst[0] = carry[c];
+            for (uint32_t i = 0; i < frames; ++i)
+                dst[i + 1] = scratch[size_t(i) * channels + c];
+            carry[c] = dst[frames];
+        }
+        block->frames = frames;
+        block->last = ended;
+
+        // can't fail, the ring only holds the stream's own blocks
+        readyBlocks.push(block);
+        blocksDecoded.fetch_add(1, std::memory_order_relaxed);
+        framesDecoded.fetch_add(frames, std::memory_order_relaxed);
+        return true;
+    }
+
+    const PixieAudioBlock *PixieAudioStream::acquire() {
+        if (!current)
+            readyBlocks.pop(current);
+        return current;
+    }
+
+    void PixieAudioStream::release() {
+        if (current) {
+            freeBlocks.push(current);
+            current = nullptr;
+        }
+    }
+
+    PixieAudioStreamStats PixieAudioStream::stats() const {
+        PixieAudioStreamStats result = {};
+        result.blocksDecoded = blocksDecoded.load(std::memory_order_relaxed);
+        result.framesDecoded = framesDecoded.load(std::memory_order_relaxed);
+        result.underruns = underruns.load(std::memory_order_relaxed);
+        result.memoryBytes = sizeof(*this) + decoder->memoryBytes() + (scratch.capacity() + carry.capacity()) * sizeof(float) +
+            (freeBlocks.capacity() + readyBlocks.capacity()) * sizeof(PixieAudioBlock *);
+        for (const PixieAudioBlock &block : blocks)
+            result.memoryBytes += sizeof(block) + block.samples.capacity() * sizeof(float);
+        return result;
+    }
+
+    PixieAudioStreamer::PixieAudioStreamer(std::chrono::milliseconds pollInterval)
+        : pollInterval(pollInterval)
+        , stopping(false)
+        , thread([this] { run(); }) {
+    }
+
+    PixieAudioStreamer::~PixieAudioStreamer() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        thread.join();
+    }
+
+    std::shared_ptr<PixieAudioStream> PixieAudioStreamer::open(std::unique_ptr<PixieAudioDecoder> decoder, const PixieAudioStreamSettings &settings) {
+        auto stream = std::make_shared<PixieAudioStream>(std::move(decoder), settings);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            streams.push_back(stream);
+        }
+        wake.notify_all();
+        return stream;
+    }
+
+    size_t PixieAudioStreamer::streamCount() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return streams.size();
+    }
+
+    void PixieAudioStreamer::run() {
+        PixieProfiler::setThreadName("audio streamer");
+
+        // the audio thread never signals anything, blocks it frees are picked up on the next poll.
+        // a poll is a lot shorter than a block, so that only eats into the slack the read ahead gives
+        std::vector<std::shared_ptr<PixieAudioStream>> pass;
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!stopping) {
+            pass.clear();
+            for (size_t i = 0; i < streams.size();) {
+                std::shared_ptr<PixieAudioStream> stream = streams[i].lock();
+                if (stream && !stream->exhausted()) {
+                    pass.push_back(std::move(stream));
+                    ++i;
+                } else {
+                    streams[i] = std::move(streams.back());
+                    streams.pop_back();
+                }
+            }
+
+            lock.unlock();
+            for (const std::shared_ptr<PixieAudioStream> &stream : pass) {
+                while (stream->fill()) {
+                }
+            }
+            // a stream's last reference may go here, off the game and audio threads
+            pass.clear();
+            lock.lock();
+
+            wake.wait_for(lock, pollInterval, [this] { return stopping; });
+        }
+    }
+
+    std::shared_ptr<PixieSound> decodeSound(PixieAudioDecoder &decoder) {
+        const uint64_t frames = decoder.frames();
+        if (frames > UINT32_MAX)
+            throw std::runtime_error("decodeSound: track too long to keep in memory, stream it");
+
+        std::vector<float> samples(size_t(frames) * decoder.channels());
+        decoder.seek(0);
+        const uint32_t decoded = decoder.decode(samples.data(), static_cast<uint32_t>(frames));
+        return std::make_shared<PixieSound>(decoder.sampleRate(), decoder.channels(), samples.data(), decoded);
+    }
+} // namespace pxe
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "audio.hpp"
+#include "spscqueue.hpp"
+#include "wav.hpp"
+
+namespace pxe {
+    struct PixieAudioStreamSettings {
+        uint32_t blockFrames = 4096; // 85 ms at 48 kHz
+        uint32_t blockCount = 2; // double buffered, one block plays while the next decodes
+        bool loop = false; // the decoder seeks back to the start, the voice's own loop flag is ignored for streams
+    };
+
+    struct PixieAudioStreamStats {
+        uint64_t blocksDecoded;
+        uint64_t framesDecoded;
+        uint64_t underruns; // mixer blocks that found nothing decoded and played silence
+        size_t memoryBytes; // decoded blocks, scratch and decoder state, mapped pages aren't counted
+    };
+
+    // one stretch of decoded stream, planar like PixieSound. frame 0 repeats the last frame of the block before,
+    // so interpolating across the seam never needs that block back
+    struct PixieAudioBlock {
+        std::vector<float> samples;
+        uint32_t stride; // per channel, blockFrames + 1
+        uint32_t frames; // new frames after the repeated one
+        bool last;
+
+        const float *channel(uint32_t index) const { return samples.data() + size_t(index) * stride; }
+    };
+
+    // a track decoded a few blocks ahead of playback. the streamer's thread fills blocks and the audio thread plays
+    // them, the two only meet in a pair of lock-free queues. one voice at a time can play a stream
+    class PixieAudioStream {
+    public:
+        // decodes the first block on the calling thread so the stream can start playing straight away
+        PixieAudioStream(std::unique_ptr<PixieAudioDecoder> decoder, const PixieAudioStreamSettings &settings = {});
+
+        PixieAudioStream(const PixieAudioStream &) = delete;
+        PixieAudioStream &operator=(const PixieAudioStream &) = delete;
+
+        uint32_t sampleRate() const { return decoder->sampleRate(); }
+        uint32_t channels() const { return decoder->channels(); }
+
+        // decoding thread. fills one free block, false when none is free or the track has been decoded to its end
+        bool fill();
+        bool exhausted() const { return ended; }
+
+        // audio thread. the block being played, nullptr when decoding has fallen behind
+        const PixieAudioBlock *acquire();
+        // hands the acquired block back to be decoded into again
+        void release();
+        void underrun() { underruns.fetch_add(1, std::memory_order_relaxed); }
+
+        PixieAudioStreamStats stats() const;
+
+    private:
+        std::unique_ptr<PixieAudioDecoder> decoder;
+        PixieAudioStreamSettings settings;
+        std::vector<PixieAudioBlock> blocks;
+        PixieSPSCQueue<PixieAudioBlock *> freeBlocks; // audio thread to decoder
+        PixieSPSCQueue<PixieAudioBlock *> readyBlocks; // decoder to audio thread
+
+        // decoding thread
+        std::vector<float> scratch; // one block interleaved, straight from the decoder
+        std::vector<float> carry; // last decoded frame, repeated at the start of the next block
+        bool ended;
+
+        // audio thread
+        PixieAudioBlock *current;
+
+        std::atomic<uint64_t> blocksDecoded;
+        std::atomic<uint64_t> framesDecoded;
+        std::atomic<uint64_t> underruns;
+    };
+
+    // one background thread keeping every open stream's blocks full. it only holds streams weakly,
+    // a stream nobody plays or keeps any more is dropped on its next pass
+    class PixieAudioStreamer {
+    public:
+        explicit PixieAudioStreamer(std::chrono::milliseconds pollInterval = std::chrono::milliseconds(2));
+        ~PixieAudioStreamer();
+
+        PixieAudioStreamer(const PixieAudioStreamer &) = delete;
+        PixieAudioStreamer &operator=(const PixieAudioStreamer &) = delete;
+
+        std::shared_ptr<PixieAudioStream> open(std::unique_ptr<PixieAudioDecoder> decoder, const PixieAudioStreamSettings &settings = {});
+        // still decoding
+        size_t streamCount() const;
+
+    private:
+        void run();
+
+        std::chrono::milliseconds pollInterval;
+        mutable std::mutex mutex;
+        std::condition_variable wake;
+        std::vector<std::weak_ptr<PixieAudioStream>> streams;
+        bool stopping;
+        std::thread thread; // last, it starts running in the constructor
+    };
+
+    // decodes a whole track up front, for sounds short enough to keep in memory
+    std::shared_ptr<PixieSound> decodeSound(PixieAudioDecoder &decoder);
+} // namespace pxe
@@ -0,0 +1,1314 @@
+#include "allocators.hpp"
+#include "atlas.hpp"
+#include "audio.hpp"
+#include "audiostream.hpp"
+#include "descriptors.hpp"
+#include "drawqueue.hpp"
+#include "entity.hpp"
+#include "framecapture.hpp"
+#include "framepacer.hpp"
+#include "framering.hpp"
+#include "input.hpp"
+#include "mipgen.hpp"
+#include "pixelconvert.hpp"
+#include "profiler.hpp"
+#include "recorder.hpp"
+#include "shadercache.hpp"
+#include "softrenderer.hpp"
+#include "spatial.hpp"
+#include "taskgraph.hpp"
+#include "texturefile.hpp"
+#include "texturestream.hpp"
+#include "transform2d.hpp"
+#include "upload.hpp"
+#include "wav.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// headless throughput numbers for the cpu side, no window or gpu needed
+// usage: bench [--json <path>] [--samples <n>] [--filter <group>], compare two json runs with benchcompare
+
+using namespace pxe;
+
+// every benchmark() run, for the json report
+struct BenchResult {
+    std::string name;
+    int iterations; // per sample
+    std::vector<double> samples; // ms per iteration
+};
+
+static std::vector<BenchResult> results;
+static int sampleCount = 5;
+
+template <typename Fn>
+static double benchmark(const char *name, int iterations, Fn &&fn) {
+    fn(); // warm up
+
+    // split into batches so two runs can be compared on their spread, not just one average. benchmarks with fewer
+    // iterations than samples run once per sample
+    BenchResult result = {name, iterations / sampleCount > 1 ? iterations / sampleCount : 1, {}};
+    double total = 0.0;
+    for (int sample = 0; sample < sampleCount; ++sample) {
+        const auto begin = std::chrono::steady_clock::now();
+        for (int i = 0; i < result.iterations; ++i)
+            fn();
+        const auto end = std::chrono::steady_clock::now();
+
+        const double ms = std::chrono::duration<double, std::milli>(end - begin).count() / result.iterations;
+        result.samples.push_back(ms);
+        total += ms;
+    }
+    results.push_back(std::move(result));
+
+    const double ms = total / sampleCount;
+    std::printf("%-40s %10.3f ms\n", name, ms);
+    return ms;
+}
+
+static void benchSoftRenderer() {
+    constexpr uint32_t width = 1024;
+    constexpr uint32_t height = 768;
+    constexpr int spriteCount = 10000;
+
+    PixieSoftRenderer renderer(width, height);
+
+    std::vector<uint32_t> checker(64 * 64);
+    for (uint32_t i = 0; i < checker.size(); ++i)
+        checker[i] = ((i / 64 / 8 + i % 64 / 8) & 1) ? 0xffffffffu : 0xff2020c0u;
+    const uint32_t texture = renderer.createTexture(64, 64, checker.data());
+
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> pos(0.0f, 1000.0f);
+    std::vector<PixieRect> rects;
+    for (int i = 0; i < spriteCount; ++i)
+        rects.push_back({pos(rng), pos(rng) * 0.75f, 51.2f, 38.4f});
+
+    float color[4] = {0.1f, 0.1f, 0.1f, 1.0f};
+
+    std::printf("soft renderer %ux%u, %d sprites, %zu threads\n", width, height, spriteCount, renderer.threadCount());
+
+    for (auto level : {PixieSIMDLevel::Scalar, PixieSIMDLevel::SSE2, PixieSIMDLevel::AVX2}) {
+        if (level > detectSIMDLevel())
+            continue;
+
+        renderer.setSIMDLevel(level);
+
+        char name[64];
+        std::snprintf(name, sizeof(name), "softrenderer/frame/%s", simdLevelName(level));
+        const double ms = benchmark(name, 20, [&] {
+            renderer.beginFrame(color);
+            for (const auto &rect : rects)
+                renderer.drawSprite(texture, rect, {0.0f, 0.0f, 1.0f, 1.0f}, 0xffffffff, PixieTransform2D::identity());
+            renderer.endFrame();
+        });
+
+        std::printf("%-40s %10.1f Mtri/s\n", "", renderer.stats().trianglesBinned / ms / 1000.0);
+    }
+}
+
+static void benchSpriteBatch() {
+    constexpr uint32_t spriteCount = 100000;
+    constexpr uint32_t textureCount = 8;
+
+    struct NullSink final : PixieBatchSink {
+        uint64_t quads = 0;
+        void drawQuads(const PixieDrawRun &run) override { quads += run.quadCount; }
+    } sink;
+
+    std::vector<PixieVertexData> ring(spriteCount * 4);
+    PixieSpriteBatch batch(ring.data(), static_cast<uint32_t>(ring.size()));
+
+    const PixieTransform2D transform = {0.8f, 0.6f, -0.6f, 0.8f, 512.0f, 384.0f};
+
+    // sprites arrive with their textures interleaved, the sort key groups them back into one run per texture
+    benchmark("spritebatch/100k", 50, [&] {
+        batch.release(batch.frameMarker());
+        batch.begin(1024.0f, 768.0f);
+        for (uint32_t i = 0; i < spriteCount; ++i) {
+            const float x = static_cast<float>(i % 1024);
+            batch.drawSprite(i % textureCount, {x, x * 0.5f, 16.0f, 16.0f}, {0.0f, 0.0f, 1.0f, 1.0f}, 0xffffffff, transform);
+        }
+        batch.flush(sink);
+    });
+
+    std::printf("%-40s %10u draws, %u texture binds\n", "", batch.stats().draws, batch.stats().textureChanges);
+}
+
+static void benchDrawQueue() {
+    std::mt19937_64 rng(7);
+
+    for (const uint32_t count : {100000u, 1000000u}) {
+        // a realistic spread: a few layers and pipelines, a few thousand textures, random depth
+        std::vector<PixieDrawPacket> packets(count);
+        for (uint32_t i = 0; i < count; ++i) {
+            const auto layer = static_cast<uint32_t>(rng() % 4);
+            const auto pipeline = static_cast<uint32_t>(rng() % 8);
+            const auto texture = static_cast<uint32_t>(rng() % 4096);
+            packets[i] = {PixieSortKey::make(layer, pipeline, texture, static_cast<float>(rng() % 1000) / 1000.0f), i};
+        }
+
+        std::vector<PixieDrawPacket> sorted(count);
+        std::vector<PixieDrawPacket> scratch(count);
+        const std::string name = "drawqueue/radix-" + std::to_string(count / 1000) + "k";
+        const double ms = benchmark(name.c_str(), 20, [&] {
+            sorted = packets;
+            PixieDrawQueue::radixSort(sorted.data(), scratch.data(), count);
+        });
+        std::printf("%-40s %10.2f ns per packet\n", "", ms * 1e6 / count);
+
+        const std::string reference = "drawqueue/stable_sort-" + std::to_string(count / 1000) + "k";
+        benchmark(reference.c_str(), 5, [&] {
+            sorted = packets;
+            std::stable_sort(sorted.begin(), sorted.end(), [](const PixieDrawPacket &a, const PixieDrawPacket &b) { return a.key < b.key; });
+        });
+    }
+}
+
+static void benchFrameRing() {
+    constexpr int frameCount = 100000;
+
+    // gpu finishing each frame `latency` frames after submit, waits show how far ahead the cpu can run
+    for (uint32_t inFlight = 1; inFlight <= PixieFrameRing::maxFramesInFlight; ++inFlight) {
+        for (uint32_t latency = 0; latency <= 3; ++latency) {
+            PixieMockQueue queue(latency);
+            PixieFrameRing frames(queue, inFlight);
+
+            char name[64];
+            std::snprintf(name, sizeof(name), "framering/%u-in-flight/latency-%u", inFlight, latency);
+            const double ms = benchmark(name, 1, [&] {
+                for (int i = 0; i < frameCount; ++i) {
+                    frames.beginFrame();
+                    frames.endFrame();
+                }
+            });
+
+            std::printf("%-40s %10.1f ns/frame, %.2f waits/frame\n", "", ms * 1e6 / frameCount, double(frames.stats().waits) / frames.stats().frames);
+        }
+    }
+}
+
+static void benchUploadAllocator() {
+    constexpr uint64_t ringSize = 32 * 1024 * 1024;
+    constexpr int frameCount = 1000;
+    constexpr int uploadsPerFrame = 64;
+
+    std::vector<std::vector<uint8_t>> memory;
+    PixieUploadAllocator uploads(ringSize, 4, [&](uint32_t, uint64_t size) {
+        memory.emplace_back(size);
+        return memory.back().data();
+    });
+
+    // textures from 16x16 up to 256x256 streaming in while the gpu trails two frames behind
+    PixieMockQueue queue(2);
+    PixieFrameRing frames(queue, 3);
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<uint32_t> side(16, 256);
+
+    const double ms = benchmark("upload/allocate-64-per-frame", 1, [&] {
+        for (int frame = 0; frame < frameCount; ++frame) {
+            frames.beginFrame();
+            uploads.retire(queue.completedValue());
+
+            for (int i = 0; i < uploadsPerFrame; ++i) {
+                const uint32_t w = side(rng);
+                const uint32_t h = side(rng);
+                const uint64_t size = PixieUploadAllocator::textureSize(w, h, 4);
+
+                PixieUploadRegion region;
+                while (!uploads.allocate(size, PixieUploadAllocator::placementAlignment, region)) {
+                    queue.waitFor(uploads.oldestPendingFence());
+                    uploads.retire(queue.completedValue());
+                }
+            }
+
+            uploads.submit(frames.endFrame());
+        }
+    });
+
+    const auto &stats = uploads.stats();
+    std::printf("%-40s %10.1f ns/alloc\n", "", ms * 1e6 / (frameCount * uploadsPerFrame));
+    std::printf("%-40s %10u rings, high water %.1f MB, %llu failed\n", "", stats.rings, stats.highWaterMark / 1048576.0, static_cast<unsigned long long>(stats.failedAllocations));
+}
+
+static void benchAtlas() {
+    constexpr int imageCount = 2000;
+
+    // sprite sheets are mostly small and squarish with the odd long strip
+    std::mt19937 rng(3);
+    std::uniform_int_distribution<uint32_t> side(8, 96);
+    std::vector<std::vector<uint32_t>> texels;
+    std::vector<PixieAtlasImage> images;
+    for (int i = 0; i < imageCount; ++i) {
+        const uint32_t w = side(rng);
+        const uint32_t h = (i % 10 == 0) ? side(rng) * 3 : side(rng);
+        texels.emplace_back(static_cast<size_t>(w) * h, 0xff00ff00u + i);
+        images.push_back({"sprite" + std::to_string(i), w, h, nullptr});
+    }
+
+    PixieAtlasBuilder builder;
+    benchmark("atlas/pack-2000", 3, [&] {
+        builder = PixieAtlasBuilder();
+        for (int i = 0; i < imageCount; ++i) {
+            images[i].texels = texels[i].data();
+            builder.add(images[i]);
+        }
+        builder.build();
+    });
+
+    const PixieAtlas atlas(builder.serializeIndex());
+    std::printf("%-40s %10zu pages, %.1f%% efficiency\n", "", builder.pages().size(), builder.efficiency() * 100.0);
+
+    PixieAtlasSprite sprite;
+    int found = 0;
+    benchmark("atlas/lookup-2000", 100, [&] {
+        for (const auto &image : images)
+            found += atlas.find(image.name, sprite);
+    });
+}
+
+static void benchTextureFile() {
+    constexpr uint32_t size = 2048;
+
+    const auto layout = PixieTextureLayout::make(PixieTextureFormat::RGBA8, size, size, PixieTextureLayout::fullMipCount(size, size));
+    std::vector<std::vector<uint8_t>> levels;
+    std::vector<const uint8_t *> texels;
+    for (const auto &mip : layout.mips) {
+        levels.emplace_back(static_cast<size_t>(mip.width) * mip.height * 4, static_cast<uint8_t>(levels.size()));
+        texels.push_back(levels.back().data());
+    }
+
+    const auto path = (std::filesystem::temp_directory_path() / "pixie_bench.pxtex").string();
+    benchmark("texturefile/write-2048", 5, [&] { writeTextureFile(path, layout, texels.data()); });
+
+    // warm page cache, so this is the best case of the disk bandwidth bound
+    std::vector<uint8_t> staging(layout.dataSize);
+    const double ms = benchmark("texturefile/map-copy-2048", 20, [&] {
+        const PixieTextureFile file(path);
+        std::memcpy(staging.data(), file.data(), file.layout().dataSize);
+    });
+    std::printf("%-40s %10.2f GB/s\n", "", layout.dataSize / (ms * 1e6));
+
+    std::filesystem::remove(path);
+}
+
+static void benchPixelConvert() {
+    constexpr uint32_t size = 2048;
+
+    std::mt19937 rng(7);
+    std::vector<uint8_t> source(static_cast<size_t>(size) * size * 4);
+    for (auto &byte : source)
+        byte = static_cast<uint8_t>(rng());
+
+    uint32_t palette[256];
+    for (auto &entry : palette)
+        entry = rng();
+
+    const std::pair<const char *, PixieSourceFormat> formats[] = {
+        {"bgra8", PixiePixelConverter::bgra8()},
+        {"rgb8", PixiePixelConverter::rgb8()},
+        {"index8", {1, 0, 0, 0, 0, palette, 256}},
+        {"rgb565", {2, 0xf800, 0x07e0, 0x001f, 0}},
+    };
+
+    std::vector<uint32_t> texels(static_cast<size_t>(size) * size);
+    for (const auto level : {PixieSIMDLevel::Scalar, PixieSIMDLevel::SSE2, PixieSIMDLevel::AVX2}) {
+        if (level > detectSIMDLevel())
+            break;
+
+        PixiePixelConverter converter(level);
+        for (const auto &[name, format] : formats) {
+            const std::string label = std::string("convert/") + name + "-2048/" + simdLevelName(level);
+            benchmark(label.c_str(), 10, [&] { converter.convert(format, source.data(), size * format.bytesPerPixel, size, size, texels.data(), size * 4); });
+        }
+
+        const std::string premultiply = std::string("convert/premultiply-2048/") + simdLevelName(level);
+        benchmark(premultiply.c_str(), 10, [&] { converter.premultiply(texels.data(), texels.size()); });
+
+        const std::string linear = std::string("convert/srgb-linear-2048/") + simdLevelName(level);
+        benchmark(linear.c_str(), 10, [&] { converter.transform(texels.data(), texels.size(), PixieColorTransform::SRGBToLinear); });
+    }
+}
+
+static void benchMipGen() {
+    PixieMipGenerator generator;
+    std::mt19937 rng(11);
+
+    for (const uint32_t size : {1024u, 4096u, 8192u}) {
+        std::vector<uint32_t> texels(static_cast<size_t>(size) * size);
+        for (auto &texel : texels)
+            texel = rng();
+
+        const int iterations = size >= 8192 ? 1 : (size >= 4096 ? 2 : 10);
+        for (const auto &[name, filter] : {std::pair{"box", PixieMipFilter::Box}, std::pair{"lanczos", PixieMipFilter::Lanczos}}) {
+            PixieMipSettings settings;
+            settings.filter = filter;
+
+            const std::string label = std::string("mipgen/") + name + "-" + std::to_string(size);
+            benchmark(label.c_str(), iterations, [&] { generator.generate(texels.data(), size, size, settings); });
+        }
+    }
+    std::printf("%-40s %10zu threads\n", "", generator.threadCount());
+}
+
+static void benchTextureStream() {
+    constexpr int textureCount = 512;
+    constexpr uint32_t size = 256;
+
+    struct NullStreamSink final : PixieStreamSink {
+        void makeResident(PixieTextureHandle, const PixieDecodedTexture &) override {}
+        void evict(PixieTextureHandle) override {}
+    } sink;
+
+    // decode stand-in: fill level 0 and build its mips, roughly what a png costs minus zlib
+    const auto decoder = [](const std::string &, PixieDecodedTexture &texture) {
+        thread_local PixieMipGenerator generator(1);
+        std::vector<PixieMipLevel> &levels = texture.levels;
+        levels.push_back({size, size, std::vector<uint32_t>(static_cast<size_t>(size) * size, 0xff336699u)});
+        auto mips = generator.generate(levels[0].texels.data(), size, size, PixieMipSettings());
+        std::move(mips.begin(), mips.end(), std::back_inserter(levels));
+        return true;
+    };
+
+    PixieStreamSettings settings;
+    settings.budgetBytes = 64ull * 1024 * 1024; // about half the set, so the lru keeps cycling
+    settings.threadCount = 4;
+
+    PixieTextureStreamer streamer(decoder, sink, settings);
+    std::vector<PixieTextureHandle> handles;
+    for (int i = 0; i < textureCount; ++i)
+        handles.push_back(streamer.registerTexture("texture" + std::to_string(i)));
+
+    // a camera sweeping over the set: each step wants a window of 64 textures and runs frames until they're all in,
+    // the window moves 8 per step so older textures fall out of the budget and get evicted
+    int frames = 0;
+    const double ms = benchmark("stream/sweep-512", 1, [&] {
+        frames = 0;
+        for (int step = 0; step < textureCount / 8; ++step) {
+            for (bool resident = false; !resident; ++frames) {
+                resident = true;
+                for (int i = 0; i < 64; ++i)
+                    resident &= streamer.resolve(handles[(step * 8 + i) % textureCount]);
+                streamer.update();
+                std::this_thread::yield();
+            }
+        }
+    });
+    std::printf("%-40s %10d frames, %.3f ms per frame\n", "", frames, ms / frames);
+
+    streamer.waitIdle();
+    const PixieStreamStats stats = streamer.stats();
+    std::printf("%-40s %10zu resident, %.1f MB, %llu loads, %llu evictions, p50 %.2f ms, p95 %.2f ms, p99 %.2f ms\n", "",
+        stats.resident, stats.bytesResident / (1024.0 * 1024.0), static_cast<unsigned long long>(stats.loads),
+        static_cast<unsigned long long>(stats.evictions), stats.latencyP50Ms, stats.latencyP95Ms, stats.latencyP99Ms);
+}
+
+static void benchShaderCache() {
+    constexpr int variants = 64;
+
+    // stands in for fxc, 4 KB of bytecode per variant so the pack is about the size of a real one
+    struct StubCompiler final : PixieShaderCompiler {
+        std::string identity() const override { return "bench"; }
+        std::vector<uint8_t> compile(const PixieShaderDesc &desc) override { return std::vector<uint8_t>(4096, static_cast<uint8_t>(desc.flags)); }
+    } compiler;
+
+    const auto directory = std::filesystem::temp_directory_path() / "pixie_bench_shaders";
+    std::filesystem::create_directories(directory);
+    std::ofstream(directory / "common.hlsli") << "Texture2D g_texture : register(t0);\nSamplerState g_sampler : register(s0);\n";
+    std::ofstream(directory / "sprite.hlsl") << "#include \"common.hlsli\"\nfloat4 PSMain(float2 uv : TEXCOORD) : SV_TARGET { return g_texture.Sample(g_sampler, uv); }\n";
+
+    const std::string source = (directory / "sprite.hlsl").string();
+    const std::string pack = (directory / "shaders.pxsc").string();
+    const auto getAll = [&](PixieShaderCache &cache) {
+        for (uint32_t i = 0; i < variants; ++i)
+            cache.get({source, "PSMain", "ps_5_0", {{"VARIANT", std::to_string(i)}}, i});
+    };
+
+    benchmark("shadercache/cold-64", 10, [&] {
+        std::filesystem::remove(pack);
+        PixieShaderCache cache(compiler, pack);
+        getAll(cache);
+    });
+
+    // what startup pays once the pack exists: map, hash sources, check each blob
+    const double ms = benchmark("shadercache/warm-64", 50, [&] {
+        PixieShaderCache cache(compiler, pack);
+        getAll(cache);
+    });
+    std::printf("%-40s %10.2f us per shader\n", "", ms * 1000.0 / variants);
+
+    std::filesystem::remove_all(directory);
+}
+
+static void benchCommandRecorder() {
+    constexpr size_t runCount = 20000;
+
+    // stands in for d3d12 lists, every command is hashed a few times to cost roughly what a driver call does
+    struct FakeBackend final : PixieRecordBackend {
+        std::vector<std::vector<uint64_t>> lists;
+        uint64_t streamHash = 0;
+
+        uint32_t createContext() override {
+            lists.emplace_back();
+            return static_cast<uint32_t>(lists.size() - 1);
+        }
+        void openContext(uint32_t context) override { lists[context].clear(); }
+        void closeContext(uint32_t) override {}
+        void submitContexts(const uint32_t *contexts, size_t count) override {
+            streamHash = 14695981039346656037ull;
+            for (size_t i = 0; i < count; ++i) {
+                for (const uint64_t command : lists[contexts[i]])
+                    streamHash = (streamHash ^ command) * 1099511628211ull;
+            }
+        }
+    };
+
+    const auto recordRuns = [](FakeBackend &backend) {
+        return [&backend](uint32_t context, size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i) {
+                uint64_t command = i;
+                for (int round = 0; round < 64; ++round)
+                    command = (command ^ (command >> 29)) * 0xbf58476d1ce4e5b9ull;
+                backend.lists[context].push_back(command);
+            }
+        };
+    };
+
+    // everything in one job on the calling thread is the serial baseline, and the stream every split has to reproduce
+    FakeBackend serialBackend;
+    PixieCommandRecorder serial(serialBackend, 1);
+    const double serialMs = benchmark("recorder/serial-20k", 10, [&] {
+        serial.beginFrame(0);
+        serial.record(runCount, runCount, recordRuns(serialBackend));
+        serial.submit();
+    });
+
+    const size_t maxWorkers = std::max<size_t>(std::thread::hardware_concurrency(), 2);
+    for (size_t workers = 1; workers <= maxWorkers; workers *= 2) {
+        FakeBackend backend;
+        PixieCommandRecorder recorder(backend, workers);
+
+        const std::string name = "recorder/" + std::to_string(workers) + "-workers-20k";
+        const double ms = benchmark(name.c_str(), 10, [&] {
+            recorder.beginFrame(0);
+            recorder.record(runCount, 64, recordRuns(backend));
+            recorder.submit();
+        });
+        std::printf("%-40s %10.2fx, %u lists, %s\n", "", serialMs / ms, recorder.stats().jobs,
+            backend.streamHash == serialBackend.streamHash ? "same stream as serial" : "STREAM DIFFERS");
+    }
+}
+
+static void benchDescriptors() {
+    constexpr uint32_t churnPerThread = 200000;
+
+    // streaming churn, every thread frees what it allocated a few steps earlier so slots keep moving between threads
+    const size_t maxThreads = std::max<size_t>(std::thread::hardware_concurrency(), 2);
+    for (size_t threads = 1; threads <= maxThreads; threads *= 2) {
+        PixieDescriptorAllocator descriptors(65536, 16384);
+
+        const std::string name = "descriptors/churn-" + std::to_string(threads) + "-threads";
+        const double ms = benchmark(name.c_str(), 5, [&] {
+            std::vector<std::thread> workers;
+            for (size_t t = 0; t < threads; ++t) {
+                workers.emplace_back([&descriptors] {
+                    PixieDescriptorHandle held[8];
+                    for (uint32_t i = 0; i < churnPerThread; ++i) {
+                        PixieDescriptorHandle &slot = held[i % 8];
+                        if (i >= 8)
+                            descriptors.free(slot);
+                        slot = descriptors.allocate();
+                    }
+                    for (const PixieDescriptorHandle handle : held)
+                        descriptors.free(handle);
+                });
+            }
+            for (std::thread &worker : workers)
+                worker.join();
+        });
+        std::printf("%-40s %10.1f ns/alloc+free, high water %u\n", "", ms * 1e6 / (churnPerThread * threads), descriptors.stats().persistentHighWater);
+    }
+
+    // per frame views with the gpu two frames behind, the ring has to recycle without ever running dry
+    constexpr int frameCount = 10000;
+    constexpr uint32_t viewsPerFrame = 1000;
+    PixieDescriptorAllocator descriptors(0, 16384);
+    uint64_t fence = 0;
+    const double ms = benchmark("descriptors/transient-1k-per-frame", 1, [&] {
+        for (int frame = 0; frame < frameCount; ++frame) {
+            if (fence >= 2)
+                descriptors.retire(fence - 2);
+
+            uint32_t first = 0;
+            for (uint32_t i = 0; i < viewsPerFrame; ++i)
+                descriptors.allocateTransient(1 + i % 4, first);
+            descriptors.submit(++fence);
+        }
+    });
+    const PixieDescriptorStats stats = descriptors.stats();
+    std::printf("%-40s %10.1f ns/range, high water %u, %llu failed\n", "", ms * 1e6 / (double(frameCount) * viewsPerFrame), stats.transientHighWater,
+        static_cast<unsigned long long>(stats.failedAllocations));
+}
+
+static void benchFramePacer() {
+    // pacing overhead alone, the manual clock makes every frame land exactly on its deadline
+    constexpr int frameCount = 1000000;
+    PixieManualClock manualClock(0, 1000);
+    PixieFramePacer manualPacer(manualClock, 60.0, 144.0);
+    manualPacer.setSpinThreshold(0); // a fake sleep is exact, spinning would only time the clock
+    const double ms = benchmark("framepacer/overhead", 1, [&] {
+        for (int i = 0; i < frameCount; ++i) {
+            manualClock.advance(1000000);
+            manualPacer.beginFrame();
+        }
+    });
+    std::printf("%-40s %10.1f ns/frame\n", "", ms * 1e6 / frameCount);
+
+    // real sleeps, how close sleep plus spin gets to the target period against a sleep alone
+    for (const uint64_t spinThreshold : {uint64_t(0), uint64_t(2000000)}) {
+        PixieSystemClock clock;
+        PixieFramePacer pacer(clock, 60.0, 240.0);
+        pacer.setSpinThreshold(spinThreshold);
+
+        const std::string name = spinThreshold != 0 ? "framepacer/240hz-sleep+spin" : "framepacer/240hz-sleep";
+        benchmark(name.c_str(), 1, [&] {
+            for (int i = 0; i < 240; ++i)
+                pacer.beginFrame();
+        });
+        const PixieFrameTimeStats stats = pacer.stats();
+        std::printf("%-40s %10.3f ms avg, p50 %.2f, p99 %.2f, max %.2f, %llu hitches\n", "", stats.averageMs, stats.p50Ms, stats.p99Ms, stats.maxMs,
+            static_cast<unsigned long long>(stats.hitches));
+    }
+}
+
+static void benchProfiler() {
+    constexpr int zoneCount = 1000000;
+
+    // what an instrumented hot path pays, with capture off and on; collecting every 8k zones keeps the rings from dropping
+    for (const bool enabled : {false, true}) {
+        PixieProfiler::setEnabled(enabled);
+        const double ms = benchmark(enabled ? "profiler/zone-enabled" : "profiler/zone-disabled", 1, [&] {
+            for (int i = 0; i < zoneCount; ++i) {
+                PIXIE_ZONE("bench zone");
+                if ((i & 8191) == 0)
+                    PixieProfiler::collect();
+            }
+        });
+        std::printf("%-40s %10.1f ns/zone\n", "", ms * 1e6 / zoneCount);
+    }
+
+    // four threads recording at once, each into its own ring
+    PixieProfiler::clear();
+    const double ms = benchmark("profiler/4-threads-8k-zones", 5, [&] {
+        PixieProfiler::clear();
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; ++t) {
+            threads.emplace_back([] {
+                for (int i = 0; i < 8192; ++i) {
+                    PIXIE_ZONE("thread zone");
+                }
+            });
+        }
+        for (std::thread &thread : threads)
+            thread.join();
+        PixieProfiler::collect();
+    });
+    const PixieProfilerStats stats = PixieProfiler::stats();
+    std::printf("%-40s %10.1f ns/zone, %llu events, %llu dropped\n", "", ms * 1e6 / (4 * 8192), static_cast<unsigned long long>(stats.events),
+        static_cast<unsigned long long>(stats.dropped));
+
+    benchmark("profiler/chrome-trace-32k-events", 5, [] { PixieProfiler::chromeTrace(); });
+
+    PixieProfiler::setEnabled(false);
+    PixieProfiler::clear();
+}
+
+static void benchTaskGraph() {
+    // scheduling cost alone, a wide fan of empty tasks joined by one
+    PixieJobPool pool;
+    benchmark("taskgraph/1k-empty-tasks", 10, [&] {
+        PixieTaskGraph graph;
+        std::vector<PixieTaskId> fan;
+        const PixieTaskId root = graph.add("root", [] {});
+        for (int i = 0; i < 1000; ++i)
+            fan.push_back(graph.add("leaf", [] {}, {root}));
+        graph.add("join", [] {}, {fan[0], fan[999]});
+        graph.run(pool);
+    });
+
+    // renderer startup in the same shape, every stage burns cpu in rough proportion to what it costs on a real device
+    const auto work = [](int units) {
+        return [units] {
+            volatile uint64_t x = 0;
+            for (int i = 0; i < units * 100000; ++i)
+                x = x * 6364136223846793005ull + 1442695040888963407ull;
+        };
+    };
+
+    PixieTaskGraph startup;
+    const double ms = benchmark("taskgraph/modelled-startup", 1, [&] {
+        startup = PixieTaskGraph();
+        const auto device = startup.add("device", work(30));
+        const auto queue = startup.add("command queue", work(2), {device});
+        const auto swapchain = startup.add("swapchain", work(10), {queue}, PixieTaskAffinity::Caller);
+        const auto heaps = startup.add("descriptor heaps", work(1), {device});
+        const auto frameBuffer = startup.add("frame buffer", work(1), {swapchain, heaps});
+        const auto allocator = startup.add("command allocator", work(1), {device});
+        const auto rootSig = startup.add("root signature", work(2), {device});
+        const auto vertexShader = startup.add("vertex shader", work(25));
+        const auto pixelShader = startup.add("pixel shader", work(25));
+        startup.add("pipeline state", work(15), {rootSig, vertexShader, pixelShader});
+        const auto decode = startup.add("decode texture", work(20));
+        startup.add("geometry buffers", work(2), {device});
+        const auto textures = startup.add("textures", work(3), {heaps, decode});
+        const auto setup = startup.add("submit setup", work(1), {queue, allocator, textures});
+        startup.add("sync structures", work(2), {setup, frameBuffer});
+        startup.add("timestamp queries", work(1), {queue});
+        startup.run(pool);
+    });
+    std::printf("%-40s %10.2fx of serial, critical path %.1f ms\n", "", startup.serialMs() / ms, startup.criticalPathMs());
+    std::fputs(startup.report().c_str(), stdout);
+}
+
+static void benchAudioMixer() {
+    // a second of 48 kHz output with every voice busy, what the audio thread pays for a full pool
+    constexpr uint32_t voiceCount = 256;
+    constexpr uint32_t frameCount = 48000;
+
+    std::vector<float> tone(48000);
+    for (size_t i = 0; i < tone.size(); ++i)
+        tone[i] = 0.25f * std::sin(float(i) * 0.0576f);
+    const auto native = std::make_shared<PixieSound>(48000, 1, tone.data(), static_cast<uint32_t>(tone.size()));
+    const auto resampled = std::make_shared<PixieSound>(44100, 1, tone.data(), static_cast<uint32_t>(tone.size()));
+
+    for (const bool resample : {false, true}) {
+        for (const PixieSIMDLevel level : {PixieSIMDLevel::Scalar, PixieSIMDLevel::SSE2, PixieSIMDLevel::AVX2}) {
+            if (level > detectSIMDLevel())
+                continue;
+
+            PixieAudioMixer mixer(48000, voiceCount, 1024, level);
+            PixieOfflineAudioBackend output(480);
+            output.start(mixer);
+            for (uint32_t i = 0; i < voiceCount; ++i) {
+                PixieVoiceParams params;
+                params.pan = float(i) / voiceCount * 2.0f - 1.0f;
+                params.pitch = resample ? 0.9f + 0.001f * i : 1.0f;
+                params.loop = true;
+                mixer.play(resample ? resampled : native, params);
+            }
+
+            const std::string name = std::string("audio/256-voices-") + (resample ? "resampled-" : "native-") + simdLevelName(level);
+            const double ms = benchmark(name.c_str(), 1, [&] {
+                output.clear();
+                output.render(frameCount);
+            });
+            // a second of output per run, so voices per ms of cpu times a thousand is what one core mixes in real time
+            std::printf("%-40s %10.1f ns/voice-frame, %.1f voices per ms\n", "", ms * 1e6 / (double(voiceCount) * frameCount), voiceCount / ms);
+        }
+    }
+}
+
+static void benchAudioStream() {
+    // ten seconds of 48 kHz stereo music, decoded out of the mapped file in mixer sized pieces
+    constexpr uint32_t rate = 48000;
+    constexpr uint32_t frameCount = rate * 10;
+    std::vector<float> track(size_t(frameCount) * 2);
+    for (size_t i = 0; i < track.size(); ++i)
+        track[i] = 0.4f * std::sin(float(i) * 0.0123f) + 0.2f * std::sin(float(i) * 0.301f);
+
+    const auto path = (std::filesystem::temp_directory_path() / "pixie_bench.wav").string();
+    const std::pair<PixieWavEncoding, const char *> encodings[] = {
+        {PixieWavEncoding::Pcm16, "pcm16"}, {PixieWavEncoding::Float32, "float32"}, {PixieWavEncoding::ImaAdpcm, "ima-adpcm"}};
+
+    for (const auto &[encoding, label] : encodings) {
+        writeWavFile(path, track.data(), frameCount, rate, 2, encoding);
+        const auto fileBytes = std::filesystem::file_size(path);
+
+        std::vector<float> block(4096 * 2);
+        const std::string name = std::string("audiostream/decode-10s-") + label;
+        const double ms = benchmark(name.c_str(), 5, [&] {
+            PixieWavDecoder decoder(path);
+            while (decoder.decode(block.data(), 4096) != 0) {
+            }
+        });
+        std::printf("%-40s %10.0fx realtime, %.1f M frames/s\n", "", 10000.0 / ms, frameCount / (ms * 1e3));
+
+        // what a playing track keeps in memory against loading it whole
+        PixieAudioStream stream(std::make_unique<PixieWavDecoder>(path));
+        std::printf("%-40s %10.1f KB per streaming track, %.1f KB file, %.1f KB decoded\n", "", stream.stats().memoryBytes / 1024.0, fileBytes / 1024.0,
+            track.size() * sizeof(float) / 1024.0);
+    }
+
+    std::filesystem::remove(path);
+}
+
+static void benchEntities() {
+    struct Position {
+        float x, y;
+    };
+    struct Velocity {
+        float x, y;
+    };
+    struct Tint {
+        uint32_t color;
+    };
+
+    // 100k movers spread over two archetypes, a quarter of them tinted
+    constexpr size_t count = 100000;
+    PixieWorld world;
+    std::vector<PixieEntity> entities;
+    for (size_t i = 0; i < count; ++i) {
+        const float f = float(i);
+        entities.push_back(i % 4 == 0 ? world.create(Position{f, f}, Velocity{1.0f, -1.0f}, Tint{0xffffffff}) : world.create(Position{f, f}, Velocity{1.0f, -1.0f}));
+    }
+
+    const auto integrate = [](Position &position, const Velocity &velocity) {
+        position.x += velocity.x * (1.0f / 60.0f);
+        position.y += velocity.y * (1.0f / 60.0f);
+    };
+
+    double ms = benchmark("entity/each-100k", 50, [&] { world.each<Position, const Velocity>(integrate); });
+    std::printf("%-40s %10.2f ns per entity\n", "", ms * 1e6 / count);
+
+    // the same loop over plain arrays, what chunked storage should come close to
+    std::vector<Position> positions(count);
+    std::vector<Velocity> velocities(count, Velocity{1.0f, -1.0f});
+    ms = benchmark("entity/flat-arrays-100k", 50, [&] {
+        for (size_t i = 0; i < count; ++i)
+            integrate(positions[i], velocities[i]);
+    });
+    std::printf("%-40s %10.2f ns per entity\n", "", ms * 1e6 / count);
+
+    // chunks spread over pools of growing size, the calling thread helps so n workers run n + 1 wide
+    const size_t cores = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    double single = 0.0;
+    for (size_t threads = 1; threads <= cores; threads *= 2) {
+        PixieJobPool pool(threads);
+        const std::string name = "entity/parallel-each-100k-" + std::to_string(threads) + "t";
+        ms = benchmark(name.c_str(), 50, [&] { world.each<Position, const Velocity>(pool, integrate); });
+        if (threads == 1)
+            single = ms;
+        std::printf("%-40s %10.2fx of one worker\n", "", single / ms);
+    }
+
+    // add and remove flip an entity between archetypes, each one a row copy and a swap into the hole
+    ms = benchmark("entity/add-remove-10k", 20, [&] {
+        for (size_t i = 1; i < 40000; i += 4)
+            world.add(entities[i], Tint{0xff00ff00});
+        for (size_t i = 1; i < 40000; i += 4)
+            world.remove<Tint>(entities[i]);
+    });
+    std::printf("%-40s %10.1f ns per change\n", "", ms * 1e6 / 20000);
+
+    ms = benchmark("entity/create-destroy-10k", 20, [&] {
+        for (size_t i = 0; i < 10000; ++i) {
+            world.destroy(entities[i]);
+            entities[i] = world.create(Position{0.0f, 0.0f}, Velocity{1.0f, -1.0f});
+        }
+    });
+    std::printf("%-40s %10.1f ns per entity\n", "", ms * 1e6 / 10000);
+
+    // three systems, the two that share nothing run side by side and the reader waits on the mover
+    PixieJobPool pool;
+    PixieSystemScheduler scheduler;
+    scheduler.add("move", PixieAccess().write<Position>().read<Velocity>(), [&](PixieWorld &w) { w.each<Position, const Velocity>(pool, integrate); });
+    scheduler.add("fade", PixieAccess().write<Tint>(), [](PixieWorld &w) { w.each<Tint>([](Tint &tint) { tint.color -= 0x01000000; }); });
+    scheduler.add("bounds", PixieAccess().read<Position>(), [](PixieWorld &w) {
+        float top = 0.0f;
+        w.each<const Position>([&top](const Position &position) { top = std::max(top, position.y); });
+        volatile float sink = top;
+        (void)sink;
+    });
+    benchmark("entity/scheduler-3-systems-100k", 50, [&] { scheduler.run(world, pool); });
+
+    const PixieWorldStats stats = world.stats();
+    std::printf("%-40s %10zu archetypes, %zu chunks, %.1f MB\n", "", stats.archetypes, stats.chunks, stats.memoryBytes / (1024.0 * 1024.0));
+}
+
+static void benchSpatialGrid() {
+    const PixieSIMDLevel levels[] = {PixieSIMDLevel::Scalar, PixieSIMDLevel::SSE2, PixieSIMDLevel::AVX2};
+    const PixieRect view = {30000.0f, 30000.0f, 1920.0f, 1080.0f};
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<float> extent(16.0f, 64.0f);
+    std::vector<uint32_t> visible;
+
+    // 1M static sprites over a 64k square map, a 1080p camera sees a few hundred of them
+    constexpr size_t staticCount = 1000000;
+    std::uniform_real_distribution<float> across(0.0f, 65536.0f);
+    std::vector<PixieRect> rects(staticCount);
+    for (PixieRect &rect : rects)
+        rect = {across(rng), across(rng), extent(rng), extent(rng)};
+
+    std::vector<uint32_t> items(staticCount);
+    for (size_t i = 0; i < staticCount; ++i)
+        items[i] = static_cast<uint32_t>(i);
+
+    PixieSpatialGrid grid;
+    benchmark("spatial/insert-1m-one-by-one", 1, [&] {
+        grid.clear();
+        for (size_t i = 0; i < staticCount; ++i)
+            grid.insert(rects[i], items[i]);
+    });
+    benchmark("spatial/insert-1m-bulk", 1, [&] {
+        grid.clear();
+        grid.insert(rects.data(), items.data(), staticCount, nullptr);
+    });
+
+    // one cell holding everything is a plain simd scan of the whole map, what culling costs without the index
+    PixieSpatialGrid flat(1e9f);
+    flat.insert(rects.data(), items.data(), staticCount, nullptr);
+
+    for (const PixieSIMDLevel level : levels) {
+        flat.setSIMDLevel(level);
+        const std::string name = std::string("spatial/linear-cull-1m-") + simdLevelName(level);
+        benchmark(name.c_str(), 10, [&] { flat.query(view, visible); });
+    }
+
+    PixieCullStats cull = {};
+    for (const PixieSIMDLevel level : levels) {
+        grid.setSIMDLevel(level);
+        const std::string name = std::string("spatial/grid-query-1m-") + simdLevelName(level);
+        const double ms = benchmark(name.c_str(), 1000, [&] { cull = grid.query(view, visible); });
+        std::printf("%-40s %10.1f ns per visible, %u visible of %u tested in %u cells\n", "", ms * 1e6 / cull.visible, cull.visible, cull.tested,
+            cull.cellsVisited);
+    }
+
+    // the same view anywhere on the map costs the same, it only sees what's around it
+    PixieRect scrolled = view;
+    benchmark("spatial/grid-query-1m-scrolling", 1000, [&] {
+        scrolled.x = std::fmod(scrolled.x + 977.0f, 60000.0f);
+        scrolled.y = std::fmod(scrolled.y + 613.0f, 60000.0f);
+        grid.query(scrolled, visible);
+    });
+    PixieSpatialStats stats = grid.stats();
+    std::printf("%-40s %10zu cells, %.1f MB\n", "", stats.cells, stats.memoryBytes / (1024.0 * 1024.0));
+
+    // 50k movers bouncing around an 8k square, all of them moved every frame and the camera queried after
+    constexpr size_t dynamicCount = 50000;
+    std::uniform_real_distribution<float> arena(0.0f, 8192.0f);
+    std::uniform_real_distribution<float> velocity(-8.0f, 8.0f);
+    std::vector<PixieRect> movers(dynamicCount);
+    std::vector<PixieRect> velocities(dynamicCount); // x and y only
+    std::vector<PixieProxyId> proxies(dynamicCount);
+    PixieSpatialGrid dynamic;
+    for (size_t i = 0; i < dynamicCount; ++i) {
+        movers[i] = {arena(rng), arena(rng), extent(rng), extent(rng)};
+        velocities[i] = {velocity(rng), velocity(rng), 0.0f, 0.0f};
+        proxies[i] = dynamic.insert(movers[i], static_cast<uint32_t>(i));
+    }
+
+    const double ms = benchmark("spatial/update-query-50k-dynamic", 100, [&] {
+        for (size_t i = 0; i < dynamicCount; ++i) {
+            PixieRect &rect = movers[i];
+            PixieRect &step = velocities[i];
+            rect.x += step.x;
+            rect.y += step.y;
+            if (rect.x < 0.0f || rect.x > 8192.0f)
+                step.x = -step.x;
+            if (rect.y < 0.0f || rect.y > 8192.0f)
+                step.y = -step.y;
+            dynamic.update(proxies[i], rect);
+        }
+        dynamic.query({3000.0f, 3000.0f, 1920.0f, 1080.0f}, visible);
+    });
+    stats = dynamic.stats();
+    std::printf("%-40s %10.1f ns per update, %.1f%% changed cell, %zu visible\n", "", ms * 1e6 / dynamicCount,
+        100.0 * stats.cellMoves / (dynamicCount * 101.0), visible.size());
+}
+
+static void benchTransforms() {
+    const PixieSIMDLevel levels[] = {PixieSIMDLevel::Scalar, PixieSIMDLevel::SSE2, PixieSIMDLevel::AVX2};
+    std::mt19937 rng(13);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    const auto randomTransform = [&] {
+        const float angle = unit(rng) * 3.14159f;
+        const float scale = 1.0f + unit(rng) * 0.5f;
+        return PixieTransform2D {std::cos(angle) * scale, std::sin(angle) * scale, -std::sin(angle) * scale, std::cos(angle) * scale, unit(rng) * 512.0f,
+            unit(rng) * 512.0f};
+    };
+
+    // 1000 roots with 99 children each, every level added after the one above so compose stays on the wide path
+    constexpr uint32_t rootCount = 1000;
+    constexpr uint32_t nodeCount = 100000;
+    PixieTransformHierarchy hierarchy;
+    for (uint32_t i = 0; i < rootCount; ++i)
+        hierarchy.add(randomTransform());
+    for (uint32_t i = rootCount; i < nodeCount; ++i)
+        hierarchy.add(randomTransform(), i % rootCount);
+
+    for (const PixieSIMDLevel level : levels) {
+        hierarchy.setSIMDLevel(level);
+        const std::string name = std::string("transform/compose-100k-") + simdLevelName(level);
+        benchmark(name.c_str(), 100, [&] { hierarchy.compose(); });
+    }
+
+    // a sprite per node, in node order. sprites scattered at random over the nodes are bound by cache misses instead
+    constexpr uint32_t spriteCount = nodeCount;
+    PixieSpriteArrays sprites;
+    sprites.reserve(spriteCount);
+    for (uint32_t i = 0; i < spriteCount; ++i)
+        sprites.push({unit(rng) * 32.0f, unit(rng) * 32.0f, 16.0f, 16.0f}, {0.0f, 0.0f, 0.25f, 0.25f}, 0xffffffff, i);
+
+    const PixieTransformColumns columns = hierarchy.worldColumns();
+    std::vector<PixieVertexData> vertices(spriteCount * 4);
+    std::vector<PixieCompactVertex> compact(spriteCount * 4);
+    for (const PixieSIMDLevel level : levels) {
+        const std::string name = std::string("transform/expand-100k-") + simdLevelName(level);
+        benchmark(name.c_str(), 100, [&] { expandSprites(sprites, 0, spriteCount, &columns, 2.0f / 1920.0f, -2.0f / 1080.0f, vertices.data(), level); });
+    }
+    for (const PixieSIMDLevel level : levels) {
+        const std::string name = std::string("transform/expand-compact-100k-") + simdLevelName(level);
+        benchmark(name.c_str(), 100,
+            [&] { expandSpritesCompact(sprites, 0, spriteCount, &columns, 2.0f / 1920.0f, -2.0f / 1080.0f, compact.data(), level); });
+    }
+
+    // the same sprites through the batch, one drawSprite each against one drawSprites for the lot
+    struct NullSink final : PixieBatchSink {
+        void drawQuads(const PixieDrawRun &) override {}
+    } sink;
+
+    std::vector<PixieVertexData> ring(spriteCount * 4);
+    PixieSpriteBatch batch(ring.data(), static_cast<uint32_t>(ring.size()));
+    benchmark("transform/batch-100k-per-sprite", 20, [&] {
+        batch.release(batch.frameMarker());
+        batch.begin(1920.0f, 1080.0f);
+        for (uint32_t i = 0; i < spriteCount; ++i) {
+            const PixieRect rect = {sprites.x[i], sprites.y[i], sprites.width[i], sprites.height[i]};
+            batch.drawSprite(0, rect, {0.0f, 0.0f, 0.25f, 0.25f}, sprites.color[i], hierarchy.world(sprites.transform[i]));
+        }
+        batch.flush(sink);
+    });
+    benchmark("transform/batch-100k-arrays", 20, [&] {
+        batch.release(batch.frameMarker());
+        batch.begin(1920.0f, 1080.0f);
+        batch.drawSprites(0, sprites, &hierarchy);
+        batch.flush(sink);
+    });
+    std::printf("%-40s %10u draws\n", "", batch.stats().draws);
+
+    // what the d3d renderer does, 16 byte vertices straight into its ring
+    std::vector<PixieCompactVertex> compactRing(spriteCount * 4);
+    PixieSpriteBatch compactBatch(compactRing.data(), static_cast<uint32_t>(compactRing.size()));
+    benchmark("transform/batch-100k-arrays-compact", 20, [&] {
+        compactBatch.release(compactBatch.frameMarker());
+        compactBatch.begin(1920.0f, 1080.0f);
+        compactBatch.drawSprites(0, sprites, &hierarchy);
+        compactBatch.flush(sink);
+    });
+}
+
+static void benchAllocators() {
+    // debug builds poison and guard everything, numbers against the heap only mean something with NDEBUG
+    std::printf("%-40s %10s\n", "", PIXIE_MEMORY_DEBUG ? "memory debug on" : "memory debug off");
+
+    // a frame's worth of short lived lists, 2000 of them a few dozen entries long
+    constexpr int listCount = 2000;
+    constexpr int listLength = 48;
+    uint64_t checksum = 0;
+    benchmark("allocators/frame-lists-heap", 200, [&] {
+        for (int i = 0; i < listCount; ++i) {
+            std::vector<uint64_t> list;
+            list.reserve(listLength);
+            for (int k = 0; k < listLength; ++k)
+                list.push_back(k);
+            checksum += list.back();
+        }
+    });
+
+    PixieFrameArena frameMemory(64 * 1024, 2);
+    uint32_t slot = 0;
+    benchmark("allocators/frame-lists-arena", 200, [&] {
+        frameMemory.beginFrame(slot);
+        slot ^= 1;
+        for (int i = 0; i < listCount; ++i) {
+            PixieArenaVector<uint64_t> list {PixieArenaAllocator<uint64_t>(frameMemory.arena())};
+            list.reserve(listLength);
+            for (int k = 0; k < listLength; ++k)
+                list.push_back(k);
+            checksum += list.back();
+        }
+    });
+    const PixieArenaStats frameStats = frameMemory.stats();
+    std::printf("%-40s %10.1f KB per frame, %.1f KB peak, %.1f KB capacity\n", "", frameStats.used / 1024.0, frameStats.peak / 1024.0,
+        frameStats.capacity / 1024.0);
+
+    benchmark("allocators/scratch-scope", 200, [&] {
+        for (int i = 0; i < listCount; ++i) {
+            PixieScratchScope scratch;
+            uint64_t *list = scratch.arena().allocateArray<uint64_t>(listLength);
+            for (int k = 0; k < listLength; ++k)
+                list[k] = k;
+            checksum += list[listLength - 1];
+        }
+    });
+
+    // 100k objects made and freed in a shuffled order, so neither side gets the easy lifo pattern
+    struct Particle {
+        float position[2];
+        float velocity[2];
+        uint32_t color;
+        float life;
+    };
+    constexpr size_t objectCount = 100000;
+    std::vector<size_t> order(objectCount);
+    for (size_t i = 0; i < objectCount; ++i)
+        order[i] = i;
+    std::shuffle(order.begin(), order.end(), std::mt19937(17));
+
+    std::vector<Particle *> objects(objectCount);
+    benchmark("allocators/objects-100k-new", 20, [&] {
+        for (Particle *&object : objects)
+            object = new Particle {};
+        for (const size_t i : order)
+            delete objects[i];
+    });
+
+    PixieObjectPool<Particle> particles(4096);
+    benchmark("allocators/objects-100k-pool", 20, [&] {
+        for (Particle *&object : objects)
+            object = particles.create();
+        for (const size_t i : order)
+            particles.destroy(objects[i]);
+    });
+
+    // node containers are where a pool pays off most, every insert is an allocation
+    constexpr int mapCount = 100000;
+    benchmark("allocators/map-100k-heap", 10, [&] {
+        std::map<int, int> map;
+        for (int i = 0; i < mapCount; ++i)
+            map.emplace(static_cast<int>(order[i]), i);
+        checksum += map.size();
+    });
+
+    using PooledMap = std::map<int, int, std::less<int>, PixiePoolAllocator<std::pair<const int, int>>>;
+    PixieFixedPool nodes(48, alignof(std::max_align_t), 4096);
+    benchmark("allocators/map-100k-pool", 10, [&] {
+        PooledMap map {PixiePoolAllocator<std::pair<const int, int>>(nodes)};
+        for (int i = 0; i < mapCount; ++i)
+            map.emplace(static_cast<int>(order[i]), i);
+        checksum += map.size();
+    });
+    std::printf("%-40s %10zu blocks, %zu peak nodes (checksum %llu)\n", "", nodes.stats().blocks, nodes.stats().peak,
+        static_cast<unsigned long long>(checksum));
+}
+
+static void benchInput() {
+    PixieManualClock clock;
+    clock.advance(1);
+
+    // a busy frame's worth of mouse and keys, pushed then folded into the snapshot
+    constexpr int eventsPerFrame = 64;
+    PixieInput input(clock);
+    double ms = benchmark("input/push-begin-frame-64", 10000, [&] {
+        for (int i = 0; i < eventsPerFrame; ++i) {
+            const auto type = i % 4 == 0 ? PixieInputType::KeyDown : i % 4 == 1 ? PixieInputType::KeyUp : PixieInputType::MouseMove;
+            input.push({1, type, false, static_cast<uint16_t>(i % 128), float(i), float(i)});
+        }
+        input.beginFrame();
+    });
+    std::printf("%-40s %10.1f ns per event\n", "", ms * 1e6 / eventsPerFrame);
+
+    // the same through the sampler queue, what a sampler thread's handoff costs on top
+    ms = benchmark("input/sampler-queue-begin-frame-64", 10000, [&] {
+        for (int i = 0; i < eventsPerFrame; ++i)
+            input.pushFromSampler({1, PixieInputType::MouseMove, false, 0, float(i), float(i)});
+        input.beginFrame();
+    });
+    std::printf("%-40s %10.1f ns per event\n", "", ms * 1e6 / eventsPerFrame);
+
+    // a 1 kHz mouse against 60 Hz frames, event to submit latency when each frame drains everything and when
+    // it takes one event a frame like the old loop did. submit comes 5 ms into each frame
+    const auto simulate = [](bool drainAll) {
+        PixieManualClock simulated;
+        simulated.advance(1);
+        PixieInput tracked(simulated, 1 << 16);
+        tracked.setLatencyTracking(true);
+        std::deque<uint64_t> pending;
+        uint64_t nextEvent = 1;
+        for (int frame = 0; frame < 600; ++frame) {
+            const uint64_t frameStart = simulated.now();
+            while (nextEvent <= frameStart) {
+                pending.push_back(nextEvent);
+                nextEvent += 1000000;
+            }
+            for (size_t taken = 0; !pending.empty() && (drainAll || taken < 1); ++taken) {
+                tracked.push({pending.front(), PixieInputType::MouseMove, false, 0, 0.0f, 0.0f});
+                pending.pop_front();
+            }
+            tracked.beginFrame();
+            simulated.advance(5000000);
+            tracked.frameSubmitted();
+            simulated.advance(16666667 - 5000000);
+        }
+        return tracked.latencyStats();
+    };
+    for (const bool drainAll : {true, false}) {
+        const PixieInputLatencyStats latency = simulate(drainAll);
+        std::printf("%-40s %10.2f ms p50, %.2f ms p99, %.2f ms max over %llu events\n", drainAll ? "input/latency-drain-all" : "input/latency-one-per-frame",
+            latency.p50Ms, latency.p99Ms, latency.maxMs, static_cast<unsigned long long>(latency.samples));
+    }
+}
+
+static void benchCapture() {
+    constexpr uint32_t width = 1024;
+    constexpr uint32_t height = 768;
+    constexpr int spriteCount = 2000;
+
+    // a rendered frame rather than noise, flat background with textured sprites over it like a replay would have
+    PixieSoftRenderer renderer(width, height);
+    std::vector<uint32_t> checker(64 * 64);
+    for (uint32_t i = 0; i < checker.size(); ++i)
+        checker[i] = ((i / 64 / 8 + i % 64 / 8) & 1) ? 0xffffffffu : 0xff2020c0u;
+    const uint32_t texture = renderer.createTexture(64, 64, checker.data());
+
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> pos(0.0f, 1000.0f);
+    std::vector<PixieRect> rects;
+    for (int i = 0; i < spriteCount; ++i)
+        rects.push_back({pos(rng), pos(rng) * 0.75f, 32.0f, 32.0f});
+
+    float color[4] = {0.1f, 0.1f, 0.15f, 1.0f};
+    const auto render = [&](int frame) {
+        renderer.beginFrame(color);
+        for (const auto &rect : rects)
+            renderer.drawSprite(texture, {rect.x + frame, rect.y, rect.width, rect.height}, {0.0f, 0.0f, 1.0f, 1.0f}, 0xffffffff, PixieTransform2D::identity());
+        renderer.endFrame();
+    };
+    render(0);
+
+    PixieImageEncoder encoder;
+    for (const auto format : {PixieImageFormat::QOI, PixieImageFormat::PNG}) {
+        size_t bytes = 0;
+        char name[64];
+        std::snprintf(name, sizeof(name), "capture/encode-%s-1024x768", imageFormatExtension(format));
+        const double ms = benchmark(name, format == PixieImageFormat::QOI ? 50 : 10, [&] {
+            bytes = encoder.encode(format, renderer.pixels(), width, height, renderer.pitch()).size();
+        });
+        std::printf("%-40s %10.1f MB/s in, %.1f KB out\n", "", width * height * 4.0 / ms / 1000.0, bytes / 1024.0);
+    }
+
+    // the render loop against the ring, what it costs the loop to hand frames over and how often it waited
+    const auto directory = std::filesystem::temp_directory_path() / "pixie_bench_capture";
+    for (const auto format : {PixieImageFormat::QOI, PixieImageFormat::PNG}) {
+        constexpr int frames = 30;
+        PixieCaptureSettings settings;
+        settings.directory = directory.string();
+        settings.format = format;
+
+        double submitMs = 0.0;
+        {
+            PixieFrameCapture capture(width, height, settings);
+            for (int frame = 0; frame < frames; ++frame) {
+                render(frame);
+                const auto begin = std::chrono::steady_clock::now();
+                capture.submit(renderer.pixels(), renderer.pitch());
+                submitMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+            }
+            capture.finish();
+
+            const PixieCaptureStats stats = capture.stats();
+            char name[64];
+            std::snprintf(name, sizeof(name), "capture/ring-%s-%d-frames", imageFormatExtension(format), frames);
+            std::printf("%-40s %10.3f ms submit, %.1f fps written, %llu stalls (%.1f ms)\n", name, submitMs / frames,
+                stats.framesPerSecond, static_cast<unsigned long long>(stats.stalls), stats.stallMs);
+        }
+    }
+    std::filesystem::remove_all(directory);
+}
+
+static bool writeResults(const char *path) {
+    std::FILE *file = std::fopen(path, "w");
+    if (!file)
+        return false;
+
+    std::fprintf(file, "{\n  \"simd\": \"%s\",\n  \"hardwareThreads\": %u,\n  \"samples\": %d,\n  \"benchmarks\": [",
+        simdLevelName(detectSIMDLevel()), std::thread::hardware_concurrency(), sampleCount);
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchResult &result = results[i];
+        std::vector<double> sorted = result.samples;
+        std::sort(sorted.begin(), sorted.end());
+        const size_t n = sorted.size();
+        const double median = n % 2 ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) * 0.5;
+        double mean = 0.0;
+        for (const double sample : sorted)
+            mean += sample / n;
+        double variance = 0.0;
+        for (const double sample : sorted)
+            variance += (sample - mean) * (sample - mean) / (n > 1 ? n - 1 : 1);
+
+        std::fprintf(file, "%s\n    {\"name\": \"%s\", \"iterations\": %d, \"medianMs\": %.6f, \"meanMs\": %.6f, \"stddevMs\": %.6f, \"minMs\": %.6f, \"samplesMs\": [",
+            i ? "," : "", result.name.c_str(), result.iterations, median, mean, std::sqrt(variance), sorted.front());
+        for (size_t k = 0; k < n; ++k)
+            std::fprintf(file, "%s%.6f", k ? ", " : "", result.samples[k]);
+        std::fprintf(file, "]}");
+    }
+    std::fprintf(file, "\n  ]\n}\n");
+    return std::fclose(file) == 0;
+}
+
+int main(int argc, char **argv) {
+    const char *jsonPath = nullptr;
+    const char *filter = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--json") == 0 && i + 1 < argc)
+            jsonPath = argv[++i];
+        else if (std::strcmp(argv[i], "--samples") == 0 && i + 1 < argc)
+            sampleCount = std::max(1, std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+            filter = argv[++i];
+    }
+
+    // texture ingestion is texturefile through stream, vertex and quad generation softrenderer, spritebatch and
+    // transforms, command recording recorder and descriptors, frame sync framering, framepacer and upload
+    const struct {
+        const char *group;
+        void (*run)();
+    } groups[] = {
+        {"softrenderer", benchSoftRenderer},
+        {"spritebatch", benchSpriteBatch},
+        {"drawqueue", benchDrawQueue},
+        {"recorder", benchCommandRecorder},
+        {"descriptors", benchDescriptors},
+        {"framering", benchFrameRing},
+        {"framepacer", benchFramePacer},
+        {"profiler", benchProfiler},
+        {"upload", benchUploadAllocator},
+        {"atlas", benchAtlas},
+        {"texturefile", benchTextureFile},
+        {"pixelconvert", benchPixelConvert},
+        {"mipgen", benchMipGen},
+        {"stream", benchTextureStream},
+        {"shadercache", benchShaderCache},
+        {"taskgraph", benchTaskGraph},
+        {"audio", benchAudioMixer},
+        {"audiostream", benchAudioStream},
+        {"entities", benchEntities},
+        {"spatial", benchSpatialGrid},
+        {"transforms", benchTransforms},
+        {"allocators", benchAllocators},
+        {"input", benchInput},
+        {"capture", benchCapture},
+    };
+    for (const auto &group : groups) {
+        if (!filter || std::strstr(group.group, filter))
+            group.run();
+    }
+
+    if (jsonPath && !writeResults(jsonPath)) {
+        std::fprintf(stderr, "failed to write %s\n", jsonPath);
+        return 1;
+    }
+    return 0;
+}
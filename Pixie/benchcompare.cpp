@@ -0,0 +1,270 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// compares two bench --json runs, usage: benchcompare <baseline.json> <current.json> [--threshold <percent>] [--all]
+// a benchmark regressed when its median got slower by more than the threshold and a welch t test on the samples
+// says the difference is real at 95%. exits 1 when anything regressed so a release check can fail on it
+
+namespace {
+    struct Benchmark {
+        double medianMs = 0.0;
+        std::vector<double> samples;
+    };
+
+    // just enough json for what bench writes: objects, arrays, strings without escapes, numbers
+    class Reader {
+    public:
+        explicit Reader(const std::string &text) : text(text), at(0) {}
+
+        std::map<std::string, Benchmark> benchmarks() {
+            std::map<std::string, Benchmark> result;
+            expect('{');
+            while (!peek('}')) {
+                const std::string key = string();
+                expect(':');
+                if (key != "benchmarks") {
+                    skip();
+                } else {
+                    expect('[');
+                    while (!peek(']')) {
+                        std::string name;
+                        Benchmark benchmark = entry(name);
+                        result[name] = std::move(benchmark);
+                        if (!peek(']'))
+                            expect(',');
+                    }
+                    expect(']');
+                }
+                if (!peek('}'))
+                    expect(',');
+            }
+            expect('}');
+            return result;
+        }
+
+    private:
+        Benchmark entry(std::string &name) {
+            Benchmark benchmark;
+            expect('{');
+            while (!peek('}')) {
+                const std::string key = string();
+                expect(':');
+                if (key == "name") {
+                    name = string();
+                } else if (key == "medianMs") {
+                    benchmark.medianMs = number();
+                } else if (key == "samplesMs") {
+                    expect('[');
+                    while (!peek(']')) {
+                        benchmark.samples.push_back(number());
+                        if (!peek(']'))
+                            expect(',');
+                    }
+                    expect(']');
+                } else {
+                    skip();
+                }
+                if (!peek('}'))
+                    expect(',');
+            }
+            expect('}');
+            return benchmark;
+        }
+
+        void skip() {
+            whitespace();
+            if (peek('"')) {
+                string();
+            } else if (peek('{') || peek('[')) {
+                const char close = text[at] == '{' ? '}' : ']';
+                at++;
+                while (!peek(close)) {
+                    skip();
+                    if (peek(':') || peek(','))
+                        at++;
+                }
+                at++;
+            } else {
+                number();
+            }
+        }
+
+        std::string string() {
+            expect('"');
+            const size_t end = text.find('"', at);
+            if (end == std::string::npos)
+                throw std::runtime_error("unterminated string");
+            std::string result = text.substr(at, end - at);
+            at = end + 1;
+            return result;
+        }
+
+        double number() {
+            whitespace();
+            const char *begin = text.c_str() + at;
+            char *end = nullptr;
+            const double value = std::strtod(begin, &end);
+            if (end == begin)
+                throw std::runtime_error("expected a number at offset " + std::to_string(at));
+            at += end - begin;
+            return value;
+        }
+
+        bool peek(char c) {
+            whitespace();
+            return at < text.size() && text[at] == c;
+        }
+
+        void expect(char c) {
+            if (!peek(c))
+                throw std::runtime_error(std::string("expected '") + c + "' at offset " + std::to_string(at));
+            at++;
+        }
+
+        void whitespace() {
+            while (at < text.size() && std::strchr(" \t\r\n", text[at]))
+                at++;
+        }
+
+        const std::string &text;
+        size_t at;
+    };
+
+    std::map<std::string, Benchmark> load(const char *path) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in)
+            throw std::runtime_error(std::string("can't open ") + path);
+        const std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        try {
+            return Reader(text).benchmarks();
+        } catch (const std::exception &e) {
+            throw std::runtime_error(std::string(path) + ": " + e.what());
+        }
+    }
+
+    void meanVariance(const std::vector<double> &samples, double &mean, double &variance) {
+        mean = 0.0;
+        for (const double sample : samples)
+            mean += sample / samples.size();
+        variance = 0.0;
+        for (const double sample : samples)
+            variance += (sample - mean) * (sample - mean) / (samples.size() > 1 ? samples.size() - 1 : 1);
+    }
+
+    // two sided 95% critical values of student's t by degrees of freedom, the normal's past 30
+    double criticalT(double degrees) {
+        static const double table[30] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228, 2.201, 2.179, 2.160, 2.145, 2.131,
+            2.120, 2.110, 2.101, 2.093, 2.086, 2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+        const auto index = static_cast<int>(degrees);
+        if (index < 1)
+            return table[0];
+        return index <= 30 ? table[index - 1] : 1.960;
+    }
+
+    // welch's t for current against baseline, positive when current is slower. sets significant when it clears
+    // the critical value for the welch satterthwaite degrees of freedom
+    double welchT(const Benchmark &baseline, const Benchmark &current, bool &significant) {
+        double baseMean, baseVariance, currentMean, currentVariance;
+        meanVariance(baseline.samples, baseMean, baseVariance);
+        meanVariance(current.samples, currentMean, currentVariance);
+
+        const double a = baseVariance / baseline.samples.size();
+        const double b = currentVariance / current.samples.size();
+        if (a + b <= 0.0) {
+            // no spread on either side, any difference at all is real
+            significant = currentMean != baseMean;
+            return currentMean > baseMean ? HUGE_VAL : (currentMean < baseMean ? -HUGE_VAL : 0.0);
+        }
+
+        const double t = (currentMean - baseMean) / std::sqrt(a + b);
+        const double degrees = (a + b) * (a + b) / (a * a / (baseline.samples.size() - 1) + b * b / (current.samples.size() - 1));
+        significant = std::fabs(t) > criticalT(degrees);
+        return t;
+    }
+} // namespace
+
+static int usage(const char *program) {
+    std::fprintf(stderr, "usage: %s <baseline.json> <current.json> [--threshold <percent>] [--all]\n", program);
+    return 2;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 3)
+        return usage(argv[0]);
+
+    // a mistyped flag would silently compare with the defaults, so anything unknown is an error
+    double threshold = 5.0;
+    bool all = false;
+    for (int i = 3; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--threshold") == 0 && i + 1 < argc) {
+            char *end = nullptr;
+            threshold = std::strtod(argv[++i], &end);
+            if (end == argv[i] || *end != '\0' || !(threshold >= 0.0))
+                return usage(argv[0]);
+        } else if (std::strcmp(argv[i], "--all") == 0) {
+            all = true;
+        } else {
+            return usage(argv[0]);
+        }
+    }
+
+    std::map<std::string, Benchmark> baseline;
+    std::map<std::string, Benchmark> current;
+    try {
+        baseline = load(argv[1]);
+        current = load(argv[2]);
+    } catch (const std::exception &e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 2;
+    }
+
+    int regressions = 0;
+    int improvements = 0;
+    int compared = 0;
+    std::printf("%-40s %12s %12s %9s %8s\n", "benchmark", "baseline ms", "current ms", "change", "t");
+    for (const auto &[name, now] : current) {
+        const auto found = baseline.find(name);
+        if (found == baseline.end()) {
+            if (all)
+                std::printf("%-40s %12s %12.3f %9s %8s  new\n", name.c_str(), "-", now.medianMs, "-", "-");
+            continue;
+        }
+
+        const Benchmark &before = found->second;
+        if (before.samples.size() < 2 || now.samples.size() < 2 || before.medianMs <= 0.0) {
+            std::printf("%-40s %12.3f %12.3f %9s %8s  too few samples\n", name.c_str(), before.medianMs, now.medianMs, "-", "-");
+            continue;
+        }
+        compared++;
+
+        bool significant = false;
+        const double t = welchT(before, now, significant);
+        const double change = (now.medianMs - before.medianMs) / before.medianMs * 100.0;
+
+        const char *verdict = "";
+        if (significant && change > threshold) {
+            verdict = "  REGRESSION";
+            regressions++;
+        } else if (significant && change < -threshold) {
+            verdict = "  improved";
+            improvements++;
+        }
+        if (all || *verdict)
+            std::printf("%-40s %12.3f %12.3f %+8.1f%% %8.2f%s\n", name.c_str(), before.medianMs, now.medianMs, change, t, verdict);
+    }
+    for (const auto &entry : baseline) {
+        if (current.find(entry.first) == current.end())
+            std::printf("%-40s %12.3f %12s %9s %8s  missing\n", entry.first.c_str(), entry.second.medianMs, "-", "-", "-");
+    }
+
+    std::printf("%d compared, %d regressed, %d improved past %.1f%%\n", compared, regressions, improvements, threshold);
+    return regressions > 0 ? 1 : 0;
+}
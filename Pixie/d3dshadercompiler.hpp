@@ -0,0 +1,42 @@
+#pragma once
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+
+#include <d3dcompiler.h>
+#include <wrl.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "shadercache.hpp"
+#include "utils.hpp"
+
+namespace pxe {
+    // fxc through d3dcompiler_47, includes resolve next to the including file like the cache expects
+    class PixieD3DShaderCompiler final : public PixieShaderCompiler {
+    public:
+        std::string identity() const override {
+            return "d3dcompiler " + std::to_string(D3D_COMPILER_VERSION);
+        }
+
+        std::vector<uint8_t> compile(const PixieShaderDesc &desc) override {
+            std::vector<D3D_SHADER_MACRO> macros;
+            for (const PixieShaderDefine &define : desc.defines)
+                macros.push_back({define.name.c_str(), define.value.c_str()});
+            macros.push_back({nullptr, nullptr});
+
+            const std::wstring path(desc.path.begin(), desc.path.end());
+            Microsoft::WRL::ComPtr<ID3DBlob> bytecode;
+            Microsoft::WRL::ComPtr<ID3DBlob> errors;
+
+            const HRESULT hr = D3DCompileFromFile(path.c_str(), macros.data(), D3D_COMPILE_STANDARD_FILE_INCLUDE, desc.entryPoint.c_str(), desc.target.c_str(), desc.flags, 0, &bytecode, &errors);
+            if (errors != nullptr)
+                std::cerr << static_cast<const char *>(errors->GetBufferPointer());
+            throwIfFailed(hr);
+
+            const auto *data = static_cast<const uint8_t *>(bytecode->GetBufferPointer());
+            return std::vector<uint8_t>(data, data + bytecode->GetBufferSize());
+        }
+    };
+} // namespace pxe
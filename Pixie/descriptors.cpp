@@ -0,0 +1,148 @@
+#include "descriptors.hpp"
+#include <stdexcept>
+
+namespace pxe {
+    static const uint32_t generationMask = UINT32_MAX >> PixieDescriptorHandle::indexBits;
+
+    PixieDescriptorAllocator::PixieDescriptorAllocator(uint32_t persistentCount, uint32_t transientCount)
+        : persistentCount(persistentCount)
+        , transientCount(transientCount)
+        , freeHead(persistentCount == 0 ? endOfList : 0)
+        , nextFree(new std::atomic<uint32_t>[persistentCount])
+        , generations(new std::atomic<uint32_t>[persistentCount])
+        , transientHead(0)
+        , transientTail(0)
+        , submittedHead(0)
+        , persistentInUse(0)
+        , persistentHighWater(0)
+        , transientHighWater(0)
+        , failedAllocations(0) {
+
+        // the top index is never handed out so no live handle can equal invalidDescriptor
+        if (persistentCount >= PixieDescriptorHandle::indexMask)
+            throw std::invalid_argument("PixieDescriptorAllocator: persistent region too big for the handle index");
+
+        for (uint32_t i = 0; i < persistentCount; ++i) {
+            nextFree[i].store(i + 1 < persistentCount ? i + 1 : endOfList, std::memory_order_relaxed);
+            generations[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    PixieDescriptorHandle PixieDescriptorAllocator::allocate() {
+        uint64_t head = freeHead.load(std::memory_order_acquire);
+        for (;;) {
+            const auto slot = static_cast<uint32_t>(head);
+            if (slot == endOfList) {
+                failedAllocations.fetch_add(1, std::memory_order_relaxed);
+                return invalidDescriptor;
+            }
+
+            // next may already be stale if another thread popped this slot, the tag makes that cas fail
+            const uint64_t next = nextFree[slot].load(std::memory_order_relaxed);
+            const uint64_t tag = (head >> 32) + 1;
+            if (freeHead.compare_exchange_weak(head, (tag << 32) | next, std::memory_order_acquire, std::memory_order_acquire)) {
+                const uint32_t generation = generations[slot].fetch_add(1, std::memory_order_relaxed) + 1;
+
+                const uint32_t inUse = persistentInUse.fetch_add(1, std::memory_order_relaxed) + 1;
+                uint32_t highWater = persistentHighWater.load(std::memory_order_relaxed);
+                while (inUse > highWater && !persistentHighWater.compare_exchange_weak(highWater, inUse, std::memory_order_relaxed)) {
+                }
+
+                return {slot | ((generation & generationMask) << PixieDescriptorHandle::indexBits)};
+            }
+        }
+    }
+
+    void PixieDescriptorAllocator::free(PixieDescriptorHandle handle) {
+        const uint32_t slot = handle.index();
+        if (slot >= persistentCount)
+            throw std::out_of_range("PixieDescriptorAllocator: handle outside the persistent region");
+
+        // only one free can move the generation from allocated to free
+        uint32_t generation = generations[slot].load(std::memory_order_relaxed);
+        do {
+            if ((generation & 1) == 0 || (generation & generationMask) != handle.generation())
+                throw std::logic_error("PixieDescriptorAllocator: stale or double free");
+        } while (!generations[slot].compare_exchange_weak(generation, generation + 1, std::memory_order_relaxed));
+
+        persistentInUse.fetch_sub(1, std::memory_order_relaxed);
+
+        uint64_t head = freeHead.load(std::memory_order_relaxed);
+        for (;;) {
+            nextFree[slot].store(static_cast<uint32_t>(head), std::memory_order_relaxed);
+            const uint64_t tag = (head >> 32) + 1;
+            if (freeHead.compare_exchange_weak(head, (tag << 32) | slot, std::memory_order_release, std::memory_order_relaxed))
+                return;
+        }
+    }
+
+    bool PixieDescriptorAllocator::valid(PixieDescriptorHandle handle) const {
+        const uint32_t slot = handle.index();
+        if (slot >= persistentCount)
+            return false;
+
+        const uint32_t generation = generations[slot].load(std::memory_order_relaxed);
+        return (generation & 1) != 0 && (generation & generationMask) == handle.generation();
+    }
+
+    uint32_t PixieDescriptorAllocator::index(PixieDescriptorHandle handle) const {
+        if (!valid(handle))
+            throw std::logic_error("PixieDescriptorAllocator: stale descriptor handle");
+        return handle.index();
+    }
+
+    bool PixieDescriptorAllocator::allocateTransient(uint32_t count, uint32_t &first) {
+        if (count == 0 || count > transientCount)
+            throw std::invalid_argument("PixieDescriptorAllocator: bad transient range size");
+
+        uint64_t head = transientHead.load(std::memory_order_relaxed);
+        for (;;) {
+            // ranges are contiguous in the heap, one that would wrap skips the rest of the ring instead
+            const uint64_t position = head % transientCount;
+            const uint64_t start = position + count > transientCount ? head + (transientCount - position) : head;
+            const uint64_t end = start + count;
+
+            if (end - transientTail.load(std::memory_order_acquire) > transientCount) {
+                failedAllocations.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+
+            if (transientHead.compare_exchange_weak(head, end, std::memory_order_relaxed)) {
+                first = persistentCount + static_cast<uint32_t>(start % transientCount);
+
+                const auto inUse = static_cast<uint32_t>(end - transientTail.load(std::memory_order_relaxed));
+                uint32_t highWater = transientHighWater.load(std::memory_order_relaxed);
+                while (inUse > highWater && !transientHighWater.compare_exchange_weak(highWater, inUse, std::memory_order_relaxed)) {
+                }
+                return true;
+            }
+        }
+    }
+
+    void PixieDescriptorAllocator::submit(uint64_t fence) {
+        const uint64_t head = transientHead.load(std::memory_order_relaxed);
+        if (head != submittedHead) {
+            inFlight.push_back({fence, head});
+            submittedHead = head;
+        }
+    }
+
+    void PixieDescriptorAllocator::retire(uint64_t completedFence) {
+        uint64_t tail = transientTail.load(std::memory_order_relaxed);
+        while (!inFlight.empty() && inFlight.front().first <= completedFence) {
+            tail = inFlight.front().second;
+            inFlight.pop_front();
+        }
+        transientTail.store(tail, std::memory_order_release);
+    }
+
+    PixieDescriptorStats PixieDescriptorAllocator::stats() const {
+        PixieDescriptorStats result = {};
+        result.persistentInUse = persistentInUse.load(std::memory_order_relaxed);
+        result.persistentHighWater = persistentHighWater.load(std::memory_order_relaxed);
+        result.transientInUse = static_cast<uint32_t>(transientHead.load(std::memory_order_relaxed) - transientTail.load(std::memory_order_relaxed));
+        result.transientHighWater = transientHighWater.load(std::memory_order_relaxed);
+        result.failedAllocations = failedAllocations.load(std::memory_order_relaxed);
+        return result;
+    }
+} // namespace pxe
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <utility>
+
+namespace pxe {
+    // index into the persistent region plus a generation, a freed handle stops resolving even once its slot is reused
+    struct PixieDescriptorHandle {
+        static const uint32_t indexBits = 20;
+        static const uint32_t indexMask = (1u << indexBits) - 1;
+
+        uint32_t value = UINT32_MAX;
+
+        uint32_t index() const { return value & indexMask; }
+        uint32_t generation() const { return value >> indexBits; }
+        bool operator==(const PixieDescriptorHandle &other) const { return value == other.value; }
+    };
+
+    static const PixieDescriptorHandle invalidDescriptor = {};
+
+    struct PixieDescriptorStats {
+        uint32_t persistentInUse;
+        uint32_t persistentHighWater;
+        uint32_t transientInUse; // descriptors in frames the gpu hasn't finished, wasted tail slots included
+        uint32_t transientHighWater;
+        uint64_t failedAllocations;
+    };
+
+    // hands out descriptor indices in one big shader visible heap, the backend writes the views.
+    // [0, persistentCount) holds long lived views behind a lock-free free list, any thread may allocate and free.
+    // [persistentCount, persistentCount + transientCount) is a ring of views that live until the frame using them retires,
+    // any recording thread may allocate, submit and retire belong to the render thread
+    class PixieDescriptorAllocator {
+    public:
+        PixieDescriptorAllocator(uint32_t persistentCount, uint32_t transientCount);
+
+        PixieDescriptorAllocator(const PixieDescriptorAllocator &) = delete;
+        PixieDescriptorAllocator &operator=(const PixieDescriptorAllocator &) = delete;
+
+        // invalidDescriptor once the region is full, lower indices come out first on a fresh allocator
+        PixieDescriptorHandle allocate();
+        // the caller makes sure no frame in flight still samples the view, stale or double frees throw
+        void free(PixieDescriptorHandle handle);
+        bool valid(PixieDescriptorHandle handle) const;
+        // heap index of a live handle, throws on a stale one
+        uint32_t index(PixieDescriptorHandle handle) const;
+
+        // count contiguous heap indices for this frame, false when the ring is still full of frames in flight
+        bool allocateTransient(uint32_t count, uint32_t &first);
+        // tag every transient range handed out since the last submit with the fence of the frame using it
+        void submit(uint64_t fence);
+        void retire(uint64_t completedFence);
+
+        uint32_t capacity() const { return persistentCount + transientCount; }
+        uint32_t transientBase() const { return persistentCount; }
+        PixieDescriptorStats stats() const;
+
+    private:
+        static const uint32_t endOfList = UINT32_MAX;
+
+        uint32_t persistentCount;
+        uint32_t transientCount;
+
+        // treiber stack of free slots, the head carries a tag in its top half so a pop racing a pop and push can't aba
+        std::atomic<uint64_t> freeHead;
+        std::unique_ptr<std::atomic<uint32_t>[]> nextFree;
+        std::unique_ptr<std::atomic<uint32_t>[]> generations; // odd while the slot is allocated
+
+        std::atomic<uint64_t> transientHead; // total descriptors handed out, only grows
+        std::atomic<uint64_t> transientTail; // total given back
+        std::deque<std::pair<uint64_t, uint64_t>> inFlight; // fence and the head it covers
+        uint64_t submittedHead;
+
+        std::atomic<uint32_t> persistentInUse;
+        std::atomic<uint32_t> persistentHighWater;
+        std::atomic<uint32_t> transientHighWater;
+        std::atomic<uint64_t> failedAllocations;
+    };
+} // namespace pxe
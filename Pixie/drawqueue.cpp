@@ -0,0 +1,74 @@
+#include "drawqueue.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+namespace pxe {
+    uint64_t PixieSortKey::make(uint32_t layer, uint32_t pipeline, uint32_t texture, float depth) {
+        if (layer >> layerBits != 0 || pipeline >> pipelineBits != 0 || texture >> textureBits != 0)
+            throw std::out_of_range("PixieSortKey: field doesn't fit its bits");
+
+        // the comparison form also sends nan to 0
+        const float clamped = depth > 0.0f ? std::min(depth, 1.0f) : 0.0f;
+        // double, float can't hold the half step at the top of 24 bits and would spill into the texture field
+        const auto quantized = static_cast<uint64_t>(static_cast<double>(clamped) * ((1u << depthBits) - 1) + 0.5);
+
+        return (static_cast<uint64_t>(layer) << layerShift) | (static_cast<uint64_t>(pipeline) << pipelineShift) |
+            (static_cast<uint64_t>(texture) << textureShift) | (quantized << depthShift);
+    }
+
+    void PixieDrawQueue::reserve(size_t count) {
+        packets.reserve(count);
+        scratch.reserve(count);
+    }
+
+    const std::vector<PixieDrawPacket> &PixieDrawQueue::sort() {
+        scratch.resize(packets.size());
+        radixSort(packets.data(), scratch.data(), packets.size());
+        return packets;
+    }
+
+    void PixieDrawQueue::radixSort(PixieDrawPacket *packets, PixieDrawPacket *scratch, size_t count) {
+        // 11 bit digits, six passes cover the key and the histograms stay in l1/l2
+        constexpr int digitBits = 11;
+        constexpr int digits = (64 + digitBits - 1) / digitBits;
+        constexpr uint32_t buckets = 1u << digitBits;
+        constexpr uint64_t mask = buckets - 1;
+
+        if (count < 2)
+            return;
+
+        // every digit's histogram in one read of the keys
+        static thread_local uint32_t histograms[digits][buckets];
+        std::memset(histograms, 0, sizeof(histograms));
+        for (size_t i = 0; i < count; ++i) {
+            const uint64_t key = packets[i].key;
+            for (int d = 0; d < digits; ++d)
+                histograms[d][(key >> (d * digitBits)) & mask]++;
+        }
+
+        PixieDrawPacket *src = packets;
+        PixieDrawPacket *dst = scratch;
+        for (int d = 0; d < digits; ++d) {
+            uint32_t *histogram = histograms[d];
+            const int shift = d * digitBits;
+
+            // one bucket holding everything means this digit can't reorder anything
+            if (histogram[(src[0].key >> shift) & mask] == count)
+                continue;
+
+            uint32_t offset = 0;
+            for (uint32_t b = 0; b < buckets; ++b)
+                offset += std::exchange(histogram[b], offset);
+
+            for (size_t i = 0; i < count; ++i)
+                dst[histogram[(src[i].key >> shift) & mask]++] = src[i];
+
+            std::swap(src, dst);
+        }
+
+        if (src != packets)
+            std::memcpy(packets, src, count * sizeof(PixieDrawPacket));
+    }
+} // namespace pxe
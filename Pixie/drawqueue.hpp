@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace pxe {
+    // 64 bit draw order, most significant first: layer | pipeline | texture | depth.
+    // whatever has to composite in submission order goes on separate layers, inside a layer draws group by state
+    struct PixieSortKey {
+        static const uint32_t layerBits = 8;
+        static const uint32_t pipelineBits = 12;
+        static const uint32_t textureBits = 20;
+        static const uint32_t depthBits = 24;
+
+        static const uint32_t depthShift = 0;
+        static const uint32_t textureShift = depthShift + depthBits;
+        static const uint32_t pipelineShift = textureShift + textureBits;
+        static const uint32_t layerShift = pipelineShift + pipelineBits;
+
+        // depth is clamped to [0, 1], lower draws first
+        static uint64_t make(uint32_t layer, uint32_t pipeline, uint32_t texture, float depth);
+
+        static uint32_t layer(uint64_t key) { return static_cast<uint32_t>(key >> layerShift) & ((1u << layerBits) - 1); }
+        static uint32_t pipeline(uint64_t key) { return static_cast<uint32_t>(key >> pipelineShift) & ((1u << pipelineBits) - 1); }
+        static uint32_t texture(uint64_t key) { return static_cast<uint32_t>(key >> textureShift) & ((1u << textureBits) - 1); }
+    };
+
+    // key plus an index into whatever the caller keeps per draw
+    struct PixieDrawPacket {
+        uint64_t key;
+        uint32_t payload;
+    };
+
+    // packets for one frame, sorted with an lsd radix sort so equal keys keep submission order
+    class PixieDrawQueue {
+    public:
+        void push(uint64_t key, uint32_t payload) { packets.push_back({key, payload}); }
+        void clear() { packets.clear(); }
+        void reserve(size_t count);
+
+        // returns the packets in key order, valid until the next push or clear
+        const std::vector<PixieDrawPacket> &sort();
+
+        size_t size() const { return packets.size(); }
+        bool empty() const { return packets.empty(); }
+
+        // 11 bit digits, six passes of 2048 buckets over the 64 bit key. passes where every key has the same digit are skipped, so unused fields cost nothing
+        static void radixSort(PixieDrawPacket *packets, PixieDrawPacket *scratch, size_t count);
+
+    private:
+        std::vector<PixieDrawPacket> packets;
+        std::vector<PixieDrawPacket> scratch;
+    };
+} // namespace pxe
@@ -0,0 +1,292 @@
+#include "entity.hpp"
+#include <bitset>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+
+namespace pxe {
+    namespace {
+        std::mutex registryMutex;
+        std::array<PixieComponentInfo, PixieComponentRegistry::maxComponents> registryInfo;
+        uint32_t registryCount = 0;
+
+        size_t alignUp(size_t value, size_t alignment) {
+            return (value + alignment - 1) & ~(alignment - 1);
+        }
+
+        uint8_t *allocateChunk() {
+            return static_cast<uint8_t *>(::operator new(PixieArchetype::chunkBytes, std::align_val_t(PixieArchetype::columnAlignment)));
+        }
+
+        void freeChunk(uint8_t *memory) {
+            ::operator delete(memory, std::align_val_t(PixieArchetype::columnAlignment));
+        }
+    } // namespace
+
+    PixieComponentId PixieComponentRegistry::add(size_t size, size_t alignment) {
+        if (alignment > PixieArchetype::columnAlignment)
+            throw std::invalid_argument("PixieComponentRegistry: components can't be aligned past a cache line");
+
+        std::lock_guard<std::mutex> lock(registryMutex);
+        if (registryCount == maxComponents)
+            throw std::length_error("PixieComponentRegistry: out of component ids");
+        registryInfo[registryCount] = {size, alignment};
+        return registryCount++;
+    }
+
+    PixieComponentInfo PixieComponentRegistry::info(PixieComponentId id) {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        if (id >= registryCount)
+            throw std::out_of_range("PixieComponentRegistry: unknown component");
+        return registryInfo[id];
+    }
+
+    uint32_t PixieComponentRegistry::count() {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        return registryCount;
+    }
+
+    PixieArchetype::PixieArchetype(PixieComponentMask mask)
+        : componentMask(mask)
+        , entityColumn(0)
+        , rowCapacity(0)
+        , entityCount(0) {
+
+        offsets.fill(uint32_t(noColumn));
+        sizes.fill(0);
+        addEdges.fill(nullptr);
+        removeEdges.fill(nullptr);
+
+        size_t rowBytes = sizeof(PixieEntity);
+        for (PixieComponentId id = 0; id < PixieComponentRegistry::maxComponents; ++id) {
+            if ((mask >> id & 1) == 0)
+                continue;
+            ids.push_back(id);
+            sizes[id] = static_cast<uint32_t>(PixieComponentRegistry::info(id).size);
+            rowBytes += sizes[id];
+        }
+
+        // as many rows as fit once every column is padded out to a cache line
+        for (size_t capacity = chunkBytes / rowBytes; capacity > 0; --capacity) {
+            size_t offset = alignUp(sizeof(PixieEntity) * capacity, columnAlignment);
+            for (const PixieComponentId id : ids) {
+                offsets[id] = static_cast<uint32_t>(offset);
+                offset = alignUp(offset + size_t(sizes[id]) * capacity, columnAlignment);
+            }
+            if (offset <= chunkBytes) {
+                rowCapacity = static_cast<uint32_t>(capacity);
+                return;
+            }
+        }
+        throw std::invalid_argument("PixieArchetype: components too large for one chunk");
+    }
+
+    PixieWorld::PixieWorld() : moves(0) {
+    }
+
+    PixieWorld::~PixieWorld() {
+        for (const std::unique_ptr<PixieArchetype> &archetype : archetypes) {
+            for (const PixieArchetype::Chunk &chunk : archetype->chunkList)
+                freeChunk(chunk.memory);
+        }
+        for (uint8_t *memory : spareChunks)
+            freeChunk(memory);
+    }
+
+    void PixieWorld::destroy(PixieEntity entity) {
+        if (!alive(entity))
+            return;
+
+        Record &record = records[entity.index];
+        eraseRow(*record.archetype, record.chunk, record.row);
+        record.archetype = nullptr;
+        record.generation++;
+        freeIndices.push_back(entity.index);
+    }
+
+    bool PixieWorld::alive(PixieEntity entity) const {
+        return entity.index < records.size() && records[entity.index].archetype && records[entity.index].generation == entity.generation;
+    }
+
+    PixieWorldStats PixieWorld::stats() const {
+        PixieWorldStats result = {};
+        result.entities = size();
+        result.archetypes = archetypes.size();
+        for (const std::unique_ptr<PixieArchetype> &archetype : archetypes)
+            result.chunks += archetype->chunkList.size();
+        result.spareChunks = spareChunks.size();
+        result.memoryBytes = (result.chunks + result.spareChunks) * PixieArchetype::chunkBytes;
+        result.moves = moves;
+        return result;
+    }
+
+    PixieEntity PixieWorld::allocate(PixieComponentMask mask, size_t componentCount) {
+        if (std::bitset<64>(mask).count() != componentCount)
+            throw std::invalid_argument("PixieWorld: the same component given twice");
+
+        PixieArchetype *archetype = archetypeFor(mask);
+        uint32_t index;
+        if (freeIndices.empty()) {
+            index = static_cast<uint32_t>(records.size());
+            records.push_back({nullptr, 0, 0, 0});
+        } else {
+            index = freeIndices.back();
+            freeIndices.pop_back();
+        }
+
+        pushRow(*archetype, index);
+        return {index, records[index].generation};
+    }
+
+    void *PixieWorld::data(PixieEntity entity, PixieComponentId id) {
+        if (!alive(entity))
+            return nullptr;
+
+        const Record &record = records[entity.index];
+        if (record.archetype->offsets[id] == PixieArchetype::noColumn)
+            return nullptr;
+        return column(*record.archetype, record.chunk, id) + size_t(record.row) * record.archetype->sizes[id];
+    }
+
+    void *PixieWorld::addComponent(PixieEntity entity, PixieComponentId id) {
+        if (!alive(entity))
+            throw std::invalid_argument("PixieWorld: entity was destroyed");
+
+        PixieArchetype &from = *records[entity.index].archetype;
+        if (from.offsets[id] == PixieArchetype::noColumn) {
+            PixieArchetype *to = from.addEdges[id];
+            if (!to) {
+                to = archetypeFor(from.mask() | PixieComponentMask(1) << id);
+                from.addEdges[id] = to;
+                to->removeEdges[id] = &from;
+            }
+            moveRow(entity.index, *to);
+        }
+        return data(entity, id);
+    }
+
+    void PixieWorld::removeComponent(PixieEntity entity, PixieComponentId id) {
+        if (!alive(entity))
+            throw std::invalid_argument("PixieWorld: entity was destroyed");
+
+        PixieArchetype &from = *records[entity.index].archetype;
+        if (from.offsets[id] == PixieArchetype::noColumn)
+            return;
+
+        PixieArchetype *to = from.removeEdges[id];
+        if (!to) {
+            to = archetypeFor(from.mask() & ~(PixieComponentMask(1) << id));
+            from.removeEdges[id] = to;
+            to->addEdges[id] = &from;
+        }
+        moveRow(entity.index, *to);
+    }
+
+    PixieArchetype *PixieWorld::archetypeFor(PixieComponentMask mask) {
+        const auto found = archetypesByMask.find(mask);
+        if (found != archetypesByMask.end())
+            return found->second;
+
+        archetypes.push_back(std::make_unique<PixieArchetype>(mask));
+        PixieArchetype *archetype = archetypes.back().get();
+        archetypesByMask.emplace(mask, archetype);
+        return archetype;
+    }
+
+    void PixieWorld::pushRow(PixieArchetype &archetype, uint32_t index) {
+        if (archetype.chunkList.empty() || archetype.chunkList.back().count == archetype.rowCapacity) {
+            uint8_t *memory;
+            if (spareChunks.empty()) {
+                memory = allocateChunk();
+            } else {
+                memory = spareChunks.back();
+                spareChunks.pop_back();
+            }
+            archetype.chunkList.push_back({memory, 0});
+        }
+
+        PixieArchetype::Chunk &chunk = archetype.chunkList.back();
+        Record &record = records[index];
+        record.archetype = &archetype;
+        record.chunk = static_cast<uint32_t>(archetype.chunkList.size() - 1);
+        record.row = chunk.count++;
+        reinterpret_cast<PixieEntity *>(chunk.memory + archetype.entityColumn)[record.row] = {index, record.generation};
+        archetype.entityCount++;
+    }
+
+    void PixieWorld::eraseRow(PixieArchetype &archetype, uint32_t chunk, uint32_t row) {
+        const auto lastChunk = static_cast<uint32_t>(archetype.chunkList.size() - 1);
+        PixieArchetype::Chunk &last = archetype.chunkList.back();
+        const uint32_t lastRow = last.count - 1;
+
+        if (chunk != lastChunk || row != lastRow) {
+            for (const PixieComponentId id : archetype.ids) {
+                const size_t size = archetype.sizes[id];
+                std::memcpy(column(archetype, chunk, id) + row * size, column(archetype, lastChunk, id) + lastRow * size, size);
+            }
+
+            PixieEntity *entities = reinterpret_cast<PixieEntity *>(archetype.chunkList[chunk].memory + archetype.entityColumn);
+            const PixieEntity moved = reinterpret_cast<const PixieEntity *>(last.memory + archetype.entityColumn)[lastRow];
+            entities[row] = moved;
+            records[moved.index].chunk = chunk;
+            records[moved.index].row = row;
+        }
+
+        if (--last.count == 0) {
+            spareChunks.push_back(last.memory);
+            archetype.chunkList.pop_back();
+        }
+        archetype.entityCount--;
+    }
+
+    void PixieWorld::moveRow(uint32_t index, PixieArchetype &to) {
+        PixieArchetype &from = *records[index].archetype;
+        const uint32_t chunk = records[index].chunk;
+        const uint32_t row = records[index].row;
+
+        pushRow(to, index);
+        const Record &record = records[index];
+        for (const PixieComponentId id : from.ids) {
+            if (to.offsets[id] == PixieArchetype::noColumn)
+                continue;
+            const size_t size = from.sizes[id];
+            std::memcpy(column(to, record.chunk, id) + record.row * size, column(from, chunk, id) + row * size, size);
+        }
+
+        eraseRow(from, chunk, row);
+        moves++;
+    }
+
+    uint8_t *PixieWorld::column(const PixieArchetype &archetype, uint32_t chunk, PixieComponentId id) const {
+        return archetype.chunkList[chunk].memory + archetype.offsets[id];
+    }
+
+    void PixieSystemScheduler::add(const char *name, const PixieAccess &access, System system) {
+        systems.push_back({name, access, std::move(system)});
+        taskGraph.reset();
+    }
+
+    void PixieSystemScheduler::run(PixieWorld &world, PixieJobPool &pool) {
+        if (!taskGraph)
+            build();
+
+        this->world = &world;
+        taskGraph->run(pool);
+        this->world = nullptr;
+    }
+
+    void PixieSystemScheduler::build() {
+        taskGraph = std::make_unique<PixieTaskGraph>();
+
+        // every earlier conflict rather than just the latest, a system can conflict with two that don't with each other
+        std::vector<PixieTaskId> dependsOn;
+        for (size_t i = 0; i < systems.size(); ++i) {
+            dependsOn.clear();
+            for (size_t j = 0; j < i; ++j) {
+                if (systems[i].access.conflicts(systems[j].access))
+                    dependsOn.push_back(static_cast<PixieTaskId>(j));
+            }
+            taskGraph->add(systems[i].name, [this, i] { systems[i].system(*world); }, dependsOn);
+        }
+    }
+} // namespace pxe
@@ -0,0 +1,301 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+#include "jobs.hpp"
+#include "taskgraph.hpp"
+
+namespace pxe {
+    // slot plus a generation, a destroyed entity's handle stops matching once its slot is reused
+    struct PixieEntity {
+        uint32_t index = UINT32_MAX;
+        uint32_t generation = 0;
+
+        bool operator==(const PixieEntity &other) const { return index == other.index && generation == other.generation; }
+        bool operator!=(const PixieEntity &other) const { return !(*this == other); }
+    };
+
+    static const PixieEntity invalidEntity = {};
+
+    using PixieComponentId = uint32_t;
+    using PixieComponentMask = uint64_t;
+
+    struct PixieComponentInfo {
+        size_t size;
+        size_t alignment;
+    };
+
+    // hands out a dense id per component type the first time it's used. components are plain data,
+    // chunks move them around with memcpy and never run constructors or destructors
+    class PixieComponentRegistry {
+    public:
+        static const uint32_t maxComponents = 64; // one bit each in a mask
+
+        template <typename T>
+        static PixieComponentId id() {
+            return registered<std::remove_cv_t<T>>();
+        }
+
+        static PixieComponentInfo info(PixieComponentId id);
+        static uint32_t count();
+
+    private:
+        template <typename T>
+        static PixieComponentId registered() {
+            static_assert(std::is_trivially_copyable_v<T> && std::is_trivially_destructible_v<T>, "components have to be plain data");
+            static const PixieComponentId value = add(sizeof(T), alignof(T));
+            return value;
+        }
+
+        static PixieComponentId add(size_t size, size_t alignment);
+    };
+
+    template <typename... Ts>
+    PixieComponentMask componentMask() {
+        return (PixieComponentMask(0) | ... | (PixieComponentMask(1) << PixieComponentRegistry::id<Ts>()));
+    }
+
+    // one set of components. its entities live in fixed size chunks, each chunk split into a cache line aligned
+    // column per component so a query walks every column front to back
+    class PixieArchetype {
+    public:
+        static const size_t chunkBytes = 16384;
+        static const size_t columnAlignment = 64;
+        static const uint32_t noColumn = UINT32_MAX;
+
+        struct Chunk {
+            uint8_t *memory;
+            uint32_t count;
+        };
+
+        explicit PixieArchetype(PixieComponentMask mask);
+
+        PixieComponentMask mask() const { return componentMask; }
+        const std::vector<PixieComponentId> &components() const { return ids; }
+        // rows a chunk holds
+        uint32_t capacity() const { return rowCapacity; }
+        // byte offset of a component's column in each chunk, noColumn when the archetype doesn't have it
+        uint32_t columnOffset(PixieComponentId id) const { return offsets[id]; }
+        uint32_t entityOffset() const { return entityColumn; }
+        const std::vector<Chunk> &chunks() const { return chunkList; }
+        size_t size() const { return entityCount; }
+
+    private:
+        friend class PixieWorld;
+
+        PixieComponentMask componentMask;
+        std::vector<PixieComponentId> ids;
+        std::array<uint32_t, PixieComponentRegistry::maxComponents> offsets;
+        std::array<uint32_t, PixieComponentRegistry::maxComponents> sizes;
+        uint32_t entityColumn;
+        uint32_t rowCapacity;
+        std::vector<Chunk> chunkList; // only the last one is ever partly full
+        size_t entityCount;
+
+        // where adding or removing one component leads, filled in as structural changes find them
+        std::array<PixieArchetype *, PixieComponentRegistry::maxComponents> addEdges;
+        std::array<PixieArchetype *, PixieComponentRegistry::maxComponents> removeEdges;
+    };
+
+    // one chunk as a query sees it
+    class PixieChunkView {
+    public:
+        PixieChunkView(const PixieArchetype &archetype, const PixieArchetype::Chunk &chunk) : archetype(&archetype), chunk(chunk) {}
+
+        uint32_t size() const { return chunk.count; }
+        const PixieEntity *entities() const { return reinterpret_cast<const PixieEntity *>(chunk.memory + archetype->entityOffset()); }
+
+        // nullptr when the archetype doesn't have the component, const T for read only columns
+        template <typename T>
+        T *column() const {
+            const uint32_t offset = archetype->columnOffset(PixieComponentRegistry::id<T>());
+            return offset == PixieArchetype::noColumn ? nullptr : reinterpret_cast<T *>(chunk.memory + offset);
+        }
+
+    private:
+        const PixieArchetype *archetype;
+        PixieArchetype::Chunk chunk;
+    };
+
+    struct PixieWorldStats {
+        size_t entities;
+        size_t archetypes;
+        size_t chunks;
+        size_t spareChunks; // emptied and kept for the next archetype that grows
+        size_t memoryBytes; // chunks, spare ones included
+        uint64_t moves; // entities copied to another archetype by add or remove
+    };
+
+    // entities and their components grouped by archetype. structural changes (create, destroy, add, remove) move rows
+    // between chunks, so they mustn't happen while a query or a system is running, queries only read and write in place
+    class PixieWorld {
+    public:
+        PixieWorld();
+        ~PixieWorld();
+
+        PixieWorld(const PixieWorld &) = delete;
+        PixieWorld &operator=(const PixieWorld &) = delete;
+
+        template <typename... Ts>
+        PixieEntity create(const Ts &...components) {
+            const PixieEntity entity = allocate(componentMask<Ts...>(), sizeof...(Ts));
+            (std::memcpy(data(entity, PixieComponentRegistry::id<Ts>()), &components, sizeof(Ts)), ...);
+            return entity;
+        }
+
+        void destroy(PixieEntity entity);
+        bool alive(PixieEntity entity) const;
+
+        // overwrites the component if the entity already has it
+        template <typename T>
+        void add(PixieEntity entity, const T &component) {
+            std::memcpy(addComponent(entity, PixieComponentRegistry::id<T>()), &component, sizeof(T));
+        }
+
+        template <typename T>
+        void remove(PixieEntity entity) {
+            removeComponent(entity, PixieComponentRegistry::id<T>());
+        }
+
+        // nullptr when the entity is gone or doesn't have the component, valid until the next structural change
+        template <typename T>
+        T *get(PixieEntity entity) {
+            return static_cast<T *>(data(entity, PixieComponentRegistry::id<T>()));
+        }
+
+        template <typename T>
+        bool has(PixieEntity entity) const {
+            return alive(entity) && (records[entity.index].archetype->mask() & componentMask<T>()) != 0;
+        }
+
+        // fn(const PixieChunkView &) for every non empty chunk holding at least Ts
+        template <typename... Ts, typename Fn>
+        void eachChunk(Fn &&fn) {
+            const PixieComponentMask required = componentMask<Ts...>();
+            for (const std::unique_ptr<PixieArchetype> &archetype : archetypes) {
+                if ((archetype->mask() & required) != required)
+                    continue;
+                for (const PixieArchetype::Chunk &chunk : archetype->chunks())
+                    fn(PixieChunkView(*archetype, chunk));
+            }
+        }
+
+        // fn(Ts &...) per entity, const Ts for components the query only reads
+        template <typename... Ts, typename Fn>
+        void each(Fn &&fn) {
+            eachChunk<Ts...>([&fn](const PixieChunkView &chunk) { eachRow(chunk.size(), fn, chunk.column<Ts>()...); });
+        }
+
+        // same with chunks spread over the pool, fn runs concurrently and may only touch its own entity
+        template <typename... Ts, typename Fn>
+        void each(PixieJobPool &pool, Fn &&fn) {
+            std::vector<PixieChunkView> chunks;
+            eachChunk<Ts...>([&chunks](const PixieChunkView &chunk) { chunks.push_back(chunk); });
+            pool.parallelFor(chunks.size(), [&](size_t i) { eachRow(chunks[i].size(), fn, chunks[i].column<Ts>()...); });
+        }
+
+        size_t size() const { return records.size() - freeIndices.size(); }
+        const std::vector<std::unique_ptr<PixieArchetype>> &archetypeList() const { return archetypes; }
+        PixieWorldStats stats() const;
+
+    private:
+        struct Record {
+            PixieArchetype *archetype; // null while the slot is free
+            uint32_t chunk;
+            uint32_t row;
+            uint32_t generation;
+        };
+
+        template <typename Fn, typename... Ps>
+        static void eachRow(uint32_t count, Fn &fn, Ps *...columns) {
+            for (uint32_t i = 0; i < count; ++i)
+                fn(columns[i]...);
+        }
+
+        PixieEntity allocate(PixieComponentMask mask, size_t componentCount);
+        void *data(PixieEntity entity, PixieComponentId id);
+        void *addComponent(PixieEntity entity, PixieComponentId id);
+        void removeComponent(PixieEntity entity, PixieComponentId id);
+
+        PixieArchetype *archetypeFor(PixieComponentMask mask);
+        // appends a row to the archetype's last chunk, the components are left for the caller to write
+        void pushRow(PixieArchetype &archetype, uint32_t index);
+        // fills the hole with the archetype's last row
+        void eraseRow(PixieArchetype &archetype, uint32_t chunk, uint32_t row);
+        void moveRow(uint32_t index, PixieArchetype &to);
+        uint8_t *column(const PixieArchetype &archetype, uint32_t chunk, PixieComponentId id) const;
+
+        std::vector<Record> records;
+        std::vector<uint32_t> freeIndices;
+        std::vector<std::unique_ptr<PixieArchetype>> archetypes;
+        std::unordered_map<PixieComponentMask, PixieArchetype *> archetypesByMask;
+        std::vector<uint8_t *> spareChunks;
+        uint64_t moves;
+    };
+
+    // what a system reads and writes. two systems whose sets don't conflict can run at the same time
+    class PixieAccess {
+    public:
+        template <typename... Ts>
+        PixieAccess &read() {
+            reads |= componentMask<Ts...>();
+            return *this;
+        }
+
+        template <typename... Ts>
+        PixieAccess &write() {
+            writes |= componentMask<Ts...>();
+            return *this;
+        }
+
+        // for systems that make structural changes or touch state outside the world, they run alone
+        PixieAccess &exclusive() {
+            exclusiveAccess = true;
+            return *this;
+        }
+
+        bool conflicts(const PixieAccess &other) const {
+            return exclusiveAccess || other.exclusiveAccess || (writes & (other.reads | other.writes)) != 0 || (reads & other.writes) != 0;
+        }
+
+    private:
+        PixieComponentMask reads = 0;
+        PixieComponentMask writes = 0;
+        bool exclusiveAccess = false;
+    };
+
+    // runs a frame's systems on the task graph. each one waits for the earlier systems it conflicts with,
+    // so the result is the same as running them in the order they were added
+    class PixieSystemScheduler {
+    public:
+        using System = std::function<void(PixieWorld &)>;
+
+        // names have to outlive the graph's profiler events, use literals
+        void add(const char *name, const PixieAccess &access, System system);
+        void run(PixieWorld &world, PixieJobPool &pool);
+
+        size_t size() const { return systems.size(); }
+        // the last run's timeline and report, only valid after run
+        const PixieTaskGraph &graph() const { return *taskGraph; }
+
+    private:
+        struct Entry {
+            const char *name;
+            PixieAccess access;
+            System system;
+        };
+
+        void build();
+
+        std::vector<Entry> systems;
+        std::unique_ptr<PixieTaskGraph> taskGraph; // rebuilt when a system is added
+        PixieWorld *world = nullptr;
+    };
+} // namespace pxe
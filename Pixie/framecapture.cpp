@@ -0,0 +1,135 @@
+#include "framecapture.hpp"
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+namespace pxe {
+    PixieFrameCapture::PixieFrameCapture(uint32_t width, uint32_t height, const PixieCaptureSettings &settings)
+        : width(width)
+        , height(height)
+        , settings(settings)
+        , frameCount(0)
+        , captureStats {}
+        , encoders(settings.threadCount) {
+
+        if (width == 0 || height == 0)
+            throw std::invalid_argument("PixieFrameCapture: bad frame size");
+        if (settings.slotCount == 0)
+            throw std::invalid_argument("PixieFrameCapture: needs at least one slot");
+
+        std::error_code error;
+        std::filesystem::create_directories(settings.directory, error);
+        if (error)
+            throw std::runtime_error("PixieFrameCapture: can't create " + settings.directory + ": " + error.message());
+
+        // every slot is sized up front, nothing is allocated per frame once the encoders have grown their buffers
+        for (uint32_t i = 0; i < settings.slotCount; ++i) {
+            slots.push_back(std::make_unique<Slot>());
+            slots.back()->pixels.resize(size_t(width) * height);
+            freeSlots.push_back(slots.back().get());
+        }
+    }
+
+    PixieFrameCapture::~PixieFrameCapture() {
+        encoders.wait();
+    }
+
+    bool PixieFrameCapture::submit(const uint32_t *pixels, uint32_t pitch) {
+        if (pitch < width)
+            throw std::invalid_argument("PixieFrameCapture: pitch narrower than the frame");
+
+        Slot *slot;
+        {
+            std::unique_lock<std::mutex> lock(slotMutex);
+            if (!failure.empty())
+                throw std::runtime_error(failure);
+
+            const auto now = std::chrono::steady_clock::now();
+            if (captureStats.submitted == 0)
+                firstSubmit = now;
+            captureStats.submitted++;
+            const uint64_t frame = frameCount++;
+
+            if (freeSlots.empty()) {
+                if (settings.dropWhenFull) {
+                    captureStats.dropped++;
+                    return false;
+                }
+
+                captureStats.stalls++;
+                slotFreed.wait(lock, [this] { return !freeSlots.empty() || !failure.empty(); });
+                captureStats.stallMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - now).count();
+                if (!failure.empty())
+                    throw std::runtime_error(failure);
+            }
+
+            slot = freeSlots.back();
+            freeSlots.pop_back();
+            slot->frame = frame;
+        }
+
+        // the slot belongs to this thread until the job is queued
+        const size_t rowBytes = size_t(width) * sizeof(uint32_t);
+        for (uint32_t y = 0; y < height; ++y)
+            std::memcpy(slot->pixels.data() + size_t(y) * width, pixels + size_t(y) * pitch, rowBytes);
+
+        encoders.submit([this, slot] { encode(*slot); });
+        return true;
+    }
+
+    void PixieFrameCapture::encode(Slot &slot) {
+        const auto begin = std::chrono::steady_clock::now();
+        const std::string path = framePath(slot.frame);
+
+        std::string error;
+        size_t bytes = 0;
+        try {
+            const std::vector<uint8_t> &image = slot.encoder.encode(settings.format, slot.pixels.data(), width, height, width, settings.opaque);
+            std::ofstream out(path, std::ios::binary | std::ios::trunc);
+            out.write(reinterpret_cast<const char *>(image.data()), static_cast<std::streamsize>(image.size()));
+            if (!out)
+                error = "PixieFrameCapture: failed to write " + path;
+            bytes = image.size();
+        } catch (const std::exception &e) {
+            error = std::string("PixieFrameCapture: failed to encode ") + path + ": " + e.what();
+        }
+
+        const auto end = std::chrono::steady_clock::now();
+        {
+            std::lock_guard<std::mutex> lock(slotMutex);
+            if (error.empty()) {
+                captureStats.written++;
+                captureStats.bytesWritten += bytes;
+            } else if (failure.empty()) {
+                failure = error;
+            }
+            captureStats.encodeMs += std::chrono::duration<double, std::milli>(end - begin).count();
+            lastWrite = end;
+            freeSlots.push_back(&slot);
+        }
+        slotFreed.notify_one();
+    }
+
+    void PixieFrameCapture::finish() {
+        encoders.wait();
+        std::lock_guard<std::mutex> lock(slotMutex);
+        if (!failure.empty())
+            throw std::runtime_error(failure);
+    }
+
+    std::string PixieFrameCapture::framePath(uint64_t frame) const {
+        char name[32];
+        std::snprintf(name, sizeof(name), "_%06llu.", static_cast<unsigned long long>(frame));
+        return (std::filesystem::path(settings.directory) / (settings.prefix + name + imageFormatExtension(settings.format))).string();
+    }
+
+    PixieCaptureStats PixieFrameCapture::stats() const {
+        std::lock_guard<std::mutex> lock(slotMutex);
+        PixieCaptureStats result = captureStats;
+        const double seconds = std::chrono::duration<double>(lastWrite - firstSubmit).count();
+        result.framesPerSecond = result.written > 0 && seconds > 0.0 ? double(result.written) / seconds : 0.0;
+        return result;
+    }
+} // namespace pxe
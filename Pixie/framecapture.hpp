@@ -0,0 +1,83 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "imageencode.hpp"
+#include "jobs.hpp"
+
+namespace pxe {
+    struct PixieCaptureSettings {
+        std::string directory = "."; // created if it isn't there
+        std::string prefix = "frame"; // files are prefix_000042.qoi, numbered by submit order
+        PixieImageFormat format = PixieImageFormat::QOI;
+        uint32_t slotCount = 4; // frames copied out and waiting on or going through an encoder
+        size_t threadCount = 0; // encode workers, 0 = one per core
+        bool dropWhenFull = false; // skip frames instead of stalling the render loop when every slot is busy
+        bool opaque = true; // alpha written as 255, png leaves the channel out
+    };
+
+    struct PixieCaptureStats {
+        uint64_t submitted; // dropped frames included
+        uint64_t written;
+        uint64_t dropped;
+        uint64_t stalls; // submits that had to wait for a slot
+        double stallMs; // render thread time spent waiting in those
+        double encodeMs; // summed over the workers, file writes included
+        uint64_t bytesWritten;
+        double framesPerSecond; // written frames from the first submit to the last write
+    };
+
+    // offscreen output for a renderer without a window. each finished frame is copied into one of a ring of slots,
+    // the readback targets, and a worker encodes and writes it while the renderer gets on with the next. the render
+    // loop only waits when encoding falls a whole ring behind, which stats report as stalls.
+    // any backend that can hand over R8G8B8A8 rows works, PixieSoftRenderer's frame buffer on a headless box
+    class PixieFrameCapture {
+    public:
+        PixieFrameCapture(uint32_t width, uint32_t height, const PixieCaptureSettings &settings = {});
+        ~PixieFrameCapture();
+
+        PixieFrameCapture(const PixieFrameCapture &) = delete;
+        PixieFrameCapture &operator=(const PixieFrameCapture &) = delete;
+
+        // copies the frame out, pixels can be reused as soon as this returns. rows are pitch pixels apart.
+        // false when every slot was busy and dropWhenFull skipped it. throws once an earlier frame failed to write
+        bool submit(const uint32_t *pixels, uint32_t pitch);
+        // waits until every submitted frame is on disk
+        void finish();
+
+        std::string framePath(uint64_t frame) const;
+        PixieCaptureStats stats() const;
+
+    private:
+        struct Slot {
+            std::vector<uint32_t> pixels;
+            PixieImageEncoder encoder;
+            uint64_t frame;
+        };
+
+        void encode(Slot &slot);
+
+        uint32_t width;
+        uint32_t height;
+        PixieCaptureSettings settings;
+
+        std::vector<std::unique_ptr<Slot>> slots;
+        std::vector<Slot *> freeSlots;
+        mutable std::mutex slotMutex;
+        std::condition_variable slotFreed;
+        std::string failure; // the first write that went wrong
+
+        uint64_t frameCount;
+        PixieCaptureStats captureStats;
+        std::chrono::steady_clock::time_point firstSubmit;
+        std::chrono::steady_clock::time_point lastWrite;
+
+        PixieJobPool encoders; // last, so workers are joined before the slots go away
+    };
+} // namespace pxe
@@ -0,0 +1,100 @@
+#include "framecapture.hpp"
+#include "softrenderer.hpp"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+// headless replay to an image sequence, usage: framedump <directory> [--frames <n>] [--size <w>x<h>] [--png] [--slots <n>] [--threads <n>] [--drop]
+// renders a fixed seed scene through the software renderer, so the same arguments give the same images on any box
+
+using namespace pxe;
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        std::fprintf(stderr, "usage: %s <directory> [--frames <n>] [--size <w>x<h>] [--png] [--slots <n>] [--threads <n>] [--drop]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    uint32_t frames = 120;
+    uint32_t width = 640;
+    uint32_t height = 480;
+    PixieCaptureSettings settings;
+    settings.directory = argv[1];
+    for (int i = 2; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+            frames = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        else if (std::strcmp(argv[i], "--size") == 0 && i + 1 < argc)
+            std::sscanf(argv[++i], "%ux%u", &width, &height);
+        else if (std::strcmp(argv[i], "--png") == 0)
+            settings.format = PixieImageFormat::PNG;
+        else if (std::strcmp(argv[i], "--slots") == 0 && i + 1 < argc)
+            settings.slotCount = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        else if (std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            settings.threadCount = std::strtoul(argv[++i], nullptr, 10);
+        else if (std::strcmp(argv[i], "--drop") == 0)
+            settings.dropWhenFull = true;
+    }
+
+    try {
+        PixieSoftRenderer renderer(width, height);
+        PixieFrameCapture capture(width, height, settings);
+
+        std::vector<uint32_t> checker(64 * 64);
+        for (uint32_t i = 0; i < checker.size(); ++i)
+            checker[i] = ((i / 64 / 8 + i % 64 / 8) & 1) ? 0xffffffffu : 0xff2020c0u;
+        const uint32_t texture = renderer.createTexture(64, 64, checker.data());
+
+        // every sprite drifts and spins from a seeded start, frame n is a pure function of n
+        struct Sprite {
+            float x, y, vx, vy, spin;
+            uint32_t color;
+        };
+        std::mt19937 rng(42);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        std::vector<Sprite> sprites(500);
+        for (Sprite &sprite : sprites) {
+            sprite = {unit(rng) * width, unit(rng) * height, unit(rng) * 4.0f - 2.0f, unit(rng) * 4.0f - 2.0f, unit(rng) * 0.1f - 0.05f, 0};
+            sprite.color = 0xff000000u | static_cast<uint32_t>(rng() & 0xffffff);
+        }
+
+        float color[4] = {0.1f, 0.1f, 0.15f, 1.0f};
+        double renderMs = 0.0;
+        const auto begin = std::chrono::steady_clock::now();
+        for (uint32_t frame = 0; frame < frames; ++frame) {
+            const auto frameBegin = std::chrono::steady_clock::now();
+            renderer.beginFrame(color);
+            for (const Sprite &sprite : sprites) {
+                const float x = std::fmod(sprite.x + sprite.vx * frame + width, float(width));
+                const float y = std::fmod(sprite.y + sprite.vy * frame + height, float(height));
+                const float angle = sprite.spin * frame;
+                const PixieTransform2D transform = {std::cos(angle), std::sin(angle), -std::sin(angle), std::cos(angle), x, y};
+                renderer.drawSprite(texture, {-16.0f, -16.0f, 32.0f, 32.0f}, {0.0f, 0.0f, 1.0f, 1.0f}, sprite.color, transform);
+            }
+            renderer.endFrame();
+            renderMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameBegin).count();
+
+            capture.submit(renderer.pixels(), renderer.pitch());
+        }
+        const auto submitted = std::chrono::steady_clock::now();
+        capture.finish();
+        const auto end = std::chrono::steady_clock::now();
+
+        const PixieCaptureStats stats = capture.stats();
+        const double loopSeconds = std::chrono::duration<double>(submitted - begin).count();
+        const double totalSeconds = std::chrono::duration<double>(end - begin).count();
+        std::printf("%u frames %ux%u, render %.2f ms/frame, render loop %.1f fps, written %.1f fps over %.2f s\n",
+            frames, width, height, renderMs / frames, frames / loopSeconds, stats.written / totalSeconds, totalSeconds);
+        std::printf("%llu written, %llu dropped, %llu stalls (%.1f ms), encode %.2f ms/frame, %.1f KB/frame\n",
+            static_cast<unsigned long long>(stats.written), static_cast<unsigned long long>(stats.dropped), static_cast<unsigned long long>(stats.stalls),
+            stats.stallMs, stats.written ? stats.encodeMs / stats.written : 0.0, stats.written ? stats.bytesWritten / 1024.0 / stats.written : 0.0);
+    } catch (const std::exception &e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,194 @@
+#include "framepacer.hpp"
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#endif
+
+#include <immintrin.h>
+
+namespace pxe {
+    PixieSystemClock::PixieSystemClock() {
+#ifdef _WIN32
+        // plain Sleep rounds up to the system tick, the high resolution timer wakes within a fraction of a millisecond
+        timer = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+#endif
+    }
+
+    PixieSystemClock::~PixieSystemClock() {
+#ifdef _WIN32
+        if (timer)
+            CloseHandle(timer);
+#endif
+    }
+
+    uint64_t PixieSystemClock::now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void PixieSystemClock::sleepFor(uint64_t nanoseconds) {
+#ifdef _WIN32
+        if (timer) {
+            LARGE_INTEGER due = {};
+            due.QuadPart = -static_cast<LONGLONG>(nanoseconds / 100); // relative, in 100 ns units
+            if (SetWaitableTimerEx(timer, &due, 0, nullptr, nullptr, nullptr, 0)) {
+                WaitForSingleObject(timer, INFINITE);
+                return;
+            }
+        }
+#endif
+        std::this_thread::sleep_for(std::chrono::nanoseconds(nanoseconds));
+    }
+
+    void PixieSystemClock::relax() {
+        _mm_pause();
+    }
+
+    PixieFramePacer::PixieFramePacer(PixieClock &clock, double updateRate, double targetRate)
+        : clock(clock)
+        , stepNs(0)
+        , periodNs(0)
+        , spinThreshold(2000000)
+        , maxSteps(8)
+        , frameStart(0)
+        , deadline(0)
+        , accumulator(0)
+        , lastFrameNs(0)
+        , started(false)
+        , history(historySize)
+        , buckets(bucketCount + 1) // the last one catches everything past 100 ms
+        , historyCount(0)
+        , historyNext(0)
+        , historyTotal(0)
+        , frames(0)
+        , hitches(0)
+        , droppedSteps(0) {
+
+        if (!(updateRate > 0.0))
+            throw std::invalid_argument("PixieFramePacer: update rate has to be positive");
+
+        stepNs = static_cast<uint64_t>(1e9 / updateRate + 0.5);
+        setTargetRate(targetRate);
+    }
+
+    void PixieFramePacer::setTargetRate(double framesPerSecond) {
+        if (framesPerSecond < 0.0)
+            throw std::invalid_argument("PixieFramePacer: negative target rate");
+
+        periodNs = framesPerSecond > 0.0 ? static_cast<uint64_t>(1e9 / framesPerSecond + 0.5) : 0;
+        deadline = frameStart + periodNs;
+    }
+
+    void PixieFramePacer::waitForDeadline() {
+        uint64_t now = clock.now();
+        if (now + spinThreshold < deadline)
+            clock.sleepFor(deadline - spinThreshold - now);
+
+        // the sleep only has to land inside the threshold, spinning covers the rest exactly
+        while (clock.now() < deadline)
+            clock.relax();
+    }
+
+    uint32_t PixieFramePacer::beginFrame() {
+        if (!started) {
+            // nothing to measure yet, the first frame runs no steps
+            started = true;
+            frameStart = clock.now();
+            deadline = frameStart + periodNs;
+            return 0;
+        }
+
+        if (periodNs != 0)
+            waitForDeadline();
+
+        const uint64_t now = clock.now();
+        const uint64_t frameNs = now - frameStart;
+        frameStart = now;
+        lastFrameNs = frameNs;
+        record(frameNs);
+
+        if (periodNs != 0) {
+            // deadlines follow the schedule so small overshoots average out, a frame more than a period late starts a new one
+            deadline += periodNs;
+            if (deadline <= now)
+                deadline = now + periodNs;
+        }
+
+        accumulator += frameNs;
+        uint64_t steps = accumulator / stepNs;
+        if (steps > maxSteps) {
+            droppedSteps += steps - maxSteps;
+            steps = maxSteps;
+            accumulator = 0;
+        } else {
+            accumulator -= steps * stepNs;
+        }
+
+        return static_cast<uint32_t>(steps);
+    }
+
+    void PixieFramePacer::record(uint64_t frameNs) {
+        // capped frames are expected to take a period, uncapped ones whatever the recent median is
+        const double expectedMs = periodNs != 0 ? double(periodNs) * 1e-6 : percentileMs(0.5);
+        if (historyCount != 0 && double(frameNs) * 1e-6 > expectedMs * hitchFactor)
+            hitches++;
+        frames++;
+
+        if (historyCount == historySize) {
+            const uint64_t oldest = history[historyNext];
+            buckets[std::min<uint64_t>(oldest / bucketWidth, bucketCount)]--;
+            historyTotal -= oldest;
+        } else {
+            historyCount++;
+        }
+
+        history[historyNext] = frameNs;
+        buckets[std::min<uint64_t>(frameNs / bucketWidth, bucketCount)]++;
+        historyTotal += frameNs;
+        historyNext = (historyNext + 1) % historySize;
+    }
+
+    double PixieFramePacer::percentileMs(double fraction) const {
+        if (historyCount == 0)
+            return 0.0;
+
+        // upper edge of the bucket holding the rank, so a p99 never reads lower than the frames it covers
+        const auto rank = static_cast<uint32_t>(fraction * (historyCount - 1));
+        uint32_t seen = 0;
+        for (uint32_t i = 0; i < bucketCount; ++i) {
+            seen += buckets[i];
+            if (seen > rank)
+                return double((i + 1) * bucketWidth) * 1e-6;
+        }
+        return double(maxFrameNs()) * 1e-6;
+    }
+
+    uint64_t PixieFramePacer::maxFrameNs() const {
+        uint64_t maxNs = 0;
+        for (uint32_t i = 0; i < historyCount; ++i)
+            maxNs = std::max(maxNs, history[i]);
+        return maxNs;
+    }
+
+    PixieFrameTimeStats PixieFramePacer::stats() const {
+        PixieFrameTimeStats result = {};
+        result.frames = frames;
+        result.hitches = hitches;
+        result.droppedSteps = droppedSteps;
+        if (historyCount == 0)
+            return result;
+
+        result.averageMs = double(historyTotal) * 1e-6 / historyCount;
+        result.maxMs = double(maxFrameNs()) * 1e-6;
+        // a bucket edge can overshoot the slowest frame, the max is exact
+        result.p50Ms = std::min(percentileMs(0.5), result.maxMs);
+        result.p99Ms = std::min(percentileMs(0.99), result.maxMs);
+        return result;
+    }
+} // namespace pxe
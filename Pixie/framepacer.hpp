@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace pxe {
+    // where the pacer gets its time from, swap in PixieManualClock to drive it frame by frame
+    class PixieClock {
+    public:
+        virtual ~PixieClock() = default;
+
+        // monotonic nanoseconds
+        virtual uint64_t now() = 0;
+        // may wake late, never early
+        virtual void sleepFor(uint64_t nanoseconds) = 0;
+        // one iteration of a busy wait
+        virtual void relax() = 0;
+    };
+
+    // steady_clock, with a high resolution waitable timer for sleeps on windows
+    class PixieSystemClock final : public PixieClock {
+    public:
+        PixieSystemClock();
+        ~PixieSystemClock();
+
+        PixieSystemClock(const PixieSystemClock &) = delete;
+        PixieSystemClock &operator=(const PixieSystemClock &) = delete;
+
+        uint64_t now() override;
+        void sleepFor(uint64_t nanoseconds) override;
+        void relax() override;
+
+    private:
+#ifdef _WIN32
+        void *timer = nullptr;
+#endif
+    };
+
+    // time only moves when something sleeps, spins or calls advance, so every run of the pacer is reproducible
+    class PixieManualClock final : public PixieClock {
+    public:
+        explicit PixieManualClock(uint64_t oversleep = 0, uint64_t spinCost = 1000)
+            : time(0)
+            , oversleep(oversleep)
+            , spinCost(spinCost) {
+        }
+
+        uint64_t now() override { return time; }
+        void sleepFor(uint64_t nanoseconds) override { time += nanoseconds + oversleep; }
+        void relax() override { time += spinCost; }
+
+        // the game doing work between frames
+        void advance(uint64_t nanoseconds) { time += nanoseconds; }
+
+    private:
+        uint64_t time;
+        uint64_t oversleep; // added to every sleep, like a coarse os timer
+        uint64_t spinCost;
+    };
+
+    struct PixieFrameTimeStats {
+        uint64_t frames;
+        uint64_t hitches; // frames that took over hitchFactor times the expected frame time
+        uint64_t droppedSteps; // simulation time thrown away once a frame hit maxStepsPerFrame
+        // over the last historySize frames
+        double averageMs;
+        double p50Ms;
+        double p99Ms;
+        double maxMs;
+    };
+
+    // runs the simulation at a fixed rate whatever the frame rate does, the renderer blends the last two states with alpha().
+    // a target rate sleeps most of the way to each deadline and spins the rest, 0 leaves the loop uncapped so vsync or nothing paces it
+    class PixieFramePacer {
+    public:
+        static const uint32_t historySize = 1024;
+        static const uint32_t bucketCount = 1000; // 0.1 ms each, so percentiles are exact to 0.1 ms up to 100 ms
+        static const uint64_t bucketWidth = 100000;
+        static constexpr double hitchFactor = 2.0;
+
+        PixieFramePacer(PixieClock &clock, double updateRate, double targetRate = 0.0);
+
+        // waits for the next deadline when capped, measures the frame and returns how many fixed steps to run
+        uint32_t beginFrame();
+
+        // 0 uncaps the loop
+        void setTargetRate(double framesPerSecond);
+        // stop a slow frame from asking for more steps than a frame can run, the rest is dropped
+        void setMaxStepsPerFrame(uint32_t steps) { maxSteps = steps; }
+        // how close to a deadline sleeping stops and spinning starts, should cover the os timer's worst oversleep
+        void setSpinThreshold(uint64_t nanoseconds) { spinThreshold = nanoseconds; }
+
+        double stepSeconds() const { return double(stepNs) * 1e-9; }
+        // how far the simulation is between the last step and the next one, [0, 1)
+        double alpha() const { return double(accumulator) / double(stepNs); }
+        // last frame, start to start
+        double frameMs() const { return double(lastFrameNs) * 1e-6; }
+        bool capped() const { return periodNs != 0; }
+
+        PixieFrameTimeStats stats() const;
+
+    private:
+        void waitForDeadline();
+        void record(uint64_t frameNs);
+        double percentileMs(double fraction) const;
+        uint64_t maxFrameNs() const;
+
+        PixieClock &clock;
+        uint64_t stepNs;
+        uint64_t periodNs;
+        uint64_t spinThreshold;
+        uint32_t maxSteps;
+
+        uint64_t frameStart;
+        uint64_t deadline;
+        uint64_t accumulator;
+        uint64_t lastFrameNs;
+        bool started;
+
+        // ring of the last frames, and the same frames bucketed so percentiles don't need a sort
+        std::vector<uint64_t> history;
+        std::vector<uint32_t> buckets;
+        uint32_t historyCount;
+        uint32_t historyNext;
+        uint64_t historyTotal;
+
+        uint64_t frames;
+        uint64_t hitches;
+        uint64_t droppedSteps;
+    };
+} // namespace pxe
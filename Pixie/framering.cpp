@@ -0,0 +1,58 @@
+#include "framering.hpp"
+#include <stdexcept>
+
+namespace pxe {
+    PixieFrameRing::PixieFrameRing(PixieFenceQueue &queue, uint32_t framesInFlight)
+        : queue(queue)
+        , slotCount(framesInFlight)
+        , currentSlot(0)
+        , fenceValues {}
+        , lastSignaled(0)
+        , recording(false)
+        , frameStats {} {
+
+        if (framesInFlight < 1 || framesInFlight > maxFramesInFlight)
+            throw std::invalid_argument("PixieFrameRing: frames in flight out of range");
+    }
+
+    uint32_t PixieFrameRing::beginFrame() {
+        if (recording)
+            throw std::logic_error("PixieFrameRing: beginFrame called twice");
+
+        // the slot was last used slotCount frames ago, only wait if the gpu is still on it
+        const uint64_t guard = fenceValues[currentSlot];
+        if (guard != 0 && queue.completedValue() < guard) {
+            frameStats.waits++;
+            queue.waitFor(guard);
+        }
+
+        const uint64_t completed = queue.completedValue();
+        frameStats.framesAhead = 0;
+        for (uint32_t i = 0; i < slotCount; ++i) {
+            if (fenceValues[i] > completed)
+                frameStats.framesAhead++;
+        }
+
+        recording = true;
+        return currentSlot;
+    }
+
+    uint64_t PixieFrameRing::endFrame() {
+        if (!recording)
+            throw std::logic_error("PixieFrameRing: endFrame without beginFrame");
+
+        lastSignaled = queue.signal();
+        fenceValues[currentSlot] = lastSignaled;
+
+        currentSlot = (currentSlot + 1) % slotCount;
+        frameStats.frames++;
+        recording = false;
+
+        return lastSignaled;
+    }
+
+    void PixieFrameRing::flush() {
+        if (lastSignaled != 0 && queue.completedValue() < lastSignaled)
+            queue.waitFor(lastSignaled);
+    }
+} // namespace pxe
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+
+namespace pxe {
+    // the part of a command queue the frame ring needs, PixieRenderer implements it over an ID3D12Fence
+    class PixieFenceQueue {
+    public:
+        virtual ~PixieFenceQueue() = default;
+
+        // signal after everything submitted so far, returns the value the fence will reach
+        virtual uint64_t signal() = 0;
+        virtual uint64_t completedValue() = 0;
+        // block the calling thread until the fence reaches value
+        virtual void waitFor(uint64_t value) = 0;
+    };
+
+    struct PixieFrameStats {
+        uint64_t frames;
+        uint64_t waits; // beginFrame had to block on the gpu
+        uint32_t framesAhead; // submitted frames the gpu hasn't finished yet
+    };
+
+    // tracks which of N frame slots the gpu is still using, the cpu only waits when it's N frames ahead
+    class PixieFrameRing {
+    public:
+        static const uint32_t maxFramesInFlight = 3;
+
+        PixieFrameRing(PixieFenceQueue &queue, uint32_t framesInFlight);
+
+        // returns the slot to record into, per slot resources are free to reuse once this returns
+        uint32_t beginFrame();
+        // signals the queue for the current slot and returns the fence value guarding it
+        uint64_t endFrame();
+        // wait for every submitted frame, needed before resizing or teardown
+        void flush();
+
+        uint32_t slot() const { return currentSlot; }
+        uint32_t framesInFlight() const { return slotCount; }
+        uint64_t slotFence(uint32_t slot) const { return fenceValues[slot]; }
+        const PixieFrameStats &stats() const { return frameStats; }
+
+    private:
+        PixieFenceQueue &queue;
+        uint32_t slotCount;
+        uint32_t currentSlot;
+        uint64_t fenceValues[maxFramesInFlight];
+        uint64_t lastSignaled;
+        bool recording;
+        PixieFrameStats frameStats;
+    };
+
+    // stands in for a gpu queue, signals complete once `latency` newer ones exist or when something waits on them
+    class PixieMockQueue final : public PixieFenceQueue {
+    public:
+        explicit PixieMockQueue(uint32_t latency = 0)
+            : latency(latency)
+            , lastSignaled(0)
+            , completed(0)
+            , stalls(0) {
+        }
+
+        uint64_t signal() override {
+            lastSignaled++;
+            if (lastSignaled > latency)
+                advance(lastSignaled - latency);
+            return lastSignaled;
+        }
+
+        uint64_t completedValue() override { return completed; }
+
+        void waitFor(uint64_t value) override {
+            if (value > completed) {
+                stalls++;
+                advance(value);
+            }
+        }
+
+        // the fake gpu finishes work up to value
+        void advance(uint64_t value) {
+            if (value > lastSignaled)
+                value = lastSignaled;
+            if (value > completed)
+                completed = value;
+        }
+
+        uint64_t signaled() const { return lastSignaled; }
+        uint64_t stallCount() const { return stalls; }
+
+    private:
+        uint32_t latency;
+        uint64_t lastSignaled;
+        uint64_t completed;
+        uint64_t stalls;
+    };
+} // namespace pxe
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace pxe {
+    // 64 bit FNV-1a, chain calls by passing the previous result as seed
+    inline uint64_t hashBytes(const void *data, size_t size, uint64_t seed = 14695981039346656037ull) {
+        const auto *bytes = static_cast<const uint8_t *>(data);
+        uint64_t hash = seed;
+        for (size_t i = 0; i < size; ++i) {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    inline uint64_t hashString(std::string_view text, uint64_t seed = 14695981039346656037ull) {
+        return hashBytes(text.data(), text.size(), seed);
+    }
+} // namespace pxe
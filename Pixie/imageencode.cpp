@@ -0,0 +1,419 @@
+#include "imageencode.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace pxe {
+    namespace {
+        const uint32_t hashBits = 15;
+        const uint32_t windowSize = 32768;
+        const uint32_t minMatch = 3;
+        const uint32_t maxMatch = 258;
+        const uint32_t maxChain = 8; // candidates tried per position, enough for flat and repeated runs
+
+        const uint16_t lengthBase[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+        const uint8_t lengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+        const uint16_t distanceBase[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+        const uint8_t distanceExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+        uint32_t reverseBits(uint32_t code, uint32_t length) {
+            uint32_t result = 0;
+            for (uint32_t i = 0; i < length; ++i)
+                result |= ((code >> i) & 1) << (length - 1 - i);
+            return result;
+        }
+
+        // the fixed literal/length code from rfc 1951 3.2.6, reversed since huffman codes go out msb first
+        // into an lsb first stream. length symbols are looked up by match length
+        struct FixedCodes {
+            uint16_t literalCode[288];
+            uint8_t literalLength[288];
+            uint16_t lengthSymbol[maxMatch + 1];
+
+            FixedCodes() {
+                for (uint32_t symbol = 0; symbol < 288; ++symbol) {
+                    uint32_t code;
+                    uint32_t length;
+                    if (symbol < 144) {
+                        code = 0x30 + symbol;
+                        length = 8;
+                    } else if (symbol < 256) {
+                        code = 0x190 + symbol - 144;
+                        length = 9;
+                    } else if (symbol < 280) {
+                        code = symbol - 256;
+                        length = 7;
+                    } else {
+                        code = 0xc0 + symbol - 280;
+                        length = 8;
+                    }
+                    literalCode[symbol] = static_cast<uint16_t>(reverseBits(code, length));
+                    literalLength[symbol] = static_cast<uint8_t>(length);
+                }
+
+                uint32_t index = 0;
+                for (uint32_t length = minMatch; length <= maxMatch; ++length) {
+                    while (index + 1 < 29 && lengthBase[index + 1] <= length)
+                        index++;
+                    lengthSymbol[length] = static_cast<uint16_t>(index);
+                }
+            }
+        };
+
+        const FixedCodes &fixedCodes() {
+            static const FixedCodes codes;
+            return codes;
+        }
+
+        struct CrcTable {
+            uint32_t entries[256];
+
+            CrcTable() {
+                for (uint32_t i = 0; i < 256; ++i) {
+                    uint32_t c = i;
+                    for (int k = 0; k < 8; ++k)
+                        c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+                    entries[i] = c;
+                }
+            }
+        };
+
+        uint32_t crc32(uint32_t crc, const uint8_t *data, size_t size) {
+            static const CrcTable table;
+            crc = ~crc;
+            for (size_t i = 0; i < size; ++i)
+                crc = table.entries[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+            return ~crc;
+        }
+
+        uint32_t adler32(const uint8_t *data, size_t size) {
+            uint32_t a = 1;
+            uint32_t b = 0;
+            while (size > 0) {
+                // the largest run that can't overflow b before the modulo
+                const size_t run = size < 5552 ? size : 5552;
+                for (size_t i = 0; i < run; ++i) {
+                    a += data[i];
+                    b += a;
+                }
+                a %= 65521;
+                b %= 65521;
+                data += run;
+                size -= run;
+            }
+            return (b << 16) | a;
+        }
+
+        void putBigEndian(std::vector<uint8_t> &out, uint32_t value) {
+            out.push_back(static_cast<uint8_t>(value >> 24));
+            out.push_back(static_cast<uint8_t>(value >> 16));
+            out.push_back(static_cast<uint8_t>(value >> 8));
+            out.push_back(static_cast<uint8_t>(value));
+        }
+
+        // lsb first, the way deflate packs everything but the huffman codes themselves
+        class BitWriter {
+        public:
+            explicit BitWriter(std::vector<uint8_t> &out) : out(out), bits(0), count(0) {}
+
+            void put(uint32_t value, uint32_t length) {
+                bits |= uint64_t(value) << count;
+                count += length;
+                while (count >= 8) {
+                    out.push_back(static_cast<uint8_t>(bits));
+                    bits >>= 8;
+                    count -= 8;
+                }
+            }
+
+            void flush() {
+                if (count > 0)
+                    out.push_back(static_cast<uint8_t>(bits));
+                bits = 0;
+                count = 0;
+            }
+
+        private:
+            std::vector<uint8_t> &out;
+            uint64_t bits;
+            uint32_t count;
+        };
+
+        uint32_t hash3(const uint8_t *data) {
+            const uint32_t value = data[0] | (uint32_t(data[1]) << 8) | (uint32_t(data[2]) << 16);
+            return (value * 2654435761u) >> (32 - hashBits);
+        }
+
+        uint8_t paeth(uint8_t a, uint8_t b, uint8_t c) {
+            const int p = int(a) + int(b) - int(c);
+            const int pa = p > a ? p - a : a - p;
+            const int pb = p > b ? p - b : b - p;
+            const int pc = p > c ? p - c : c - p;
+            if (pa <= pb && pa <= pc)
+                return a;
+            return pb <= pc ? b : c;
+        }
+    } // namespace
+
+    const char *imageFormatExtension(PixieImageFormat format) {
+        return format == PixieImageFormat::PNG ? "png" : "qoi";
+    }
+
+    PixieImageEncoder::PixieImageEncoder()
+        : head(size_t(1) << hashBits)
+        , chain(windowSize) {
+    }
+
+    const std::vector<uint8_t> &PixieImageEncoder::encode(PixieImageFormat format, const uint32_t *pixels, uint32_t width, uint32_t height, uint32_t pitch, bool opaque) {
+        if (width == 0 || height == 0 || pitch < width)
+            throw std::invalid_argument("PixieImageEncoder: bad image size");
+
+        output.clear();
+        if (format == PixieImageFormat::PNG)
+            encodePNG(pixels, width, height, pitch, opaque);
+        else
+            encodeQOI(pixels, width, height, pitch, opaque);
+        return output;
+    }
+
+    void PixieImageEncoder::encodeQOI(const uint32_t *pixels, uint32_t width, uint32_t height, uint32_t pitch, bool opaque) {
+        // worst case every pixel is a five byte rgba op
+        output.reserve(14 + size_t(width) * height * 5 + 8);
+        output.insert(output.end(), {'q', 'o', 'i', 'f'});
+        putBigEndian(output, width);
+        putBigEndian(output, height);
+        output.push_back(opaque ? 3 : 4);
+        output.push_back(0); // srgb with linear alpha
+
+        const uint32_t alphaMask = opaque ? 0xff000000u : 0;
+        uint32_t index[64] = {};
+        uint32_t previous = 0xff000000u;
+        uint32_t run = 0;
+
+        for (uint32_t y = 0; y < height; ++y) {
+            const uint32_t *row = pixels + size_t(y) * pitch;
+            for (uint32_t x = 0; x < width; ++x) {
+                const uint32_t pixel = row[x] | alphaMask;
+                if (pixel == previous) {
+                    if (++run == 62) {
+                        output.push_back(static_cast<uint8_t>(0xc0 | (run - 1)));
+                        run = 0;
+                    }
+                    continue;
+                }
+                if (run > 0) {
+                    output.push_back(static_cast<uint8_t>(0xc0 | (run - 1)));
+                    run = 0;
+                }
+
+                const uint32_t r = pixel & 0xff;
+                const uint32_t g = (pixel >> 8) & 0xff;
+                const uint32_t b = (pixel >> 16) & 0xff;
+                const uint32_t a = pixel >> 24;
+                const uint32_t slot = (r * 3 + g * 5 + b * 7 + a * 11) % 64;
+                if (index[slot] == pixel) {
+                    output.push_back(static_cast<uint8_t>(slot));
+                    previous = pixel;
+                    continue;
+                }
+                index[slot] = pixel;
+
+                if (a == previous >> 24) {
+                    const auto dr = static_cast<int8_t>(r - (previous & 0xff));
+                    const auto dg = static_cast<int8_t>(g - ((previous >> 8) & 0xff));
+                    const auto db = static_cast<int8_t>(b - ((previous >> 16) & 0xff));
+                    const int drg = dr - dg;
+                    const int dbg = db - dg;
+
+                    if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+                        output.push_back(static_cast<uint8_t>(0x40 | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2)));
+                    } else if (dg >= -32 && dg <= 31 && drg >= -8 && drg <= 7 && dbg >= -8 && dbg <= 7) {
+                        output.push_back(static_cast<uint8_t>(0x80 | (dg + 32)));
+                        output.push_back(static_cast<uint8_t>((drg + 8) << 4 | (dbg + 8)));
+                    } else {
+                        output.insert(output.end(), {0xfe, static_cast<uint8_t>(r), static_cast<uint8_t>(g), static_cast<uint8_t>(b)});
+                    }
+                } else {
+                    output.insert(output.end(), {0xff, static_cast<uint8_t>(r), static_cast<uint8_t>(g), static_cast<uint8_t>(b), static_cast<uint8_t>(a)});
+                }
+                previous = pixel;
+            }
+        }
+
+        if (run > 0)
+            output.push_back(static_cast<uint8_t>(0xc0 | (run - 1)));
+        output.insert(output.end(), {0, 0, 0, 0, 0, 0, 0, 1});
+    }
+
+    void PixieImageEncoder::encodePNG(const uint32_t *pixels, uint32_t width, uint32_t height, uint32_t pitch, bool opaque) {
+        const uint32_t channels = opaque ? 3 : 4;
+        filterRows(pixels, width, height, pitch, channels);
+
+        const auto chunk = [this](const char *type, const uint8_t *data, size_t size) {
+            putBigEndian(output, static_cast<uint32_t>(size));
+            const size_t start = output.size();
+            output.insert(output.end(), type, type + 4);
+            output.insert(output.end(), data, data + size);
+            putBigEndian(output, crc32(0, output.data() + start, output.size() - start));
+        };
+
+        static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+        output.insert(output.end(), signature, signature + 8);
+
+        uint8_t header[13];
+        for (int i = 0; i < 4; ++i) {
+            header[i] = static_cast<uint8_t>(width >> (24 - i * 8));
+            header[4 + i] = static_cast<uint8_t>(height >> (24 - i * 8));
+        }
+        header[8] = 8; // bits per channel
+        header[9] = opaque ? 2 : 6; // rgb or rgba
+        header[10] = 0;
+        header[11] = 0;
+        header[12] = 0;
+        chunk("IHDR", header, sizeof(header));
+
+        // the idat is deflated in place after its length and type, then the crc covers what came out
+        const size_t lengthAt = output.size();
+        putBigEndian(output, 0);
+        output.insert(output.end(), {'I', 'D', 'A', 'T'});
+        output.push_back(0x78); // zlib, 32k window, no dictionary
+        output.push_back(0x01);
+        deflate(filtered.data(), filtered.size());
+        putBigEndian(output, adler32(filtered.data(), filtered.size()));
+
+        const auto length = static_cast<uint32_t>(output.size() - lengthAt - 8);
+        for (int i = 0; i < 4; ++i)
+            output[lengthAt + i] = static_cast<uint8_t>(length >> (24 - i * 8));
+        putBigEndian(output, crc32(0, output.data() + lengthAt + 4, output.size() - lengthAt - 4));
+
+        chunk("IEND", nullptr, 0);
+    }
+
+    void PixieImageEncoder::filterRows(const uint32_t *pixels, uint32_t width, uint32_t height, uint32_t pitch, uint32_t channels) {
+        const size_t rowBytes = size_t(width) * channels;
+        filtered.resize((rowBytes + 1) * height);
+        rows[0].assign(rowBytes, 0);
+        rows[1].assign(rowBytes, 0); // the row above the first is all zero
+        candidate.resize(rowBytes * 5);
+
+        for (uint32_t y = 0; y < height; ++y) {
+            uint8_t *current = rows[y & 1].data();
+            const uint8_t *above = rows[(y + 1) & 1].data();
+
+            const uint32_t *source = pixels + size_t(y) * pitch;
+            for (uint32_t x = 0; x < width; ++x)
+                std::memcpy(current + size_t(x) * channels, &source[x], channels);
+
+            // every filter, then the one whose bytes read as signed sum closest to zero, the usual png heuristic
+            uint64_t scores[5] = {};
+            for (size_t i = 0; i < rowBytes; ++i) {
+                const uint8_t value = current[i];
+                const uint8_t left = i >= channels ? current[i - channels] : 0;
+                const uint8_t up = above[i];
+                const uint8_t upLeft = i >= channels ? above[i - channels] : 0;
+
+                const uint8_t bytes[5] = {
+                    value,
+                    static_cast<uint8_t>(value - left),
+                    static_cast<uint8_t>(value - up),
+                    static_cast<uint8_t>(value - ((left + up) >> 1)),
+                    static_cast<uint8_t>(value - paeth(left, up, upLeft)),
+                };
+                for (int f = 0; f < 5; ++f) {
+                    candidate[f * rowBytes + i] = bytes[f];
+                    scores[f] += bytes[f] < 128 ? bytes[f] : 256 - bytes[f];
+                }
+            }
+
+            int best = 0;
+            for (int f = 1; f < 5; ++f) {
+                if (scores[f] < scores[best])
+                    best = f;
+            }
+
+            uint8_t *out = filtered.data() + (rowBytes + 1) * y;
+            out[0] = static_cast<uint8_t>(best);
+            std::memcpy(out + 1, candidate.data() + best * rowBytes, rowBytes);
+        }
+    }
+
+    void PixieImageEncoder::deflate(const uint8_t *data, size_t size) {
+        const FixedCodes &codes = fixedCodes();
+        BitWriter bits(output);
+        bits.put(1, 1); // last block
+        bits.put(1, 2); // fixed huffman
+
+        const auto literal = [&](uint32_t symbol) {
+            bits.put(codes.literalCode[symbol], codes.literalLength[symbol]);
+        };
+
+        std::fill(head.begin(), head.end(), -1);
+        const auto insert = [&](size_t position) {
+            const uint32_t hash = hash3(data + position);
+            chain[position & (windowSize - 1)] = head[hash];
+            head[hash] = static_cast<int32_t>(position);
+        };
+
+        size_t position = 0;
+        while (position < size) {
+            uint32_t bestLength = 0;
+            size_t bestDistance = 0;
+
+            if (size - position >= minMatch) {
+                const size_t limit = size - position < maxMatch ? size - position : maxMatch;
+                int32_t candidate = head[hash3(data + position)];
+                for (uint32_t tries = 0; candidate >= 0 && tries < maxChain; ++tries) {
+                    const size_t distance = position - size_t(candidate);
+                    if (distance > windowSize)
+                        break;
+
+                    // a match only beats the best so far if it reaches one byte further
+                    const uint8_t *a = data + candidate;
+                    const uint8_t *b = data + position;
+                    if (a[bestLength] == b[bestLength] || bestLength == 0) {
+                        uint32_t length = 0;
+                        while (length < limit && a[length] == b[length])
+                            length++;
+                        if (length > bestLength) {
+                            bestLength = length;
+                            bestDistance = distance;
+                            if (length == limit)
+                                break;
+                        }
+                    }
+
+                    const int32_t next = chain[size_t(candidate) & (windowSize - 1)];
+                    if (next >= candidate)
+                        break; // overwritten by a newer position, the rest of the chain is gone
+                    candidate = next;
+                }
+            }
+
+            if (bestLength >= minMatch) {
+                const uint32_t lengthIndex = codes.lengthSymbol[bestLength];
+                literal(257 + lengthIndex);
+                bits.put(bestLength - lengthBase[lengthIndex], lengthExtra[lengthIndex]);
+
+                uint32_t distanceIndex = 29;
+                while (distanceBase[distanceIndex] > bestDistance)
+                    distanceIndex--;
+                bits.put(reverseBits(distanceIndex, 5), 5);
+                bits.put(static_cast<uint32_t>(bestDistance - distanceBase[distanceIndex]), distanceExtra[distanceIndex]);
+
+                const size_t end = position + bestLength;
+                for (; position < end; ++position) {
+                    if (size - position >= minMatch)
+                        insert(position);
+                }
+            } else {
+                literal(data[position]);
+                if (size - position >= minMatch)
+                    insert(position);
+                position++;
+            }
+        }
+
+        literal(256);
+        bits.flush();
+    }
+} // namespace pxe
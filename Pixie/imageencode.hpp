@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace pxe {
+    enum class PixieImageFormat : uint8_t {
+        QOI, // fast, about as small as a quick png on rendered frames
+        PNG,
+    };
+
+    const char *imageFormatExtension(PixieImageFormat format);
+
+    // writes R8G8B8A8 frames out as qoi or png files in memory. keeps its buffers between calls so encoding the same
+    // size again doesn't allocate, one encoder per thread.
+    // png is a single fixed huffman deflate block over per row filtered data, the compressor matches through short
+    // hash chains. it trades some size against a full zlib for not needing one
+    class PixieImageEncoder {
+    public:
+        PixieImageEncoder();
+
+        // rows are pitch pixels apart. opaque writes every alpha as 255, png drops the channel entirely.
+        // the result stays valid until the next encode
+        const std::vector<uint8_t> &encode(PixieImageFormat format, const uint32_t *pixels, uint32_t width, uint32_t height, uint32_t pitch, bool opaque = true);
+
+    private:
+        void encodeQOI(const uint32_t *pixels, uint32_t width, uint32_t height, uint32_t pitch, bool opaque);
+        void encodePNG(const uint32_t *pixels, uint32_t width, uint32_t height, uint32_t pitch, bool opaque);
+        void filterRows(const uint32_t *pixels, uint32_t width, uint32_t height, uint32_t pitch, uint32_t channels);
+        void deflate(const uint8_t *data, size_t size);
+
+        std::vector<uint8_t> output;
+        std::vector<uint8_t> filtered; // filter byte then the filtered row, for every row
+        std::vector<uint8_t> rows[2]; // unfiltered current and previous row, packed to the png's channels
+        std::vector<uint8_t> candidate;
+        std::vector<int32_t> head; // newest position for each hash of three bytes
+        std::vector<int32_t> chain; // position before that with the same hash, over the window
+    };
+} // namespace pxe
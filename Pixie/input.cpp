@@ -0,0 +1,234 @@
+#include "input.hpp"
+#include <chrono>
+#include <stdexcept>
+
+namespace pxe {
+    namespace {
+        uint64_t roundUp(uint64_t value) {
+            uint64_t result = 1;
+            while (result < value)
+                result <<= 1;
+            return result;
+        }
+    } // namespace
+
+    PixieInput::PixieInput(PixieClock &clock, uint32_t ringCapacity)
+        : clock(clock)
+        , ring(roundUp(ringCapacity))
+        , mask(ring.size() - 1)
+        , written(0)
+        , frameFirst(0)
+        , frameEnd(0)
+        , current {}
+        , inputStats {}
+        , samplerQueue(ringCapacity)
+        , samplerDropped(0)
+        , samplerStopping(false)
+        , trackLatency(false)
+        , latencyPending(false)
+        , latencyBuckets(bucketCount + 1)
+        , latencySamples(0)
+        , latencyTotal(0)
+        , latencyMax(0) {
+    }
+
+    PixieInput::~PixieInput() {
+        stopSampler();
+    }
+
+    bool PixieInput::push(const PixieInputEvent &event) {
+        // what this frame's events and the ones still waiting for the next frame take up
+        if (written - frameFirst > mask) {
+            inputStats.dropped++;
+            return false;
+        }
+
+        PixieInputEvent &slot = ring[written & mask];
+        slot = event;
+        if (slot.timestamp == 0)
+            slot.timestamp = clock.now();
+        written++;
+        return true;
+    }
+
+    void PixieInput::beginFrame() {
+        PixieInputEvent event;
+        while (samplerQueue.pop(event))
+            push(event);
+
+        current.keysPressed.reset();
+        current.keysReleased.reset();
+        current.buttonsPressed = 0;
+        current.buttonsReleased = 0;
+        current.wheelX = 0.0f;
+        current.wheelY = 0.0f;
+
+        frameFirst = frameEnd;
+        frameEnd = written;
+        for (uint64_t i = frameFirst; i < frameEnd; ++i)
+            apply(ring[i & mask]);
+
+        const auto count = static_cast<uint32_t>(frameEnd - frameFirst);
+        inputStats.frames++;
+        inputStats.events += count;
+        inputStats.lastFrameEvents = count;
+        if (count > inputStats.maxFrameEvents)
+            inputStats.maxFrameEvents = count;
+        latencyPending = trackLatency;
+    }
+
+    void PixieInput::apply(const PixieInputEvent &event) {
+        const uint32_t bit = event.code - 1u < 32u ? 1u << (event.code - 1) : 0u;
+
+        switch (event.type) {
+            case PixieInputType::Quit:
+                current.quit = true;
+                break;
+            case PixieInputType::KeyDown:
+                if (event.code >= PixieInputState::keyCount)
+                    break;
+                if (!event.repeat && !current.keys[event.code])
+                    current.keysPressed.set(event.code);
+                current.keys.set(event.code);
+                break;
+            case PixieInputType::KeyUp:
+                if (event.code >= PixieInputState::keyCount)
+                    break;
+                if (current.keys[event.code])
+                    current.keysReleased.set(event.code);
+                current.keys.reset(event.code);
+                break;
+            case PixieInputType::MouseMove:
+                current.mouseX = event.x;
+                current.mouseY = event.y;
+                break;
+            case PixieInputType::MouseDown:
+                current.buttonsPressed |= bit & ~current.buttons;
+                current.buttons |= bit;
+                current.mouseX = event.x;
+                current.mouseY = event.y;
+                break;
+            case PixieInputType::MouseUp:
+                current.buttonsReleased |= bit & current.buttons;
+                current.buttons &= ~bit;
+                current.mouseX = event.x;
+                current.mouseY = event.y;
+                break;
+            case PixieInputType::MouseWheel:
+                current.wheelX += event.x;
+                current.wheelY += event.y;
+                break;
+            case PixieInputType::FocusLost:
+                current.keysReleased |= current.keys;
+                current.keys.reset();
+                current.buttonsReleased |= current.buttons;
+                current.buttons = 0;
+                break;
+            default:
+                break;
+        }
+    }
+
+    void PixieInput::startSampler(std::function<void(PixieInput &)> sample, uint64_t periodNs) {
+        if (sampler.joinable())
+            throw std::logic_error("PixieInput: sampler already running");
+
+        samplerStopping = false;
+        sampler = std::thread([this, sample = std::move(sample), periodNs] {
+            std::unique_lock<std::mutex> lock(samplerMutex);
+            auto next = std::chrono::steady_clock::now();
+            while (!samplerStopping) {
+                lock.unlock();
+                sample(*this);
+                lock.lock();
+
+                // on a schedule, so a slow sample doesn't push every later one back
+                next += std::chrono::nanoseconds(periodNs);
+                const auto now = std::chrono::steady_clock::now();
+                if (next < now)
+                    next = now;
+                samplerWake.wait_until(lock, next, [this] { return samplerStopping; });
+            }
+        });
+    }
+
+    void PixieInput::stopSampler() {
+        if (!sampler.joinable())
+            return;
+
+        {
+            std::lock_guard<std::mutex> lock(samplerMutex);
+            samplerStopping = true;
+        }
+        samplerWake.notify_one();
+        sampler.join();
+    }
+
+    bool PixieInput::pushFromSampler(const PixieInputEvent &event) {
+        PixieInputEvent stamped = event;
+        if (stamped.timestamp == 0)
+            stamped.timestamp = clock.now();
+        if (!samplerQueue.push(stamped)) {
+            samplerDropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+
+    void PixieInput::setLatencyTracking(bool enabled) {
+        trackLatency = enabled;
+        latencyPending = false;
+    }
+
+    void PixieInput::frameSubmitted() {
+        if (!latencyPending)
+            return;
+        latencyPending = false;
+
+        const uint64_t now = clock.now();
+        for (uint64_t i = frameFirst; i < frameEnd; ++i) {
+            const uint64_t timestamp = ring[i & mask].timestamp;
+            const uint64_t latency = now > timestamp ? now - timestamp : 0;
+            const uint64_t bucket = latency / bucketWidth;
+            latencyBuckets[bucket < bucketCount ? bucket : bucketCount]++;
+            latencySamples++;
+            latencyTotal += latency;
+            if (latency > latencyMax)
+                latencyMax = latency;
+        }
+    }
+
+    double PixieInput::percentileMs(double fraction) const {
+        // upper edge of the bucket holding the rank, like PixieFramePacer
+        const auto rank = static_cast<uint64_t>(fraction * double(latencySamples - 1));
+        uint64_t seen = 0;
+        for (uint32_t i = 0; i < bucketCount; ++i) {
+            seen += latencyBuckets[i];
+            if (seen > rank)
+                return double((i + 1) * bucketWidth) * 1e-6;
+        }
+        return double(latencyMax) * 1e-6;
+    }
+
+    PixieInputLatencyStats PixieInput::latencyStats() const {
+        PixieInputLatencyStats result = {};
+        result.samples = latencySamples;
+        if (latencySamples == 0)
+            return result;
+
+        result.averageMs = double(latencyTotal) * 1e-6 / double(latencySamples);
+        result.maxMs = double(latencyMax) * 1e-6;
+        // a bucket edge can overshoot the slowest event, the max is exact
+        const double p50 = percentileMs(0.5);
+        const double p99 = percentileMs(0.99);
+        result.p50Ms = p50 < result.maxMs ? p50 : result.maxMs;
+        result.p99Ms = p99 < result.maxMs ? p99 : result.maxMs;
+        return result;
+    }
+
+    PixieInputStats PixieInput::stats() const {
+        PixieInputStats result = inputStats;
+        result.dropped += samplerDropped.load(std::memory_order_relaxed);
+        return result;
+    }
+} // namespace pxe
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <atomic>
+#include <bitset>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "framepacer.hpp"
+#include "spscqueue.hpp"
+
+namespace pxe {
+    enum class PixieInputType : uint8_t {
+        None,
+        Quit,
+        KeyDown,
+        KeyUp,
+        MouseMove,
+        MouseDown,
+        MouseUp,
+        MouseWheel,
+        FocusLost, // everything held is let go, the ups will go to another window
+    };
+
+    struct PixieInputEvent {
+        uint64_t timestamp; // PixieClock nanoseconds, when it happened as near as the source can tell. 0 stamps it on push
+        PixieInputType type;
+        bool repeat; // key auto repeat, never a press edge
+        uint16_t code; // scancode for keys, 1 based button for the mouse
+        float x; // mouse position, or the wheel's movement
+        float y;
+    };
+
+    // what game code reads each frame: held keys and buttons, and every press and release since the last frame
+    // even when both came inside it
+    struct PixieInputState {
+        static const uint32_t keyCount = 512; // scancodes, SDL_NUM_SCANCODES
+
+        std::bitset<keyCount> keys;
+        std::bitset<keyCount> keysPressed;
+        std::bitset<keyCount> keysReleased;
+        uint32_t buttons; // bit n - 1 for button n
+        uint32_t buttonsPressed;
+        uint32_t buttonsReleased;
+        float mouseX;
+        float mouseY;
+        float wheelX; // this frame's movement
+        float wheelY;
+        bool quit;
+
+        bool down(uint16_t key) const { return key < keyCount && keys[key]; }
+        bool pressed(uint16_t key) const { return key < keyCount && keysPressed[key]; }
+        bool released(uint16_t key) const { return key < keyCount && keysReleased[key]; }
+        bool buttonDown(uint16_t button) const { return button - 1u < 32u && (buttons >> (button - 1) & 1); }
+        bool buttonPressed(uint16_t button) const { return button - 1u < 32u && (buttonsPressed >> (button - 1) & 1); }
+        bool buttonReleased(uint16_t button) const { return button - 1u < 32u && (buttonsReleased >> (button - 1) & 1); }
+    };
+
+    struct PixieInputStats {
+        uint64_t frames;
+        uint64_t events;
+        uint64_t dropped; // the ring or the sampler queue was full
+        uint32_t lastFrameEvents;
+        uint32_t maxFrameEvents;
+    };
+
+    // event to frame submit, over every event since tracking was turned on
+    struct PixieInputLatencyStats {
+        uint64_t samples;
+        double averageMs;
+        double p50Ms;
+        double p99Ms;
+        double maxMs;
+    };
+
+    // input for one game thread. sources push events as they drain them, beginFrame turns everything pushed since
+    // the last frame into the state snapshot and edges. events stay in a fixed ring in arrival order, so nothing is
+    // allocated per frame and a frame can still see its events in order with their timestamps.
+    // events can also come from a sampler thread through a lock free queue, for sources that don't have to be
+    // pumped on the window's thread
+    class PixieInput {
+    public:
+        static const uint32_t bucketCount = 1000; // 0.1 ms each, latency percentiles are exact to 0.1 ms up to 100 ms
+        static const uint64_t bucketWidth = 100000;
+
+        // rounded up to a power of two, has to hold a frame's events plus however many arrive before beginFrame
+        explicit PixieInput(PixieClock &clock, uint32_t ringCapacity = 4096);
+        ~PixieInput();
+
+        PixieInput(const PixieInput &) = delete;
+        PixieInput &operator=(const PixieInput &) = delete;
+
+        // game thread, false when the ring is full and the event was dropped
+        bool push(const PixieInputEvent &event);
+
+        // once per frame after draining every source
+        void beginFrame();
+        const PixieInputState &state() const { return current; }
+        // this frame's events, oldest first
+        uint32_t eventCount() const { return static_cast<uint32_t>(frameEnd - frameFirst); }
+        const PixieInputEvent &event(uint32_t index) const { return ring[(frameFirst + index) & mask]; }
+
+        // sample runs every period on its own thread and hands events over with pushFromSampler, beginFrame
+        // collects them. only one sampler at a time
+        void startSampler(std::function<void(PixieInput &)> sample, uint64_t periodNs);
+        void stopSampler();
+        // sampler thread only
+        bool pushFromSampler(const PixieInputEvent &event);
+
+        // call right after the frame that read this input was submitted, each of its events then counts
+        // from its timestamp to now
+        void setLatencyTracking(bool enabled);
+        void frameSubmitted();
+        PixieInputLatencyStats latencyStats() const;
+
+        PixieInputStats stats() const;
+
+    private:
+        void apply(const PixieInputEvent &event);
+        double percentileMs(double fraction) const;
+
+        PixieClock &clock;
+        std::vector<PixieInputEvent> ring;
+        uint64_t mask;
+        uint64_t written; // events ever pushed
+        uint64_t frameFirst; // this frame's window in the ring
+        uint64_t frameEnd;
+        PixieInputState current;
+        PixieInputStats inputStats;
+
+        PixieSPSCQueue<PixieInputEvent> samplerQueue;
+        std::atomic<uint64_t> samplerDropped;
+        std::thread sampler;
+        std::mutex samplerMutex;
+        std::condition_variable samplerWake;
+        bool samplerStopping;
+
+        bool trackLatency;
+        bool latencyPending; // beginFrame ran since the last frameSubmitted
+        std::vector<uint32_t> latencyBuckets;
+        uint64_t latencySamples;
+        uint64_t latencyTotal;
+        uint64_t latencyMax;
+    };
+} // namespace pxe
@@ -0,0 +1,144 @@
+#include "jobs.hpp"
+#include "profiler.hpp"
+#include <algorithm>
+#include <exception>
+#include <memory>
+
+namespace pxe {
+    PixieJobPool::PixieJobPool(size_t threadCount)
+        : pendingJobs(0)
+        , stopping(false) {
+
+        if (threadCount == 0)
+            threadCount = std::max<size_t>(1, std::thread::hardware_concurrency());
+
+        workers.reserve(threadCount);
+        for (size_t i = 0; i < threadCount; ++i)
+            workers.emplace_back([this] { workerLoop(); });
+    }
+
+    PixieJobPool::~PixieJobPool() {
+        {
+            std::lock_guard<std::mutex> lock(jobMutex);
+            stopping = true;
+        }
+        jobReady.notify_all();
+
+        for (auto &worker : workers)
+            worker.join();
+    }
+
+    void PixieJobPool::submit(std::function<void()> job) {
+        {
+            std::lock_guard<std::mutex> lock(jobMutex);
+            jobs.push_back(std::move(job));
+            pendingJobs++;
+        }
+        jobReady.notify_one();
+    }
+
+    void PixieJobPool::wait() {
+        std::unique_lock<std::mutex> lock(jobMutex);
+        jobsDone.wait(lock, [this] { return pendingJobs == 0; });
+
+        if (jobError) {
+            std::exception_ptr error = jobError;
+            jobError = nullptr;
+            std::rethrow_exception(error);
+        }
+    }
+
+    void PixieJobPool::parallelFor(size_t count, const std::function<void(size_t)> &fn) {
+        if (count == 0)
+            return;
+
+        if (count == 1 || workers.empty()) {
+            for (size_t i = 0; i < count; ++i)
+                fn(i);
+            return;
+        }
+
+        // helpers may only get scheduled after the loop is over, so the state has to outlive this call
+        struct ForState {
+            std::atomic<size_t> next {0};
+            std::atomic<size_t> finished {0};
+            std::mutex mutex;
+            std::condition_variable done;
+            const std::function<void(size_t)> *fn = nullptr;
+            size_t count = 0;
+            std::exception_ptr error; // the first fn that threw, under mutex
+        };
+
+        auto state = std::make_shared<ForState>();
+        state->fn = &fn;
+        state->count = count;
+
+        // a throw stops the loop handing out indices, the ones never handed out count as finished so the caller
+        // still waits for every fn already running before it rethrows
+        auto drain = [](ForState &s) {
+            size_t ran = 0;
+            for (size_t i = s.next.fetch_add(1); i < s.count; i = s.next.fetch_add(1)) {
+                try {
+                    (*s.fn)(i);
+                } catch (...) {
+                    {
+                        std::lock_guard<std::mutex> lock(s.mutex);
+                        if (!s.error)
+                            s.error = std::current_exception();
+                    }
+                    const size_t unclaimed = s.next.exchange(s.count);
+                    if (unclaimed < s.count)
+                        ran += s.count - unclaimed;
+                }
+                ran++;
+            }
+
+            if (ran != 0 && s.finished.fetch_add(ran) + ran == s.count) {
+                std::lock_guard<std::mutex> lock(s.mutex);
+                s.done.notify_all();
+            }
+        };
+
+        const size_t helpers = std::min(workers.size(), count - 1);
+        for (size_t i = 0; i < helpers; ++i)
+            submit([state, drain] { drain(*state); });
+
+        drain(*state);
+
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->done.wait(lock, [&] { return state->finished.load() == count; });
+        if (state->error)
+            std::rethrow_exception(state->error);
+    }
+
+    void PixieJobPool::workerLoop() {
+        PixieProfiler::setThreadName("job worker");
+
+        for (;;) {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(jobMutex);
+                jobReady.wait(lock, [this] { return stopping || !jobs.empty(); });
+
+                if (jobs.empty())
+                    return;
+
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+
+            std::exception_ptr error;
+            try {
+                job();
+            } catch (...) {
+                error = std::current_exception();
+            }
+
+            std::lock_guard<std::mutex> lock(jobMutex);
+            if (error && !jobError)
+                jobError = error;
+            if (--pendingJobs == 0)
+                jobsDone.notify_all();
+        }
+    }
+} // namespace pxe
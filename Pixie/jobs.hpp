@@ -0,0 +1,46 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace pxe {
+    // fixed set of worker threads shared by the cpu side of the renderer
+    class PixieJobPool {
+    public:
+        explicit PixieJobPool(size_t threadCount = 0); // 0 = one per core
+        ~PixieJobPool();
+
+        PixieJobPool(const PixieJobPool &) = delete;
+        PixieJobPool &operator=(const PixieJobPool &) = delete;
+
+        // queue a job, use wait() to join everything queued so far. wait rethrows the first exception a job threw
+        // since the last wait
+        void submit(std::function<void()> job);
+        void wait();
+
+        // run fn(i) for every i in [0, count), the calling thread helps out so nesting is fine. if fn throws no
+        // new indices are started, and the first exception is rethrown here once every running fn has returned
+        void parallelFor(size_t count, const std::function<void(size_t)> &fn);
+
+        size_t threadCount() const { return workers.size(); }
+
+    private:
+        void workerLoop();
+
+        std::vector<std::thread> workers;
+        std::deque<std::function<void()>> jobs;
+        std::mutex jobMutex;
+        std::condition_variable jobReady;
+        std::condition_variable jobsDone;
+        size_t pendingJobs;
+        std::exception_ptr jobError;
+        bool stopping;
+    };
+} // namespace pxe
@@ -1,10 +1,12 @@
+#include <cmath>
+#include <filesystem>
 #include <iostream>
 #include <SDL.h>
 #include <memory>
+#include <vector>
 #include "sound.hpp"
 #include "entity.hpp"
-
-//HRESULT findChunk(HANDLE file)
+#include "sdlinput.hpp"
 
 int main(int, char **)
 {
@@ -24,18 +26,45 @@ int main(int, char **)
 	if (FAILED(hr = xaudio->CreateMasteringVoice(&masterVoice)))
 		return hr;
 
+	// the mixer runs on xaudio2's thread, this one only queues commands
+	pxe::PixieAudioMixer mixer(48000, 256);
+	pxe::PixieXAudio2Backend audio(xaudio);
+	audio.start(mixer);
+
+	// a short decaying blip to click with until there are sounds to load
+	std::vector<float> blipSamples(4800);
+	for (size_t i = 0; i < blipSamples.size(); ++i)
+		blipSamples[i] = 0.5f * std::sin(2.0f * 3.14159265f * 660.0f * i / 48000.0f) * std::exp(-float(i) / 800.0f);
+	const auto blip = std::make_shared<pxe::PixieSound>(48000, 1, blipSamples.data(), static_cast<uint32_t>(blipSamples.size()));
+
+	// music streams out of the mapped file, one block plays while the next decodes
+	pxe::PixieAudioStreamer streamer;
+	if (std::filesystem::exists("Pixie/assets/music.wav")) {
+		pxe::PixieAudioStreamSettings settings;
+		settings.loop = true;
+		mixer.play(streamer.open(std::make_unique<pxe::PixieWavDecoder>("Pixie/assets/music.wav"), settings));
+	}
+
 	auto window = std::shared_ptr<SDL_Window>(SDL_CreateWindow("", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, 1024, 768, 0), SDL_DestroyWindow);
 	auto renderer = std::shared_ptr<SDL_Renderer>(SDL_CreateRenderer(window.get(), -1, SDL_RENDERER_ACCELERATED), SDL_DestroyRenderer);
 
-	bool shouldRun = true;
-	while (shouldRun) {
-		SDL_Event ev;
-		SDL_PollEvent(&ev);
-		switch (ev.type) {
-			case SDL_QUIT:
-				shouldRun = false;
-				break;
+	pxe::PixieSystemClock clock;
+	pxe::PixieInput input(clock);
+
+	while (!input.state().quit) {
+		// every event since the last frame, several clicks in one frame each get their blip
+		pxe::drainSDLEvents(input, clock);
+		input.beginFrame();
+		for (uint32_t i = 0; i < input.eventCount(); ++i) {
+			const pxe::PixieInputEvent &event = input.event(i);
+			if (event.type == pxe::PixieInputType::MouseDown) {
+				// panned to where the click landed
+				pxe::PixieVoiceParams params;
+				params.pan = event.x / 512.0f - 1.0f;
+				mixer.play(blip, params);
+			}
 		}
+		mixer.update();
 
 		SDL_SetRenderDrawColor(renderer.get(), 255, 0, 0, 255);
 		SDL_RenderClear(renderer.get());
@@ -43,6 +72,7 @@ int main(int, char **)
 		SDL_RenderPresent(renderer.get());
 	}
 
+	audio.stop();
 	masterVoice->DestroyVoice();
 	xaudio->StopEngine();
 	xaudio->Release();
@@ -0,0 +1,105 @@
+#include "mappedfile.hpp"
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace pxe {
+    PixieMappedFile::PixieMappedFile(const std::string &path) {
+#ifdef _WIN32
+        fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (fileHandle == INVALID_HANDLE_VALUE) {
+            fileHandle = nullptr;
+            throw std::runtime_error("PixieMappedFile: can't open " + path);
+        }
+
+        LARGE_INTEGER fileSize = {};
+        GetFileSizeEx(fileHandle, &fileSize);
+        length = static_cast<size_t>(fileSize.QuadPart);
+
+        // empty files can't be mapped, they just stay open with no data
+        if (length == 0)
+            return;
+
+        mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mappingHandle != nullptr)
+            mapped = static_cast<const uint8_t *>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+#else
+        fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            throw std::runtime_error("PixieMappedFile: can't open " + path);
+
+        struct stat info = {};
+        fstat(fd, &info);
+        length = static_cast<size_t>(info.st_size);
+
+        if (length == 0)
+            return;
+
+        void *view = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (view != MAP_FAILED) {
+            mapped = static_cast<const uint8_t *>(view);
+            madvise(view, length, MADV_SEQUENTIAL);
+        }
+#endif
+
+        if (mapped == nullptr) {
+            close();
+            throw std::runtime_error("PixieMappedFile: can't map " + path);
+        }
+    }
+
+    PixieMappedFile::~PixieMappedFile() {
+        close();
+    }
+
+    PixieMappedFile::PixieMappedFile(PixieMappedFile &&other) noexcept {
+        *this = std::move(other);
+    }
+
+    PixieMappedFile &PixieMappedFile::operator=(PixieMappedFile &&other) noexcept {
+        if (this != &other) {
+            close();
+            mapped = std::exchange(other.mapped, nullptr);
+            length = std::exchange(other.length, 0);
+#ifdef _WIN32
+            fileHandle = std::exchange(other.fileHandle, nullptr);
+            mappingHandle = std::exchange(other.mappingHandle, nullptr);
+#else
+            fd = std::exchange(other.fd, -1);
+#endif
+        }
+        return *this;
+    }
+
+    void PixieMappedFile::close() {
+#ifdef _WIN32
+        if (mapped != nullptr)
+            UnmapViewOfFile(mapped);
+        if (mappingHandle != nullptr)
+            CloseHandle(mappingHandle);
+        if (fileHandle != nullptr)
+            CloseHandle(fileHandle);
+        mappingHandle = nullptr;
+        fileHandle = nullptr;
+#else
+        if (mapped != nullptr)
+            munmap(const_cast<uint8_t *>(mapped), length);
+        if (fd >= 0)
+            ::close(fd);
+        fd = -1;
+#endif
+        mapped = nullptr;
+        length = 0;
+    }
+} // namespace pxe
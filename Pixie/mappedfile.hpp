@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace pxe {
+    // read-only view of a whole file, pages come in from the os cache on first touch
+    class PixieMappedFile {
+    public:
+        PixieMappedFile() = default;
+        explicit PixieMappedFile(const std::string &path);
+        ~PixieMappedFile();
+
+        PixieMappedFile(PixieMappedFile &&other) noexcept;
+        PixieMappedFile &operator=(PixieMappedFile &&other) noexcept;
+        PixieMappedFile(const PixieMappedFile &) = delete;
+        PixieMappedFile &operator=(const PixieMappedFile &) = delete;
+
+        const uint8_t *data() const { return mapped; }
+        size_t size() const { return length; }
+
+    private:
+        void close();
+
+        const uint8_t *mapped = nullptr;
+        size_t length = 0;
+#ifdef _WIN32
+        void *fileHandle = nullptr;
+        void *mappingHandle = nullptr;
+#else
+        int fd = -1;
+#endif
+    };
+} // namespace pxe
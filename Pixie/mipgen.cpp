@@ -0,0 +1,409 @@
+#include "mipgen.hpp"
+#include "pixelconvert.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace pxe {
+    static const uint32_t bandRows = 16; // destination rows per job
+    static const float filterRadius = 3.0f; // kaiser and lanczos, in destination texels
+    static const float kaiserBeta = 4.0f;
+    static const double pi = 3.14159265358979323846;
+    static const size_t encodeSize = 16384; // fine enough that the steep end of sRGB near black still lands on the right byte
+
+    static double sinc(double x) {
+        if (std::abs(x) < 1e-6)
+            return 1.0;
+        return std::sin(pi * x) / (pi * x);
+    }
+
+    // modified bessel function of the first kind, the series converges long before 32 terms
+    static double besselI0(double x) {
+        double sum = 1.0;
+        double term = 1.0;
+        for (int k = 1; k < 32; ++k) {
+            term *= (x / (2.0 * k)) * (x / (2.0 * k));
+            sum += term;
+        }
+        return sum;
+    }
+
+    static double filterWeight(PixieMipFilter filter, double t) {
+        t = std::abs(t);
+        switch (filter) {
+            case PixieMipFilter::Kaiser:
+                if (t >= filterRadius)
+                    return 0.0;
+                return sinc(t) * besselI0(kaiserBeta * std::sqrt(1.0 - (t / filterRadius) * (t / filterRadius))) / besselI0(kaiserBeta);
+            case PixieMipFilter::Lanczos:
+                return t < filterRadius ? sinc(t) * sinc(t / filterRadius) : 0.0;
+            default:
+                // a texel straddling the box edge counts half
+                return t < 0.5 ? 1.0 : (t == 0.5 ? 0.5 : 0.0);
+        }
+    }
+
+    PixieMipGenerator::PixieMipGenerator(size_t threadCount)
+        : jobPool(threadCount)
+        , simdLevel(detectSIMDLevel()) {
+
+        for (uint32_t i = 0; i < 256; ++i) {
+            decodeTables[0][i] = srgbToLinear(static_cast<uint8_t>(i));
+            decodeTables[1][i] = i / 255.0f;
+        }
+
+        // 3 bytes of slack so a 32 bit gather at the last entry stays inside
+        for (auto &table : encodeTables)
+            table.resize(encodeSize + 3);
+        for (size_t i = 0; i < encodeSize; ++i) {
+            const float value = static_cast<float>(i) / (encodeSize - 1);
+            encodeTables[0][i] = linearToSRGB(value);
+            encodeTables[1][i] = static_cast<uint8_t>(value * 255.0f + 0.5f);
+        }
+    }
+
+    PixieMipGenerator::Taps PixieMipGenerator::makeTaps(uint32_t srcSize, uint32_t dstSize, PixieMipFilter filter) {
+        const double scale = static_cast<double>(srcSize) / dstSize;
+        const double radius = (filter == PixieMipFilter::Box ? 0.5 : filterRadius) * scale;
+
+        Taps taps;
+        std::vector<std::vector<float>> weights(dstSize);
+        taps.first.resize(dstSize);
+        taps.count.resize(dstSize);
+        taps.stride = 0;
+
+        for (uint32_t i = 0; i < dstSize; ++i) {
+            const double center = (i + 0.5) * scale;
+            const auto lo = static_cast<int64_t>(std::floor(center - radius - 0.5));
+            const auto hi = static_cast<int64_t>(std::ceil(center + radius - 0.5));
+
+            // out of range texels fold onto the edge they clamp to
+            const int64_t first = std::clamp<int64_t>(lo, 0, srcSize - 1);
+            const int64_t last = std::clamp<int64_t>(hi, 0, srcSize - 1);
+            std::vector<double> row(static_cast<size_t>(last - first + 1), 0.0);
+
+            double sum = 0.0;
+            for (int64_t j = lo; j <= hi; ++j) {
+                const double w = filterWeight(filter, ((j + 0.5) - center) / scale);
+                row[static_cast<size_t>(std::clamp<int64_t>(j, first, last) - first)] += w;
+                sum += w;
+            }
+
+            taps.first[i] = static_cast<uint32_t>(first);
+            taps.count[i] = static_cast<uint32_t>(row.size());
+            for (const double w : row)
+                weights[i].push_back(static_cast<float>(w / sum));
+            taps.stride = std::max<uint32_t>(taps.stride, taps.count[i]);
+        }
+
+        taps.weights.assign(static_cast<size_t>(dstSize) * taps.stride, 0.0f);
+        for (uint32_t i = 0; i < dstSize; ++i)
+            std::copy(weights[i].begin(), weights[i].end(), taps.weights.begin() + static_cast<size_t>(i) * taps.stride);
+
+        return taps;
+    }
+
+    static void decodeRowScalar(const uint32_t *src, uint32_t width, float *dst, const float *table, bool weightByAlpha) {
+        for (uint32_t x = 0; x < width; ++x) {
+            const uint32_t t = src[x];
+            const float a = (t >> 24) * (1.0f / 255.0f);
+            const float weight = weightByAlpha ? a : 1.0f;
+
+            for (int c = 0; c < 3; ++c)
+                dst[x * 4 + c] = table[(t >> (c * 8)) & 0xff] * weight;
+            dst[x * 4 + 3] = a;
+        }
+    }
+
+    // two texels per register, every channel byte is a gather index and alpha is swapped back in afterwards
+    PIXIE_TARGET_AVX2 static void decodeRowAVX2(const uint32_t *src, uint32_t width, float *dst, const float *table, bool weightByAlpha) {
+        const __m256 alphaScale = _mm256_set1_ps(1.0f / 255.0f);
+        const __m256 one = _mm256_set1_ps(1.0f);
+
+        uint32_t x = 0;
+        for (; x + 2 <= width; x += 2) {
+            const __m256i bytes = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(src + x)));
+            const __m256 rgb = _mm256_i32gather_ps(table, bytes, 4);
+            const __m256 a = _mm256_mul_ps(_mm256_cvtepi32_ps(bytes), alphaScale);
+
+            const __m256 alpha = _mm256_shuffle_ps(a, a, _MM_SHUFFLE(3, 3, 3, 3));
+            const __m256 weighted = _mm256_mul_ps(rgb, weightByAlpha ? alpha : one);
+            _mm256_storeu_ps(dst + static_cast<size_t>(x) * 4, _mm256_blend_ps(weighted, a, 0x88));
+        }
+        decodeRowScalar(src + x, width - x, dst + static_cast<size_t>(x) * 4, table, weightByAlpha);
+    }
+
+    static void encodeRowScalar(const float *src, uint32_t width, uint32_t *dst, const uint8_t *table, bool weightedByAlpha) {
+        const float encodeScale = encodeSize - 1;
+
+        for (uint32_t x = 0; x < width; ++x) {
+            // sharp filters ring, so everything is clamped back into range
+            const float a = std::clamp(src[x * 4 + 3], 0.0f, 1.0f);
+            const float unweight = (weightedByAlpha && a > 0.0f) ? 1.0f / a : 1.0f;
+            const float limit = weightedByAlpha ? 1.0f : a; // premultiplied color can't be brighter than its alpha
+
+            uint32_t out = static_cast<uint32_t>(a * 255.0f + 0.5f) << 24;
+            for (int c = 0; c < 3; ++c) {
+                const float v = std::clamp(src[x * 4 + c] * unweight, 0.0f, limit);
+                out |= uint32_t(table[static_cast<size_t>(v * encodeScale + 0.5f)]) << (c * 8);
+            }
+            dst[x] = out;
+        }
+    }
+
+    PIXIE_TARGET_AVX2 static void encodeRowAVX2(const float *src, uint32_t width, uint32_t *dst, const uint8_t *table, bool weightedByAlpha) {
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 one = _mm256_set1_ps(1.0f);
+        const __m256 half = _mm256_set1_ps(0.5f);
+        const __m256 encodeScale = _mm256_set1_ps(encodeSize - 1);
+        const __m256 alphaScale = _mm256_set1_ps(255.0f);
+        const __m256i byteMask = _mm256_set1_epi32(0xff);
+        // low byte of every dword, then the two lanes' results side by side
+        const __m256i gatherBytes = _mm256_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+            0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+        const __m256i joinLanes = _mm256_setr_epi32(0, 4, 1, 1, 1, 1, 1, 1);
+
+        uint32_t x = 0;
+        for (; x + 2 <= width; x += 2) {
+            const __m256 texels = _mm256_loadu_ps(src + static_cast<size_t>(x) * 4);
+            const __m256 a = _mm256_min_ps(_mm256_max_ps(_mm256_shuffle_ps(texels, texels, _MM_SHUFFLE(3, 3, 3, 3)), zero), one);
+
+            __m256 v;
+            if (weightedByAlpha) {
+                const __m256 unweight = _mm256_blendv_ps(one, _mm256_div_ps(one, a), _mm256_cmp_ps(a, zero, _CMP_GT_OQ));
+                v = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(texels, unweight), zero), one);
+            } else {
+                v = _mm256_min_ps(_mm256_max_ps(texels, zero), a);
+            }
+
+            const __m256i index = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(v, encodeScale), half));
+            const __m256i color = _mm256_and_si256(_mm256_i32gather_epi32(reinterpret_cast<const int *>(table), index, 1), byteMask);
+            const __m256i alpha = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(a, alphaScale), half));
+            const __m256i bytes = _mm256_shuffle_epi8(_mm256_blend_epi32(color, alpha, 0x88), gatherBytes);
+
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(dst + x), _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(bytes, joinLanes)));
+        }
+        encodeRowScalar(src + static_cast<size_t>(x) * 4, width - x, dst + x, table, weightedByAlpha);
+    }
+
+    // rgba floats out, linear and premultiplied so filtering is a plain weighted sum
+    void PixieMipGenerator::decodeRow(const uint32_t *src, uint32_t width, float *dst, const PixieMipSettings &settings) const {
+        const float *table = decodeTables[settings.srgb ? 0 : 1].data();
+        if (simdLevel == PixieSIMDLevel::AVX2)
+            decodeRowAVX2(src, width, dst, table, !settings.premultiplied);
+        else
+            decodeRowScalar(src, width, dst, table, !settings.premultiplied);
+    }
+
+    void PixieMipGenerator::encodeRow(const float *src, uint32_t width, uint32_t *dst, const PixieMipSettings &settings) const {
+        const uint8_t *table = encodeTables[settings.srgb ? 0 : 1].data();
+        if (simdLevel == PixieSIMDLevel::AVX2)
+            encodeRowAVX2(src, width, dst, table, !settings.premultiplied);
+        else
+            encodeRowScalar(src, width, dst, table, !settings.premultiplied);
+    }
+
+    PIXIE_TARGET_AVX2 static void accumulateAVX2(const float *src, float weight, float *dst, size_t count) {
+        const __m256 w = _mm256_set1_ps(weight);
+
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+            _mm256_storeu_ps(dst + i, _mm256_fmadd_ps(_mm256_loadu_ps(src + i), w, _mm256_loadu_ps(dst + i)));
+        for (; i < count; ++i)
+            dst[i] += src[i] * weight;
+    }
+
+    // dst += src * weight over whole rows, the vertical pass is nothing but this
+    void PixieMipGenerator::accumulateRow(const float *src, float weight, float *dst, size_t count) const {
+        switch (simdLevel) {
+            case PixieSIMDLevel::AVX2:
+                accumulateAVX2(src, weight, dst, count);
+                break;
+            case PixieSIMDLevel::SSE2: {
+                const __m128 w = _mm_set1_ps(weight);
+                size_t i = 0;
+                for (; i + 4 <= count; i += 4)
+                    _mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_mul_ps(_mm_loadu_ps(src + i), w)));
+                for (; i < count; ++i)
+                    dst[i] += src[i] * weight;
+                break;
+            }
+            default:
+                for (size_t i = 0; i < count; ++i)
+                    dst[i] += src[i] * weight;
+                break;
+        }
+    }
+
+    // two destination texels per register, taps past a texel's count have zero weight
+    PIXIE_TARGET_AVX2 static void filterRowAVX2(const float *in, float *out, uint32_t dstWidth, const uint32_t *first, const float *weights, uint32_t stride) {
+        uint32_t x = 0;
+        for (; x + 2 <= dstWidth; x += 2) {
+            const float *a = in + static_cast<size_t>(first[x]) * 4;
+            const float *b = in + static_cast<size_t>(first[x + 1]) * 4;
+            const float *wa = weights + static_cast<size_t>(x) * stride;
+            const float *wb = wa + stride;
+
+            __m256 sum = _mm256_setzero_ps();
+            for (uint32_t k = 0; k < stride; ++k) {
+                const __m256 texels = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(a + k * 4)), _mm_loadu_ps(b + k * 4), 1);
+                const __m256 w = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(wa[k])), _mm_set1_ps(wb[k]), 1);
+                sum = _mm256_fmadd_ps(texels, w, sum);
+            }
+            _mm256_storeu_ps(out + static_cast<size_t>(x) * 4, sum);
+        }
+
+        for (; x < dstWidth; ++x) {
+            const float *a = in + static_cast<size_t>(first[x]) * 4;
+            const float *wa = weights + static_cast<size_t>(x) * stride;
+            __m128 sum = _mm_setzero_ps();
+            for (uint32_t k = 0; k < stride; ++k)
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(a + k * 4), _mm_set1_ps(wa[k])));
+            _mm_storeu_ps(out + static_cast<size_t>(x) * 4, sum);
+        }
+    }
+
+    // horizontal pass, one rgba texel at a time below avx2
+    void PixieMipGenerator::filterRow(const float *in, float *out, uint32_t dstWidth, const Taps &columns) const {
+        if (simdLevel == PixieSIMDLevel::AVX2) {
+            filterRowAVX2(in, out, dstWidth, columns.first.data(), columns.weights.data(), columns.stride);
+            return;
+        }
+
+        for (uint32_t x = 0; x < dstWidth; ++x) {
+            const float *texels = in + static_cast<size_t>(columns.first[x]) * 4;
+            const float *w = columns.weights.data() + static_cast<size_t>(x) * columns.stride;
+
+            if (simdLevel == PixieSIMDLevel::SSE2) {
+                __m128 sum = _mm_setzero_ps();
+                for (uint32_t k = 0; k < columns.count[x]; ++k)
+                    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(texels + k * 4), _mm_set1_ps(w[k])));
+                _mm_storeu_ps(out + static_cast<size_t>(x) * 4, sum);
+            } else {
+                float sum[4] = {};
+                for (uint32_t k = 0; k < columns.count[x]; ++k) {
+                    for (int c = 0; c < 4; ++c)
+                        sum[c] += texels[k * 4 + c] * w[k];
+                }
+                std::copy(sum, sum + 4, out + static_cast<size_t>(x) * 4);
+            }
+        }
+    }
+
+    // separable, rows are split into bands and every band filters the source rows it needs horizontally first
+    void PixieMipGenerator::downsample(const uint32_t *src, uint32_t srcWidth, uint32_t srcHeight, uint32_t *dst, uint32_t dstWidth, uint32_t dstHeight, const PixieMipSettings &settings) {
+        const Taps columns = makeTaps(srcWidth, dstWidth, settings.filter);
+        const Taps rows = makeTaps(srcHeight, dstHeight, settings.filter);
+        const size_t bandCount = (dstHeight + bandRows - 1) / bandRows;
+
+        jobPool.parallelFor(bandCount, [&](size_t band) {
+            const uint32_t y0 = static_cast<uint32_t>(band * bandRows);
+            const uint32_t y1 = std::min(y0 + bandRows, dstHeight);
+            const uint32_t firstRow = rows.first[y0];
+            uint32_t lastRow = firstRow;
+            for (uint32_t y = y0; y < y1; ++y)
+                lastRow = std::max(lastRow, rows.first[y] + rows.count[y] - 1);
+
+            const size_t dstFloats = static_cast<size_t>(dstWidth) * 4;
+            // zero padded so the simd paths can run every texel out to the full tap stride
+            std::vector<float> decoded((static_cast<size_t>(srcWidth) + columns.stride) * 4, 0.0f);
+            std::vector<float> filtered((lastRow - firstRow + 1) * dstFloats);
+            std::vector<float> accum(dstFloats);
+
+            for (uint32_t row = firstRow; row <= lastRow; ++row) {
+                decodeRow(src + static_cast<size_t>(row) * srcWidth, srcWidth, decoded.data(), settings);
+                float *out = filtered.data() + (row - firstRow) * dstFloats;
+
+                filterRow(decoded.data(), out, dstWidth, columns);
+            }
+
+            for (uint32_t y = y0; y < y1; ++y) {
+                std::fill(accum.begin(), accum.end(), 0.0f);
+                const float *w = rows.weights.data() + static_cast<size_t>(y) * rows.stride;
+                for (uint32_t k = 0; k < rows.count[y]; ++k)
+                    accumulateRow(filtered.data() + (rows.first[y] + k - firstRow) * dstFloats, w[k], accum.data(), dstFloats);
+
+                encodeRow(accum.data(), dstWidth, dst + static_cast<size_t>(y) * dstWidth, settings);
+            }
+        });
+    }
+
+    float PixieMipGenerator::coverage(const uint32_t *texels, size_t count, float cutoff) {
+        size_t covered = 0;
+        for (size_t i = 0; i < count; ++i)
+            covered += (texels[i] >> 24) > cutoff * 255.0f;
+        return static_cast<float>(covered) / count;
+    }
+
+    // finds the alpha scale that passes the same fraction of texels through the alpha test as level 0
+    void PixieMipGenerator::scaleAlpha(std::vector<uint32_t> &texels, float cutoff, float target) {
+        size_t histogram[256] = {};
+        for (const uint32_t t : texels)
+            histogram[t >> 24]++;
+
+        const auto covered = [&](float scale) {
+            size_t count = 0;
+            for (uint32_t a = 0; a < 256; ++a) {
+                if (std::min(a * scale, 255.0f) > cutoff * 255.0f)
+                    count += histogram[a];
+            }
+            return static_cast<float>(count) / texels.size();
+        };
+
+        float lo = 0.0f;
+        float hi = 4.0f;
+        for (int i = 0; i < 16; ++i) {
+            const float mid = (lo + hi) * 0.5f;
+            if (covered(mid) < target)
+                lo = mid;
+            else
+                hi = mid;
+        }
+
+        // coverage moves in steps, take whichever side of the step lands closer
+        const float scale = std::abs(covered(lo) - target) < std::abs(covered(hi) - target) ? lo : hi;
+
+        for (uint32_t &t : texels) {
+            const auto alpha = static_cast<uint32_t>(std::min((t >> 24) * scale + 0.5f, 255.0f));
+            t = (t & 0x00ffffff) | (alpha << 24);
+        }
+    }
+
+    std::vector<PixieMipLevel> PixieMipGenerator::generate(const uint32_t *texels, uint32_t width, uint32_t height, const PixieMipSettings &settings, uint32_t mipCount) {
+        if (width == 0 || height == 0)
+            throw std::invalid_argument("PixieMipGenerator: empty texture");
+
+        uint32_t fullCount = 1;
+        for (uint32_t w = width, h = height; w > 1 || h > 1; w = std::max(w / 2, 1u), h = std::max(h / 2, 1u))
+            fullCount++;
+        mipCount = mipCount == 0 ? fullCount : std::min(mipCount, fullCount);
+
+        const bool keepCoverage = settings.alphaCutoff > 0.0f;
+        float targetCoverage = 0.0f;
+        if (keepCoverage)
+            targetCoverage = coverage(texels, static_cast<size_t>(width) * height, settings.alphaCutoff);
+
+        std::vector<PixieMipLevel> levels;
+        levels.reserve(mipCount - 1);
+
+        const uint32_t *src = texels;
+        uint32_t srcWidth = width;
+        uint32_t srcHeight = height;
+
+        for (uint32_t mip = 1; mip < mipCount; ++mip) {
+            PixieMipLevel level = {std::max(srcWidth / 2, 1u), std::max(srcHeight / 2, 1u), {}};
+            level.texels.resize(static_cast<size_t>(level.width) * level.height);
+
+            downsample(src, srcWidth, srcHeight, level.texels.data(), level.width, level.height, settings);
+            if (keepCoverage)
+                scaleAlpha(level.texels, settings.alphaCutoff, targetCoverage);
+
+            levels.push_back(std::move(level));
+            src = levels.back().texels.data();
+            srcWidth = levels.back().width;
+            srcHeight = levels.back().height;
+        }
+
+        return levels;
+    }
+} // namespace pxe
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+#include "jobs.hpp"
+#include "simd.hpp"
+
+namespace pxe {
+    enum class PixieMipFilter {
+        Box,
+        Kaiser, // windowed sinc, a little softer than lanczos with less ringing
+        Lanczos
+    };
+
+    struct PixieMipSettings {
+        PixieMipFilter filter = PixieMipFilter::Box;
+        bool srgb = true; // rgb is sRGB encoded and gets filtered in linear space
+        bool premultiplied = false; // straight alpha is weighted by alpha while filtering so edges don't darken
+        float alphaCutoff = 0.0f; // alpha test threshold to keep coverage for, 0 leaves alpha alone
+    };
+
+    struct PixieMipLevel {
+        uint32_t width;
+        uint32_t height;
+        std::vector<uint32_t> texels; // R8G8B8A8, tightly packed
+    };
+
+    // builds R8G8B8A8 mip chains on the cpu, each level is filtered from the one above it
+    class PixieMipGenerator {
+    public:
+        explicit PixieMipGenerator(size_t threadCount = 0);
+
+        // levels 1 and down, mipCount counts level 0 and 0 means the full chain
+        std::vector<PixieMipLevel> generate(const uint32_t *texels, uint32_t width, uint32_t height, const PixieMipSettings &settings, uint32_t mipCount = 0);
+
+        void setSIMDLevel(PixieSIMDLevel level) { simdLevel = level; }
+        PixieSIMDLevel getSIMDLevel() const { return simdLevel; }
+        size_t threadCount() const { return jobPool.threadCount(); }
+
+    private:
+        // source texels feeding one destination texel along an axis, clamped to the edge
+        struct Taps {
+            std::vector<uint32_t> first;
+            std::vector<uint32_t> count;
+            std::vector<float> weights; // count[i] weights per destination texel, padded to the widest
+            uint32_t stride;
+        };
+
+        static Taps makeTaps(uint32_t srcSize, uint32_t dstSize, PixieMipFilter filter);
+
+        void downsample(const uint32_t *src, uint32_t srcWidth, uint32_t srcHeight, uint32_t *dst, uint32_t dstWidth, uint32_t dstHeight, const PixieMipSettings &settings);
+        void decodeRow(const uint32_t *src, uint32_t width, float *dst, const PixieMipSettings &settings) const;
+        void encodeRow(const float *src, uint32_t width, uint32_t *dst, const PixieMipSettings &settings) const;
+        void filterRow(const float *in, float *out, uint32_t dstWidth, const Taps &columns) const;
+        void accumulateRow(const float *src, float weight, float *dst, size_t count) const;
+        static float coverage(const uint32_t *texels, size_t count, float cutoff);
+        static void scaleAlpha(std::vector<uint32_t> &texels, float cutoff, float target);
+
+        PixieJobPool jobPool;
+        PixieSIMDLevel simdLevel;
+        // byte to float and float * (encodeSize - 1) back to byte, [0] is sRGB and [1] plain unorm
+        std::array<float, 256> decodeTables[2];
+        std::vector<uint8_t> encodeTables[2];
+    };
+} // namespace pxe
@@ -0,0 +1,413 @@
+#include "pixelconvert.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+namespace pxe {
+    static const uint32_t opaqueAlpha = 0xff000000;
+
+    // shift of a mask that covers exactly one byte, -1 otherwise
+    static int byteShift(uint32_t mask) {
+        for (int shift = 0; shift < 32; shift += 8) {
+            if (mask == (0xffu << shift))
+                return shift;
+        }
+        return -1;
+    }
+
+    static uint32_t loadPixel(const uint8_t *src, uint32_t bytesPerPixel) {
+        uint32_t pixel = 0;
+        if (bytesPerPixel == 4) {
+            std::memcpy(&pixel, src, 4);
+            return pixel;
+        }
+        if (bytesPerPixel == 3)
+            return uint32_t(src[0]) | (uint32_t(src[1]) << 8) | (uint32_t(src[2]) << 16);
+
+        for (uint32_t i = 0; i < bytesPerPixel; ++i)
+            pixel |= uint32_t(src[i]) << (i * 8);
+        return pixel;
+    }
+
+    // (t + (t >> 8)) >> 8 with t = a * b + 128 is exactly round(a * b / 255), same as the soft renderer
+    // red and blue share one multiply, each 16 bit half stays below 65536 so nothing carries across
+    static uint32_t premultiplyPixel(uint32_t texel) {
+        const uint32_t alpha = texel >> 24;
+
+        uint32_t rb = (texel & 0x00ff00ff) * alpha + 0x00800080;
+        rb = ((rb + ((rb >> 8) & 0x00ff00ff)) >> 8) & 0x00ff00ff;
+
+        uint32_t g = ((texel >> 8) & 0xff) * alpha + 128;
+        g = ((g + (g >> 8)) >> 8) & 0xff;
+
+        return rb | (g << 8) | (texel & opaqueAlpha);
+    }
+
+    static __m128i premultiplySSE2(__m128i texel) {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i bias = _mm_set1_epi16(128);
+
+        // alpha broadcast into rgb, alpha itself is multiplied by 255
+        const __m128i alpha = _mm_srli_epi32(texel, 24);
+        const __m128i factor = _mm_or_si128(_mm_or_si128(alpha, _mm_slli_epi32(alpha, 8)), _mm_or_si128(_mm_slli_epi32(alpha, 16), _mm_set1_epi32(int(opaqueAlpha))));
+
+        __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(texel, zero), _mm_unpacklo_epi8(factor, zero)), bias);
+        __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(texel, zero), _mm_unpackhi_epi8(factor, zero)), bias);
+        lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+        hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+
+        return _mm_packus_epi16(lo, hi);
+    }
+
+    PIXIE_TARGET_AVX2 static __m256i premultiplyAVX2(__m256i texel) {
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i bias = _mm256_set1_epi16(128);
+
+        const __m256i alpha = _mm256_srli_epi32(texel, 24);
+        const __m256i factor = _mm256_or_si256(_mm256_or_si256(alpha, _mm256_slli_epi32(alpha, 8)), _mm256_or_si256(_mm256_slli_epi32(alpha, 16), _mm256_set1_epi32(int(opaqueAlpha))));
+
+        __m256i lo = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(texel, zero), _mm256_unpacklo_epi8(factor, zero)), bias);
+        __m256i hi = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(texel, zero), _mm256_unpackhi_epi8(factor, zero)), bias);
+        lo = _mm256_srli_epi16(_mm256_add_epi16(lo, _mm256_srli_epi16(lo, 8)), 8);
+        hi = _mm256_srli_epi16(_mm256_add_epi16(hi, _mm256_srli_epi16(hi, 8)), 8);
+
+        return _mm256_packus_epi16(lo, hi);
+    }
+
+    PIXIE_TARGET_AVX2 static void premultiplyRowAVX2(uint32_t *texels, size_t count) {
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            __m256i *p = reinterpret_cast<__m256i *>(texels + i);
+            _mm256_storeu_si256(p, premultiplyAVX2(_mm256_loadu_si256(p)));
+        }
+        for (; i < count; ++i)
+            texels[i] = premultiplyPixel(texels[i]);
+    }
+
+    static void premultiplyRowSSE2(uint32_t *texels, size_t count) {
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            __m128i *p = reinterpret_cast<__m128i *>(texels + i);
+            _mm_storeu_si128(p, premultiplySSE2(_mm_loadu_si128(p)));
+        }
+        for (; i < count; ++i)
+            texels[i] = premultiplyPixel(texels[i]);
+    }
+
+    // rgb through a 256 entry table, alpha is linear in both spaces and passes through
+    static void transformRowScalar(uint32_t *texels, size_t count, const uint32_t *table) {
+        for (size_t i = 0; i < count; ++i) {
+            const uint32_t t = texels[i];
+            texels[i] = table[t & 0xff] | (table[(t >> 8) & 0xff] << 8) | (table[(t >> 16) & 0xff] << 16) | (t & opaqueAlpha);
+        }
+    }
+
+    PIXIE_TARGET_AVX2 static void transformRowAVX2(uint32_t *texels, size_t count, const uint32_t *table) {
+        const __m256i byteMask = _mm256_set1_epi32(0xff);
+        const __m256i alphaMask = _mm256_set1_epi32(int(opaqueAlpha));
+        const int *base = reinterpret_cast<const int *>(table);
+
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            __m256i *p = reinterpret_cast<__m256i *>(texels + i);
+            const __m256i t = _mm256_loadu_si256(p);
+
+            const __m256i r = _mm256_i32gather_epi32(base, _mm256_and_si256(t, byteMask), 4);
+            const __m256i g = _mm256_i32gather_epi32(base, _mm256_and_si256(_mm256_srli_epi32(t, 8), byteMask), 4);
+            const __m256i b = _mm256_i32gather_epi32(base, _mm256_and_si256(_mm256_srli_epi32(t, 16), byteMask), 4);
+
+            const __m256i rg = _mm256_or_si256(r, _mm256_slli_epi32(g, 8));
+            const __m256i ba = _mm256_or_si256(_mm256_slli_epi32(b, 16), _mm256_and_si256(t, alphaMask));
+            _mm256_storeu_si256(p, _mm256_or_si256(rg, ba));
+        }
+        transformRowScalar(texels + i, count - i, table);
+    }
+
+    // decoders, one row of source pixels into R8G8B8A8
+
+    struct Swizzle {
+        int r;
+        int g;
+        int b;
+        int a; // -1 when the source has no alpha
+    };
+
+    static void swizzleRowScalar(const uint8_t *src, uint32_t *dst, uint32_t width, uint32_t bytesPerPixel, const Swizzle &s) {
+        const uint32_t fill = s.a < 0 ? opaqueAlpha : 0;
+        for (uint32_t x = 0; x < width; ++x) {
+            const uint32_t p = loadPixel(src + static_cast<size_t>(x) * bytesPerPixel, bytesPerPixel);
+            uint32_t out = ((p >> s.r) & 0xff) | (((p >> s.g) & 0xff) << 8) | (((p >> s.b) & 0xff) << 16) | fill;
+            if (s.a >= 0)
+                out |= ((p >> s.a) & 0xff) << 24;
+            dst[x] = out;
+        }
+    }
+
+    // no byte shuffle before ssse3, so each channel is shifted down and masked into place
+    static void swizzle32RowSSE2(const uint8_t *src, uint32_t *dst, uint32_t width, const Swizzle &s) {
+        const __m128i byteMask = _mm_set1_epi32(0xff);
+        const __m128i fill = _mm_set1_epi32(s.a < 0 ? int(opaqueAlpha) : 0);
+        const __m128i rShift = _mm_cvtsi32_si128(s.r);
+        const __m128i gShift = _mm_cvtsi32_si128(s.g);
+        const __m128i bShift = _mm_cvtsi32_si128(s.b);
+        const __m128i aShift = _mm_cvtsi32_si128(std::max(s.a, 0));
+
+        uint32_t x = 0;
+        for (; x + 4 <= width; x += 4) {
+            const __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + static_cast<size_t>(x) * 4));
+            const __m128i r = _mm_and_si128(_mm_srl_epi32(p, rShift), byteMask);
+            const __m128i g = _mm_slli_epi32(_mm_and_si128(_mm_srl_epi32(p, gShift), byteMask), 8);
+            const __m128i b = _mm_slli_epi32(_mm_and_si128(_mm_srl_epi32(p, bShift), byteMask), 16);
+            __m128i out = _mm_or_si128(_mm_or_si128(r, g), _mm_or_si128(b, fill));
+            if (s.a >= 0)
+                out = _mm_or_si128(out, _mm_slli_epi32(_mm_srl_epi32(p, aShift), 24));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x), out);
+        }
+        swizzleRowScalar(src + static_cast<size_t>(x) * 4, dst + x, width - x, 4, s);
+    }
+
+    // byte shuffle for 4 pixels of bytesPerPixel each, repeated in both lanes, missing alpha zeroes and gets or'd in
+    PIXIE_TARGET_AVX2 static __m256i swizzleControl(uint32_t bytesPerPixel, const Swizzle &s) {
+        alignas(32) int8_t control[32];
+        for (int lane = 0; lane < 2; ++lane) {
+            for (int i = 0; i < 4; ++i) {
+                const int base = i * static_cast<int>(bytesPerPixel);
+                int8_t *out = control + lane * 16 + i * 4;
+                out[0] = static_cast<int8_t>(base + s.r / 8);
+                out[1] = static_cast<int8_t>(base + s.g / 8);
+                out[2] = static_cast<int8_t>(base + s.b / 8);
+                out[3] = s.a < 0 ? int8_t(-128) : static_cast<int8_t>(base + s.a / 8);
+            }
+        }
+        return _mm256_load_si256(reinterpret_cast<const __m256i *>(control));
+    }
+
+    PIXIE_TARGET_AVX2 static void swizzle32RowAVX2(const uint8_t *src, uint32_t *dst, uint32_t width, const Swizzle &s) {
+        const __m256i control = swizzleControl(4, s);
+        const __m256i fill = _mm256_set1_epi32(s.a < 0 ? int(opaqueAlpha) : 0);
+
+        uint32_t x = 0;
+        for (; x + 8 <= width; x += 8) {
+            const __m256i p = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + static_cast<size_t>(x) * 4));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + x), _mm256_or_si256(_mm256_shuffle_epi8(p, control), fill));
+        }
+        swizzleRowScalar(src + static_cast<size_t>(x) * 4, dst + x, width - x, 4, s);
+    }
+
+    // 4 packed pixels are 12 bytes, each lane loads 16 so the loop stops while the last load is still inside the row
+    PIXIE_TARGET_AVX2 static void swizzle24RowAVX2(const uint8_t *src, uint32_t *dst, uint32_t width, const Swizzle &s) {
+        const __m256i control = swizzleControl(3, s);
+        const __m256i fill = _mm256_set1_epi32(int(opaqueAlpha));
+
+        uint32_t x = 0;
+        for (; x + 10 <= width; x += 8) {
+            const uint8_t *p = src + static_cast<size_t>(x) * 3;
+            const __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+            const __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 12));
+            const __m256i packed = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + x), _mm256_or_si256(_mm256_shuffle_epi8(packed, control), fill));
+        }
+        swizzleRowScalar(src + static_cast<size_t>(x) * 3, dst + x, width - x, 3, s);
+    }
+
+    // 16 bit sources read through a table of every possible pixel
+    static void lookup16RowScalar(const uint8_t *src, uint32_t *dst, uint32_t width, const uint32_t *table) {
+        for (uint32_t x = 0; x < width; ++x)
+            dst[x] = table[src[x * 2] | (src[x * 2 + 1] << 8)];
+    }
+
+    PIXIE_TARGET_AVX2 static void lookup16RowAVX2(const uint8_t *src, uint32_t *dst, uint32_t width, const uint32_t *table) {
+        const int *base = reinterpret_cast<const int *>(table);
+
+        uint32_t x = 0;
+        for (; x + 8 <= width; x += 8) {
+            const __m256i index = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + static_cast<size_t>(x) * 2)));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + x), _mm256_i32gather_epi32(base, index, 4));
+        }
+        lookup16RowScalar(src + static_cast<size_t>(x) * 2, dst + x, width - x, table);
+    }
+
+    static void paletteRowScalar(const uint8_t *src, uint32_t *dst, uint32_t width, const uint32_t *table) {
+        for (uint32_t x = 0; x < width; ++x)
+            dst[x] = table[src[x]];
+    }
+
+    PIXIE_TARGET_AVX2 static void paletteRowAVX2(const uint8_t *src, uint32_t *dst, uint32_t width, const uint32_t *table) {
+        const int *base = reinterpret_cast<const int *>(table);
+
+        uint32_t x = 0;
+        for (; x + 8 <= width; x += 8) {
+            const __m256i index = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(src + x)));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + x), _mm256_i32gather_epi32(base, index, 4));
+        }
+        paletteRowScalar(src + x, dst + x, width - x, table);
+    }
+
+    // anything else (565, 4444, 2101010...) expands each channel from its own bit width
+    struct Channel {
+        uint32_t mask;
+        uint32_t shift;
+        uint32_t max; // 0 when the channel is missing
+        std::array<uint8_t, 256> expanded; // for channels of 8 bits or less
+    };
+
+    static uint32_t expand(uint32_t value, uint32_t max) {
+        return static_cast<uint32_t>((uint64_t(value) * 255 + max / 2) / max);
+    }
+
+    static Channel channel(uint32_t mask) {
+        Channel c = {mask, 0, 0, {}};
+        if (mask == 0)
+            return c;
+
+        while (((mask >> c.shift) & 1) == 0)
+            c.shift++;
+        c.max = mask >> c.shift;
+
+        for (uint32_t value = 0; value <= std::min(c.max, 255u); ++value)
+            c.expanded[value] = static_cast<uint8_t>(expand(value, c.max));
+        return c;
+    }
+
+    static uint32_t expand(uint32_t pixel, const Channel &c) {
+        const uint32_t value = (pixel & c.mask) >> c.shift;
+        return c.max <= 255 ? c.expanded[value] : expand(value, c.max);
+    }
+
+    static void genericRowScalar(const uint8_t *src, uint32_t *dst, uint32_t width, uint32_t bytesPerPixel, const Channel *channels) {
+        for (uint32_t x = 0; x < width; ++x) {
+            const uint32_t p = loadPixel(src + static_cast<size_t>(x) * bytesPerPixel, bytesPerPixel);
+            uint32_t out = channels[3].max == 0 ? opaqueAlpha : expand(p, channels[3]) << 24;
+            for (int c = 0; c < 3; ++c) {
+                if (channels[c].max != 0)
+                    out |= expand(p, channels[c]) << (c * 8);
+            }
+            dst[x] = out;
+        }
+    }
+
+    float srgbToLinear(uint8_t value) {
+        static const auto table = [] {
+            std::array<float, 256> values = {};
+            for (int i = 0; i < 256; ++i) {
+                const double c = i / 255.0;
+                values[i] = static_cast<float>(c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4));
+            }
+            return values;
+        }();
+        return table[value];
+    }
+
+    uint8_t linearToSRGB(float value) {
+        const double c = std::clamp(static_cast<double>(value), 0.0, 1.0);
+        const double encoded = c <= 0.0031308 ? c * 12.92 : 1.055 * std::pow(c, 1.0 / 2.4) - 0.055;
+        return static_cast<uint8_t>(encoded * 255.0 + 0.5);
+    }
+
+    PixiePixelConverter::PixiePixelConverter(PixieSIMDLevel level)
+        : simdLevel(level) {
+
+        for (uint32_t i = 0; i < 256; ++i) {
+            srgbToLinearTable[i] = static_cast<uint32_t>(srgbToLinear(static_cast<uint8_t>(i)) * 255.0f + 0.5f);
+            linearToSRGBTable[i] = linearToSRGB(i / 255.0f);
+        }
+    }
+
+    void PixiePixelConverter::premultiply(uint32_t *texels, size_t count) const {
+        switch (simdLevel) {
+            case PixieSIMDLevel::AVX2:
+                premultiplyRowAVX2(texels, count);
+                break;
+            case PixieSIMDLevel::SSE2:
+                premultiplyRowSSE2(texels, count);
+                break;
+            default:
+                for (size_t i = 0; i < count; ++i)
+                    texels[i] = premultiplyPixel(texels[i]);
+                break;
+        }
+    }
+
+    void PixiePixelConverter::transform(uint32_t *texels, size_t count, PixieColorTransform transform) const {
+        if (transform == PixieColorTransform::None)
+            return;
+
+        const uint32_t *table = transform == PixieColorTransform::SRGBToLinear ? srgbToLinearTable.data() : linearToSRGBTable.data();
+        if (simdLevel == PixieSIMDLevel::AVX2)
+            transformRowAVX2(texels, count, table);
+        else
+            transformRowScalar(texels, count, table);
+    }
+
+    void PixiePixelConverter::convert(const PixieSourceFormat &format, const void *src, size_t srcPitch, uint32_t width, uint32_t height,
+        void *dst, size_t dstPitch, const PixieConvertOptions &options) const {
+
+        const uint32_t bpp = format.bytesPerPixel;
+        if (bpp == 0 || bpp > 4 || (bpp == 1 && format.palette == nullptr && (format.rMask | format.gMask | format.bMask) == 0))
+            throw std::invalid_argument("PixiePixelConverter: unsupported source format");
+        if (dstPitch < static_cast<size_t>(width) * 4 || srcPitch < static_cast<size_t>(width) * bpp)
+            throw std::invalid_argument("PixiePixelConverter: pitch shorter than a row");
+
+        // indices past the end of a short palette read transparent black
+        std::array<uint32_t, 256> palette = {};
+        const bool indexed = bpp == 1 && format.palette != nullptr;
+        if (indexed)
+            std::copy_n(format.palette, std::min<uint32_t>(format.paletteSize, 256), palette.begin());
+
+        const Swizzle swizzle = {byteShift(format.rMask), byteShift(format.gMask), byteShift(format.bMask), format.aMask == 0 ? -1 : byteShift(format.aMask)};
+        const bool byteAligned = (bpp == 3 || bpp == 4) && swizzle.r >= 0 && swizzle.g >= 0 && swizzle.b >= 0 && (format.aMask == 0 || swizzle.a >= 0) &&
+                                 std::max({swizzle.r, swizzle.g, swizzle.b, swizzle.a}) < static_cast<int>(bpp * 8);
+        const bool identity = bpp == 4 && swizzle.r == 0 && swizzle.g == 8 && swizzle.b == 16 && swizzle.a == 24;
+        const Channel channels[4] = {channel(format.rMask), channel(format.gMask), channel(format.bMask), channel(format.aMask)};
+
+        // 8 and 16 bit packed formats decode every possible pixel once and then just look them up
+        std::vector<uint32_t> lookup;
+        if (!indexed && bpp <= 2) {
+            lookup.resize(size_t(1) << (bpp * 8));
+            for (uint32_t value = 0; value < lookup.size(); ++value) {
+                const uint8_t bytes[2] = {static_cast<uint8_t>(value), static_cast<uint8_t>(value >> 8)};
+                genericRowScalar(bytes, &lookup[value], 1, bpp, channels);
+            }
+        }
+
+        for (uint32_t y = 0; y < height; ++y) {
+            const uint8_t *srcRow = static_cast<const uint8_t *>(src) + y * srcPitch;
+            auto *dstRow = reinterpret_cast<uint32_t *>(static_cast<uint8_t *>(dst) + y * dstPitch);
+
+            if (identity) {
+                std::memcpy(dstRow, srcRow, static_cast<size_t>(width) * 4);
+            } else if (bpp == 1) {
+                const uint32_t *table = indexed ? palette.data() : lookup.data();
+                if (simdLevel == PixieSIMDLevel::AVX2)
+                    paletteRowAVX2(srcRow, dstRow, width, table);
+                else
+                    paletteRowScalar(srcRow, dstRow, width, table);
+            } else if (bpp == 2) {
+                if (simdLevel == PixieSIMDLevel::AVX2)
+                    lookup16RowAVX2(srcRow, dstRow, width, lookup.data());
+                else
+                    lookup16RowScalar(srcRow, dstRow, width, lookup.data());
+            } else if (byteAligned && bpp == 4 && simdLevel == PixieSIMDLevel::AVX2) {
+                swizzle32RowAVX2(srcRow, dstRow, width, swizzle);
+            } else if (byteAligned && bpp == 4 && simdLevel == PixieSIMDLevel::SSE2) {
+                swizzle32RowSSE2(srcRow, dstRow, width, swizzle);
+            } else if (byteAligned && bpp == 3 && swizzle.a < 0 && simdLevel == PixieSIMDLevel::AVX2) {
+                swizzle24RowAVX2(srcRow, dstRow, width, swizzle);
+            } else if (byteAligned) {
+                swizzleRowScalar(srcRow, dstRow, width, bpp, swizzle);
+            } else {
+                genericRowScalar(srcRow, dstRow, width, bpp, channels);
+            }
+
+            // premultiply goes after decoding and before encoding, with no transform it works on the values as stored
+            if (options.transform == PixieColorTransform::SRGBToLinear)
+                transform(dstRow, width, options.transform);
+            if (options.premultiply)
+                premultiply(dstRow, width);
+            if (options.transform == PixieColorTransform::LinearToSRGB)
+                transform(dstRow, width, options.transform);
+        }
+    }
+} // namespace pxe
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include "simd.hpp"
+
+namespace pxe {
+    // how source pixels are packed, masks apply to the little-endian pixel value like SDL_PixelFormat's
+    struct PixieSourceFormat {
+        uint32_t bytesPerPixel; // 1 (indexed), 2, 3 or 4
+        uint32_t rMask;
+        uint32_t gMask;
+        uint32_t bMask;
+        uint32_t aMask; // 0 reads as opaque
+        const uint32_t *palette = nullptr; // R8G8B8A8 entries for indexed sources
+        uint32_t paletteSize = 0;
+    };
+
+    enum class PixieColorTransform {
+        None,
+        SRGBToLinear,
+        LinearToSRGB
+    };
+
+    struct PixieConvertOptions {
+        bool premultiply = false; // applied between the decode and encode transforms, so to the stored values when transform is None
+        PixieColorTransform transform = PixieColorTransform::None;
+    };
+
+    // sRGB transfer function, exact to the float
+    float srgbToLinear(uint8_t value);
+    uint8_t linearToSRGB(float value);
+
+    // turns any packed source into R8G8B8A8 rows (DXGI_FORMAT_R8G8B8A8_UNORM byte order)
+    class PixiePixelConverter {
+    public:
+        explicit PixiePixelConverter(PixieSIMDLevel level = detectSIMDLevel());
+
+        // pitches are in bytes, dst rows need width * 4 bytes and may alias nothing in src
+        void convert(const PixieSourceFormat &format, const void *src, size_t srcPitch, uint32_t width, uint32_t height,
+            void *dst, size_t dstPitch, const PixieConvertOptions &options = {}) const;
+
+        // in place passes over R8G8B8A8 rows, convert runs these itself
+        void premultiply(uint32_t *texels, size_t count) const;
+        void transform(uint32_t *texels, size_t count, PixieColorTransform transform) const;
+
+        void setSIMDLevel(PixieSIMDLevel level) { simdLevel = level; }
+        PixieSIMDLevel getSIMDLevel() const { return simdLevel; }
+
+        static PixieSourceFormat rgba8() { return {4, 0x000000ff, 0x0000ff00, 0x00ff0000, 0xff000000}; }
+        static PixieSourceFormat bgra8() { return {4, 0x00ff0000, 0x0000ff00, 0x000000ff, 0xff000000}; }
+        static PixieSourceFormat rgb8() { return {3, 0x000000ff, 0x0000ff00, 0x00ff0000, 0}; }
+
+    private:
+        PixieSIMDLevel simdLevel;
+        std::array<uint32_t, 256> srgbToLinearTable; // per channel, 8 bit in and out
+        std::array<uint32_t, 256> linearToSRGBTable;
+    };
+} // namespace pxe
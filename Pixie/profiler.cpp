@@ -0,0 +1,269 @@
+#include "profiler.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+
+namespace pxe {
+#if PIXIE_PROFILE
+    std::atomic<bool> PixieProfiler::enabledFlag(false);
+#endif
+
+    namespace {
+        // single producer (the owning thread), single consumer (collect under the registry lock)
+        struct ThreadRing {
+            PixieProfileEvent events[PixieProfiler::ringSize];
+            std::atomic<uint32_t> head {0};
+            std::atomic<uint32_t> tail {0};
+            std::atomic<uint64_t> dropped {0};
+            uint32_t track = 0;
+        };
+
+        struct Registry {
+            std::mutex mutex;
+            std::vector<std::unique_ptr<ThreadRing>> rings; // kept after their thread exits so nothing is lost
+            std::vector<std::string> trackNames;
+            std::vector<PixieProfileEvent> captured;
+            uint64_t capturedDropped = 0;
+        };
+
+        Registry &registry() {
+            static Registry instance;
+            return instance;
+        }
+
+        thread_local ThreadRing *currentRing = nullptr;
+        thread_local const char *currentName = nullptr;
+
+        // rings are made on a thread's first event, naming a thread that never records costs nothing
+        ThreadRing &threadRing() {
+            if (!currentRing) {
+                Registry &reg = registry();
+                std::lock_guard<std::mutex> lock(reg.mutex);
+                reg.rings.push_back(std::make_unique<ThreadRing>());
+                currentRing = reg.rings.back().get();
+                currentRing->track = static_cast<uint32_t>(reg.trackNames.size());
+                reg.trackNames.push_back(currentName ? currentName : "thread " + std::to_string(currentRing->track));
+            }
+            return *currentRing;
+        }
+
+        void push(ThreadRing &ring, const PixieProfileEvent &event) {
+            const uint32_t head = ring.head.load(std::memory_order_relaxed);
+            if (head - ring.tail.load(std::memory_order_acquire) == PixieProfiler::ringSize) {
+                ring.dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            ring.events[head % PixieProfiler::ringSize] = event;
+            ring.head.store(head + 1, std::memory_order_release);
+        }
+
+        void appendEscaped(std::string &out, const char *text) {
+            for (; *text; ++text) {
+                const char c = *text;
+                if (c == '"' || c == '\\') {
+                    out += '\\';
+                    out += c;
+                } else if (static_cast<unsigned char>(c) < 0x20) {
+                    char escaped[8];
+                    std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                    out += escaped;
+                } else {
+                    out += c;
+                }
+            }
+        }
+    } // namespace
+
+    void PixieProfiler::setEnabled(bool enabled) {
+#if PIXIE_PROFILE
+        enabledFlag.store(enabled, std::memory_order_relaxed);
+#else
+        (void)enabled;
+#endif
+    }
+
+    uint64_t PixieProfiler::now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void PixieProfiler::setThreadName(const char *name) {
+        currentName = name;
+        if (currentRing) {
+            Registry &reg = registry();
+            std::lock_guard<std::mutex> lock(reg.mutex);
+            reg.trackNames[currentRing->track] = name;
+        }
+    }
+
+    uint32_t PixieProfiler::registerTrack(const char *name) {
+        Registry &reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        reg.trackNames.push_back(name);
+        return static_cast<uint32_t>(reg.trackNames.size() - 1);
+    }
+
+    void PixieProfiler::record(const char *name, uint64_t begin, uint64_t end) {
+        ThreadRing &ring = threadRing();
+        push(ring, {name, begin, end, ring.track});
+    }
+
+    void PixieProfiler::record(uint32_t track, const char *name, uint64_t begin, uint64_t end) {
+        push(threadRing(), {name, begin, end, track});
+    }
+
+    void PixieProfiler::collect() {
+        Registry &reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+
+        for (const auto &ring : reg.rings) {
+            const uint32_t tail = ring->tail.load(std::memory_order_relaxed);
+            const uint32_t head = ring->head.load(std::memory_order_acquire);
+            for (uint32_t i = tail; i != head; ++i) {
+                if (reg.captured.size() < maxCapturedEvents)
+                    reg.captured.push_back(ring->events[i % ringSize]);
+                else
+                    reg.capturedDropped++;
+            }
+            ring->tail.store(head, std::memory_order_release);
+        }
+    }
+
+    std::vector<PixieProfileEvent> PixieProfiler::captured() {
+        collect();
+        Registry &reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        return reg.captured;
+    }
+
+    void PixieProfiler::clear() {
+        collect();
+        Registry &reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        reg.captured.clear();
+        reg.capturedDropped = 0;
+        for (const auto &ring : reg.rings)
+            ring->dropped.store(0, std::memory_order_relaxed);
+    }
+
+    std::string PixieProfiler::chromeTrace() {
+        collect();
+        Registry &reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+
+        // timestamps are microseconds from the first event so the viewer doesn't open on a huge offset
+        uint64_t origin = UINT64_MAX;
+        for (const PixieProfileEvent &event : reg.captured)
+            origin = std::min(origin, event.begin);
+
+        std::string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+        char number[96];
+        bool first = true;
+        for (uint32_t track = 0; track < reg.trackNames.size(); ++track) {
+            std::snprintf(number, sizeof(number), "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"", first ? "" : ",\n", track);
+            out += number;
+            appendEscaped(out, reg.trackNames[track].c_str());
+            out += "\"}}";
+            first = false;
+        }
+
+        for (const PixieProfileEvent &event : reg.captured) {
+            out += first ? "" : ",\n";
+            out += "{\"ph\":\"X\",\"name\":\"";
+            appendEscaped(out, event.name);
+            std::snprintf(number, sizeof(number), "\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", event.track, double(event.begin - origin) * 1e-3,
+                double(event.end - event.begin) * 1e-3);
+            out += number;
+            first = false;
+        }
+
+        out += "\n]}\n";
+        return out;
+    }
+
+    void PixieProfiler::exportChromeTrace(const std::string &path) {
+        const std::string trace = chromeTrace();
+        std::ofstream file(path, std::ios::binary);
+        if (!file.write(trace.data(), trace.size()))
+            throw std::runtime_error("PixieProfiler: can't write " + path);
+    }
+
+    PixieProfilerStats PixieProfiler::stats() {
+        Registry &reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+
+        PixieProfilerStats result = {};
+        result.events = reg.captured.size();
+        result.dropped = reg.capturedDropped;
+        for (const auto &ring : reg.rings)
+            result.dropped += ring->dropped.load(std::memory_order_relaxed);
+        result.tracks = static_cast<uint32_t>(reg.trackNames.size());
+        return result;
+    }
+
+    PixieGpuProfiler::PixieGpuProfiler(PixieTimestampBackend &backend, uint32_t slotCount)
+        : backend(backend)
+        , track(PixieProfiler::registerTrack("gpu"))
+        , currentSlot(0)
+        , names(slotCount, std::vector<const char *>(maxZonesPerFrame))
+        , zoneCounts(new std::atomic<uint32_t>[slotCount]) {
+
+        for (uint32_t i = 0; i < slotCount; ++i)
+            zoneCounts[i].store(0, std::memory_order_relaxed);
+    }
+
+    void PixieGpuProfiler::beginFrame(uint32_t slot, const uint64_t *ticks) {
+        if (slot >= slotCount())
+            throw std::out_of_range("PixieGpuProfiler: bad frame slot");
+
+        const uint32_t zones = zonesIn(slot);
+        if (zones != 0 && ticks) {
+            uint64_t gpuTick = 0;
+            uint64_t cpuNs = 0;
+            uint64_t ticksPerSecond = 1;
+            backend.calibrateTimestamps(gpuTick, cpuNs, ticksPerSecond);
+
+            // onto the cpu timeline through the calibration pair, the ticks can sit on either side of it
+            const double nsPerTick = 1e9 / double(ticksPerSecond);
+            const auto toCpu = [&](uint64_t tick) {
+                return static_cast<uint64_t>(static_cast<int64_t>(cpuNs) + static_cast<int64_t>(double(static_cast<int64_t>(tick - gpuTick)) * nsPerTick));
+            };
+
+            for (uint32_t i = 0; i < zones; ++i) {
+                const uint64_t begin = ticks[2 * i];
+                const uint64_t end = ticks[2 * i + 1];
+                if (end >= begin)
+                    PixieProfiler::record(track, names[slot][i], toCpu(begin), toCpu(end));
+            }
+        }
+
+        zoneCounts[slot].store(0, std::memory_order_relaxed);
+        currentSlot = slot;
+    }
+
+    uint32_t PixieGpuProfiler::zonesIn(uint32_t slot) const {
+        // zones past the limit still bump the count, they just never got queries
+        const uint32_t zones = zoneCounts[slot].load(std::memory_order_acquire);
+        return zones < maxZonesPerFrame ? zones : maxZonesPerFrame;
+    }
+
+    uint32_t PixieGpuProfiler::beginZone(uint32_t context, const char *name) {
+        if (!PixieProfiler::enabled())
+            return invalidZone;
+
+        const uint32_t zone = zoneCounts[currentSlot].fetch_add(1, std::memory_order_relaxed);
+        if (zone >= maxZonesPerFrame)
+            return invalidZone;
+
+        names[currentSlot][zone] = name;
+        backend.writeTimestamp(context, firstQuery(currentSlot) + 2 * zone);
+        return zone;
+    }
+
+    void PixieGpuProfiler::endZone(uint32_t context, uint32_t zone) {
+        if (zone != invalidZone)
+            backend.writeTimestamp(context, firstQuery(currentSlot) + 2 * zone + 1);
+    }
+} // namespace pxe
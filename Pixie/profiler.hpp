@@ -0,0 +1,139 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// build with PIXIE_PROFILE=0 to compile every zone out, otherwise a zone costs one relaxed load while capture is off
+#ifndef PIXIE_PROFILE
+#define PIXIE_PROFILE 1
+#endif
+
+#define PIXIE_PROFILE_CONCAT_INNER(a, b) a##b
+#define PIXIE_PROFILE_CONCAT(a, b) PIXIE_PROFILE_CONCAT_INNER(a, b)
+
+#if PIXIE_PROFILE
+// times the rest of the enclosing scope, name has to outlive the capture so use a literal
+#define PIXIE_ZONE(name) ::pxe::PixieProfileZone PIXIE_PROFILE_CONCAT(pixieZone, __LINE__)(name)
+#else
+#define PIXIE_ZONE(name) ((void)0)
+#endif
+
+namespace pxe {
+    struct PixieProfileEvent {
+        const char *name;
+        uint64_t begin; // PixieProfiler::now() nanoseconds
+        uint64_t end;
+        uint32_t track;
+    };
+
+    struct PixieProfilerStats {
+        uint64_t events; // collected so far
+        uint64_t dropped; // a thread's ring or the capture was full
+        uint32_t tracks;
+    };
+
+    // process wide capture. every thread records into its own ring without locks, collect() drains them all.
+    // threads get a track the first time they record, extra tracks carry timelines with no thread of their own like the gpu
+    class PixieProfiler {
+    public:
+        static const uint32_t ringSize = 16384; // per thread, plenty for a frame between collects
+        static const size_t maxCapturedEvents = 4 * 1024 * 1024;
+
+        static void setEnabled(bool enabled);
+#if PIXIE_PROFILE
+        static bool enabled() { return enabledFlag.load(std::memory_order_relaxed); }
+#else
+        static constexpr bool enabled() { return false; }
+#endif
+        static uint64_t now();
+
+        // names the calling thread's track in the trace
+        static void setThreadName(const char *name);
+        static uint32_t registerTrack(const char *name);
+
+        // the calling thread's track, or another one when the timeline belongs elsewhere
+        static void record(const char *name, uint64_t begin, uint64_t end);
+        static void record(uint32_t track, const char *name, uint64_t begin, uint64_t end);
+
+        // moves what every ring holds into the capture, call it from one thread, once a frame or so
+        static void collect();
+        static std::vector<PixieProfileEvent> captured();
+        static void clear();
+
+        // collects and writes the capture as chrome trace json, open it in chrome://tracing or perfetto
+        static void exportChromeTrace(const std::string &path);
+        static std::string chromeTrace();
+
+        static PixieProfilerStats stats();
+
+    private:
+#if PIXIE_PROFILE
+        static std::atomic<bool> enabledFlag;
+#endif
+    };
+
+    class PixieProfileZone {
+    public:
+        explicit PixieProfileZone(const char *name)
+            : name(name)
+            , begin(PixieProfiler::enabled() ? PixieProfiler::now() : 0) {
+        }
+
+        ~PixieProfileZone() {
+            if (begin != 0)
+                PixieProfiler::record(name, begin, PixieProfiler::now());
+        }
+
+        PixieProfileZone(const PixieProfileZone &) = delete;
+        PixieProfileZone &operator=(const PixieProfileZone &) = delete;
+
+    private:
+        const char *name;
+        uint64_t begin;
+    };
+
+    // what the gpu profiler needs from a backend, PixieRenderer writes d3d12 timestamp queries
+    class PixieTimestampBackend {
+    public:
+        virtual ~PixieTimestampBackend() = default;
+
+        // records a timestamp into query slot `query` on the recording context
+        virtual void writeTimestamp(uint32_t context, uint32_t query) = 0;
+        // a gpu tick and PixieProfiler::now() sampled at the same moment, plus the gpu tick rate
+        virtual void calibrateTimestamps(uint64_t &gpuTick, uint64_t &cpuNs, uint64_t &ticksPerSecond) = 0;
+    };
+
+    // gpu zones per frame slot. recording threads bracket work with timestamp pairs, the backend resolves
+    // the slot's queries after the frame and hands the ticks back once its fence completes
+    class PixieGpuProfiler {
+    public:
+        static const uint32_t maxZonesPerFrame = 128;
+        static const uint32_t queriesPerSlot = maxZonesPerFrame * 2;
+        static const uint32_t invalidZone = UINT32_MAX;
+
+        PixieGpuProfiler(PixieTimestampBackend &backend, uint32_t slotCount);
+
+        // the slot's last frame has retired, ticks holds its resolved queries from firstQuery(slot) on
+        void beginFrame(uint32_t slot, const uint64_t *ticks);
+        // any recording thread, invalidZone when capture is off or the frame ran out of queries
+        uint32_t beginZone(uint32_t context, const char *name);
+        void endZone(uint32_t context, uint32_t zone);
+
+        // what the backend resolves at the end of the frame
+        uint32_t firstQuery(uint32_t slot) const { return slot * queriesPerSlot; }
+        uint32_t queriesUsed() const { return 2 * zonesIn(currentSlot); }
+        uint32_t slotCount() const { return static_cast<uint32_t>(names.size()); }
+
+    private:
+        uint32_t zonesIn(uint32_t slot) const;
+
+        PixieTimestampBackend &backend;
+        uint32_t track;
+        uint32_t currentSlot;
+        std::vector<std::vector<const char *>> names; // per slot, zone i uses queries 2i and 2i + 1
+        std::unique_ptr<std::atomic<uint32_t>[]> zoneCounts;
+    };
+} // namespace pxe
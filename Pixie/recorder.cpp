@@ -0,0 +1,96 @@
+#include "recorder.hpp"
+#include "profiler.hpp"
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+namespace pxe {
+    PixieCommandRecorder::PixieCommandRecorder(PixieRecordBackend &backend, size_t threadCount)
+        : backend(backend)
+        , frameSlot(0)
+        , frameStats({})
+        , jobPool(threadCount) {
+    }
+
+    void PixieCommandRecorder::beginFrame(uint32_t frameSlot) {
+        if (frameSlot >= PixieFrameRing::maxFramesInFlight)
+            throw std::out_of_range("PixieCommandRecorder: bad frame slot");
+        if (!passes.empty())
+            throw std::logic_error("PixieCommandRecorder: frame began with passes still queued");
+
+        this->frameSlot = frameSlot;
+        const uint32_t made = frameStats.contexts;
+        frameStats = {};
+        frameStats.contexts = made;
+    }
+
+    std::vector<size_t> PixieCommandRecorder::partition(size_t itemCount, size_t minItemsPerJob, size_t threadCount) {
+        std::vector<size_t> bounds = {0};
+        if (itemCount == 0)
+            return bounds;
+
+        const size_t target = std::max<size_t>(threadCount, 1) * jobsPerThread;
+        const size_t perJob = std::max({minItemsPerJob, (itemCount + target - 1) / target, size_t(1)});
+
+        for (size_t begin = 0; begin < itemCount; begin += perJob)
+            bounds.push_back(std::min(begin + perJob, itemCount));
+        return bounds;
+    }
+
+    void PixieCommandRecorder::record(size_t itemCount, size_t minItemsPerJob, PixieRecordFn fn) {
+        const std::vector<size_t> bounds = partition(itemCount, minItemsPerJob, threadCount());
+        const size_t pass = passes.size();
+        passes.push_back(std::move(fn));
+
+        for (size_t i = 0; i + 1 < bounds.size(); ++i)
+            jobs.push_back({pass, bounds[i], bounds[i + 1], 0});
+        frameStats.passes++;
+    }
+
+    void PixieCommandRecorder::submit() {
+        PIXIE_ZONE("PixieCommandRecorder::submit");
+        const auto begin = std::chrono::steady_clock::now();
+
+        // contexts are handed out by job index, growing the pool here keeps the backend calls on this thread
+        std::vector<uint32_t> &pool = contexts[frameSlot];
+        while (pool.size() < jobs.size()) {
+            pool.push_back(backend.createContext());
+            frameStats.contexts++;
+        }
+        for (size_t i = 0; i < jobs.size(); ++i)
+            jobs[i].context = pool[i];
+
+        try {
+            jobPool.parallelFor(jobs.size(), [this](size_t i) {
+                PIXIE_ZONE("PixieCommandRecorder::job");
+                const Job &job = jobs[i];
+                backend.openContext(job.context);
+                try {
+                    passes[job.pass](job.context, job.begin, job.end);
+                } catch (...) {
+                    // left open the context couldn't be reset when its slot comes round again
+                    backend.closeContext(job.context);
+                    throw;
+                }
+                backend.closeContext(job.context);
+            });
+        } catch (...) {
+            // nothing is submitted, the frame is dropped so the next beginFrame starts clean
+            passes.clear();
+            jobs.clear();
+            throw;
+        }
+
+        submitted.clear();
+        for (const Job &job : jobs)
+            submitted.push_back(job.context);
+        if (!submitted.empty())
+            backend.submitContexts(submitted.data(), submitted.size());
+
+        frameStats.jobs = static_cast<uint32_t>(jobs.size());
+        frameStats.recordMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+
+        passes.clear();
+        jobs.clear();
+    }
+} // namespace pxe
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "framering.hpp"
+#include "jobs.hpp"
+
+namespace pxe {
+    // backend side of parallel recording, a context is one command allocator plus its command list on d3d12
+    class PixieRecordBackend {
+    public:
+        virtual ~PixieRecordBackend() = default;
+        // render thread, when a frame slot needs more contexts than it has made so far
+        virtual uint32_t createContext() = 0;
+        // recording thread, the context's last submission has retired so its allocator can be reset
+        virtual void openContext(uint32_t context) = 0;
+        virtual void closeContext(uint32_t context) = 0;
+        // render thread, one submission with the contexts in recording order
+        virtual void submitContexts(const uint32_t *contexts, size_t count) = 0;
+    };
+
+    // records items [begin, end) into the context
+    using PixieRecordFn = std::function<void(uint32_t context, size_t begin, size_t end)>;
+
+    struct PixieRecordStats {
+        uint32_t passes;
+        uint32_t jobs; // one context each
+        uint32_t contexts; // made so far across every frame slot
+        double recordMs;
+    };
+
+    // splits a frame into recording jobs that run on a job pool and submits them in the order they were queued,
+    // so the gpu sees the same command stream whatever the thread count and scheduling
+    class PixieCommandRecorder {
+    public:
+        static const size_t jobsPerThread = 2; // a little slack so one slow job doesn't hold up the frame
+
+        PixieCommandRecorder(PixieRecordBackend &backend, size_t threadCount = 0);
+
+        // contexts of this slot are free again, the frame ring has waited for its fence
+        void beginFrame(uint32_t frameSlot);
+        // queues itemCount items split into jobs of at least minItemsPerJob, recorded in order after earlier passes
+        void record(size_t itemCount, size_t minItemsPerJob, PixieRecordFn fn);
+        // a pass that is one job, barriers and clears
+        void record(PixieRecordFn fn) { record(1, 1, std::move(fn)); }
+        // records every queued pass and submits the contexts with one call. if a pass throws nothing is submitted,
+        // the frame's passes are dropped and the first exception is rethrown
+        void submit();
+
+        size_t threadCount() const { return jobPool.threadCount() + 1; } // the submitting thread records too
+        const PixieRecordStats &stats() const { return frameStats; }
+
+        // the job split for a pass, exposed so the partitioning can be checked without a backend
+        static std::vector<size_t> partition(size_t itemCount, size_t minItemsPerJob, size_t threadCount);
+
+    private:
+        struct Job {
+            size_t pass;
+            size_t begin;
+            size_t end;
+            uint32_t context;
+        };
+
+        PixieRecordBackend &backend;
+        uint32_t frameSlot;
+        // job i of a frame always records into contexts[slot][i], nothing is shared between recording threads
+        std::vector<uint32_t> contexts[PixieFrameRing::maxFramesInFlight];
+        std::vector<PixieRecordFn> passes;
+        std::vector<Job> jobs;
+        std::vector<uint32_t> submitted;
+        PixieRecordStats frameStats;
+
+        PixieJobPool jobPool;
+    };
+} // namespace pxe
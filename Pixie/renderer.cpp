@@ -1,44 +1,114 @@
 #include "renderer.hpp"
+#include "d3dshadercompiler.hpp"
+#include "mipgen.hpp"
+#include "surfaceconvert.hpp"
+#include "taskgraph.hpp"
 #include <d3d12sdklayers.h>
 #include <d3dcompiler.h>
 #include <SDL_image.h>
 #include <SDL_syswm.h>
+#include <algorithm>
+#include <filesystem>
 #include <iostream>
+#include <iterator>
+#include <memory>
 #include <format>
 #include <vector>
 #include <sstream>
 
 namespace pxe {
-    PixieRenderer::PixieRenderer(SDL_Window *window, UINT width, UINT height)
+    // runs on the streaming workers, cooked textures come with their mips and pngs get them generated
+    static bool decodeStreamedTexture(const std::string &path, PixieDecodedTexture &texture) {
+        std::vector<PixieMipLevel> &levels = texture.levels;
+        if (std::filesystem::path(path).extension() == ".pxtex") {
+            const PixieTextureFile file(path);
+            // rows are copied as whole UINT32 texels
+            if (file.layout().format != PixieTextureFormat::RGBA8 && file.layout().format != PixieTextureFormat::RGBA8_SRGB)
+                return false;
+
+            texture.format = file.layout().format;
+            for (UINT mip = 0; mip < file.layout().mips.size(); ++mip) {
+                const PixieTextureMip &source = file.layout().mips[mip];
+                PixieMipLevel level = {source.width, source.height, std::vector<UINT32>(static_cast<size_t>(source.width) * source.height)};
+                for (UINT y = 0; y < source.height; ++y)
+                    std::memcpy(level.texels.data() + static_cast<size_t>(y) * source.width, file.mipData(mip) + static_cast<UINT64>(y) * source.rowPitch, source.width * sizeof(UINT32));
+                levels.push_back(std::move(level));
+            }
+            return true;
+        }
+
+        SDL_Surface *surf = IMG_Load(path.c_str());
+        if (surf == nullptr)
+            return false;
+
+        PixieMipLevel base = {static_cast<UINT>(surf->w), static_cast<UINT>(surf->h), convertSurface(surf, PixiePixelConverter())};
+        SDL_FreeSurface(surf);
+
+        // the worker is already one of several, so each generator keeps to its own thread
+        thread_local PixieMipGenerator generator(1);
+        auto mips = generator.generate(base.texels.data(), base.width, base.height, PixieMipSettings());
+
+        levels.push_back(std::move(base));
+        std::move(mips.begin(), mips.end(), std::back_inserter(levels));
+        return true;
+    }
+
+    PixieRenderer::PixieRenderer(SDL_Window *window, UINT width, UINT height, UINT framesInFlight)
         : surfaceWidth(width)
         , surfaceHeight(height)
         , factory(nullptr)
         , device(nullptr)
         , cmdQueue(nullptr)
-        , cmdAlloc(nullptr)
         , rootSig(nullptr)
         , pipelineState(nullptr)
-        , cmdList(nullptr)
         , viewport(0.0f, 0.0f, static_cast<float>(surfaceWidth), static_cast<float>(surfaceHeight))
         , scissor(0, 0, static_cast<LONG>(surfaceWidth), static_cast<LONG>(surfaceHeight))
         , rtvHeap(nullptr)
         , srvHeap(nullptr)
+        , descriptors(persistentDescriptors, transientDescriptors)
         , swapchain(nullptr)
         , vertexBuffer(nullptr)
+        , vertexBufferData(nullptr)
+        , indexBuffer(nullptr)
+        , uploads(stagingRingSize, maxStagingRings, [this](uint32_t, uint64_t size) { return createStagingRing(size); })
+        , streamedTextures(maxStreamedTextures)
+        , streamedViews(maxStreamedTextures)
+        , setupContext(0)
+        , clearColor {}
+        , recorder(*this)
+        , timestampData(nullptr)
+        , timestampFrequency(1)
+        , gpuProfiler(*this, bufferCount)
+        , frames(*this, framesInFlight)
+        , frameMemory(64 * 1024, framesInFlight)
+        , frameSlot(0)
         , fence(nullptr) {
 
         for (size_t i = 0; i < bufferCount; ++i)
             renderTargets[i] = nullptr;
 
+        for (size_t i = 0; i < PixieFrameRing::maxFramesInFlight; ++i)
+            spriteMarkers[i] = 0;
+
+        for (size_t i = 0; i < bufferCount; ++i)
+            resolveContexts[i] = UINT32_MAX;
+
         SDL_SysWMinfo WMinfo;
         SDL_VERSION(&WMinfo.version);
         SDL_GetWindowWMInfo(window, &WMinfo);
         hwnd = (HWND)WMinfo.info.win.window;
 
         loadPipeline();
+
+        // a texture can't be evicted while a frame still in flight might sample it
+        PixieStreamSettings streamSettings;
+        streamSettings.maxTextures = maxStreamedTextures;
+        streamSettings.evictionDelay = bufferCount + 1;
+        streamer = std::make_unique<PixieTextureStreamer>(decodeStreamedTexture, *this, streamSettings);
     }
 
     PixieRenderer::~PixieRenderer() {
+        streamer.reset();
         awaitFence();
 
         CloseHandle(fenceEvent);
@@ -89,23 +159,75 @@ namespace pxe {
         *ppAdapter = adapter.Detach();
     }
 
+    // the test image off disk with its mips, nothing here needs the device
+    static PixieInitTexture decodeInitTexture() {
+        PixieInitTexture image = {};
+
+        // prefer the cooked texture, it maps straight into staging with no decode
+        if (std::filesystem::exists("Pixie/assets/icon.pxtex")) {
+            image.cooked = std::make_unique<PixieTextureFile>("Pixie/assets/icon.pxtex");
+            image.width = image.cooked->layout().width;
+            image.height = image.cooked->layout().height;
+            return image;
+        }
+
+        SDL_Surface *surf = IMG_Load("Pixie/assets/icon.png");
+        if (surf == nullptr)
+            throw std::runtime_error("PixieRenderer: can't load Pixie/assets/icon.png");
+
+        // whatever format the png decoded to, the texture wants R8G8B8A8 with a full mip chain under it
+        image.width = surf->w;
+        image.height = surf->h;
+        image.texels = convertSurface(surf, PixiePixelConverter());
+        SDL_FreeSurface(surf);
+        image.mips = PixieMipGenerator().generate(image.texels.data(), image.width, image.height, PixieMipSettings());
+        return image;
+    }
+
+    // init as a task graph, shader compiles and the png decode run next to device creation and each
+    // stage starts as soon as what it really needs is there
     void PixieRenderer::loadPipeline() {
-        createDevice();
-        std::cout << "created device\n";
-        createCMDQueue();
-        std::cout << "created command queue\n";
-        createSwapchain();
-        std::cout << "created swapchain\n";
-        createFrameBuffer();
-        std::cout << "created frame buffer\n";
-        createCMDAllocator();
-        std::cout << "created command allocator\n";
-        createRootSig();
-        std::cout << "created root signature\n";
-        createPipelineState();
-        std::cout << "created pipeline state\n";
-        createSyncStructure();
-        std::cout << "created sync structures\n";
+        PIXIE_ZONE("PixieRenderer::loadPipeline");
+
+#if defined(_DEBUG)
+        // Enable better shader debugging with the graphics debugging tools.
+        const UINT compileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
+#else
+        const UINT compileFlags = 0;
+#endif
+
+        // bytecode comes out of the cache pack unless the source, flags or compiler changed since it was written
+        PixieD3DShaderCompiler compiler;
+        PixieShaderCache shaderCache(compiler, "Pixie/cache/shaders.pxsc");
+        PixieShaderBlob vertexShader = {};
+        PixieShaderBlob pixelShader = {};
+        PixieInitTexture image = {};
+
+        PixieTaskGraph startup;
+        const auto deviceTask = startup.add("device", [this] { createDevice(); });
+        const auto queueTask = startup.add("command queue", [this] { createCMDQueue(); }, {deviceTask});
+        // dxgi ties the swapchain to the window, so it stays on the thread that owns it
+        const auto swapchainTask = startup.add("swapchain", [this] { createSwapchain(); }, {queueTask}, PixieTaskAffinity::Caller);
+        const auto heapTask = startup.add("descriptor heaps", [this] { createDescriptorHeaps(); }, {deviceTask});
+        const auto frameBufferTask = startup.add("frame buffer", [this] { createFrameBuffer(); }, {swapchainTask, heapTask});
+        const auto allocatorTask = startup.add("command allocator", [this] { createCMDAllocator(); }, {deviceTask});
+        const auto rootSigTask = startup.add("root signature", [this] { createRootSig(); }, {deviceTask});
+        const auto vertexShaderTask = startup.add("vertex shader", [&] { vertexShader = shaderCache.get({"Pixie/assets/shaders.hlsl", "VSMain", "vs_5_1", {}, compileFlags}); });
+        const auto pixelShaderTask = startup.add("pixel shader", [&] { pixelShader = shaderCache.get({"Pixie/assets/shaders.hlsl", "PSMain", "ps_5_1", {}, compileFlags}); });
+        startup.add("pipeline state", [&] { createPipelineState(vertexShader, pixelShader); }, {rootSigTask, vertexShaderTask, pixelShaderTask});
+        const auto decodeTask = startup.add("decode texture", [&] { image = decodeInitTexture(); });
+        startup.add("geometry buffers", [this] { createGeometryBuffers(); }, {deviceTask});
+        const auto textureTask = startup.add("textures", [&] { createTextures(image); }, {heapTask, decodeTask});
+        const auto setupTask = startup.add("submit setup", [this] { submitSetup(); }, {queueTask, allocatorTask, textureTask});
+        startup.add("sync structures", [this] { createSyncStructure(); }, {setupTask, frameBufferTask});
+        startup.add("timestamp queries", [this] { createTimestampQueries(); }, {queueTask});
+
+        PixieJobPool startupPool;
+        startup.run(startupPool);
+
+        std::cout << "startup:\n" << startup.report();
+        const PixieShaderCacheStats cacheStats = shaderCache.stats();
+        std::cout << "shader cache: " << cacheStats.hits << " hits, " << cacheStats.misses << " compiled\n";
     }
 
     void PixieRenderer::createDevice() {
@@ -158,44 +280,42 @@ namespace pxe {
         throwIfFailed(tmpSwapchain.As(&swapchain));
     }
 
-    void PixieRenderer::createFrameBuffer() {
-        frameIndex = swapchain->GetCurrentBackBufferIndex();
+    void PixieRenderer::createDescriptorHeaps() {
+        // render target view descriptor heap
+        D3D12_DESCRIPTOR_HEAP_DESC rtvHeapDesc = {};
+        rtvHeapDesc.NumDescriptors = bufferCount;
+        rtvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
+        rtvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
 
-        // create descriptor heaps
-        {
-            // render target view descriptor heap
-            D3D12_DESCRIPTOR_HEAP_DESC rtvHeapDesc = {};
-            rtvHeapDesc.NumDescriptors = bufferCount;
-            rtvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_RTV;
-            rtvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_NONE;
+        throwIfFailed(device->CreateDescriptorHeap(&rtvHeapDesc, IID_PPV_ARGS(&rtvHeap)));
 
-            throwIfFailed(device->CreateDescriptorHeap(&rtvHeapDesc, IID_PPV_ARGS(&rtvHeap)));
+        // shader resource view descriptor heap
+        D3D12_DESCRIPTOR_HEAP_DESC srvHeapDesc = {};
+        srvHeapDesc.NumDescriptors = descriptors.capacity();
+        srvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+        srvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
 
-            // shader resource view descriptor heap
-            D3D12_DESCRIPTOR_HEAP_DESC srvHeapDesc = {};
-            srvHeapDesc.NumDescriptors = 1;
-            srvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-            srvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+        throwIfFailed(device->CreateDescriptorHeap(&srvHeapDesc, IID_PPV_ARGS(&srvHeap)));
 
-            throwIfFailed(device->CreateDescriptorHeap(&srvHeapDesc, IID_PPV_ARGS(&srvHeap)));
+        rtvDescSize = device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
+        srvDescSize = device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+    }
 
-            rtvDescSize = device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
-        }
+    void PixieRenderer::createFrameBuffer() {
+        frameIndex = swapchain->GetCurrentBackBufferIndex();
 
-        // frame buffer
-        {
-            CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(rtvHeap->GetCPUDescriptorHandleForHeapStart());
+        CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(rtvHeap->GetCPUDescriptorHandleForHeapStart());
 
-            for (UINT i = 0; i < bufferCount; ++i) {
-                throwIfFailed(swapchain->GetBuffer(i, IID_PPV_ARGS(&renderTargets[i])));
-                device->CreateRenderTargetView(renderTargets[i].Get(), nullptr, rtvHandle);
-                rtvHandle.Offset(1, rtvDescSize);
-            }
+        for (UINT i = 0; i < bufferCount; ++i) {
+            throwIfFailed(swapchain->GetBuffer(i, IID_PPV_ARGS(&renderTargets[i])));
+            device->CreateRenderTargetView(renderTargets[i].Get(), nullptr, rtvHandle);
+            rtvHandle.Offset(1, rtvDescSize);
         }
     }
 
+    // frame allocators come from the recorder as it needs them, this one is only for the init uploads
     void PixieRenderer::createCMDAllocator() {
-        throwIfFailed(device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&cmdAlloc)));
+        setupContext = createContext();
     }
 
     void PixieRenderer::createRootSig() {
@@ -206,14 +326,17 @@ namespace pxe {
         if (FAILED(device->CheckFeatureSupport(D3D12_FEATURE_ROOT_SIGNATURE, &featureData, sizeof(featureData))))
             featureData.HighestVersion = D3D_ROOT_SIGNATURE_VERSION_1_0;
 
+        // the whole heap as one unbounded texture array, views get written while frames that don't use them are in flight
         CD3DX12_DESCRIPTOR_RANGE1 ranges[1] = {}; // remove braces later
-        ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0, 0, D3D12_DESCRIPTOR_RANGE_FLAG_DATA_STATIC);
+        ranges[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, UINT_MAX, 0, 0, D3D12_DESCRIPTOR_RANGE_FLAG_DESCRIPTORS_VOLATILE);
 
-        CD3DX12_ROOT_PARAMETER1 rootParameters[1] = {};
+        // texture index per draw as a root constant, b0 in the pixel shader
+        CD3DX12_ROOT_PARAMETER1 rootParameters[2] = {};
         rootParameters[0].InitAsDescriptorTable(1, &ranges[0], D3D12_SHADER_VISIBILITY_PIXEL);
+        rootParameters[1].InitAsConstants(1, 0, 0, D3D12_SHADER_VISIBILITY_PIXEL);
 
         D3D12_STATIC_SAMPLER_DESC sampler = {};
-        sampler.Filter = D3D12_FILTER_MIN_MAG_MIP_POINT;
+        sampler.Filter = D3D12_FILTER_MIN_LINEAR_MAG_POINT_MIP_LINEAR; // pixel art stays crisp up close, minified sprites blend through the mips
         sampler.AddressU = D3D12_TEXTURE_ADDRESS_MODE_BORDER;
         sampler.AddressV = D3D12_TEXTURE_ADDRESS_MODE_BORDER;
         sampler.AddressW = D3D12_TEXTURE_ADDRESS_MODE_BORDER;
@@ -237,64 +360,42 @@ namespace pxe {
         throwIfFailed(device->CreateRootSignature(0, signature->GetBufferPointer(), signature->GetBufferSize(), IID_PPV_ARGS(&rootSig)));
     }
 
-    void PixieRenderer::createPipelineState() {
-        // optionally break this into @ createShader(path, entryPoint, version)
-        {
-            wrl::ComPtr<ID3DBlob> vertexShader;
-            wrl::ComPtr<ID3DBlob> pixelShader;
-
-#if defined(_DEBUG)
-            // Enable better shader debugging with the graphics debugging tools.
-            UINT compileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
-#else
-            UINT compileFlags = 0;
-#endif
-
-            throwIfFailed(D3DCompileFromFile((L"Pixie/assets/shaders.hlsl"), nullptr, nullptr, "VSMain", "vs_5_0", compileFlags, 0, &vertexShader, nullptr));
-            throwIfFailed(D3DCompileFromFile(L"Pixie/assets/shaders.hlsl", nullptr, nullptr, "PSMain", "ps_5_0", compileFlags, 0, &pixelShader, nullptr));
-
-            D3D12_INPUT_ELEMENT_DESC inputElemDesc[] = {
-                {"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
-                {"TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0}};
-
-            D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc = {};
-            psoDesc.InputLayout = {inputElemDesc, _countof(inputElemDesc)};
-            psoDesc.pRootSignature = rootSig.Get();
-            psoDesc.VS = CD3DX12_SHADER_BYTECODE(vertexShader.Get());
-            psoDesc.PS = CD3DX12_SHADER_BYTECODE(pixelShader.Get());
-            psoDesc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
-            psoDesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
-            psoDesc.DepthStencilState.DepthEnable = FALSE;
-            psoDesc.DepthStencilState.StencilEnable = FALSE;
-            psoDesc.SampleMask = UINT_MAX;
-            psoDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
-            psoDesc.NumRenderTargets = 1;
-            psoDesc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
-            psoDesc.SampleDesc.Count = 1;
-
-            throwIfFailed(device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&pipelineState)));
-            pipelineState->SetName(L"Pipeline State Object");
-        }
-
-        // Create the command list.
-        throwIfFailed(device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, cmdAlloc.Get(), pipelineState.Get(), IID_PPV_ARGS(&cmdList)));
-        cmdList->SetName(L"Command List");
+    void PixieRenderer::createPipelineState(const PixieShaderBlob &vertexShader, const PixieShaderBlob &pixelShader) {
+        // PixieCompactVertex, the input assembler fills in z = 0 and w = 1
+        D3D12_INPUT_ELEMENT_DESC inputElemDesc[] = {
+            {"POSITION", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+            {"TEXCOORD", 0, DXGI_FORMAT_R16G16_UNORM, 0, 8, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0},
+            {"COLOR", 0, DXGI_FORMAT_R8G8B8A8_UNORM, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0}};
+
+        D3D12_GRAPHICS_PIPELINE_STATE_DESC psoDesc = {};
+        psoDesc.InputLayout = {inputElemDesc, _countof(inputElemDesc)};
+        psoDesc.pRootSignature = rootSig.Get();
+        psoDesc.VS = CD3DX12_SHADER_BYTECODE(vertexShader.data, vertexShader.size);
+        psoDesc.PS = CD3DX12_SHADER_BYTECODE(pixelShader.data, pixelShader.size);
+        psoDesc.RasterizerState = CD3DX12_RASTERIZER_DESC(D3D12_DEFAULT);
+        psoDesc.RasterizerState.CullMode = D3D12_CULL_MODE_NONE; // mirrored sprites flip their winding
+        psoDesc.BlendState = CD3DX12_BLEND_DESC(D3D12_DEFAULT);
+        psoDesc.DepthStencilState.DepthEnable = FALSE;
+        psoDesc.DepthStencilState.StencilEnable = FALSE;
+        psoDesc.SampleMask = UINT_MAX;
+        psoDesc.PrimitiveTopologyType = D3D12_PRIMITIVE_TOPOLOGY_TYPE_TRIANGLE;
+        psoDesc.NumRenderTargets = 1;
+        psoDesc.RTVFormats[0] = DXGI_FORMAT_R8G8B8A8_UNORM;
+        psoDesc.SampleDesc.Count = 1;
+
+        throwIfFailed(device->CreateGraphicsPipelineState(&psoDesc, IID_PPV_ARGS(&pipelineState)));
+        pipelineState->SetName(L"Pipeline State Object");
+    }
 
-        // Create the vertex buffer.
+    void PixieRenderer::createGeometryBuffers() {
+        // Create the sprite vertex ring, it stays mapped for the renderer's lifetime. compact vertices, so bulk sprites
+        // are expanded a cache line each straight into the upload heap
         {
             /*
 				{{0.0f, 0.25f * static_cast<FLOAT>(surfaceWidth / surfaceHeight), 0.0f}, {0.5f, 0.0f}},
 				{{0.25f, -0.25f * static_cast<FLOAT>(surfaceWidth / surfaceHeight), 0.0f}, {1.0f, 1.0f}},
 				{{-0.25f, -0.25f * static_cast<FLOAT>(surfaceWidth / surfaceHeight), 0.0f}, {0.0f, 1.0f}},
 			*/
-            PixieVertexData triangleVertices[] = {
-                {{-0.5f, 0.5f * static_cast<FLOAT>(surfaceWidth / surfaceHeight), 0.0f}, {0.5f, 0.0f}}, // top left
-                {{0.5f, -0.5f * static_cast<FLOAT>(surfaceWidth / surfaceHeight), 0.0f}, {1.0f, 1.0f}}, // bottom right
-                {{-0.5f, -0.5f * static_cast<FLOAT>(surfaceWidth / surfaceHeight), 0.0f}, {0.0f, 1.0f}}, // bottom left
-                {{0.5f, 0.5f * static_cast<FLOAT>(surfaceWidth / surfaceHeight), 0.0f}, {0.5f, 0.0f}} // top right
-            };
-
-            //const UINT vertexBufferSize = sizeof(triangleVertices);
             /*
 			auto uploadProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
 			auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(sizeof(triangleVertices));
@@ -347,20 +448,59 @@ namespace pxe {
 			indexBufferView.Format = DXGI_FORMAT_R32_UINT;
 			indexBufferView.SizeInBytes = sizeof(quadIndices);
 			*/
+
+            const UINT vertexBufferSize = maxSprites * 4 * sizeof(PixieCompactVertex);
+
+            auto uploadProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
+            auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(vertexBufferSize);
+
+            throwIfFailed(device->CreateCommittedResource(&uploadProps, D3D12_HEAP_FLAG_NONE, &bufferDesc, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&vertexBuffer)));
+            vertexBuffer->SetName(L"Sprite Vertex Ring");
+
+            CD3DX12_RANGE readRange(0, 0); // the cpu never reads it back
+            throwIfFailed(vertexBuffer->Map(0, &readRange, reinterpret_cast<void **>(&vertexBufferData)));
+            sprites.setRing(vertexBufferData, maxSprites * 4);
+
+            vertexBufferView.BufferLocation = vertexBuffer->GetGPUVirtualAddress();
+            vertexBufferView.StrideInBytes = sizeof(PixieCompactVertex);
+            vertexBufferView.SizeInBytes = vertexBufferSize;
+        }
+
+        // Create the quad index buffer, every run draws from index 0 with its own base vertex
+        {
+            const UINT indexCount = PixieSpriteBatch::maxQuadsPerRun * PixieSpriteBatch::indicesPerQuad;
+            const UINT indexBufferSize = indexCount * sizeof(UINT16);
+
+            auto uploadProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
+            auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(indexBufferSize);
+
+            throwIfFailed(device->CreateCommittedResource(&uploadProps, D3D12_HEAP_FLAG_NONE, &bufferDesc, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&indexBuffer)));
+            indexBuffer->SetName(L"Quad Index Buffer");
+
+            UINT16 *indexData = nullptr;
+            CD3DX12_RANGE readRange(0, 0);
+            throwIfFailed(indexBuffer->Map(0, &readRange, reinterpret_cast<void **>(&indexData)));
+            PixieSpriteBatch::writeQuadIndices(indexData, PixieSpriteBatch::maxQuadsPerRun);
+            indexBuffer->Unmap(0, nullptr);
+
+            indexBufferView.BufferLocation = indexBuffer->GetGPUVirtualAddress();
+            indexBufferView.Format = DXGI_FORMAT_R16_UINT;
+            indexBufferView.SizeInBytes = indexBufferSize;
         }
+    }
 
+    // test texture and placeholder, their copies wait in the staging rings for submitSetup
+    void PixieRenderer::createTextures(const PixieInitTexture &image) {
         // Create the texture.
         {
-            // Load the test image
-            SDL_Surface *surf = IMG_Load("Pixie/assets/icon.png");
-            int textureWidth = surf->w;
-            int textureHeight = surf->h;
+            const PixieTextureFile *cooked = image.cooked.get();
+            const UINT16 mipLevels = cooked ? static_cast<UINT16>(cooked->layout().mips.size()) : static_cast<UINT16>(image.mips.size() + 1);
 
             D3D12_RESOURCE_DESC textureDesc = {};
-            textureDesc.MipLevels = 1;
-            textureDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-            textureDesc.Width = textureWidth;
-            textureDesc.Height = textureHeight;
+            textureDesc.MipLevels = mipLevels;
+            textureDesc.Format = cooked ? static_cast<DXGI_FORMAT>(cooked->layout().format) : DXGI_FORMAT_R8G8B8A8_UNORM;
+            textureDesc.Width = image.width;
+            textureDesc.Height = image.height;
             textureDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
             textureDesc.DepthOrArraySize = 1;
             textureDesc.SampleDesc.Count = 1;
@@ -372,44 +512,59 @@ namespace pxe {
             throwIfFailed(device->CreateCommittedResource(&textureProps, D3D12_HEAP_FLAG_NONE, &textureDesc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&texture)));
             texture->SetName(L"Texture Resource Heap");
 
-            const UINT64 uploadBufferSize = GetRequiredIntermediateSize(texture.Get(), 0, 1);
-
-            // Create the GPU upload buffer.
-            auto uploadProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
-            auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(uploadBufferSize);
+            // rows go straight into a staging ring, submitSetup records the copy
+            if (cooked) {
+                uploadTextureFile(texture.Get(), *cooked);
+            } else {
+                uploadTexture(texture.Get(), reinterpret_cast<const UINT8 *>(image.texels.data()), image.width, image.height, image.width * texturePixelSize);
+                for (UINT mip = 1; mip < mipLevels; ++mip) {
+                    const PixieMipLevel &level = image.mips[mip - 1];
+                    uploadTexture(texture.Get(), reinterpret_cast<const UINT8 *>(level.texels.data()), level.width, level.height, level.width * texturePixelSize, mip);
+                }
+            }
 
-            throwIfFailed(device->CreateCommittedResource(&uploadProps, D3D12_HEAP_FLAG_NONE, &bufferDesc, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&textureUploadHeap)));
-            textureUploadHeap->SetName(L"Texture Upload Resource Heap");
+            // Describe and create a SRV for the texture.
+            D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+            srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+            srvDesc.Format = textureDesc.Format;
+            srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+            srvDesc.Texture2D.MipLevels = mipLevels;
+            textureView = descriptors.allocate();
+            device->CreateShaderResourceView(texture.Get(), &srvDesc, CD3DX12_CPU_DESCRIPTOR_HANDLE(srvHeap->GetCPUDescriptorHandleForHeapStart(), descriptors.index(textureView), srvDescSize));
+        }
 
-            // copy the pitch and yaw to upload heap and push that data into Texture2D
-            std::vector<UINT8> textureBytes;
-            textureBytes.resize(static_cast<size_t>(textureWidth) * static_cast<size_t>(textureHeight) * texturePixelSize);
-            std::memcpy(textureBytes.data(), surf->pixels, textureBytes.size());
+        // grey checker that streamed textures draw with until they're resident
+        {
+            const UINT32 texels[4] = {0xff808080, 0xff404040, 0xff404040, 0xff808080};
 
-            SDL_FreeSurface(surf);
+            auto textureDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8G8B8A8_UNORM, 2, 2, 1, 1);
+            auto textureProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
 
-            D3D12_SUBRESOURCE_DATA textureData = {};
-            textureData.pData = &textureBytes[0];
-            textureData.RowPitch = textureWidth * texturePixelSize;
-            textureData.SlicePitch = textureData.RowPitch * textureHeight;
+            throwIfFailed(device->CreateCommittedResource(&textureProps, D3D12_HEAP_FLAG_NONE, &textureDesc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&placeholder)));
+            placeholder->SetName(L"Placeholder Texture");
 
-            UpdateSubresources(cmdList.Get(), texture.Get(), textureUploadHeap.Get(), 0, 0, 1, &textureData);
-            auto resBarrier = CD3DX12_RESOURCE_BARRIER::Transition(texture.Get(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
-            cmdList->ResourceBarrier(1, &resBarrier);
+            uploadTexture(placeholder.Get(), reinterpret_cast<const UINT8 *>(texels), 2, 2, 2 * texturePixelSize);
 
-            // Describe and create a SRV for the texture.
             D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
             srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-            srvDesc.Format = textureDesc.Format;
+            srvDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
             srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
             srvDesc.Texture2D.MipLevels = 1;
-            device->CreateShaderResourceView(texture.Get(), &srvDesc, srvHeap->GetCPUDescriptorHandleForHeapStart());
+            placeholderView = descriptors.allocate();
+            device->CreateShaderResourceView(placeholder.Get(), &srvDesc, CD3DX12_CPU_DESCRIPTOR_HANDLE(srvHeap->GetCPUDescriptorHandleForHeapStart(), descriptors.index(placeholderView), srvDescSize));
         }
+    }
+
+    // Close the setup command list and execute it to set gpu initial state
+    void PixieRenderer::submitSetup() {
+        // no pipeline state, the list only copies, so the pso can still be compiling
+        ID3D12GraphicsCommandList *cmdList = recordContexts[setupContext].list.Get();
+        throwIfFailed(cmdList->Reset(recordContexts[setupContext].allocator.Get(), nullptr));
 
-        // Close the command list and execute it to set gpu initial state
+        recordUploads(cmdList);
         throwIfFailed(cmdList->Close());
 
-        ID3D12CommandList *ppCommandLists[] = {cmdList.Get()};
+        ID3D12CommandList *ppCommandLists[] = {cmdList};
         cmdQueue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
     }
 
@@ -422,73 +577,433 @@ namespace pxe {
         if (fenceEvent == nullptr)
             throwIfFailed(HRESULT_FROM_WIN32(GetLastError()));
 
+        // the init command list carried the first uploads
+        submitUploads(signal());
         awaitFence();
+        retireUploads();
+    }
+
+    void PixieRenderer::createTimestampQueries() {
+        throwIfFailed(cmdQueue->GetTimestampFrequency(&timestampFrequency));
+
+        D3D12_QUERY_HEAP_DESC queryHeapDesc = {};
+        queryHeapDesc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+        queryHeapDesc.Count = PixieGpuProfiler::queriesPerSlot * bufferCount;
+        throwIfFailed(device->CreateQueryHeap(&queryHeapDesc, IID_PPV_ARGS(&timestampHeap)));
+
+        auto readbackProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK);
+        auto readbackDesc = CD3DX12_RESOURCE_DESC::Buffer(sizeof(UINT64) * queryHeapDesc.Count);
+        throwIfFailed(device->CreateCommittedResource(&readbackProps, D3D12_HEAP_FLAG_NONE, &readbackDesc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&timestampReadback)));
+        timestampReadback->SetName(L"Timestamp Readback");
+
+        // only ever read a slot after its fence, so the buffer can stay mapped
+        void *data = nullptr;
+        throwIfFailed(timestampReadback->Map(0, nullptr, &data));
+        timestampData = static_cast<const UINT64 *>(data);
     }
 
+    // full cpu/gpu sync, only for init and teardown, frames go through the frame ring
     void PixieRenderer::awaitFence() {
-        const UINT64 fence = fenceVal;
+        waitFor(signal());
+
+        frameIndex = swapchain->GetCurrentBackBufferIndex();
+    }
+
+    UINT64 PixieRenderer::signal() {
+        const UINT64 value = fenceVal;
 
-        throwIfFailed(cmdQueue->Signal(this->fence.Get(), fence));
+        throwIfFailed(cmdQueue->Signal(fence.Get(), value));
 
         fenceVal++;
 
-        // Wait until the prev frame is finished
-        if (this->fence->GetCompletedValue() < fence) {
-            throwIfFailed(this->fence->SetEventOnCompletion(fence, fenceEvent));
+        return value;
+    }
+
+    UINT64 PixieRenderer::completedValue() {
+        return fence->GetCompletedValue();
+    }
+
+    void PixieRenderer::waitFor(UINT64 value) {
+        if (fence->GetCompletedValue() < value) {
+            PIXIE_ZONE("PixieRenderer::waitFor");
+            throwIfFailed(fence->SetEventOnCompletion(value, fenceEvent));
 
             WaitForSingleObject(fenceEvent, INFINITE);
         }
+    }
 
-        frameIndex = swapchain->GetCurrentBackBufferIndex();
+    UINT8 *PixieRenderer::createStagingRing(UINT64 size) {
+        wrl::ComPtr<ID3D12Resource> ring;
+
+        auto uploadProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
+        auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(size);
+
+        throwIfFailed(device->CreateCommittedResource(&uploadProps, D3D12_HEAP_FLAG_NONE, &bufferDesc, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&ring)));
+        ring->SetName(L"Staging Ring");
+
+        UINT8 *data = nullptr;
+        CD3DX12_RANGE readRange(0, 0);
+        throwIfFailed(ring->Map(0, &readRange, reinterpret_cast<void **>(&data)));
+
+        stagingRings.push_back(ring);
+        return data;
     }
 
-    void PixieRenderer::handleCommands(FLOAT *color) {
-        throwIfFailed(cmdAlloc->Reset());
+    // staging memory for one upload, from a ring when it fits and a dedicated buffer otherwise
+    UINT8 *PixieRenderer::acquireStaging(UINT64 size, ID3D12Resource *&source, UINT64 &offset) {
+        const bool fitsRing = size <= uploads.ringSize();
 
-        throwIfFailed(cmdList->Reset(cmdAlloc.Get(), pipelineState.Get()));
+        PixieUploadRegion region;
+        bool allocated = fitsRing && uploads.allocate(size, PixieUploadAllocator::placementAlignment, region);
 
-        cmdList->SetGraphicsRootSignature(rootSig.Get());
+        // let older submissions hand their staging memory back before giving up on the rings
+        while (!allocated && fitsRing && uploads.oldestPendingFence() != 0) {
+            waitFor(uploads.oldestPendingFence());
+            uploads.retire(completedValue());
+            allocated = uploads.allocate(size, PixieUploadAllocator::placementAlignment, region);
+        }
 
-        ID3D12DescriptorHeap *ppHeaps[] = {srvHeap.Get()};
-        cmdList->SetDescriptorHeaps(_countof(ppHeaps), ppHeaps);
+        if (allocated) {
+            source = stagingRings[region.ring].Get();
+            offset = region.offset;
+            return region.data;
+        }
 
-        cmdList->SetGraphicsRootDescriptorTable(0, srvHeap->GetGPUDescriptorHandleForHeapStart());
-        cmdList->RSSetViewports(1, &viewport);
-        cmdList->RSSetScissorRects(1, &scissor);
+        // too big for a ring, or the rings are full of copies that haven't been submitted yet
+        wrl::ComPtr<ID3D12Resource> dedicated;
 
-        // Set back buffer as render target
-        auto targetBarrier = CD3DX12_RESOURCE_BARRIER::Transition(renderTargets[frameIndex].Get(), D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET);
-        cmdList->ResourceBarrier(1, &targetBarrier);
+        auto uploadProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD);
+        auto bufferDesc = CD3DX12_RESOURCE_DESC::Buffer(size);
 
-        CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(rtvHeap->GetCPUDescriptorHandleForHeapStart(), frameIndex, rtvDescSize);
-        cmdList->OMSetRenderTargets(1, &rtvHandle, FALSE, nullptr);
+        throwIfFailed(device->CreateCommittedResource(&uploadProps, D3D12_HEAP_FLAG_NONE, &bufferDesc, D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS(&dedicated)));
+        dedicated->SetName(L"Dedicated Upload");
 
-        // Record commands
-        cmdList->ClearRenderTargetView(rtvHandle, color, 0, nullptr);
-        cmdList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
-        cmdList->IASetVertexBuffers(0, 1, &vertexBufferView);
-        //cmdList->DrawInstanced(3, 1, 0, 0);
-        cmdList->IASetIndexBuffer(&indexBufferView);
-        cmdList->DrawIndexedInstanced(6, 1, 0, 0, 0);
+        UINT8 *staging = nullptr;
+        CD3DX12_RANGE readRange(0, 0);
+        throwIfFailed(dedicated->Map(0, &readRange, reinterpret_cast<void **>(&staging)));
 
-        // Present back buffer
-        auto presentBarrier = CD3DX12_RESOURCE_BARRIER::Transition(renderTargets[frameIndex].Get(), D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT);
-        cmdList->ResourceBarrier(1, &presentBarrier);
+        source = dedicated.Get();
+        offset = 0;
+        dedicatedUploads.emplace_back(UINT64_MAX, dedicated);
+        return staging;
+    }
 
-        throwIfFailed(cmdList->Close());
+    void PixieRenderer::uploadTexture(ID3D12Resource *destination, const UINT8 *pixels, UINT width, UINT height, UINT sourcePitch, UINT subresource) {
+        const UINT rowPitch = PixieUploadAllocator::rowPitch(width, texturePixelSize);
+
+        PendingUpload upload = {};
+        upload.destination = destination;
+        upload.subresource = subresource;
+        // the footprint has to name the resource's own format, streamed textures can be srgb
+        upload.footprint.Footprint = {destination->GetDesc().Format, width, height, 1, rowPitch};
+
+        UINT8 *staging = acquireStaging(PixieUploadAllocator::textureSize(width, height, texturePixelSize), upload.source, upload.footprint.Offset);
+
+        for (UINT y = 0; y < height; ++y)
+            std::memcpy(staging + static_cast<UINT64>(y) * rowPitch, pixels + static_cast<UINT64>(y) * sourcePitch, static_cast<size_t>(width) * texturePixelSize);
+
+        pendingUploads.push_back(upload);
+    }
+
+    // the cooked file is already in footprint layout, so the whole mip chain is one memcpy
+    void PixieRenderer::uploadTextureFile(ID3D12Resource *destination, const PixieTextureFile &file) {
+        const PixieTextureLayout &layout = file.layout();
+
+        ID3D12Resource *source = nullptr;
+        UINT64 offset = 0;
+        UINT8 *staging = acquireStaging(layout.dataSize, source, offset);
+
+        std::memcpy(staging, file.data(), layout.dataSize);
+
+        for (UINT mip = 0; mip < layout.mips.size(); ++mip) {
+            const PixieTextureMip &level = layout.mips[mip];
+
+            PendingUpload upload = {};
+            upload.destination = destination;
+            upload.source = source;
+            upload.subresource = mip;
+            upload.footprint.Offset = offset + level.offset;
+            upload.footprint.Footprint = {static_cast<DXGI_FORMAT>(layout.format), level.width, level.height, 1, level.rowPitch};
+
+            pendingUploads.push_back(upload);
+        }
+    }
+
+    // every queued copy goes into the open command list with a single barrier batch
+    void PixieRenderer::recordUploads(ID3D12GraphicsCommandList *cmdList) {
+        if (pendingUploads.empty())
+            return;
+
+        PIXIE_ZONE("PixieRenderer::recordUploads");
+
+        // runs inside a recording job, so off the job thread's scratch rather than the frame arena
+        PixieScratchScope scratch;
+        PixieArenaVector<D3D12_RESOURCE_BARRIER> barriers {PixieArenaAllocator<D3D12_RESOURCE_BARRIER>(scratch.arena())};
+        barriers.reserve(pendingUploads.size());
+
+        for (const auto &upload : pendingUploads) {
+            CD3DX12_TEXTURE_COPY_LOCATION dst(upload.destination, upload.subresource);
+            CD3DX12_TEXTURE_COPY_LOCATION src(upload.source, upload.footprint);
+            cmdList->CopyTextureRegion(&dst, 0, 0, 0, &src, nullptr);
+
+            barriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(upload.destination, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, upload.subresource));
+        }
+
+        cmdList->ResourceBarrier(static_cast<UINT>(barriers.size()), barriers.data());
+        pendingUploads.clear();
+    }
+
+    void PixieRenderer::submitUploads(UINT64 fence) {
+        PIXIE_ZONE("PixieRenderer::submitUploads");
+
+        uploads.submit(fence);
+
+        for (auto &dedicated : dedicatedUploads) {
+            if (dedicated.first == UINT64_MAX)
+                dedicated.first = fence;
+        }
+    }
+
+    void PixieRenderer::retireUploads() {
+        const UINT64 completed = completedValue();
+
+        uploads.retire(completed);
+        std::erase_if(dedicatedUploads, [completed](const auto &dedicated) { return dedicated.first <= completed; });
+    }
+
+    void PixieRenderer::handleCommands(ID3D12GraphicsCommandList *list) {
+        PIXIE_ZONE("PixieRenderer::handleCommands");
+
+        list->SetGraphicsRootSignature(rootSig.Get());
+
+        ID3D12DescriptorHeap *ppHeaps[] = {srvHeap.Get()};
+        list->SetDescriptorHeaps(_countof(ppHeaps), ppHeaps);
+        list->SetGraphicsRootDescriptorTable(0, srvHeap->GetGPUDescriptorHandleForHeapStart());
+
+        list->RSSetViewports(1, &viewport);
+        list->RSSetScissorRects(1, &scissor);
+
+        CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(rtvHeap->GetCPUDescriptorHandleForHeapStart(), frameIndex, rtvDescSize);
+        list->OMSetRenderTargets(1, &rtvHandle, FALSE, nullptr);
+
+        list->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+        list->IASetVertexBuffers(0, 1, &vertexBufferView);
+        list->IASetIndexBuffer(&indexBufferView);
     }
 
     void PixieRenderer::beginFrame(FLOAT *color) {
-        handleCommands(color);
+        PIXIE_ZONE("PixieRenderer::beginFrame");
+
+        // only blocks when the gpu is still on the frame that last used this slot
+        frameSlot = frames.beginFrame();
+        frameMemory.beginFrame(frameSlot);
+        frameIndex = swapchain->GetCurrentBackBufferIndex();
+        gpuProfiler.beginFrame(frameSlot, timestampData + gpuProfiler.firstQuery(frameSlot));
+
+        // that frame and every one before it are done, their sprite vertices, staging memory and allocators can be reused
+        sprites.release(spriteMarkers[frameSlot]);
+        retireUploads();
+        descriptors.retire(completedValue());
+        recorder.beginFrame(frameSlot);
+
+        // finished decodes queue their copies for this frame's command lists
+        {
+            PIXIE_ZONE("PixieTextureStreamer::update");
+            streamer->update();
+        }
+
+        std::copy(color, color + 4, clearColor);
+        sprites.begin(static_cast<float>(surfaceWidth), static_cast<float>(surfaceHeight));
+    }
+
+    bool PixieRenderer::drawSprite(UINT texture, const PixieRect &rect, const PixieRect &uv, UINT32 color, const PixieTransform2D &transform, UINT layer, float depth) {
+        return sprites.drawSprite(texture, rect, uv, color, transform, 0, layer, depth);
+    }
+
+    bool PixieRenderer::drawSprites(UINT texture, const PixieSpriteArrays &sprites, const PixieTransformHierarchy *transforms, UINT layer, float depth) {
+        return this->sprites.drawSprites(texture, sprites, transforms, 0, layer, depth);
     }
 
+    PixieTextureHandle PixieRenderer::streamTexture(const std::string &path, int priority) {
+        const PixieTextureHandle handle = streamer->registerTexture(path);
+        streamer->request(handle, priority);
+        return handle;
+    }
+
+    UINT PixieRenderer::textureSlot(PixieTextureHandle handle) {
+        return descriptors.index(streamer->resolve(handle) ? streamedViews[handle] : placeholderView);
+    }
+
+    void PixieRenderer::makeResident(PixieTextureHandle handle, const PixieDecodedTexture &texture) {
+        wrl::ComPtr<ID3D12Resource> &resource = streamedTextures[handle];
+        const std::vector<PixieMipLevel> &levels = texture.levels;
+
+        // cooked srgb textures stream in as srgb, the same as when createTextures loads them up front
+        auto textureDesc = CD3DX12_RESOURCE_DESC::Tex2D(static_cast<DXGI_FORMAT>(texture.format), levels[0].width, levels[0].height, 1, static_cast<UINT16>(levels.size()));
+        auto textureProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_DEFAULT);
+
+        throwIfFailed(device->CreateCommittedResource(&textureProps, D3D12_HEAP_FLAG_NONE, &textureDesc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&resource)));
+        resource->SetName(L"Streamed Texture");
+
+        for (UINT mip = 0; mip < levels.size(); ++mip)
+            uploadTexture(resource.Get(), reinterpret_cast<const UINT8 *>(levels[mip].texels.data()), levels[mip].width, levels[mip].height, levels[mip].width * texturePixelSize, mip);
+
+        D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+        srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+        srvDesc.Format = textureDesc.Format;
+        srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+        srvDesc.Texture2D.MipLevels = static_cast<UINT>(levels.size());
+        streamedViews[handle] = descriptors.allocate();
+        if (streamedViews[handle] == invalidDescriptor)
+            throw std::runtime_error("PixieRenderer: out of persistent descriptors");
+        device->CreateShaderResourceView(resource.Get(), &srvDesc, CD3DX12_CPU_DESCRIPTOR_HANDLE(srvHeap->GetCPUDescriptorHandleForHeapStart(), descriptors.index(streamedViews[handle]), srvDescSize));
+    }
+
+    // the streamer only evicts textures no frame in flight has used, so the resource and its view can go right away
+    void PixieRenderer::evict(PixieTextureHandle handle) {
+        streamedTextures[handle].Reset();
+        descriptors.free(streamedViews[handle]);
+        streamedViews[handle] = invalidDescriptor;
+    }
+
+    UINT PixieRenderer::createTransientView(ID3D12Resource *resource, const D3D12_SHADER_RESOURCE_VIEW_DESC &desc) {
+        UINT index = 0;
+        if (!descriptors.allocateTransient(1, index))
+            throw std::runtime_error("PixieRenderer: transient descriptor ring is full");
+
+        device->CreateShaderResourceView(resource, &desc, CD3DX12_CPU_DESCRIPTOR_HANDLE(srvHeap->GetCPUDescriptorHandleForHeapStart(), index, srvDescSize));
+        return index;
+    }
+
+    // sprite runs going into one recording context
+    class PixieListSink final : public PixieBatchSink {
+    public:
+        explicit PixieListSink(ID3D12GraphicsCommandList *list)
+            : list(list) {
+        }
+
+        // textures are heap indices, the shader picks the view out of the bindless table
+        void setTexture(uint32_t texture) override {
+            list->SetGraphicsRoot32BitConstant(1, texture, 0);
+        }
+
+        void drawQuads(const PixieDrawRun &run) override {
+            list->DrawIndexedInstanced(run.quadCount * PixieSpriteBatch::indicesPerQuad, 1, 0, run.firstVertex, 0);
+        }
+
+    private:
+        ID3D12GraphicsCommandList *list;
+    };
+
     void PixieRenderer::endFrame() {
-        ID3D12CommandList *cmdBuffer[] = {cmdList.Get()};
-        (*cmdBuffer)->SetName(L"command list buffer");
+        PIXIE_ZONE("PixieRenderer::endFrame");
 
-        cmdQueue->ExecuteCommandLists(_countof(cmdBuffer), cmdBuffer);
+        const size_t runCount = sprites.prepare();
 
-        swapchain->Present(1, 0);
-        awaitFence();
+        // copies land ahead of the draws that sample them, then the back buffer becomes a render target
+        recorder.record([this](uint32_t context, size_t, size_t) {
+            ID3D12GraphicsCommandList *list = recordContexts[context].list.Get();
+            const uint32_t zone = gpuProfiler.beginZone(context, "uploads + clear");
+            recordUploads(list);
+
+            auto targetBarrier = CD3DX12_RESOURCE_BARRIER::Transition(renderTargets[frameIndex].Get(), D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET);
+            list->ResourceBarrier(1, &targetBarrier);
+
+            CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(rtvHeap->GetCPUDescriptorHandleForHeapStart(), frameIndex, rtvDescSize);
+            list->ClearRenderTargetView(rtvHandle, clearColor, 0, nullptr);
+            gpuProfiler.endZone(context, zone);
+        });
+
+        // sprite runs in key order, spread over as many lists as there are threads to fill them
+        recorder.record(runCount, minRunsPerJob, [this](uint32_t context, size_t begin, size_t end) {
+            const uint32_t zone = gpuProfiler.beginZone(context, "sprites");
+            PixieListSink sink(recordContexts[context].list.Get());
+            sprites.record(sink, begin, end - begin);
+            gpuProfiler.endZone(context, zone);
+        });
+
+        recorder.record([this](uint32_t context, size_t, size_t) {
+            auto presentBarrier = CD3DX12_RESOURCE_BARRIER::Transition(renderTargets[frameIndex].Get(), D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT);
+            recordContexts[context].list->ResourceBarrier(1, &presentBarrier);
+        });
+
+        recorder.submit();
+
+        {
+            PIXIE_ZONE("Present");
+            swapchain->Present(1, 0);
+        }
+
+        spriteMarkers[frameSlot] = sprites.frameMarker();
+
+        const UINT64 frameFence = frames.endFrame();
+        submitUploads(frameFence);
+        descriptors.submit(frameFence);
+
+        if (PixieProfiler::enabled())
+            PixieProfiler::collect();
+    }
+
+    uint32_t PixieRenderer::createContext() {
+        RecordContext context;
+        throwIfFailed(device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT, IID_PPV_ARGS(&context.allocator)));
+        throwIfFailed(device->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, context.allocator.Get(), nullptr, IID_PPV_ARGS(&context.list)));
+        context.list->SetName(L"Command List");
+
+        // lists are born open, every use starts from openContext
+        throwIfFailed(context.list->Close());
+
+        recordContexts.push_back(std::move(context));
+        return static_cast<uint32_t>(recordContexts.size() - 1);
+    }
+
+    void PixieRenderer::openContext(uint32_t context) {
+        RecordContext &record = recordContexts[context];
+        throwIfFailed(record.allocator->Reset());
+        throwIfFailed(record.list->Reset(record.allocator.Get(), pipelineState.Get()));
+        handleCommands(record.list.Get());
+    }
+
+    void PixieRenderer::closeContext(uint32_t context) {
+        throwIfFailed(recordContexts[context].list->Close());
+    }
+
+    void PixieRenderer::submitContexts(const uint32_t *contexts, size_t count) {
+        PixieArenaVector<ID3D12CommandList *> lists {PixieArenaAllocator<ID3D12CommandList *>(frameMemory.arena())};
+        lists.reserve(count + 1);
+        for (size_t i = 0; i < count; ++i)
+            lists.push_back(recordContexts[contexts[i]].list.Get());
+
+        // every recording job is done, so the zone count is final and one more list can resolve them after the rest
+        const uint32_t queries = gpuProfiler.queriesUsed();
+        if (queries != 0) {
+            if (resolveContexts[frameSlot] == UINT32_MAX)
+                resolveContexts[frameSlot] = createContext();
+
+            const uint32_t resolve = resolveContexts[frameSlot];
+            const uint32_t first = gpuProfiler.firstQuery(frameSlot);
+            openContext(resolve);
+            recordContexts[resolve].list->ResolveQueryData(timestampHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, first, queries, timestampReadback.Get(), sizeof(UINT64) * first);
+            closeContext(resolve);
+            lists.push_back(recordContexts[resolve].list.Get());
+        }
+
+        cmdQueue->ExecuteCommandLists(static_cast<UINT>(lists.size()), lists.data());
+    }
+
+    void PixieRenderer::writeTimestamp(uint32_t context, uint32_t query) {
+        recordContexts[context].list->EndQuery(timestampHeap.Get(), D3D12_QUERY_TYPE_TIMESTAMP, query);
+    }
+
+    // the profiler clock is steady_clock, which is the performance counter in nanoseconds on windows
+    void PixieRenderer::calibrateTimestamps(uint64_t &gpuTick, uint64_t &cpuNs, uint64_t &ticksPerSecond) {
+        UINT64 cpuTick = 0;
+        throwIfFailed(cmdQueue->GetClockCalibration(&gpuTick, &cpuTick));
+
+        LARGE_INTEGER frequency = {};
+        QueryPerformanceFrequency(&frequency);
+        const UINT64 counterRate = static_cast<UINT64>(frequency.QuadPart);
+        cpuNs = cpuTick / counterRate * 1000000000ull + cpuTick % counterRate * 1000000000ull / counterRate;
+        ticksPerSecond = timestampFrequency;
     }
 } // namespace pxe
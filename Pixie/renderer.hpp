@@ -8,80 +8,187 @@
 #include <d3d12.h>
 #include <dxgi1_6.h>
 #include <DirectXMath.h>
+#include <memory>
+#include <vector>
 #include "ext/d3dx12.h"
+#include "allocators.hpp"
+#include "descriptors.hpp"
+#include "framering.hpp"
+#include "profiler.hpp"
+#include "mipgen.hpp"
+#include "recorder.hpp"
+#include "shadercache.hpp"
+#include "spritebatch.hpp"
+#include "texturefile.hpp"
+#include "texturestream.hpp"
+#include "upload.hpp"
 #include "utils.hpp"
+#include "vertex.hpp"
 
 using namespace DirectX;
 namespace wrl = Microsoft::WRL;
 
 namespace pxe {
-	struct PixieVertexShader {
-		XMFLOAT4X4 modelMatrix;
-		XMFLOAT4X4 projectionMatrix;
-		XMFLOAT4X4 viewMatrix;
-	};
-	
-	struct PixieVertexData {
-		XMFLOAT3 position;
-		XMFLOAT2 uv;
+	// the test texture as it comes off disk, decoded while the device is still being made
+	struct PixieInitTexture {
+		std::unique_ptr<PixieTextureFile> cooked; // maps straight into staging when there is one
+		UINT width;
+		UINT height;
+		std::vector<UINT32> texels;
+		std::vector<PixieMipLevel> mips;
 	};
 
 	// create a basic renderer
-	class PixieRenderer {
+	class PixieRenderer final : public PixieFenceQueue, public PixieStreamSink, public PixieRecordBackend, public PixieTimestampBackend {
 	public:
-		PixieRenderer(SDL_Window *window, UINT width, UINT height);
+		PixieRenderer(SDL_Window *window, UINT width, UINT height, UINT framesInFlight = 2);
 		~PixieRenderer();
 
 		void loadPipeline();
 		void createDevice();
 		void createCMDQueue();
 		void createSwapchain();
-		void createFrameBuffer(); // descriptor heap
+		void createDescriptorHeaps();
+		void createFrameBuffer();
 		void createCMDAllocator();
 		void createRootSig();
-		void createPipelineState();
+		void createPipelineState(const PixieShaderBlob &vertexShader, const PixieShaderBlob &pixelShader);
+		void createGeometryBuffers();
+		void createTextures(const PixieInitTexture &image);
+		void submitSetup();
 		void createSyncStructure();
+		void createTimestampQueries();
 		void awaitFence();
-		void handleCommands(FLOAT *color);
+		UINT64 signal() override;
+		UINT64 completedValue() override;
+		void waitFor(UINT64 value) override;
+		void uploadTexture(ID3D12Resource *destination, const UINT8 *pixels, UINT width, UINT height, UINT sourcePitch, UINT subresource = 0);
+		void uploadTextureFile(ID3D12Resource *destination, const PixieTextureFile &file);
+		void recordUploads(ID3D12GraphicsCommandList *list);
+		void submitUploads(UINT64 fence);
+		void retireUploads();
+		void handleCommands(ID3D12GraphicsCommandList *list); // state every recording context starts with
 		void beginFrame(FLOAT *color);
+		// sprites in one layer may be reordered to group textures, lower depth draws first
+		bool drawSprite(UINT texture, const PixieRect &rect, const PixieRect &uv, UINT32 color, const PixieTransform2D &transform, UINT layer = 0, float depth = 0.0f);
+		// whole arrays expanded by the simd kernels, both have to stay alive until endFrame
+		bool drawSprites(UINT texture, const PixieSpriteArrays &sprites, const PixieTransformHierarchy *transforms = nullptr, UINT layer = 0, float depth = 0.0f);
 		void endFrame();
 
+		// recording contexts for the command recorder, every one gets its own allocator and list
+		uint32_t createContext() override;
+		void openContext(uint32_t context) override;
+		void closeContext(uint32_t context) override;
+		void submitContexts(const uint32_t *contexts, size_t count) override;
+		const PixieRecordStats &recordStats() const { return recorder.stats(); }
+
+		// gpu zones land on the profiler's gpu track a few frames late, once their frame has retired
+		void writeTimestamp(uint32_t context, uint32_t query) override;
+		void calibrateTimestamps(uint64_t &gpuTick, uint64_t &cpuNs, uint64_t &ticksPerSecond) override;
+
+		// descriptor index for drawSprite that stays valid until this frame's fence completes
+		UINT createTransientView(ID3D12Resource *resource, const D3D12_SHADER_RESOURCE_VIEW_DESC &desc);
+		PixieDescriptorStats descriptorStats() const { return descriptors.stats(); }
+
+		// streamed textures draw with the placeholder until they're resident, textureSlot goes to drawSprite every frame
+		PixieTextureHandle streamTexture(const std::string &path, int priority = 0);
+		UINT textureSlot(PixieTextureHandle handle);
+		void makeResident(PixieTextureHandle handle, const PixieDecodedTexture &texture) override;
+		void evict(PixieTextureHandle handle) override;
+		PixieStreamStats streamStats() const { return streamer->stats(); }
+
+		const PixieUploadStats &uploadStats() const { return uploads.stats(); }
+		PixieArenaStats frameMemoryStats() const { return frameMemory.stats(); }
 
 	private:
 		HWND hwnd;
 		UINT surfaceWidth;
 		UINT surfaceHeight;
 
-		static const UINT bufferCount = 2;
+		static const UINT bufferCount = PixieFrameRing::maxFramesInFlight;
 		static const UINT texturePixelSize = 4; // 4 components = RGBA
+		static const UINT maxSprites = 131072; // vertex ring capacity in quads
+		static const UINT64 stagingRingSize = 32 * 1024 * 1024;
+		static const UINT maxStagingRings = 4;
+		static const UINT persistentDescriptors = 65536; // texture views, shaders index the whole heap
+		static const UINT transientDescriptors = 16384; // views that only live for a frame
+		static const UINT maxStreamedTextures = 1024;
+		static const size_t minRunsPerJob = 64; // below this a job costs more in list overhead than it records
+
+		struct RecordContext {
+			wrl::ComPtr<ID3D12CommandAllocator> allocator;
+			wrl::ComPtr<ID3D12GraphicsCommandList> list;
+		};
+
+		struct PendingUpload {
+			ID3D12Resource *destination;
+			ID3D12Resource *source;
+			UINT subresource;
+			D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint;
+		};
+
+		UINT8 *createStagingRing(UINT64 size);
+		UINT8 *acquireStaging(UINT64 size, ID3D12Resource *&source, UINT64 &offset);
 		
 		// pipeline
 		wrl::ComPtr<IDXGIFactory7> factory;
 		wrl::ComPtr<ID3D12Device> device;
 		wrl::ComPtr<ID3D12CommandQueue> cmdQueue;
-		wrl::ComPtr<ID3D12CommandAllocator> cmdAlloc;
 		wrl::ComPtr<ID3D12RootSignature> rootSig;
 		wrl::ComPtr<ID3D12PipelineState> pipelineState;
-		wrl::ComPtr<ID3D12GraphicsCommandList> cmdList;
 		CD3DX12_VIEWPORT viewport;
 		CD3DX12_RECT scissor;
 		UINT rtvDescSize;
+		UINT srvDescSize;
 		// frame buffer
 		wrl::ComPtr<ID3D12DescriptorHeap> rtvHeap;
-		wrl::ComPtr<ID3D12DescriptorHeap> srvHeap;
+		wrl::ComPtr<ID3D12DescriptorHeap> srvHeap; // bindless, laid out by descriptors
+		PixieDescriptorAllocator descriptors;
 		wrl::ComPtr<ID3D12Resource> renderTargets[bufferCount];
 		wrl::ComPtr<IDXGISwapChain3> swapchain;
 
 		// resources
 		wrl::ComPtr<ID3D12Resource> texture;
-		wrl::ComPtr<ID3D12Resource> textureUploadHeap;
-		wrl::ComPtr<ID3D12Resource> vertexBuffer;
+		wrl::ComPtr<ID3D12Resource> placeholder;
+		PixieDescriptorHandle textureView;
+		PixieDescriptorHandle placeholderView;
+		wrl::ComPtr<ID3D12Resource> vertexBuffer; // persistently mapped sprite ring
+		PixieCompactVertex *vertexBufferData;
 		D3D12_VERTEX_BUFFER_VIEW vertexBufferView;
-		wrl::ComPtr<ID3D12Resource> indexBuffer;
-		wrl::ComPtr<ID3D12Resource> indexBufferUploadHeap;
+		wrl::ComPtr<ID3D12Resource> indexBuffer; // static quad indices shared by every run
 		D3D12_INDEX_BUFFER_VIEW indexBufferView;
+		PixieSpriteBatch sprites;
+
+		// uploads
+		PixieUploadAllocator uploads;
+		std::vector<wrl::ComPtr<ID3D12Resource>> stagingRings;
+		std::vector<PendingUpload> pendingUploads; // recorded into the next command list that closes
+		std::vector<std::pair<UINT64, wrl::ComPtr<ID3D12Resource>>> dedicatedUploads; // didn't fit a ring, freed by fence
+
+		// streaming, the streamer goes first on teardown so no decode outlives the renderer
+		std::vector<wrl::ComPtr<ID3D12Resource>> streamedTextures; // indexed by handle
+		std::vector<PixieDescriptorHandle> streamedViews;
+		std::unique_ptr<PixieTextureStreamer> streamer;
+
+		// recording, contexts only grow on the render thread and the recorder's workers go before them on teardown
+		std::vector<RecordContext> recordContexts;
+		uint32_t setupContext; // carries the init uploads
+		FLOAT clearColor[4];
+		PixieCommandRecorder recorder;
+
+		// profiling, each frame slot resolves its timestamps into its own part of a persistently mapped readback buffer
+		wrl::ComPtr<ID3D12QueryHeap> timestampHeap;
+		wrl::ComPtr<ID3D12Resource> timestampReadback;
+		const UINT64 *timestampData;
+		UINT64 timestampFrequency;
+		uint32_t resolveContexts[bufferCount]; // made the first time a slot has something to resolve
+		PixieGpuProfiler gpuProfiler;
 
 		// sync objects
+		PixieFrameRing frames;
+		PixieFrameArena frameMemory; // transient lists for the recording thread, reset with the frame slot
+		UINT frameSlot;
+		UINT64 spriteMarkers[PixieFrameRing::maxFramesInFlight]; // ring position each frame slot wrote up to
 		UINT frameIndex;
 		UINT64 fenceVal;
 		HANDLE fenceEvent;
@@ -0,0 +1,48 @@
+#include "riff.hpp"
+#include <cstring>
+#include <stdexcept>
+
+namespace pxe {
+    static uint32_t readU32(const uint8_t *p) {
+        uint32_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    PixieRiffReader::PixieRiffReader(const uint8_t *data, size_t size) {
+        if (size < 12 || readU32(data) != riffId("RIFF"))
+            throw std::runtime_error("PixieRiffReader: not a RIFF file");
+
+        form = readU32(data + 8);
+        // the header's size is only a hint, streams written live often leave it at zero or the maximum
+        chunkList = parseChunks(data + 12, size - 12);
+    }
+
+    const PixieRiffChunk *PixieRiffReader::find(uint32_t id) const {
+        for (const PixieRiffChunk &chunk : chunkList) {
+            if (chunk.id == id)
+                return &chunk;
+        }
+        return nullptr;
+    }
+
+    std::vector<PixieRiffChunk> PixieRiffReader::parseChunks(const uint8_t *data, size_t size) {
+        std::vector<PixieRiffChunk> chunks;
+        size_t offset = 0;
+        while (size - offset >= 8) {
+            const uint32_t id = readU32(data + offset);
+            uint32_t chunkSize = readU32(data + offset + 4);
+            offset += 8;
+
+            if (chunkSize > size - offset)
+                chunkSize = static_cast<uint32_t>(size - offset);
+            chunks.push_back({id, data + offset, chunkSize});
+
+            // chunks start on even offsets, odd sized ones are followed by a pad byte
+            offset += chunkSize + (chunkSize & 1);
+            if (offset > size)
+                break;
+        }
+        return chunks;
+    }
+} // namespace pxe
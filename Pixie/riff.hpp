@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace pxe {
+    // four character code as it sits in the file, riffId("fmt ")
+    constexpr uint32_t riffId(const char (&id)[5]) {
+        return uint32_t(uint8_t(id[0])) | uint32_t(uint8_t(id[1])) << 8 | uint32_t(uint8_t(id[2])) << 16 | uint32_t(uint8_t(id[3])) << 24;
+    }
+
+    struct PixieRiffChunk {
+        uint32_t id;
+        const uint8_t *data; // into the parsed memory, nothing is copied
+        uint32_t size;
+    };
+
+    // walks the top level chunks of a RIFF file in memory, usually a PixieMappedFile
+    class PixieRiffReader {
+    public:
+        // throws when there's no RIFF header, a last chunk that claims more than the file holds is cut short
+        PixieRiffReader(const uint8_t *data, size_t size);
+
+        uint32_t formType() const { return form; }
+        const std::vector<PixieRiffChunk> &chunks() const { return chunkList; }
+        // the first chunk with this id, nullptr when there's none
+        const PixieRiffChunk *find(uint32_t id) const;
+
+        // chunks inside a LIST, past its form type, or anything else laid out the same way
+        static std::vector<PixieRiffChunk> parseChunks(const uint8_t *data, size_t size);
+
+    private:
+        uint32_t form;
+        std::vector<PixieRiffChunk> chunkList;
+    };
+} // namespace pxe
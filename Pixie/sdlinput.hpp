@@ -0,0 +1,66 @@
+#pragma once
+
+#include <SDL.h>
+#include <cstdint>
+#include "input.hpp"
+
+namespace pxe {
+    // SDL stamps events in milliseconds since SDL_Init, they're moved onto the clock by how long ago SDL says they came
+    inline bool translateSDLEvent(const SDL_Event &ev, uint64_t now, uint32_t ticksNow, PixieInputEvent &out) {
+        const uint64_t ago = ev.common.timestamp < ticksNow ? uint64_t(ticksNow - ev.common.timestamp) * 1000000 : 0;
+        out = {};
+        out.timestamp = now > ago ? now - ago : 1;
+
+        switch (ev.type) {
+            case SDL_QUIT:
+                out.type = PixieInputType::Quit;
+                return true;
+            case SDL_KEYDOWN:
+            case SDL_KEYUP:
+                out.type = ev.type == SDL_KEYDOWN ? PixieInputType::KeyDown : PixieInputType::KeyUp;
+                out.code = static_cast<uint16_t>(ev.key.keysym.scancode);
+                out.repeat = ev.key.repeat != 0;
+                return true;
+            case SDL_MOUSEMOTION:
+                out.type = PixieInputType::MouseMove;
+                out.x = static_cast<float>(ev.motion.x);
+                out.y = static_cast<float>(ev.motion.y);
+                return true;
+            case SDL_MOUSEBUTTONDOWN:
+            case SDL_MOUSEBUTTONUP:
+                out.type = ev.type == SDL_MOUSEBUTTONDOWN ? PixieInputType::MouseDown : PixieInputType::MouseUp;
+                out.code = ev.button.button;
+                out.x = static_cast<float>(ev.button.x);
+                out.y = static_cast<float>(ev.button.y);
+                return true;
+            case SDL_MOUSEWHEEL:
+                out.type = PixieInputType::MouseWheel;
+                out.x = static_cast<float>(ev.wheel.x);
+                out.y = static_cast<float>(ev.wheel.y);
+                return true;
+            case SDL_WINDOWEVENT:
+                if (ev.window.event != SDL_WINDOWEVENT_FOCUS_LOST)
+                    return false;
+                out.type = PixieInputType::FocusLost;
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    // everything SDL has queued, not just the first event. window events can only be pumped on the thread that made
+    // the window, so this runs on the game thread rather than a sampler
+    inline uint32_t drainSDLEvents(PixieInput &input, PixieClock &clock) {
+        const uint64_t now = clock.now();
+        const uint32_t ticksNow = SDL_GetTicks();
+
+        uint32_t count = 0;
+        SDL_Event ev;
+        while (SDL_PollEvent(&ev)) {
+            PixieInputEvent event;
+            if (translateSDLEvent(ev, now, ticksNow, event) && input.push(event))
+                count++;
+        }
+        return count;
+    }
+} // namespace pxe
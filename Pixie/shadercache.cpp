@@ -0,0 +1,346 @@
+#include "shadercache.hpp"
+#include "hash.hpp"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+
+namespace pxe {
+    // pack layout: header, entry table, blobs at 16 byte offsets. the table is hashed so a torn or
+    // half written pack is thrown away as a whole, blobs carry their own hash and are checked on use
+    static const char packMagic[4] = {'P', 'X', 'S', 'C'};
+    static const uint32_t packVersion = 1;
+    static const uint64_t blobAlignment = 16;
+
+    struct PackHeader {
+        char magic[4];
+        uint32_t version;
+        uint32_t entryCount;
+        uint32_t reserved;
+        uint64_t tableHash;
+        uint64_t fileSize;
+    };
+
+    struct PackEntry {
+        uint64_t key;
+        uint64_t offset;
+        uint64_t size;
+        uint64_t blobHash;
+    };
+
+    static_assert(sizeof(PackHeader) == 32 && sizeof(PackEntry) == 32, "shader pack layout changed");
+
+    // only the #include lines, a commented out one just makes the key a little stricter than it needs to be
+    static std::vector<std::string> findIncludes(const std::string &source) {
+        std::vector<std::string> includes;
+        std::istringstream lines(source);
+
+        for (std::string line; std::getline(lines, line);) {
+            size_t at = line.find_first_not_of(" \t");
+            if (at == std::string::npos || line[at] != '#')
+                continue;
+            at = line.find_first_not_of(" \t", at + 1);
+            if (at == std::string::npos || line.compare(at, 7, "include") != 0)
+                continue;
+
+            const size_t open = line.find_first_of("\"<", at + 7);
+            if (open == std::string::npos)
+                continue;
+            const size_t close = line.find(line[open] == '"' ? '"' : '>', open + 1);
+            if (close != std::string::npos)
+                includes.push_back(line.substr(open + 1, close - open - 1));
+        }
+
+        return includes;
+    }
+
+    PixieShaderCache::PixieShaderCache(PixieShaderCompiler &compiler, std::string packPath)
+        : compiler(compiler)
+        , packPath(std::move(packPath))
+        , counters({}) {
+
+        openPack();
+    }
+
+    PixieShaderCache::~PixieShaderCache() {
+        try {
+            flush();
+        } catch (const std::exception &) {
+        }
+    }
+
+    void PixieShaderCache::openPack() {
+        pack = PixieMappedFile();
+        packed.clear();
+
+        std::error_code error;
+        if (!std::filesystem::exists(packPath, error))
+            return;
+
+        std::vector<Entry> entries;
+        try {
+            pack = PixieMappedFile(packPath);
+            if (!readPack(pack, entries)) {
+                counters.rejected++;
+                pack = PixieMappedFile();
+                return;
+            }
+        } catch (const std::runtime_error &) {
+            return; // unreadable is the same as missing, the next flush replaces it
+        }
+
+        for (const Entry &entry : entries)
+            packed.emplace(entry.key, entry);
+    }
+
+    bool PixieShaderCache::readPack(const PixieMappedFile &file, std::vector<Entry> &entries) {
+        PackHeader header = {};
+        if (file.size() < sizeof(header))
+            return false;
+        std::memcpy(&header, file.data(), sizeof(header));
+
+        if (std::memcmp(header.magic, packMagic, sizeof(packMagic)) != 0 || header.version != packVersion || header.fileSize != file.size())
+            return false;
+
+        const uint64_t tableSize = static_cast<uint64_t>(header.entryCount) * sizeof(PackEntry);
+        if (tableSize > file.size() - sizeof(header))
+            return false;
+
+        const uint8_t *table = file.data() + sizeof(header);
+        if (hashBytes(table, tableSize) != header.tableHash)
+            return false;
+
+        const uint64_t dataBegin = sizeof(header) + tableSize;
+        entries.resize(header.entryCount);
+        for (uint32_t i = 0; i < header.entryCount; ++i) {
+            PackEntry record = {};
+            std::memcpy(&record, table + i * sizeof(PackEntry), sizeof(record));
+
+            if (record.offset < dataBegin || record.offset > file.size() || record.size > file.size() - record.offset)
+                return false;
+            entries[i] = {record.key, record.offset, record.size, record.blobHash};
+        }
+
+        return true;
+    }
+
+    uint64_t PixieShaderCache::sourceHash(const std::string &path) {
+        const auto found = sourceHashes.find(path);
+        if (found != sourceHashes.end())
+            return found->second;
+
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+            throw std::runtime_error("PixieShaderCache: can't read " + path);
+        const std::string source((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+        hashing.insert(path);
+        uint64_t hash = hashString(source);
+
+        // includes resolve next to the file that includes them, same as the compiler's default handler
+        const std::filesystem::path directory = std::filesystem::path(path).parent_path();
+        for (const std::string &include : findIncludes(source)) {
+            const std::string includePath = (directory / include).lexically_normal().string();
+            hash = hashString(include, hash);
+
+            std::error_code error;
+            if (hashing.count(includePath) == 0 && std::filesystem::is_regular_file(includePath, error)) {
+                const uint64_t includeHash = sourceHash(includePath);
+                hash = hashBytes(&includeHash, sizeof(includeHash), hash);
+            }
+        }
+        hashing.erase(path);
+
+        sourceHashes.emplace(path, hash);
+        return hash;
+    }
+
+    uint64_t PixieShaderCache::key(const PixieShaderDesc &desc) {
+        // every string is hashed with its length so neighbouring fields can't run into each other
+        const auto hashField = [](const std::string &text, uint64_t hash) {
+            const uint64_t size = text.size();
+            return hashString(text, hashBytes(&size, sizeof(size), hash));
+        };
+
+        std::lock_guard<std::mutex> lock(mutex);
+        const uint64_t source = sourceHash(desc.path);
+
+        uint64_t hash = hashBytes(&packVersion, sizeof(packVersion));
+        hash = hashField(compiler.identity(), hash);
+        hash = hashBytes(&source, sizeof(source), hash);
+        hash = hashField(desc.entryPoint, hash);
+        hash = hashField(desc.target, hash);
+        for (const PixieShaderDefine &define : desc.defines) {
+            hash = hashField(define.name, hash);
+            hash = hashField(define.value, hash);
+        }
+        return hashBytes(&desc.flags, sizeof(desc.flags), hash);
+    }
+
+    PixieShaderBlob PixieShaderCache::get(const PixieShaderDesc &desc) {
+        const uint64_t shaderKey = key(desc);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            const auto compiled = pending.find(shaderKey);
+            if (compiled != pending.end()) {
+                counters.hits++;
+                return {compiled->second.data(), compiled->second.size()};
+            }
+
+            const auto found = packed.find(shaderKey);
+            if (found != packed.end()) {
+                const uint8_t *data = pack.data() + found->second.offset;
+                if (hashBytes(data, found->second.size) == found->second.blobHash) {
+                    counters.hits++;
+                    return {data, found->second.size};
+                }
+
+                // bad bytes on disk, the fresh compile below replaces the entry on the next flush
+                packed.erase(found);
+                counters.rejected++;
+            }
+
+            counters.misses++;
+        }
+
+        // compiles run unlocked, two threads missing the same shader both compile and the first one in wins
+        std::vector<uint8_t> bytecode = compiler.compile(desc);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        const auto inserted = pending.emplace(shaderKey, std::move(bytecode)).first;
+        return {inserted->second.data(), inserted->second.size()};
+    }
+
+    // header bytes of the pack on disk right now, 0 when there's none
+    static uint64_t packStamp(const std::string &path) {
+        PackHeader header = {};
+        std::ifstream file(path, std::ios::binary);
+        if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)))
+            return 0;
+        return hashBytes(&header, sizeof(header)) | 1;
+    }
+
+    // merges with whatever is on disk and swaps the pack in with a rename, so readers only ever see a whole pack.
+    // if another writer got in while the merge was being written it starts over, two renames landing in the
+    // same instant can still drop one side's new entries and they're compiled again next run
+    bool PixieShaderCache::flush() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (pending.empty())
+            return true;
+
+        const std::filesystem::path target(packPath);
+        std::error_code error;
+        if (target.has_parent_path())
+            std::filesystem::create_directories(target.parent_path(), error);
+
+        for (int attempt = 0; attempt < maxFlushAttempts; ++attempt) {
+            const uint64_t stamp = packStamp(packPath);
+            const std::string tempPath = writeMerged();
+            if (tempPath.empty())
+                return false;
+
+            // windows won't replace a file that's still mapped
+            pack = PixieMappedFile();
+            packed.clear();
+
+            if (packStamp(packPath) != stamp) {
+                std::filesystem::remove(tempPath, error);
+                openPack();
+                continue;
+            }
+
+            std::filesystem::rename(tempPath, packPath, error);
+            if (error) {
+                std::filesystem::remove(tempPath, error);
+                openPack();
+                return false;
+            }
+
+            counters.writes++;
+            pending.clear();
+            openPack();
+            return true;
+        }
+
+        return false;
+    }
+
+    std::string PixieShaderCache::writeMerged() {
+        PixieMappedFile current;
+        std::vector<Entry> entries;
+        try {
+            std::error_code error;
+            if (std::filesystem::exists(packPath, error)) {
+                current = PixieMappedFile(packPath);
+                if (!readPack(current, entries))
+                    entries.clear();
+            }
+        } catch (const std::runtime_error &) {
+            entries.clear();
+        }
+
+        std::erase_if(entries, [&](const Entry &entry) {
+            return pending.count(entry.key) != 0 || hashBytes(current.data() + entry.offset, entry.size) != entry.blobHash;
+        });
+
+        struct Source {
+            const uint8_t *data;
+            uint64_t size;
+        };
+        std::vector<PackEntry> table;
+        std::vector<Source> blobs;
+
+        uint64_t offset = sizeof(PackHeader) + (entries.size() + pending.size()) * sizeof(PackEntry);
+        const auto add = [&](uint64_t shaderKey, const uint8_t *data, uint64_t size, uint64_t blobHash) {
+            offset = (offset + blobAlignment - 1) & ~(blobAlignment - 1);
+            table.push_back({shaderKey, offset, size, blobHash});
+            blobs.push_back({data, size});
+            offset += size;
+        };
+
+        for (const Entry &entry : entries)
+            add(entry.key, current.data() + entry.offset, entry.size, entry.blobHash);
+        for (const auto &[shaderKey, bytecode] : pending)
+            add(shaderKey, bytecode.data(), bytecode.size(), hashBytes(bytecode.data(), bytecode.size()));
+
+        PackHeader header = {};
+        std::memcpy(header.magic, packMagic, sizeof(packMagic));
+        header.version = packVersion;
+        header.entryCount = static_cast<uint32_t>(table.size());
+        header.tableHash = hashBytes(table.data(), table.size() * sizeof(PackEntry));
+        header.fileSize = offset;
+
+        // unique per writer so concurrent flushes never share a temp file
+        std::random_device random;
+        const std::string tempPath = packPath + ".tmp" + std::to_string((static_cast<uint64_t>(random()) << 32) | random());
+
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char *>(table.data()), static_cast<std::streamsize>(table.size() * sizeof(PackEntry)));
+
+        static const char padding[blobAlignment] = {};
+        uint64_t written = sizeof(header) + table.size() * sizeof(PackEntry);
+        for (size_t i = 0; i < blobs.size(); ++i) {
+            file.write(padding, static_cast<std::streamsize>(table[i].offset - written));
+            file.write(reinterpret_cast<const char *>(blobs[i].data), static_cast<std::streamsize>(blobs[i].size));
+            written = table[i].offset + blobs[i].size;
+        }
+
+        if (!file.flush()) {
+            file.close();
+            std::error_code error;
+            std::filesystem::remove(tempPath, error);
+            return {};
+        }
+        return tempPath;
+    }
+
+    PixieShaderCacheStats PixieShaderCache::stats() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return counters;
+    }
+} // namespace pxe
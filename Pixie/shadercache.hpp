@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "mappedfile.hpp"
+
+namespace pxe {
+    struct PixieShaderDefine {
+        std::string name;
+        std::string value;
+    };
+
+    struct PixieShaderDesc {
+        std::string path;
+        std::string entryPoint;
+        std::string target; // profile, vs_5_0 and so on
+        std::vector<PixieShaderDefine> defines;
+        uint32_t flags = 0; // passed through to the compiler
+    };
+
+    // the thing that actually turns hlsl into bytecode, d3dcompiler on windows and a stub anywhere else
+    class PixieShaderCompiler {
+    public:
+        virtual ~PixieShaderCompiler() = default;
+        // names the compiler build, it's part of every key so an upgrade misses instead of loading stale bytecode
+        virtual std::string identity() const = 0;
+        // throws on errors
+        virtual std::vector<uint8_t> compile(const PixieShaderDesc &desc) = 0;
+    };
+
+    struct PixieShaderBlob {
+        const uint8_t *data;
+        size_t size;
+    };
+
+    struct PixieShaderCacheStats {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t rejected; // pack or entries that failed validation and got recompiled
+        uint64_t writes; // packs written by flush
+    };
+
+    // compiled bytecode keyed by everything that goes into a compile, kept in one mapped pack file.
+    // get is safe from several threads, blobs stay valid until the next flush
+    class PixieShaderCache {
+    public:
+        PixieShaderCache(PixieShaderCompiler &compiler, std::string packPath);
+        ~PixieShaderCache(); // flushes, write errors are dropped
+
+        PixieShaderCache(const PixieShaderCache &) = delete;
+        PixieShaderCache &operator=(const PixieShaderCache &) = delete;
+
+        PixieShaderBlob get(const PixieShaderDesc &desc);
+        // hashes the source with every file it includes, the compiler identity, entry point, target, defines and flags
+        uint64_t key(const PixieShaderDesc &desc);
+
+        // writes new bytecode out, returns false if the pack couldn't be replaced (the entries stay in memory)
+        bool flush();
+
+        PixieShaderCacheStats stats() const;
+
+    private:
+        struct Entry {
+            uint64_t key;
+            uint64_t offset;
+            uint64_t size;
+            uint64_t blobHash;
+        };
+
+        static const int maxFlushAttempts = 4;
+
+        void openPack();
+        std::string writeMerged(); // temp file with the pack on disk plus pending, empty on failure
+        static bool readPack(const PixieMappedFile &file, std::vector<Entry> &entries);
+        uint64_t sourceHash(const std::string &path);
+
+        PixieShaderCompiler &compiler;
+        std::string packPath;
+
+        mutable std::mutex mutex;
+        PixieMappedFile pack;
+        std::unordered_map<uint64_t, Entry> packed; // entries of the mapped pack
+        std::unordered_map<uint64_t, std::vector<uint8_t>> pending; // compiled since the last flush
+        std::unordered_map<std::string, uint64_t> sourceHashes; // per file, includes folded in
+        std::unordered_set<std::string> hashing; // include cycle guard
+        PixieShaderCacheStats counters;
+    };
+} // namespace pxe
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdlib>
+#include <cstring>
+#include <immintrin.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+// msvc lets any intrinsic through, the runtime dispatch keeps it honest
+#define PIXIE_TARGET_AVX2
+#else
+#define PIXIE_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+
+namespace pxe {
+    enum class PixieSIMDLevel {
+        Scalar,
+        SSE2,
+        AVX2
+    };
+
+    inline const char *simdLevelName(PixieSIMDLevel level) {
+        switch (level) {
+            case PixieSIMDLevel::AVX2:
+                return "avx2";
+            case PixieSIMDLevel::SSE2:
+                return "sse2";
+            default:
+                return "scalar";
+        }
+    }
+
+    // Check what the running cpu can do, PIXIE_SIMD=scalar|sse2|avx2 caps the result
+    inline PixieSIMDLevel detectSIMDLevel() {
+        PixieSIMDLevel level = PixieSIMDLevel::SSE2; // baseline on x64
+
+#if defined(_MSC_VER)
+        int info[4] = {};
+        __cpuid(info, 0);
+        if (info[0] >= 7) {
+            __cpuid(info, 1);
+            const bool osxsave = (info[2] & (1 << 27)) != 0;
+            const bool avx = (info[2] & (1 << 28)) != 0;
+            __cpuidex(info, 7, 0);
+            const bool avx2 = (info[1] & (1 << 5)) != 0;
+            // the os has to save the ymm registers as well
+            if (osxsave && avx && avx2 && (_xgetbv(0) & 0x6) == 0x6)
+                level = PixieSIMDLevel::AVX2;
+        }
+#else
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+            level = PixieSIMDLevel::AVX2;
+#endif
+
+        if (const char *cap = std::getenv("PIXIE_SIMD")) {
+            if (std::strcmp(cap, "scalar") == 0)
+                level = PixieSIMDLevel::Scalar;
+            else if (std::strcmp(cap, "sse2") == 0 && level == PixieSIMDLevel::AVX2)
+                level = PixieSIMDLevel::SSE2;
+        }
+
+        return level;
+    }
+} // namespace pxe
@@ -0,0 +1,476 @@
+#include "softrenderer.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+
+namespace pxe {
+    // triangles reaching further off screen than this are clipped to it, it keeps every edge inside int32
+    static const float guardBand = 4096.0f;
+    static const int32_t subPixelBits = 4;
+    static const int32_t subPixelScale = 1 << subPixelBits;
+    static const int64_t edgeClamp = int64_t(1) << 30;
+    static const uint32_t opaqueWhite = 0xffffffffu;
+
+    static uint32_t packColor(const float *color) {
+        uint32_t packed = 0;
+        for (int i = 0; i < 4; ++i) {
+            const float c = std::clamp(color[i], 0.0f, 1.0f);
+            packed |= static_cast<uint32_t>(c * 255.0f + 0.5f) << (i * 8);
+        }
+        return packed;
+    }
+
+    // a tile spans at most tileSize * stepX, so a clamped edge never changes sign inside it
+    static int32_t rowEdge(int32_t stepX, int32_t stepY, int64_t origin, int32_t x, int32_t y) {
+        const int64_t e = int64_t(stepX) * x + int64_t(stepY) * y + origin;
+        return static_cast<int32_t>(std::clamp(e, -edgeClamp, edgeClamp));
+    }
+
+    // texel * color per channel, (t + (t >> 8)) >> 8 with t = a * b + 128 is exactly round(a * b / 255)
+    static uint32_t modulate(uint32_t texel, uint32_t color) {
+        uint32_t result = 0;
+        for (int shift = 0; shift < 32; shift += 8) {
+            const uint32_t t = ((texel >> shift) & 0xff) * ((color >> shift) & 0xff) + 128;
+            result |= ((t + (t >> 8)) >> 8) << shift;
+        }
+        return result;
+    }
+
+    static __m128i modulateSSE2(__m128i texel, __m128i color) {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i bias = _mm_set1_epi16(128);
+
+        __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(texel, zero), _mm_unpacklo_epi8(color, zero)), bias);
+        __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(texel, zero), _mm_unpackhi_epi8(color, zero)), bias);
+        lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+        hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+
+        return _mm_packus_epi16(lo, hi);
+    }
+
+    PIXIE_TARGET_AVX2 static __m256i modulateAVX2(__m256i texel, __m256i color) {
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i bias = _mm256_set1_epi16(128);
+
+        __m256i lo = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(texel, zero), _mm256_unpacklo_epi8(color, zero)), bias);
+        __m256i hi = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(texel, zero), _mm256_unpackhi_epi8(color, zero)), bias);
+        lo = _mm256_srli_epi16(_mm256_add_epi16(lo, _mm256_srli_epi16(lo, 8)), 8);
+        hi = _mm256_srli_epi16(_mm256_add_epi16(hi, _mm256_srli_epi16(hi, 8)), 8);
+
+        return _mm256_packus_epi16(lo, hi);
+    }
+
+    PixieSoftRenderer::PixieSoftRenderer(uint32_t width, uint32_t height, size_t threadCount)
+        : surfaceWidth(width)
+        , surfaceHeight(height)
+        , tilesX((width + tileSize - 1) / tileSize)
+        , tilesY((height + tileSize - 1) / tileSize)
+        , clearColor(0)
+        , simdLevel(detectSIMDLevel())
+        , frameStats {}
+        , jobPool(threadCount) {
+
+        if (width == 0 || height == 0 || width > maxSurfaceSize || height > maxSurfaceSize)
+            throw std::invalid_argument("PixieSoftRenderer: surface size out of range");
+
+        frameBuffer.resize(static_cast<size_t>(pitch()) * tilesY * tileSize);
+        bins.resize(static_cast<size_t>(tilesX) * tilesY);
+
+        spriteRing.resize(static_cast<size_t>(maxSprites) * 4);
+        sprites.setRing(spriteRing.data(), static_cast<uint32_t>(spriteRing.size()));
+
+        quadIndices.resize(static_cast<size_t>(PixieSpriteBatch::maxQuadsPerRun) * PixieSpriteBatch::indicesPerQuad);
+        PixieSpriteBatch::writeQuadIndices(quadIndices.data(), PixieSpriteBatch::maxQuadsPerRun);
+    }
+
+    uint32_t PixieSoftRenderer::createTexture(uint32_t width, uint32_t height, const uint32_t *texels) {
+        if (width == 0 || height == 0 || texels == nullptr)
+            throw std::invalid_argument("PixieSoftRenderer: empty texture");
+
+        PixieSoftTexture texture = {width, height, {}};
+        texture.texels.assign(texels, texels + static_cast<size_t>(width) * height);
+        textures.push_back(std::move(texture));
+
+        return static_cast<uint32_t>(textures.size() - 1);
+    }
+
+    void PixieSoftRenderer::beginFrame(float *color) {
+        clearColor = packColor(color);
+        triangles.clear();
+        for (auto &bin : bins)
+            bin.clear();
+
+        frameStats = {};
+
+        // the previous frame is fully rasterized, its sprite vertices can go
+        sprites.release(sprites.frameMarker());
+        sprites.begin(static_cast<float>(surfaceWidth), static_cast<float>(surfaceHeight));
+    }
+
+    bool PixieSoftRenderer::drawSprite(uint32_t texture, const PixieRect &rect, const PixieRect &uv, uint32_t color, const PixieTransform2D &transform, uint32_t layer, float depth) {
+        return sprites.drawSprite(texture, rect, uv, color, transform, 0, layer, depth);
+    }
+
+    bool PixieSoftRenderer::drawSprites(uint32_t texture, const PixieSpriteArrays &sprites, const PixieTransformHierarchy *transforms, uint32_t layer, float depth) {
+        return this->sprites.drawSprites(texture, sprites, transforms, 0, layer, depth);
+    }
+
+    void PixieSoftRenderer::drawQuads(const PixieDrawRun &run) {
+        drawIndexed(spriteRing.data() + run.firstVertex, quadIndices.data(), run.quadCount * PixieSpriteBatch::indicesPerQuad, run.texture);
+    }
+
+    void PixieSoftRenderer::drawIndexed(const PixieVertexData *vertices, const uint16_t *indices, uint32_t indexCount, uint32_t texture) {
+        if (texture >= textures.size())
+            throw std::out_of_range("PixieSoftRenderer: unknown texture");
+
+        const float halfWidth = 0.5f * static_cast<float>(surfaceWidth);
+        const float halfHeight = 0.5f * static_cast<float>(surfaceHeight);
+
+        for (uint32_t i = 0; i + 2 < indexCount; i += 3) {
+            frameStats.trianglesSubmitted++;
+
+            // viewport transform
+            ScreenVertex screen[3];
+            bool finite = true;
+            bool inside = true;
+            for (int k = 0; k < 3; ++k) {
+                const PixieVertexData &vert = vertices[indices[i + k]];
+                const float px = (vert.position.x + 1.0f) * halfWidth;
+                const float py = (1.0f - vert.position.y) * halfHeight;
+                screen[k] = {px, py, vert.uv.x, vert.uv.y};
+
+                finite = finite && std::isfinite(px) && std::isfinite(py);
+                inside = inside && px >= -guardBand && px <= surfaceWidth + guardBand && py >= -guardBand && py <= surfaceHeight + guardBand;
+            }
+            if (!finite)
+                continue;
+
+            // the flat color always comes from the triangle's first vertex, clipped pieces included
+            const uint32_t color = vertices[indices[i]].color;
+            if (inside) {
+                binTriangle(screen[0], screen[1], screen[2], texture, color);
+                continue;
+            }
+
+            // anything reaching past the guard band is cut down to it, only triangles entirely outside disappear.
+            // positions have no w, so uv interpolates linearly along the cut edges
+            ScreenVertex polygon[2][maxClipVertices];
+            std::copy(screen, screen + 3, polygon[0]);
+            uint32_t count = 3;
+            const float right = surfaceWidth + guardBand;
+            const float bottom = surfaceHeight + guardBand;
+            count = clipPolygon(polygon[0], count, polygon[1], 0, -guardBand, -1.0f);
+            count = clipPolygon(polygon[1], count, polygon[0], 0, right, 1.0f);
+            count = clipPolygon(polygon[0], count, polygon[1], 1, -guardBand, -1.0f);
+            count = clipPolygon(polygon[1], count, polygon[0], 1, bottom, 1.0f);
+            if (count < 3)
+                continue;
+
+            frameStats.trianglesClipped++;
+            for (uint32_t k = 1; k + 1 < count; ++k)
+                binTriangle(polygon[0][0], polygon[0][k], polygon[0][k + 1], texture, color);
+        }
+    }
+
+    uint32_t PixieSoftRenderer::clipPolygon(const ScreenVertex *in, uint32_t count, ScreenVertex *out, int axis, float bound, float side) {
+        const auto distance = [&](const ScreenVertex &vert) { return side * ((axis == 0 ? vert.x : vert.y) - bound); };
+
+        uint32_t written = 0;
+        for (uint32_t i = 0; i < count; ++i) {
+            const ScreenVertex &current = in[i];
+            const ScreenVertex &next = in[(i + 1) % count];
+            const float d0 = distance(current);
+            const float d1 = distance(next);
+
+            if (d0 <= 0.0f)
+                out[written++] = current;
+            if ((d0 <= 0.0f) != (d1 <= 0.0f)) {
+                // the crossing lands exactly on the bound so rounding can't leave it just outside
+                const float t = d0 / (d0 - d1);
+                ScreenVertex cut = {current.x + (next.x - current.x) * t, current.y + (next.y - current.y) * t, current.u + (next.u - current.u) * t,
+                    current.v + (next.v - current.v) * t};
+                (axis == 0 ? cut.x : cut.y) = bound;
+                out[written++] = cut;
+            }
+        }
+        return written;
+    }
+
+    void PixieSoftRenderer::binTriangle(const ScreenVertex &v0, const ScreenVertex &v1, const ScreenVertex &v2, uint32_t texture, uint32_t color) {
+        // snap to the sub pixel grid
+        const ScreenVertex *verts[3] = {&v0, &v1, &v2};
+        int64_t x[3];
+        int64_t y[3];
+        for (int k = 0; k < 3; ++k) {
+            x[k] = std::llround(verts[k]->x * subPixelScale);
+            y[k] = std::llround(verts[k]->y * subPixelScale);
+        }
+
+        // culling is off, counter clockwise triangles get flipped so the edge setup only sees one winding
+        const int64_t area = (x[2] - x[1]) * (y[0] - y[1]) - (y[2] - y[1]) * (x[0] - x[1]);
+        if (area == 0)
+            return;
+
+        if (area < 0) {
+            std::swap(verts[1], verts[2]);
+            std::swap(x[1], x[2]);
+            std::swap(y[1], y[2]);
+        }
+
+        Triangle tri;
+        int64_t origin[3];
+        for (int k = 0; k < 3; ++k) {
+            // edge k runs between the two vertices opposite vertex k
+            const int a = (k + 1) % 3;
+            const int b = (k + 2) % 3;
+            const int64_t stepA = y[a] - y[b];
+            const int64_t stepB = x[b] - x[a];
+            const int64_t c = -stepA * x[a] - stepB * y[a];
+
+            tri.stepX[k] = static_cast<int32_t>(stepA * subPixelScale);
+            tri.stepY[k] = static_cast<int32_t>(stepB * subPixelScale);
+            origin[k] = c + (stepA + stepB) * (subPixelScale / 2); // sample at pixel centers
+
+            const bool topLeft = stepA > 0 || (stepA == 0 && stepB > 0);
+            tri.origin[k] = origin[k] - (topLeft ? 0 : 1);
+        }
+
+        const auto minX = std::min({x[0], x[1], x[2]}) >> subPixelBits;
+        const auto maxX = std::max({x[0], x[1], x[2]}) >> subPixelBits;
+        const auto minY = std::min({y[0], y[1], y[2]}) >> subPixelBits;
+        const auto maxY = std::max({y[0], y[1], y[2]}) >> subPixelBits;
+
+        tri.minX = static_cast<int32_t>(std::max<int64_t>(minX, 0));
+        tri.minY = static_cast<int32_t>(std::max<int64_t>(minY, 0));
+        tri.maxX = static_cast<int32_t>(std::min<int64_t>(maxX, surfaceWidth - 1));
+        tri.maxY = static_cast<int32_t>(std::min<int64_t>(maxY, surfaceHeight - 1));
+
+        if (tri.minX > tri.maxX || tri.minY > tri.maxY)
+            return;
+
+        // barycentric weight k is edge k over the area
+        double uPlane[3] = {};
+        double vPlane[3] = {};
+        const double invArea = 1.0 / static_cast<double>(area < 0 ? -area : area);
+        for (int k = 0; k < 3; ++k) {
+            const double terms[3] = {double(tri.stepX[k]), double(tri.stepY[k]), double(origin[k])};
+
+            for (int t = 0; t < 3; ++t) {
+                uPlane[t] += verts[k]->u * terms[t] * invArea;
+                vPlane[t] += verts[k]->v * terms[t] * invArea;
+            }
+        }
+
+        for (int t = 0; t < 3; ++t) {
+            tri.uPlane[t] = static_cast<float>(uPlane[t]);
+            tri.vPlane[t] = static_cast<float>(vPlane[t]);
+        }
+        tri.texture = texture;
+        tri.color = color;
+
+        const auto index = static_cast<uint32_t>(triangles.size());
+        triangles.push_back(tri);
+        frameStats.trianglesBinned++;
+
+        for (uint32_t ty = tri.minY / tileSize; ty <= tri.maxY / tileSize; ++ty) {
+            for (uint32_t tx = tri.minX / tileSize; tx <= tri.maxX / tileSize; ++tx) {
+                bins[ty * tilesX + tx].push_back(index);
+                frameStats.binEntries++;
+            }
+        }
+    }
+
+    void PixieSoftRenderer::endFrame() {
+        sprites.flush(*this);
+
+        const auto begin = std::chrono::steady_clock::now();
+
+        jobPool.parallelFor(bins.size(), [this](size_t tile) { rasterTile(static_cast<uint32_t>(tile)); });
+
+        const auto end = std::chrono::steady_clock::now();
+        frameStats.rasterMs = std::chrono::duration<double, std::milli>(end - begin).count();
+    }
+
+    void PixieSoftRenderer::rasterTile(uint32_t tile) {
+        const auto tileX = static_cast<int32_t>((tile % tilesX) * tileSize);
+        const auto tileY = static_cast<int32_t>((tile / tilesX) * tileSize);
+        const int32_t lastX = std::min<int32_t>(tileX + tileSize, surfaceWidth) - 1;
+        const int32_t lastY = std::min<int32_t>(tileY + tileSize, surfaceHeight) - 1;
+
+        for (int32_t y = tileY; y <= lastY; ++y) {
+            uint32_t *row = frameBuffer.data() + static_cast<size_t>(y) * pitch() + tileX;
+            std::fill(row, row + tileSize, clearColor);
+        }
+
+        for (const uint32_t index : bins[tile]) {
+            const Triangle &tri = triangles[index];
+            const int32_t x0 = std::max(tri.minX, tileX);
+            const int32_t x1 = std::min(tri.maxX, lastX);
+            const int32_t y0 = std::max(tri.minY, tileY);
+            const int32_t y1 = std::min(tri.maxY, lastY);
+
+            for (int32_t y = y0; y <= y1; ++y) {
+                switch (simdLevel) {
+                    case PixieSIMDLevel::AVX2:
+                        rasterAVX2(tri, x0, x1, y);
+                        break;
+                    case PixieSIMDLevel::SSE2:
+                        rasterSSE2(tri, x0, x1, y);
+                        break;
+                    default:
+                        rasterScalar(tri, x0, x1, y);
+                        break;
+                }
+            }
+        }
+    }
+
+    void PixieSoftRenderer::rasterScalar(const Triangle &tri, int32_t x0, int32_t x1, int32_t y) {
+        const PixieSoftTexture &tex = textures[tri.texture];
+        uint32_t *row = frameBuffer.data() + static_cast<size_t>(y) * pitch();
+
+        int32_t e[3];
+        for (int k = 0; k < 3; ++k)
+            e[k] = rowEdge(tri.stepX[k], tri.stepY[k], tri.origin[k], x0, y);
+
+        for (int32_t x = x0; x <= x1; ++x) {
+            if ((e[0] | e[1] | e[2]) >= 0) {
+                const float u = tri.uPlane[0] * x + tri.uPlane[1] * y + tri.uPlane[2];
+                const float v = tri.vPlane[0] * x + tri.vPlane[1] * y + tri.vPlane[2];
+
+                // border addressing, anything outside [0, 1) reads transparent black
+                uint32_t texel = 0;
+                if (u >= 0.0f && u < 1.0f && v >= 0.0f && v < 1.0f) {
+                    const auto tx = static_cast<uint32_t>(std::min(u * tex.width, tex.width - 1.0f));
+                    const auto ty = static_cast<uint32_t>(std::min(v * tex.height, tex.height - 1.0f));
+                    texel = tex.texels[static_cast<size_t>(ty) * tex.width + tx];
+                }
+
+                if (tri.color != opaqueWhite)
+                    texel = modulate(texel, tri.color);
+
+                row[x] = texel;
+            }
+
+            for (int k = 0; k < 3; ++k)
+                e[k] += tri.stepX[k];
+        }
+    }
+
+    void PixieSoftRenderer::rasterSSE2(const Triangle &tri, int32_t x0, int32_t x1, int32_t y) {
+        const PixieSoftTexture &tex = textures[tri.texture];
+        uint32_t *row = frameBuffer.data() + static_cast<size_t>(y) * pitch();
+        const int32_t start = x0 & ~3; // groups never straddle a tile since tiles are 4 aligned
+
+        __m128i e[3];
+        __m128i step[3];
+        for (int k = 0; k < 3; ++k) {
+            const int32_t s = tri.stepX[k];
+            e[k] = _mm_add_epi32(_mm_set1_epi32(rowEdge(s, tri.stepY[k], tri.origin[k], start, y)), _mm_setr_epi32(0, s, s * 2, s * 3));
+            step[k] = _mm_set1_epi32(s * 4);
+        }
+
+        const __m128 lanes = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+        __m128 u = _mm_add_ps(_mm_set1_ps(tri.uPlane[0] * start + tri.uPlane[1] * y + tri.uPlane[2]), _mm_mul_ps(_mm_set1_ps(tri.uPlane[0]), lanes));
+        __m128 v = _mm_add_ps(_mm_set1_ps(tri.vPlane[0] * start + tri.vPlane[1] * y + tri.vPlane[2]), _mm_mul_ps(_mm_set1_ps(tri.vPlane[0]), lanes));
+        const __m128 uStep = _mm_set1_ps(tri.uPlane[0] * 4.0f);
+        const __m128 vStep = _mm_set1_ps(tri.vPlane[0] * 4.0f);
+
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 texWidth = _mm_set1_ps(static_cast<float>(tex.width));
+        const __m128 texHeight = _mm_set1_ps(static_cast<float>(tex.height));
+        const __m128 maxX = _mm_set1_ps(tex.width - 1.0f);
+        const __m128 maxY = _mm_set1_ps(tex.height - 1.0f);
+        const __m128i negative = _mm_set1_epi32(-1);
+
+        for (int32_t x = start; x <= x1; x += 4) {
+            const __m128i cover = _mm_cmpgt_epi32(_mm_or_si128(_mm_or_si128(e[0], e[1]), e[2]), negative);
+
+            if (_mm_movemask_epi8(cover) != 0) {
+                const __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmplt_ps(u, one)), _mm_and_ps(_mm_cmpge_ps(v, zero), _mm_cmplt_ps(v, one)));
+                const int insideMask = _mm_movemask_ps(inside);
+
+                alignas(16) int32_t tx[4];
+                alignas(16) int32_t ty[4];
+                _mm_store_si128(reinterpret_cast<__m128i *>(tx), _mm_cvttps_epi32(_mm_min_ps(_mm_mul_ps(u, texWidth), maxX)));
+                _mm_store_si128(reinterpret_cast<__m128i *>(ty), _mm_cvttps_epi32(_mm_min_ps(_mm_mul_ps(v, texHeight), maxY)));
+
+                alignas(16) uint32_t gathered[4];
+                for (int lane = 0; lane < 4; ++lane)
+                    gathered[lane] = (insideMask & (1 << lane)) ? tex.texels[static_cast<size_t>(ty[lane]) * tex.width + tx[lane]] : 0;
+
+                __m128i texel = _mm_load_si128(reinterpret_cast<const __m128i *>(gathered));
+                if (tri.color != opaqueWhite)
+                    texel = modulateSSE2(texel, _mm_set1_epi32(static_cast<int32_t>(tri.color)));
+
+                __m128i *dst = reinterpret_cast<__m128i *>(row + x);
+                const __m128i old = _mm_loadu_si128(dst);
+                _mm_storeu_si128(dst, _mm_or_si128(_mm_and_si128(cover, texel), _mm_andnot_si128(cover, old)));
+            }
+
+            for (int k = 0; k < 3; ++k)
+                e[k] = _mm_add_epi32(e[k], step[k]);
+            u = _mm_add_ps(u, uStep);
+            v = _mm_add_ps(v, vStep);
+        }
+    }
+
+    PIXIE_TARGET_AVX2 void PixieSoftRenderer::rasterAVX2(const Triangle &tri, int32_t x0, int32_t x1, int32_t y) {
+        const PixieSoftTexture &tex = textures[tri.texture];
+        uint32_t *row = frameBuffer.data() + static_cast<size_t>(y) * pitch();
+        const int32_t start = x0 & ~7;
+
+        const __m256i laneIndex = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        __m256i e[3];
+        __m256i step[3];
+        for (int k = 0; k < 3; ++k) {
+            const __m256i s = _mm256_set1_epi32(tri.stepX[k]);
+            e[k] = _mm256_add_epi32(_mm256_set1_epi32(rowEdge(tri.stepX[k], tri.stepY[k], tri.origin[k], start, y)), _mm256_mullo_epi32(s, laneIndex));
+            step[k] = _mm256_slli_epi32(s, 3);
+        }
+
+        const __m256 lanes = _mm256_cvtepi32_ps(laneIndex);
+        __m256 u = _mm256_fmadd_ps(_mm256_set1_ps(tri.uPlane[0]), lanes, _mm256_set1_ps(tri.uPlane[0] * start + tri.uPlane[1] * y + tri.uPlane[2]));
+        __m256 v = _mm256_fmadd_ps(_mm256_set1_ps(tri.vPlane[0]), lanes, _mm256_set1_ps(tri.vPlane[0] * start + tri.vPlane[1] * y + tri.vPlane[2]));
+        const __m256 uStep = _mm256_set1_ps(tri.uPlane[0] * 8.0f);
+        const __m256 vStep = _mm256_set1_ps(tri.vPlane[0] * 8.0f);
+
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 one = _mm256_set1_ps(1.0f);
+        const __m256 texWidth = _mm256_set1_ps(static_cast<float>(tex.width));
+        const __m256 texHeight = _mm256_set1_ps(static_cast<float>(tex.height));
+        const __m256 maxX = _mm256_set1_ps(tex.width - 1.0f);
+        const __m256 maxY = _mm256_set1_ps(tex.height - 1.0f);
+        const __m256i pitchTexels = _mm256_set1_epi32(static_cast<int32_t>(tex.width));
+        const __m256i negative = _mm256_set1_epi32(-1);
+        const auto *texels = reinterpret_cast<const int *>(tex.texels.data());
+
+        for (int32_t x = start; x <= x1; x += 8) {
+            const __m256i cover = _mm256_cmpgt_epi32(_mm256_or_si256(_mm256_or_si256(e[0], e[1]), e[2]), negative);
+
+            if (!_mm256_testz_si256(cover, cover)) {
+                const __m256 inU = _mm256_and_ps(_mm256_cmp_ps(u, zero, _CMP_GE_OQ), _mm256_cmp_ps(u, one, _CMP_LT_OQ));
+                const __m256 inV = _mm256_and_ps(_mm256_cmp_ps(v, zero, _CMP_GE_OQ), _mm256_cmp_ps(v, one, _CMP_LT_OQ));
+                const __m256i inside = _mm256_and_si256(_mm256_castps_si256(_mm256_and_ps(inU, inV)), cover);
+
+                const __m256i tx = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_mul_ps(u, texWidth), maxX));
+                const __m256i ty = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_mul_ps(v, texHeight), maxY));
+                const __m256i index = _mm256_add_epi32(_mm256_mullo_epi32(ty, pitchTexels), tx);
+                __m256i texel = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), texels, index, inside, 4);
+                if (tri.color != opaqueWhite)
+                    texel = modulateAVX2(texel, _mm256_set1_epi32(static_cast<int32_t>(tri.color)));
+
+
+                __m256i *dst = reinterpret_cast<__m256i *>(row + x);
+                _mm256_storeu_si256(dst, _mm256_blendv_epi8(_mm256_loadu_si256(dst), texel, cover));
+            }
+
+            for (int k = 0; k < 3; ++k)
+                e[k] = _mm256_add_epi32(e[k], step[k]);
+            u = _mm256_add_ps(u, uStep);
+            v = _mm256_add_ps(v, vStep);
+        }
+    }
+} // namespace pxe
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "jobs.hpp"
+#include "simd.hpp"
+#include "spritebatch.hpp"
+#include "vertex.hpp"
+
+namespace pxe {
+    struct PixieSoftTexture {
+        uint32_t width;
+        uint32_t height;
+        std::vector<uint32_t> texels; // R8G8B8A8, rows tightly packed
+    };
+
+    struct PixieSoftStats {
+        uint64_t trianglesSubmitted;
+        uint64_t trianglesBinned; // survived culling and clipping, a clipped triangle counts each piece
+        uint64_t trianglesClipped; // reached past the guard band and were cut down to it
+        uint64_t binEntries; // triangles summed over every tile they touch
+        double rasterMs;
+    };
+
+    // headless backend that mirrors PixieRenderer's pipeline on the cpu
+    // VSMain passes positions through, PSMain point samples mip 0 (the gpu only differs when minifying) with a transparent black border and
+    // modulates by the flat vertex color, culling and blending are off like PixieRenderer's pipeline state
+    class PixieSoftRenderer final : public PixieBatchSink {
+    public:
+        static const uint32_t tileSize = 64;
+        static const uint32_t maxSurfaceSize = 4096;
+        static const uint32_t maxSprites = 131072; // per frame, the software ring is retired every endFrame
+
+        PixieSoftRenderer(uint32_t width, uint32_t height, size_t threadCount = 0);
+
+        uint32_t createTexture(uint32_t width, uint32_t height, const uint32_t *texels);
+
+        void beginFrame(float *color);
+        // triangle list in clip space, the texture has to stay alive until endFrame
+        void drawIndexed(const PixieVertexData *vertices, const uint16_t *indices, uint32_t indexCount, uint32_t texture);
+        bool drawSprite(uint32_t texture, const PixieRect &rect, const PixieRect &uv, uint32_t color, const PixieTransform2D &transform, uint32_t layer = 0, float depth = 0.0f);
+        // sprites and transforms have to stay alive until endFrame
+        bool drawSprites(uint32_t texture, const PixieSpriteArrays &sprites, const PixieTransformHierarchy *transforms = nullptr, uint32_t layer = 0, float depth = 0.0f);
+        void drawQuads(const PixieDrawRun &run) override;
+        void endFrame();
+
+        void setSIMDLevel(PixieSIMDLevel level) { simdLevel = level; sprites.setSIMDLevel(level); }
+        PixieSIMDLevel getSIMDLevel() const { return simdLevel; }
+
+        // rows are pitch pixels apart, padding past the surface width is undefined
+        const uint32_t *pixels() const { return frameBuffer.data(); }
+        uint32_t pitch() const { return tilesX * tileSize; }
+        uint32_t width() const { return surfaceWidth; }
+        uint32_t height() const { return surfaceHeight; }
+        size_t threadCount() const { return jobPool.threadCount(); }
+        const PixieSoftStats &stats() const { return frameStats; }
+        const PixieBatchStats &spriteStats() const { return sprites.stats(); }
+
+    private:
+        // edges are kept in 28.4 fixed point, E(x, y) = stepX * x + stepY * y + origin with the top-left bias folded in
+        // uv is interpolated from planes over whole pixel coordinates so big triangles don't need the raw edge values
+        struct Triangle {
+            int32_t minX;
+            int32_t minY;
+            int32_t maxX;
+            int32_t maxY;
+            int32_t stepX[3];
+            int32_t stepY[3];
+            int64_t origin[3];
+            float uPlane[3]; // d/dx, d/dy, value at pixel 0,0
+            float vPlane[3];
+            uint32_t texture;
+            uint32_t color;
+        };
+
+        // pixel position and uv after the viewport transform
+        struct ScreenVertex {
+            float x;
+            float y;
+            float u;
+            float v;
+        };
+
+        static const uint32_t maxClipVertices = 8; // a triangle gains at most one vertex per guard band edge
+
+        // sutherland hodgman against one guard band edge, keeps what lies on the side where
+        // side * (coordinate - bound) <= 0. axis 0 clips x, 1 clips y
+        static uint32_t clipPolygon(const ScreenVertex *in, uint32_t count, ScreenVertex *out, int axis, float bound, float side);
+        void binTriangle(const ScreenVertex &v0, const ScreenVertex &v1, const ScreenVertex &v2, uint32_t texture, uint32_t color);
+        void rasterTile(uint32_t tile);
+        void rasterScalar(const Triangle &tri, int32_t x0, int32_t x1, int32_t y);
+        void rasterSSE2(const Triangle &tri, int32_t x0, int32_t x1, int32_t y);
+        void rasterAVX2(const Triangle &tri, int32_t x0, int32_t x1, int32_t y);
+
+        uint32_t surfaceWidth;
+        uint32_t surfaceHeight;
+        uint32_t tilesX;
+        uint32_t tilesY;
+        uint32_t clearColor;
+        PixieSIMDLevel simdLevel;
+
+        std::vector<uint32_t> frameBuffer;
+        std::vector<PixieSoftTexture> textures;
+        std::vector<Triangle> triangles;
+        std::vector<std::vector<uint32_t>> bins; // triangle indices per tile in submission order
+        std::vector<PixieVertexData> spriteRing;
+        std::vector<uint16_t> quadIndices;
+        PixieSpriteBatch sprites;
+        PixieSoftStats frameStats;
+        PixieJobPool jobPool;
+    };
+} // namespace pxe
@@ -0,0 +1,7 @@
+#pragma once
+
+// everything the game needs for sound, the mixer, streaming from wav files and the xaudio2 device it plays through
+#include "audio.hpp"
+#include "audiostream.hpp"
+#include "wav.hpp"
+#include "xaudio2backend.hpp"
@@ -0,0 +1,375 @@
+#include "spatial.hpp"
+#include "profiler.hpp"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace pxe {
+    // past this a coordinate is clamped, keeps the cell maths in int32 for worlds of any size
+    static const float coordinateLimit = 1073741824.0f;
+
+    struct CullSpan {
+        const float *minX;
+        const float *minY;
+        const float *maxX;
+        const float *maxY;
+        const uint32_t *items;
+        uint32_t count;
+        float viewMinX;
+        float viewMinY;
+        float viewMaxX;
+        float viewMaxY;
+        uint32_t *out; // room for count items
+    };
+
+    // from rect `first` on, appending after `written`. the store always happens and only the count moves,
+    // visibility is too random for a branch to predict
+    static uint32_t cullSpanScalar(const CullSpan &span, uint32_t first, uint32_t written) {
+        for (uint32_t i = first; i < span.count; ++i) {
+            const bool visible = span.minX[i] <= span.viewMaxX && span.maxX[i] >= span.viewMinX && span.minY[i] <= span.viewMaxY &&
+                span.maxY[i] >= span.viewMinY;
+            span.out[written] = span.items[i];
+            written += visible ? 1 : 0;
+        }
+        return written;
+    }
+
+    // lanes of a movemask to output, all visible and none visible are by far the common cases
+    static uint32_t compact(const uint32_t *items, uint32_t lanes, uint32_t mask, uint32_t *out) {
+        if (mask == (1u << lanes) - 1) {
+            for (uint32_t j = 0; j < lanes; ++j)
+                out[j] = items[j];
+            return lanes;
+        }
+
+        uint32_t written = 0;
+        for (uint32_t j = 0; j < lanes; ++j) {
+            out[written] = items[j];
+            written += mask >> j & 1;
+        }
+        return written;
+    }
+
+    static uint32_t cullSpanSSE2(const CullSpan &span) {
+        const __m128 viewMinX = _mm_set1_ps(span.viewMinX);
+        const __m128 viewMinY = _mm_set1_ps(span.viewMinY);
+        const __m128 viewMaxX = _mm_set1_ps(span.viewMaxX);
+        const __m128 viewMaxY = _mm_set1_ps(span.viewMaxY);
+
+        uint32_t i = 0;
+        uint32_t written = 0;
+        for (; i + 4 <= span.count; i += 4) {
+            const __m128 x = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(span.minX + i), viewMaxX), _mm_cmpge_ps(_mm_loadu_ps(span.maxX + i), viewMinX));
+            const __m128 y = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(span.minY + i), viewMaxY), _mm_cmpge_ps(_mm_loadu_ps(span.maxY + i), viewMinY));
+            const auto mask = static_cast<uint32_t>(_mm_movemask_ps(_mm_and_ps(x, y)));
+            if (mask != 0)
+                written += compact(span.items + i, 4, mask, span.out + written);
+        }
+        return cullSpanScalar(span, i, written);
+    }
+
+    PIXIE_TARGET_AVX2 static uint32_t cullSpanAVX2(const CullSpan &span) {
+        const __m256 viewMinX = _mm256_set1_ps(span.viewMinX);
+        const __m256 viewMinY = _mm256_set1_ps(span.viewMinY);
+        const __m256 viewMaxX = _mm256_set1_ps(span.viewMaxX);
+        const __m256 viewMaxY = _mm256_set1_ps(span.viewMaxY);
+
+        uint32_t i = 0;
+        uint32_t written = 0;
+        for (; i + 8 <= span.count; i += 8) {
+            const __m256 x = _mm256_and_ps(_mm256_cmp_ps(_mm256_loadu_ps(span.minX + i), viewMaxX, _CMP_LE_OQ),
+                _mm256_cmp_ps(_mm256_loadu_ps(span.maxX + i), viewMinX, _CMP_GE_OQ));
+            const __m256 y = _mm256_and_ps(_mm256_cmp_ps(_mm256_loadu_ps(span.minY + i), viewMaxY, _CMP_LE_OQ),
+                _mm256_cmp_ps(_mm256_loadu_ps(span.maxY + i), viewMinY, _CMP_GE_OQ));
+            const auto mask = static_cast<uint32_t>(_mm256_movemask_ps(_mm256_and_ps(x, y)));
+            if (mask != 0)
+                written += compact(span.items + i, 8, mask, span.out + written);
+        }
+        // the tail is sse code, dirty upper halves would make every legacy instruction in it pay a transition
+        _mm256_zeroupper();
+        return cullSpanScalar(span, i, written);
+    }
+
+    PixieSpatialGrid::PixieSpatialGrid(float cellSize, PixieSIMDLevel level)
+        : cellExtent(cellSize)
+        , inverseCellExtent(1.0f / cellSize)
+        , simdLevel(level)
+        , cellMoves(0) {
+
+        if (!(cellSize > 0.0f))
+            throw std::invalid_argument("PixieSpatialGrid: cell size has to be positive");
+        clear();
+    }
+
+    PixieProxyId PixieSpatialGrid::insert(const PixieRect &bounds, uint32_t item) {
+        const PixieProxyId proxy = allocate();
+        push(proxy, cellFor(bounds), bounds, item);
+        return proxy;
+    }
+
+    void PixieSpatialGrid::insert(const PixieRect *bounds, const uint32_t *items, size_t count, PixieProxyId *ids) {
+        PIXIE_ZONE("spatial bulk insert");
+
+        // one at a time, every insert lands in a random cell and misses on its hash node and all six columns.
+        // sorted by cell each cell is looked up once, sized once and then written front to back
+        std::vector<std::pair<uint64_t, uint32_t>> order;
+        order.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            const PixieRect &rect = bounds[i];
+            if (fits(rect)) {
+                order.push_back({cellKey(cellCoordinate(rect.x + rect.width * 0.5f), cellCoordinate(rect.y + rect.height * 0.5f)), static_cast<uint32_t>(i)});
+            } else {
+                const PixieProxyId proxy = insert(rect, items[i]);
+                if (ids)
+                    ids[i] = proxy;
+            }
+        }
+        std::sort(order.begin(), order.end());
+
+        for (size_t first = 0; first < order.size();) {
+            size_t last = first + 1;
+            while (last < order.size() && order[last].first == order[first].first)
+                ++last;
+
+            const uint32_t cell = cellFor(bounds[order[first].second]);
+            Cell &target = cells[cell];
+            const size_t reserve = target.items.size() + (last - first);
+            target.minX.reserve(reserve);
+            target.minY.reserve(reserve);
+            target.maxX.reserve(reserve);
+            target.maxY.reserve(reserve);
+            target.items.reserve(reserve);
+            target.proxies.reserve(reserve);
+
+            for (size_t i = first; i < last; ++i) {
+                const uint32_t index = order[i].second;
+                const PixieProxyId proxy = allocate();
+                push(proxy, cell, bounds[index], items[index]);
+                if (ids)
+                    ids[index] = proxy;
+            }
+            first = last;
+        }
+    }
+
+    void PixieSpatialGrid::update(PixieProxyId proxy, const PixieRect &bounds) {
+        const Proxy current = proxies.at(proxy);
+        if (current.cell == noCell)
+            throw std::invalid_argument("PixieSpatialGrid: proxy was removed");
+
+        bool stays;
+        if (fits(bounds)) {
+            const Cell &cell = cells[current.cell];
+            stays = current.cell != oversizedCell && cell.x == cellCoordinate(bounds.x + bounds.width * 0.5f) &&
+                cell.y == cellCoordinate(bounds.y + bounds.height * 0.5f);
+        } else {
+            stays = current.cell == oversizedCell;
+        }
+
+        if (stays) {
+            Cell &cell = cells[current.cell];
+            cell.minX[current.slot] = bounds.x;
+            cell.minY[current.slot] = bounds.y;
+            cell.maxX[current.slot] = bounds.x + bounds.width;
+            cell.maxY[current.slot] = bounds.y + bounds.height;
+            return;
+        }
+
+        const uint32_t item = erase(proxy);
+        push(proxy, cellFor(bounds), bounds, item);
+        cellMoves++;
+    }
+
+    void PixieSpatialGrid::remove(PixieProxyId proxy) {
+        if (proxies.at(proxy).cell == noCell)
+            throw std::invalid_argument("PixieSpatialGrid: proxy was removed");
+
+        erase(proxy);
+        proxies[proxy].cell = noCell;
+        freeProxies.push_back(proxy);
+    }
+
+    PixieCullStats PixieSpatialGrid::query(const PixieRect &view, std::vector<uint32_t> &visible) const {
+        PIXIE_ZONE("spatial query");
+        visible.clear();
+        PixieCullStats result = {};
+
+        const float viewMaxX = view.x + view.width;
+        const float viewMaxY = view.y + view.height;
+
+        // everything in a cell lies within half a cell of it, so that's how far past the view cells can reach in from
+        const auto visit = [&](const Cell &cell) {
+            if (cell.items.empty())
+                return;
+
+            const float looseMinX = (float(cell.x) - 0.5f) * cellExtent;
+            const float looseMinY = (float(cell.y) - 0.5f) * cellExtent;
+            const float looseMaxX = (float(cell.x) + 1.5f) * cellExtent;
+            const float looseMaxY = (float(cell.y) + 1.5f) * cellExtent;
+            if (looseMinX > viewMaxX || looseMaxX < view.x || looseMinY > viewMaxY || looseMaxY < view.y)
+                return;
+
+            result.cellsVisited++;
+            if (looseMinX >= view.x && looseMaxX <= viewMaxX && looseMinY >= view.y && looseMaxY <= viewMaxY) {
+                result.cellsInside++;
+                visible.insert(visible.end(), cell.items.begin(), cell.items.end());
+                return;
+            }
+
+            result.tested += static_cast<uint32_t>(cell.items.size());
+            const size_t start = visible.size();
+            visible.resize(start + cell.items.size());
+            visible.resize(start + cull(cell, view, visible.data() + start));
+        };
+
+        // oversized proxies first, they have no cell of their own
+        const Cell &oversized = cells[oversizedCell];
+        if (!oversized.items.empty()) {
+            result.cellsVisited++;
+            result.tested += static_cast<uint32_t>(oversized.items.size());
+            visible.resize(oversized.items.size());
+            visible.resize(cull(oversized, view, visible.data()));
+        }
+
+        const int32_t firstX = cellCoordinate(view.x - cellExtent * 1.5f);
+        const int32_t firstY = cellCoordinate(view.y - cellExtent * 1.5f);
+        const int32_t lastX = cellCoordinate(viewMaxX + cellExtent * 0.5f);
+        const int32_t lastY = cellCoordinate(viewMaxY + cellExtent * 0.5f);
+        const double span = (double(lastX) - firstX + 1.0) * (double(lastY) - firstY + 1.0);
+
+        // zoomed far out the view can cover more cells than exist, walking the occupied ones is cheaper then
+        if (span > double(cells.size())) {
+            for (size_t i = oversizedCell + 1; i < cells.size(); ++i)
+                visit(cells[i]);
+        } else {
+            for (int32_t y = firstY; y <= lastY; ++y) {
+                for (int32_t x = firstX; x <= lastX; ++x) {
+                    const auto found = cellIndex.find(cellKey(x, y));
+                    if (found != cellIndex.end())
+                        visit(cells[found->second]);
+                }
+            }
+        }
+
+        result.visible = static_cast<uint32_t>(visible.size());
+        return result;
+    }
+
+    void PixieSpatialGrid::clear() {
+        cells.clear();
+        cells.emplace_back(); // the oversized list
+        cellIndex.clear();
+        proxies.clear();
+        freeProxies.clear();
+    }
+
+    PixieSpatialStats PixieSpatialGrid::stats() const {
+        PixieSpatialStats result = {};
+        result.proxies = size();
+        result.cells = cells.size() - 1;
+        result.oversized = cells[oversizedCell].items.size();
+        result.cellMoves = cellMoves;
+        result.memoryBytes = sizeof(*this) + cells.capacity() * sizeof(Cell) + proxies.capacity() * sizeof(Proxy) +
+            freeProxies.capacity() * sizeof(PixieProxyId) + cellIndex.size() * (sizeof(uint64_t) + sizeof(uint32_t) + 2 * sizeof(void *));
+        for (const Cell &cell : cells) {
+            result.memoryBytes += (cell.minX.capacity() + cell.minY.capacity() + cell.maxX.capacity() + cell.maxY.capacity()) * sizeof(float) +
+                (cell.items.capacity() + cell.proxies.capacity()) * sizeof(uint32_t);
+        }
+        return result;
+    }
+
+    int32_t PixieSpatialGrid::cellCoordinate(float value) const {
+        const float cell = std::floor(value * inverseCellExtent);
+        if (!(cell > -coordinateLimit))
+            return -static_cast<int32_t>(coordinateLimit);
+        if (cell > coordinateLimit)
+            return static_cast<int32_t>(coordinateLimit);
+        return static_cast<int32_t>(cell);
+    }
+
+    uint32_t PixieSpatialGrid::cellFor(const PixieRect &bounds) {
+        if (!fits(bounds))
+            return oversizedCell;
+
+        const int32_t x = cellCoordinate(bounds.x + bounds.width * 0.5f);
+        const int32_t y = cellCoordinate(bounds.y + bounds.height * 0.5f);
+        const auto [found, added] = cellIndex.try_emplace(cellKey(x, y), static_cast<uint32_t>(cells.size()));
+        if (added) {
+            cells.emplace_back();
+            cells.back().x = x;
+            cells.back().y = y;
+        }
+        return found->second;
+    }
+
+    PixieProxyId PixieSpatialGrid::allocate() {
+        if (freeProxies.empty()) {
+            proxies.push_back({noCell, 0});
+            return static_cast<PixieProxyId>(proxies.size() - 1);
+        }
+
+        const PixieProxyId proxy = freeProxies.back();
+        freeProxies.pop_back();
+        return proxy;
+    }
+
+    void PixieSpatialGrid::push(PixieProxyId proxy, uint32_t cell, const PixieRect &bounds, uint32_t item) {
+        Cell &target = cells[cell];
+        proxies[proxy] = {cell, static_cast<uint32_t>(target.items.size())};
+        target.minX.push_back(bounds.x);
+        target.minY.push_back(bounds.y);
+        target.maxX.push_back(bounds.x + bounds.width);
+        target.maxY.push_back(bounds.y + bounds.height);
+        target.items.push_back(item);
+        target.proxies.push_back(proxy);
+    }
+
+    uint32_t PixieSpatialGrid::erase(PixieProxyId proxy) {
+        const Proxy current = proxies[proxy];
+        Cell &cell = cells[current.cell];
+        const uint32_t item = cell.items[current.slot];
+        const size_t last = cell.items.size() - 1;
+
+        if (current.slot != last) {
+            cell.minX[current.slot] = cell.minX[last];
+            cell.minY[current.slot] = cell.minY[last];
+            cell.maxX[current.slot] = cell.maxX[last];
+            cell.maxY[current.slot] = cell.maxY[last];
+            cell.items[current.slot] = cell.items[last];
+            cell.proxies[current.slot] = cell.proxies[last];
+            proxies[cell.proxies[last]].slot = current.slot;
+        }
+
+        cell.minX.pop_back();
+        cell.minY.pop_back();
+        cell.maxX.pop_back();
+        cell.maxY.pop_back();
+        cell.items.pop_back();
+        cell.proxies.pop_back();
+        return item;
+    }
+
+    uint32_t PixieSpatialGrid::cull(const Cell &cell, const PixieRect &view, uint32_t *out) const {
+        CullSpan span;
+        span.minX = cell.minX.data();
+        span.minY = cell.minY.data();
+        span.maxX = cell.maxX.data();
+        span.maxY = cell.maxY.data();
+        span.items = cell.items.data();
+        span.count = static_cast<uint32_t>(cell.items.size());
+        span.viewMinX = view.x;
+        span.viewMinY = view.y;
+        span.viewMaxX = view.x + view.width;
+        span.viewMaxY = view.y + view.height;
+        span.out = out;
+
+        switch (simdLevel) {
+            case PixieSIMDLevel::AVX2:
+                return cullSpanAVX2(span);
+            case PixieSIMDLevel::SSE2:
+                return cullSpanSSE2(span);
+            default:
+                return cullSpanScalar(span, 0, 0);
+        }
+    }
+} // namespace pxe
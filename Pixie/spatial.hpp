@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+#include "simd.hpp"
+#include "spritebatch.hpp"
+
+namespace pxe {
+    using PixieProxyId = uint32_t;
+
+    static const PixieProxyId invalidProxy = UINT32_MAX;
+
+    struct PixieSpatialStats {
+        size_t proxies;
+        size_t cells; // ones that were ever used, empty cells stay around for whatever moves back in
+        size_t oversized; // too big for a cell, tested on every query
+        uint64_t cellMoves; // updates that took a proxy to another cell
+        size_t memoryBytes;
+    };
+
+    struct PixieCullStats {
+        uint32_t cellsVisited;
+        uint32_t cellsInside; // wholly in view, taken without testing a single rect
+        uint32_t tested;
+        uint32_t visible;
+    };
+
+    // loose uniform grid over an unbounded 2D world, cells hashed by coordinate so only occupied ones cost memory.
+    // a proxy lives in the cell holding its centre and may stick out of it by up to half a cell, so a query only has
+    // to look one cell past the view. each cell keeps its rects as separate min and max columns for the simd cull
+    class PixieSpatialGrid {
+    public:
+        // cells should be about as large as the biggest common object, anything larger than a cell goes on a list
+        // that every query tests
+        explicit PixieSpatialGrid(float cellSize = 256.0f, PixieSIMDLevel level = detectSIMDLevel());
+
+        // item is whatever the caller wants back from queries, a sprite or entity index
+        PixieProxyId insert(const PixieRect &bounds, uint32_t item);
+        // loads a batch cell by cell, far quicker than one at a time for static maps. ids may be null
+        void insert(const PixieRect *bounds, const uint32_t *items, size_t count, PixieProxyId *ids);
+        // rewrites the rect in place while the centre stays in its cell, which for moving objects is nearly always
+        void update(PixieProxyId proxy, const PixieRect &bounds);
+        void remove(PixieProxyId proxy);
+
+        // replaces visible with the items of every proxy overlapping view, touching edges count.
+        // the cost follows the cells around the view and what is in them, not how many proxies the grid holds
+        PixieCullStats query(const PixieRect &view, std::vector<uint32_t> &visible) const;
+
+        void clear();
+        float cellSize() const { return cellExtent; }
+        size_t size() const { return proxies.size() - freeProxies.size(); }
+        void setSIMDLevel(PixieSIMDLevel level) { simdLevel = level; }
+        PixieSIMDLevel getSIMDLevel() const { return simdLevel; }
+        PixieSpatialStats stats() const;
+
+    private:
+        static const uint32_t oversizedCell = 0; // cells[0] is the list of proxies too big for the grid
+        static const uint32_t noCell = UINT32_MAX;
+
+        struct Cell {
+            int32_t x;
+            int32_t y;
+            std::vector<float> minX;
+            std::vector<float> minY;
+            std::vector<float> maxX;
+            std::vector<float> maxY;
+            std::vector<uint32_t> items;
+            std::vector<PixieProxyId> proxies; // back to the owner when a swap fills a hole
+        };
+
+        struct Proxy {
+            uint32_t cell; // noCell while the id is free
+            uint32_t slot;
+        };
+
+        static uint64_t cellKey(int32_t x, int32_t y) { return uint64_t(uint32_t(x)) << 32 | uint32_t(y); }
+        int32_t cellCoordinate(float value) const;
+        bool fits(const PixieRect &bounds) const { return bounds.width <= cellExtent && bounds.height <= cellExtent; }
+        uint32_t cellFor(const PixieRect &bounds);
+        PixieProxyId allocate();
+        void push(PixieProxyId proxy, uint32_t cell, const PixieRect &bounds, uint32_t item);
+        // swaps the cell's last proxy into the hole, returns the item that was there
+        uint32_t erase(PixieProxyId proxy);
+        uint32_t cull(const Cell &cell, const PixieRect &view, uint32_t *out) const;
+
+        float cellExtent;
+        float inverseCellExtent;
+        PixieSIMDLevel simdLevel;
+        std::vector<Cell> cells;
+        std::unordered_map<uint64_t, uint32_t> cellIndex;
+        std::vector<Proxy> proxies;
+        std::vector<PixieProxyId> freeProxies;
+        uint64_t cellMoves;
+    };
+} // namespace pxe
@@ -0,0 +1,280 @@
+#include "spritebatch.hpp"
+#include <stdexcept>
+#include "transform2d.hpp"
+
+namespace pxe {
+    // rounded the same as expandSpritesCompact
+    static uint32_t unorm16(float value) {
+        const float clamped = value > 0.0f ? (value < 1.0f ? value : 1.0f) : 0.0f;
+        return static_cast<uint32_t>(clamped * 65535.0f + 0.5f);
+    }
+
+    PixieSpriteBatch::PixieSpriteBatch()
+        : PixieSpriteBatch(static_cast<PixieVertexData *>(nullptr), 0) {
+    }
+
+    PixieSpriteBatch::PixieSpriteBatch(PixieVertexData *ring, uint32_t vertexCapacity)
+        : ring(nullptr)
+        , compact(nullptr)
+        , capacity(0)
+        , head(0)
+        , tail(0)
+        , clipScaleX(1.0f)
+        , clipScaleY(-1.0f)
+        , pendingQuads(0)
+        , simdLevel(detectSIMDLevel())
+        , currentRun {}
+        , runOpen(false)
+        , frameStats {} {
+
+        setRing(ring, vertexCapacity);
+    }
+
+    PixieSpriteBatch::PixieSpriteBatch(PixieCompactVertex *ring, uint32_t vertexCapacity)
+        : PixieSpriteBatch() {
+        setRing(ring, vertexCapacity);
+    }
+
+    void PixieSpriteBatch::setRing(PixieVertexData *ring, uint32_t vertexCapacity) {
+        attach(ring, nullptr, ring ? vertexCapacity : 0);
+    }
+
+    void PixieSpriteBatch::setRing(PixieCompactVertex *ring, uint32_t vertexCapacity) {
+        attach(nullptr, ring, ring ? vertexCapacity : 0);
+    }
+
+    void PixieSpriteBatch::attach(PixieVertexData *full, PixieCompactVertex *compact, uint32_t vertexCapacity) {
+        if (runOpen || !runs.empty() || pendingQuads != 0)
+            throw std::logic_error("PixieSpriteBatch: ring changed with draws pending");
+
+        ring = full;
+        this->compact = compact;
+        capacity = vertexCapacity & ~3u; // whole quads only, so a quad never straddles the wrap
+        head = 0;
+        tail = 0;
+    }
+
+    void PixieSpriteBatch::begin(float viewportWidth, float viewportHeight) {
+        clipScaleX = 2.0f / viewportWidth;
+        clipScaleY = -2.0f / viewportHeight;
+        frameStats = {};
+    }
+
+    bool PixieSpriteBatch::drawSprite(uint32_t texture, const PixieRect &rect, const PixieRect &uv, uint32_t color, const PixieTransform2D &transform, uint32_t state, uint32_t layer, float depth) {
+        // room is claimed now so flush never runs out of ring halfway through
+        if (capacity == 0 || head - tail + (uint64_t(pendingQuads) + 1) * 4 > capacity) {
+            frameStats.dropped++;
+            return false;
+        }
+
+        queue.push(PixieSortKey::make(layer, state, texture, depth), static_cast<uint32_t>(queued.size()));
+        queued.push_back({rect, uv, transform, texture, state, color});
+        pendingQuads++;
+
+        frameStats.sprites++;
+        return true;
+    }
+
+    bool PixieSpriteBatch::drawSprites(uint32_t texture, const PixieSpriteArrays &sprites, const PixieTransformHierarchy *transforms, uint32_t state, uint32_t layer, float depth) {
+        const size_t count = sprites.size();
+        if (count == 0)
+            return true;
+        if (capacity == 0 || head - tail + (uint64_t(pendingQuads) + count) * 4 > capacity) {
+            frameStats.dropped += static_cast<uint32_t>(count);
+            return false;
+        }
+
+        queue.push(PixieSortKey::make(layer, state, texture, depth), bulkPayload | static_cast<uint32_t>(bulks.size()));
+        bulks.push_back({&sprites, transforms, texture, state});
+        pendingQuads += static_cast<uint32_t>(count);
+
+        frameStats.sprites += static_cast<uint32_t>(count);
+        return true;
+    }
+
+    void PixieSpriteBatch::flush(PixieBatchSink &sink) {
+        record(sink, 0, prepare());
+        runs.clear();
+    }
+
+    size_t PixieSpriteBatch::prepare() {
+        runs.clear();
+
+        for (const PixieDrawPacket &packet : queue.sort()) {
+            if (packet.payload & bulkPayload) {
+                writeBulk(bulks[packet.payload & ~bulkPayload]);
+                continue;
+            }
+            const Sprite &sprite = queued[packet.payload];
+            writeQuad(allocateQuad(sprite.texture, sprite.state), sprite);
+        }
+        queue.clear();
+        queued.clear();
+        bulks.clear();
+        pendingQuads = 0;
+        closeRun();
+
+        // binds as a single list would see them, ranges recorded elsewhere add one of each at their start
+        for (size_t i = 0; i < runs.size(); ++i) {
+            frameStats.stateChanges += i == 0 || runs[i].state != runs[i - 1].state;
+            frameStats.textureChanges += i == 0 || runs[i].texture != runs[i - 1].texture;
+        }
+        frameStats.draws += static_cast<uint32_t>(runs.size());
+
+        return runs.size();
+    }
+
+    void PixieSpriteBatch::record(PixieBatchSink &sink, size_t first, size_t count) const {
+        if (first > runs.size() || count > runs.size() - first)
+            throw std::out_of_range("PixieSpriteBatch: run range past the prepared runs");
+
+        for (size_t i = first; i < first + count; ++i) {
+            const PixieDrawRun &run = runs[i];
+            if (i == first || run.state != runs[i - 1].state)
+                sink.setState(run.state);
+            if (i == first || run.texture != runs[i - 1].texture)
+                sink.setTexture(run.texture);
+            sink.drawQuads(run);
+        }
+    }
+
+    void PixieSpriteBatch::release(uint64_t marker) {
+        if (marker > head || marker < tail)
+            throw std::out_of_range("PixieSpriteBatch: bad ring marker");
+
+        tail = marker;
+    }
+
+    void PixieSpriteBatch::writeQuadIndices(uint16_t *indices, uint32_t quadCount) {
+        for (uint32_t i = 0; i < quadCount; ++i) {
+            const auto base = static_cast<uint16_t>(i * 4);
+            indices[0] = base;
+            indices[1] = base + 1;
+            indices[2] = base + 2;
+            indices[3] = base;
+            indices[4] = base + 2;
+            indices[5] = base + 3;
+            indices += indicesPerQuad;
+        }
+    }
+
+    uint32_t PixieSpriteBatch::allocateQuad(uint32_t texture, uint32_t state) {
+        uint32_t allocated;
+        return allocateQuads(texture, state, 1, allocated);
+    }
+
+    uint32_t PixieSpriteBatch::allocateQuads(uint32_t texture, uint32_t state, uint32_t wanted, uint32_t &allocated) {
+        allocated = 0;
+        if (capacity == 0 || wanted == 0 || head - tail + 4 > capacity)
+            return 0;
+
+        const auto offset = static_cast<uint32_t>(head % capacity);
+
+        // a new run starts on a texture/state change, a full run or when the ring wraps
+        if (runOpen) {
+            const bool contiguous = offset == currentRun.firstVertex + currentRun.quadCount * 4;
+            if (currentRun.texture != texture || currentRun.state != state || currentRun.quadCount == maxQuadsPerRun || !contiguous)
+                closeRun();
+        }
+
+        if (!runOpen) {
+            currentRun = {texture, state, offset, 0};
+            runOpen = true;
+        }
+
+        // as many as the run, the ring's end and the released space allow
+        const uint32_t runRoom = maxQuadsPerRun - currentRun.quadCount;
+        const uint32_t endRoom = (capacity - offset) / 4;
+        const auto freeRoom = static_cast<uint32_t>((capacity - (head - tail)) / 4);
+        allocated = wanted < runRoom ? wanted : runRoom;
+        allocated = allocated < endRoom ? allocated : endRoom;
+        allocated = allocated < freeRoom ? allocated : freeRoom;
+
+        currentRun.quadCount += allocated;
+        head += uint64_t(allocated) * 4;
+
+        return offset;
+    }
+
+    void PixieSpriteBatch::writeBulk(const Bulk &bulk) {
+        PixieTransformColumns columns;
+        if (bulk.transforms)
+            columns = bulk.transforms->worldColumns();
+
+        // room was claimed at draw time, so this only splits where runs fill or the ring wraps
+        const size_t count = bulk.sprites->size();
+        size_t written = 0;
+        while (written < count) {
+            const size_t left = count - written;
+            uint32_t allocated;
+            const uint32_t vertex = allocateQuads(bulk.texture, bulk.state, left < maxQuadsPerRun ? static_cast<uint32_t>(left) : maxQuadsPerRun, allocated);
+            if (allocated == 0)
+                throw std::logic_error("PixieSpriteBatch: sprite arrays grew after drawSprites");
+
+            const PixieTransformColumns *world = bulk.transforms ? &columns : nullptr;
+            if (compact)
+                expandSpritesCompact(*bulk.sprites, written, allocated, world, clipScaleX, clipScaleY, compact + vertex, simdLevel);
+            else
+                expandSprites(*bulk.sprites, written, allocated, world, clipScaleX, clipScaleY, ring + vertex, simdLevel);
+            written += allocated;
+        }
+    }
+
+    void PixieSpriteBatch::writeQuad(uint32_t vertex, const Sprite &sprite) const {
+        const PixieTransform2D &transform = sprite.transform;
+        const PixieRect &rect = sprite.rect;
+        const PixieRect &uv = sprite.uv;
+
+        // fold the pixel to clip space mapping into the sprite transform
+        const float a = transform.a * clipScaleX;
+        const float b = transform.b * clipScaleY;
+        const float c = transform.c * clipScaleX;
+        const float d = transform.d * clipScaleY;
+        const float tx = transform.tx * clipScaleX - 1.0f;
+        const float ty = transform.ty * clipScaleY + 1.0f;
+
+        const float x0 = rect.x;
+        const float y0 = rect.y;
+        const float x1 = rect.x + rect.width;
+        const float y1 = rect.y + rect.height;
+        const float u0 = uv.x;
+        const float v0 = uv.y;
+        const float u1 = uv.x + uv.width;
+        const float v1 = uv.y + uv.height;
+
+        const PixieFloat2 corners[4] = {
+            {a * x0 + c * y0 + tx, b * x0 + d * y0 + ty},
+            {a * x1 + c * y0 + tx, b * x1 + d * y0 + ty},
+            {a * x1 + c * y1 + tx, b * x1 + d * y1 + ty},
+            {a * x0 + c * y1 + tx, b * x0 + d * y1 + ty},
+        };
+
+        if (compact) {
+            const uint32_t left = unorm16(u0);
+            const uint32_t right = unorm16(u1);
+            const uint32_t top = unorm16(v0) << 16;
+            const uint32_t bottom = unorm16(v1) << 16;
+
+            PixieCompactVertex *quad = compact + vertex;
+            quad[0] = {corners[0], left | top, sprite.color};
+            quad[1] = {corners[1], right | top, sprite.color};
+            quad[2] = {corners[2], right | bottom, sprite.color};
+            quad[3] = {corners[3], left | bottom, sprite.color};
+            return;
+        }
+
+        // top left, top right, bottom right, bottom left
+        PixieVertexData *quad = ring + vertex;
+        quad[0] = {{corners[0].x, corners[0].y, 0.0f}, {u0, v0}, sprite.color};
+        quad[1] = {{corners[1].x, corners[1].y, 0.0f}, {u1, v0}, sprite.color};
+        quad[2] = {{corners[2].x, corners[2].y, 0.0f}, {u1, v1}, sprite.color};
+        quad[3] = {{corners[3].x, corners[3].y, 0.0f}, {u0, v1}, sprite.color};
+    }
+
+    void PixieSpriteBatch::closeRun() {
+        if (runOpen && currentRun.quadCount != 0)
+            runs.push_back(currentRun);
+
+        runOpen = false;
+    }
+} // namespace pxe
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "drawqueue.hpp"
+#include "simd.hpp"
+#include "vertex.hpp"
+
+namespace pxe {
+    struct PixieSpriteArrays;
+    class PixieTransformHierarchy;
+
+    struct PixieRect {
+        float x;
+        float y;
+        float width;
+        float height;
+    };
+
+    // 2D affine transform, x' = a * x + c * y + tx and y' = b * x + d * y + ty
+    struct PixieTransform2D {
+        float a, b;
+        float c, d;
+        float tx, ty;
+
+        static PixieTransform2D identity() { return {1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f}; }
+    };
+
+    // a run of quads sharing texture and state, contiguous in the vertex ring
+    struct PixieDrawRun {
+        uint32_t texture;
+        uint32_t state;
+        uint32_t firstVertex;
+        uint32_t quadCount;
+    };
+
+    struct PixieBatchStats {
+        uint32_t sprites;
+        uint32_t draws;
+        uint32_t dropped; // the ring had no room left for these
+        uint32_t stateChanges; // binds the sink actually saw, repeats are dropped
+        uint32_t textureChanges;
+    };
+
+    // implemented by each backend, one call per run with the quad indices bound as a static buffer.
+    // setState and setTexture only come when the value differs from the run before, the first run of a flush binds both
+    class PixieBatchSink {
+    public:
+        virtual ~PixieBatchSink() = default;
+        virtual void setState(uint32_t) {}
+        virtual void setTexture(uint32_t) {}
+        virtual void drawQuads(const PixieDrawRun &run) = 0;
+    };
+
+    // queues sprites under a sort key, then at flush writes them in key order into a persistently mapped vertex ring
+    // and merges them into runs. the ring holds either full vertices or 16 byte compact ones, gpu backends take the
+    // compact ring so bulk sprites go out at a cache line each
+    class PixieSpriteBatch {
+    public:
+        static const uint32_t maxQuadsPerRun = 16384; // keeps every index inside uint16
+        static const uint32_t indicesPerQuad = 6;
+
+        PixieSpriteBatch();
+        PixieSpriteBatch(PixieVertexData *ring, uint32_t vertexCapacity);
+        PixieSpriteBatch(PixieCompactVertex *ring, uint32_t vertexCapacity);
+
+        // the backend owns the memory, the batch only tracks what it wrote
+        void setRing(PixieVertexData *ring, uint32_t vertexCapacity);
+        // uv has to stay inside [0, 1], it's stored as R16G16_UNORM
+        void setRing(PixieCompactVertex *ring, uint32_t vertexCapacity);
+        bool compactRing() const { return compact != nullptr; }
+
+        void begin(float viewportWidth, float viewportHeight);
+        // rect is in pixels before the transform, uv is a sub rect of the texture in [0, 1].
+        // layer and depth go into the sort key, see PixieSortKey
+        bool drawSprite(uint32_t texture, const PixieRect &rect, const PixieRect &uv, uint32_t color, const PixieTransform2D &transform, uint32_t state = 0, uint32_t layer = 0, float depth = 0.0f);
+        // every sprite in the arrays under one sort key, expanded at prepare by the batched kernels straight into the ring.
+        // sprites and transforms are read then, not now, so both have to outlive the flush. transforms may be null for
+        // sprites already in pixels, otherwise each sprite's transform names one of its nodes as of the last compose.
+        // all or nothing: when the ring can't take every sprite none are drawn
+        bool drawSprites(uint32_t texture, const PixieSpriteArrays &sprites, const PixieTransformHierarchy *transforms, uint32_t state = 0, uint32_t layer = 0, float depth = 0.0f);
+        void flush(PixieBatchSink &sink);
+
+        // flush in two halves for recording on several threads: prepare sorts the queue into the ring and returns
+        // the run count, record sends runs [first, first + count) to a sink and may run concurrently on disjoint ranges.
+        // each range rebinds state and texture for its first run, the runs stay until the next prepare
+        size_t prepare();
+        void record(PixieBatchSink &sink, size_t first, size_t count) const;
+
+        // everything written before the marker may be overwritten once the frame that used it retires
+        uint64_t frameMarker() const { return head; }
+        void release(uint64_t marker);
+
+        const PixieBatchStats &stats() const { return frameStats; }
+        uint32_t pendingSprites() const { return pendingQuads; }
+        void setSIMDLevel(PixieSIMDLevel level) { simdLevel = level; }
+        PixieSIMDLevel getSIMDLevel() const { return simdLevel; }
+
+        static void writeQuadIndices(uint16_t *indices, uint32_t quadCount);
+
+    private:
+        struct Sprite {
+            PixieRect rect;
+            PixieRect uv;
+            PixieTransform2D transform;
+            uint32_t texture;
+            uint32_t state;
+            uint32_t color;
+        };
+
+        struct Bulk {
+            const PixieSpriteArrays *sprites;
+            const PixieTransformHierarchy *transforms;
+            uint32_t texture;
+            uint32_t state;
+        };
+
+        static const uint32_t bulkPayload = 1u << 31; // packet payloads with this bit index bulks rather than queued
+
+        // the first vertex of the quads in the ring
+        uint32_t allocateQuad(uint32_t texture, uint32_t state);
+        // up to wanted quads contiguous in one run, fewer where the run fills or the ring wraps. none when the ring is full
+        uint32_t allocateQuads(uint32_t texture, uint32_t state, uint32_t wanted, uint32_t &allocated);
+        void attach(PixieVertexData *full, PixieCompactVertex *compact, uint32_t vertexCapacity);
+        void writeBulk(const Bulk &bulk);
+        void writeQuad(uint32_t vertex, const Sprite &sprite) const;
+        void closeRun();
+
+        PixieVertexData *ring; // one of ring and compact is set
+        PixieCompactVertex *compact;
+        uint32_t capacity;
+        uint64_t head; // total vertices ever written
+        uint64_t tail; // total vertices released back to the writer
+        float clipScaleX;
+        float clipScaleY;
+
+        std::vector<Sprite> queued; // indexed by packet payload
+        std::vector<Bulk> bulks;
+        uint32_t pendingQuads; // queued and bulk sprites together, what the ring has been promised
+        PixieSIMDLevel simdLevel;
+        PixieDrawQueue queue;
+        PixieDrawRun currentRun;
+        bool runOpen;
+        std::vector<PixieDrawRun> runs;
+        PixieBatchStats frameStats;
+    };
+} // namespace pxe
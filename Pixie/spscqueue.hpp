@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+namespace pxe {
+    // bounded queue between exactly one producer thread and one consumer thread. push and pop never block or
+    // allocate, so either end can live on a thread that mustn't wait like the audio callback
+    template <typename T>
+    class PixieSPSCQueue {
+    public:
+        // rounded up to a power of two
+        explicit PixieSPSCQueue(size_t capacity)
+            : head(0)
+            , cachedTail(0)
+            , tail(0)
+            , cachedHead(0)
+            , mask(roundUp(capacity) - 1)
+            , slots(new T[mask + 1]) {
+        }
+
+        PixieSPSCQueue(const PixieSPSCQueue &) = delete;
+        PixieSPSCQueue &operator=(const PixieSPSCQueue &) = delete;
+
+        // producer side, false when the queue is full and value was left alone
+        bool push(const T &value) { return emplace(value); }
+        bool push(T &&value) { return emplace(std::move(value)); }
+
+        // consumer side, false when there was nothing to take
+        bool pop(T &value) {
+            const size_t position = tail.load(std::memory_order_relaxed);
+            if (position == cachedHead) {
+                cachedHead = head.load(std::memory_order_acquire);
+                if (position == cachedHead)
+                    return false;
+            }
+
+            value = std::move(slots[position & mask]);
+            tail.store(position + 1, std::memory_order_release);
+            return true;
+        }
+
+        // only a hint while the other side is running
+        size_t size() const { return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire); }
+        bool empty() const { return size() == 0; }
+        size_t capacity() const { return mask + 1; }
+
+    private:
+        static size_t roundUp(size_t value) {
+            size_t result = 1;
+            while (result < value)
+                result <<= 1;
+            return result;
+        }
+
+        template <typename U>
+        bool emplace(U &&value) {
+            const size_t position = head.load(std::memory_order_relaxed);
+            if (position - cachedTail > mask) {
+                cachedTail = tail.load(std::memory_order_acquire);
+                if (position - cachedTail > mask)
+                    return false;
+            }
+
+            slots[position & mask] = std::forward<U>(value);
+            head.store(position + 1, std::memory_order_release);
+            return true;
+        }
+
+        // each side keeps its own copy of the other's index and only rereads it when the copy says full or empty,
+        // so the two cache lines aren't pulled back and forth on every call
+        alignas(64) std::atomic<size_t> head; // next slot the producer writes
+        size_t cachedTail;
+        alignas(64) std::atomic<size_t> tail; // next slot the consumer reads
+        size_t cachedHead;
+        alignas(64) size_t mask;
+        std::unique_ptr<T[]> slots;
+    };
+} // namespace pxe
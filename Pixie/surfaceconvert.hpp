@@ -0,0 +1,52 @@
+#pragma once
+
+#include <SDL.h>
+#include <stdexcept>
+#include <vector>
+#include "pixelconvert.hpp"
+
+namespace pxe {
+    // describes an SDL pixel format for the converter, false for the ones it can't read directly
+    inline bool sourceFormat(const SDL_PixelFormat *format, std::vector<uint32_t> &palette, PixieSourceFormat &source) {
+        if (SDL_ISPIXELFORMAT_FOURCC(format->format) || format->BitsPerPixel < 8)
+            return false;
+
+        source = {format->BytesPerPixel, format->Rmask, format->Gmask, format->Bmask, format->Amask};
+
+        if (format->palette != nullptr) {
+            palette.clear();
+            for (int i = 0; i < format->palette->ncolors; ++i) {
+                const SDL_Color &c = format->palette->colors[i];
+                palette.push_back(uint32_t(c.r) | (uint32_t(c.g) << 8) | (uint32_t(c.b) << 16) | (uint32_t(c.a) << 24));
+            }
+            source.palette = palette.data();
+            source.paletteSize = static_cast<uint32_t>(palette.size());
+        }
+
+        return true;
+    }
+
+    // any surface IMG_Load returns into tightly packed R8G8B8A8, respecting its pitch
+    inline std::vector<uint32_t> convertSurface(SDL_Surface *surf, const PixiePixelConverter &converter, const PixieConvertOptions &options = {}) {
+        std::vector<uint32_t> texels(static_cast<size_t>(surf->w) * surf->h);
+        std::vector<uint32_t> palette;
+        PixieSourceFormat source;
+
+        // sub byte indices, yuv and color keys go through SDL once, everything else is read in place
+        if (SDL_HasColorKey(surf) || !sourceFormat(surf->format, palette, source)) {
+            SDL_Surface *converted = SDL_ConvertSurfaceFormat(surf, SDL_PIXELFORMAT_RGBA32, 0);
+            if (converted == nullptr)
+                throw std::runtime_error(SDL_GetError());
+
+            converter.convert(PixiePixelConverter::rgba8(), converted->pixels, converted->pitch, surf->w, surf->h, texels.data(), surf->w * 4, options);
+            SDL_FreeSurface(converted);
+            return texels;
+        }
+
+        SDL_LockSurface(surf);
+        converter.convert(source, surf->pixels, surf->pitch, surf->w, surf->h, texels.data(), surf->w * 4, options);
+        SDL_UnlockSurface(surf);
+
+        return texels;
+    }
+} // namespace pxe
@@ -0,0 +1,220 @@
+#include "taskgraph.hpp"
+#include "profiler.hpp"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+
+namespace pxe {
+    // shared with the pool jobs, the last one may still be unwinding after run() has returned
+    struct PixieTaskGraph::RunState {
+        PixieJobPool *pool;
+        std::chrono::steady_clock::time_point begin;
+        std::mutex mutex;
+        std::condition_variable changed;
+        std::vector<uint32_t> remaining;
+        std::vector<bool> skipped;
+        std::deque<PixieTaskId> callerQueue;
+        size_t finished = 0;
+        std::exception_ptr error;
+
+        double sinceBegin() const { return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count(); }
+    };
+
+    PixieTaskId PixieTaskGraph::add(const char *name, std::function<void()> fn, std::initializer_list<PixieTaskId> dependsOn, PixieTaskAffinity affinity) {
+        return addTask(name, std::move(fn), dependsOn.begin(), dependsOn.size(), affinity);
+    }
+
+    PixieTaskId PixieTaskGraph::add(const char *name, std::function<void()> fn, const std::vector<PixieTaskId> &dependsOn, PixieTaskAffinity affinity) {
+        return addTask(name, std::move(fn), dependsOn.data(), dependsOn.size(), affinity);
+    }
+
+    PixieTaskId PixieTaskGraph::addTask(const char *name, std::function<void()> fn, const PixieTaskId *dependsOn, size_t dependencyCount, PixieTaskAffinity affinity) {
+        const auto id = static_cast<PixieTaskId>(tasks.size());
+
+        // only earlier tasks can be depended on, so the graph can't have a cycle
+        for (size_t i = 0; i < dependencyCount; ++i) {
+            if (dependsOn[i] >= id)
+                throw std::invalid_argument("PixieTaskGraph: task depends on one added after it");
+        }
+        for (size_t i = 0; i < dependencyCount; ++i)
+            tasks[dependsOn[i]].dependents.push_back(id);
+
+        tasks.push_back({name, std::move(fn), {}, static_cast<uint32_t>(dependencyCount), affinity});
+        dependencies.emplace_back(dependsOn, dependsOn + dependencyCount);
+        return id;
+    }
+
+    void PixieTaskGraph::run(PixieJobPool &pool) {
+        auto state = std::make_shared<RunState>();
+        state->pool = &pool;
+        state->begin = std::chrono::steady_clock::now();
+        state->remaining.resize(tasks.size());
+        state->skipped.assign(tasks.size(), false);
+
+        timings.assign(tasks.size(), {});
+        for (size_t i = 0; i < tasks.size(); ++i) {
+            timings[i].name = tasks[i].name;
+            state->remaining[i] = tasks[i].dependencies;
+        }
+
+        std::unique_lock<std::mutex> lock(state->mutex);
+        for (PixieTaskId id = 0; id < tasks.size(); ++id) {
+            if (tasks[id].dependencies == 0)
+                dispatch(state, id);
+        }
+
+        // the calling thread only runs the tasks pinned to it and otherwise sleeps
+        while (state->finished < tasks.size()) {
+            if (state->callerQueue.empty()) {
+                state->changed.wait(lock);
+                continue;
+            }
+
+            const PixieTaskId id = state->callerQueue.front();
+            state->callerQueue.pop_front();
+            lock.unlock();
+            execute(state, id);
+            lock.lock();
+        }
+
+        // taken out under the lock, a job still holding the state mustn't be the one to drop the exception
+        const std::exception_ptr error = std::move(state->error);
+        state->error = nullptr;
+        lock.unlock();
+
+        wall = state->sinceBegin();
+        markCriticalPath();
+
+        if (error)
+            std::rethrow_exception(error);
+    }
+
+    // with the lock held
+    void PixieTaskGraph::dispatch(const std::shared_ptr<RunState> &state, PixieTaskId id) {
+        if (tasks[id].affinity == PixieTaskAffinity::Caller) {
+            state->callerQueue.push_back(id);
+            state->changed.notify_all();
+        } else {
+            state->pool->submit([this, state, id] { execute(state, id); });
+        }
+    }
+
+    void PixieTaskGraph::execute(const std::shared_ptr<RunState> &state, PixieTaskId id) {
+        const double startMs = state->sinceBegin();
+        const uint64_t profileBegin = PixieProfiler::enabled() ? PixieProfiler::now() : 0;
+
+        std::exception_ptr error;
+        try {
+            tasks[id].fn();
+        } catch (...) {
+            error = std::current_exception();
+        }
+
+        if (profileBegin != 0)
+            PixieProfiler::record(tasks[id].name, profileBegin, PixieProfiler::now());
+
+        const double endMs = state->sinceBegin();
+        std::lock_guard<std::mutex> lock(state->mutex);
+        timings[id].startMs = startMs;
+        timings[id].endMs = endMs;
+        timings[id].ran = true;
+        if (error) {
+            state->skipped[id] = true; // so nothing runs on top of a half built stage
+            if (!state->error)
+                state->error = error;
+        }
+        complete(state, id);
+    }
+
+    // with the lock held, skipped tasks finish on the spot and take their dependents with them
+    void PixieTaskGraph::complete(const std::shared_ptr<RunState> &statePtr, PixieTaskId id) {
+        RunState &state = *statePtr;
+        std::vector<PixieTaskId> done = {id};
+        while (!done.empty()) {
+            const PixieTaskId finished = done.back();
+            done.pop_back();
+            state.finished++;
+
+            for (const PixieTaskId dependent : tasks[finished].dependents) {
+                if (state.skipped[finished])
+                    state.skipped[dependent] = true;
+                if (--state.remaining[dependent] != 0)
+                    continue;
+
+                if (state.skipped[dependent])
+                    done.push_back(dependent);
+                else
+                    dispatch(statePtr, dependent);
+            }
+        }
+        state.changed.notify_all();
+    }
+
+    // walks back from whatever finished last through the dependency each task waited on longest
+    void PixieTaskGraph::markCriticalPath() {
+        PixieTaskId last = UINT32_MAX;
+        for (PixieTaskId id = 0; id < tasks.size(); ++id) {
+            if (timings[id].ran && (last == UINT32_MAX || timings[id].endMs > timings[last].endMs))
+                last = id;
+        }
+
+        while (last != UINT32_MAX) {
+            timings[last].critical = true;
+            PixieTaskId gate = UINT32_MAX;
+            for (const PixieTaskId dependency : dependencies[last]) {
+                if (gate == UINT32_MAX || timings[dependency].endMs > timings[gate].endMs)
+                    gate = dependency;
+            }
+            last = gate;
+        }
+    }
+
+    double PixieTaskGraph::serialMs() const {
+        double total = 0.0;
+        for (const PixieTaskTiming &timing : timings)
+            total += timing.endMs - timing.startMs;
+        return total;
+    }
+
+    double PixieTaskGraph::criticalPathMs() const {
+        double total = 0.0;
+        for (const PixieTaskTiming &timing : timings) {
+            if (timing.critical)
+                total += timing.endMs - timing.startMs;
+        }
+        return total;
+    }
+
+    std::string PixieTaskGraph::report(size_t barWidth) const {
+        std::string out;
+        char line[160];
+
+        const double scale = wall > 0.0 ? double(barWidth) / wall : 0.0;
+        for (const PixieTaskTiming &timing : timings) {
+            if (!timing.ran) {
+                std::snprintf(line, sizeof(line), "  %-28s  skipped\n", timing.name);
+                out += line;
+                continue;
+            }
+
+            // at least one column so short tasks still show where they ran
+            const auto first = std::min(static_cast<size_t>(timing.startMs * scale), barWidth - 1);
+            const auto last = std::max(first + 1, std::min(static_cast<size_t>(timing.endMs * scale + 0.5), barWidth));
+            std::string bar(barWidth, ' ');
+            std::fill(bar.begin() + first, bar.begin() + last, timing.critical ? '#' : '=');
+
+            std::snprintf(line, sizeof(line), "%c %-28s %8.2f %8.2f ms |", timing.critical ? '*' : ' ', timing.name, timing.startMs, timing.endMs - timing.startMs);
+            out += line;
+            out += bar;
+            out += "|\n";
+        }
+
+        std::snprintf(line, sizeof(line), "wall %.2f ms, critical path %.2f ms, serial %.2f ms\n", wall, criticalPathMs(), serialMs());
+        out += line;
+        return out;
+    }
+} // namespace pxe
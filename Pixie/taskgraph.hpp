@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <vector>
+#include "jobs.hpp"
+
+namespace pxe {
+    using PixieTaskId = uint32_t;
+
+    enum class PixieTaskAffinity {
+        Any,
+        Caller // runs on the thread that called run(), for apis tied to the window's thread
+    };
+
+    struct PixieTaskTiming {
+        const char *name;
+        double startMs; // from the start of run()
+        double endMs;
+        bool ran; // false when a dependency threw
+        bool critical; // on the chain that decided when the graph finished
+    };
+
+    // one shot graph of tasks with declared dependencies. a task starts on the job pool as soon as everything it
+    // depends on is done, so independent stages overlap and only real dependencies join
+    class PixieTaskGraph {
+    public:
+        // names have to outlive the graph's profiler events, use literals
+        PixieTaskId add(const char *name, std::function<void()> fn, std::initializer_list<PixieTaskId> dependsOn = {}, PixieTaskAffinity affinity = PixieTaskAffinity::Any);
+        // for dependencies worked out at run time
+        PixieTaskId add(const char *name, std::function<void()> fn, const std::vector<PixieTaskId> &dependsOn, PixieTaskAffinity affinity = PixieTaskAffinity::Any);
+
+        // blocks until every task ran or was skipped, rethrows the first exception a task threw.
+        // tasks that depend on a failed one are skipped, the rest still finish so nothing is left running
+        void run(PixieJobPool &pool);
+
+        // after run, in the order tasks were added
+        const std::vector<PixieTaskTiming> &timeline() const { return timings; }
+        double wallMs() const { return wall; }
+        // every task back to back, what a serial startup would take
+        double serialMs() const;
+        double criticalPathMs() const;
+
+        // one line per task with a bar over the wall time, critical path marked
+        std::string report(size_t barWidth = 48) const;
+
+    private:
+        struct RunState;
+
+        PixieTaskId addTask(const char *name, std::function<void()> fn, const PixieTaskId *dependsOn, size_t dependencyCount, PixieTaskAffinity affinity);
+        void dispatch(const std::shared_ptr<RunState> &state, PixieTaskId id);
+        void execute(const std::shared_ptr<RunState> &state, PixieTaskId id);
+        void complete(const std::shared_ptr<RunState> &state, PixieTaskId id);
+        void markCriticalPath();
+
+        struct Task {
+            const char *name;
+            std::function<void()> fn;
+            std::vector<PixieTaskId> dependents;
+            uint32_t dependencies;
+            PixieTaskAffinity affinity;
+        };
+
+        std::vector<Task> tasks;
+        std::vector<std::vector<PixieTaskId>> dependencies; // kept for the critical path walk
+        std::vector<PixieTaskTiming> timings;
+        double wall = 0.0;
+    };
+} // namespace pxe
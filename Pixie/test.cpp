@@ -1,5 +1,13 @@
+#include "entity.hpp"
+#include "framepacer.hpp"
+#include "profiler.hpp"
 #include "renderer.hpp"
-#include <chrono>
+#include "sdlinput.hpp"
+#include "spatial.hpp"
+#include "transform2d.hpp"
+#include <cmath>
+#include <cstdio>
+#include <random>
 
 // make two triangles and render full textures
 
@@ -8,6 +16,10 @@ int main(int, char **)
 {
 	SDL_assert(SDL_Init(SDL_INIT_EVERYTHING) == 0);
 
+	// the whole run is captured and written out on exit, open it in chrome://tracing or ui.perfetto.dev
+	PixieProfiler::setThreadName("render");
+	PixieProfiler::setEnabled(true);
+
 	FLOAT color[4] = {0.1f, 0.1f, 0.1f, 1.0f};
 
 	constexpr int width = 1024;
@@ -16,32 +28,129 @@ int main(int, char **)
 	auto window = PixiePTR<SDL_Window>(SDL_CreateWindow("D3D12", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, width, height, 0));
 	auto renderer = PixieRenderer(window.get(), width, height);
 
-	auto begin = std::chrono::steady_clock::now();
+	// same image again through the streamer, it shows the placeholder until the load lands
+	const auto streamed = renderer.streamTexture("Pixie/assets/icon.png");
+
+	// the icon slides at a fixed 60 Hz update, vsync in Present paces the loop so the pacer runs uncapped
+	PixieSystemClock clock;
+	PixieFramePacer pacer(clock, 60.0);
+
+	constexpr float speed = 240.0f; // pixels per second
+	float previousX = 704.0f;
+	float currentX = 704.0f;
+	float direction = 1.0f;
+
+	// small icons bouncing around the window, moved by a system and drawn straight out of the chunks
+	struct Position {
+		float x, y;
+	};
+	struct Velocity {
+		float x, y;
+	};
+
+	PixieWorld world;
+	std::mt19937 rng(7);
+	std::uniform_real_distribution<float> across(0.0f, 1.0f);
+	for (int i = 0; i < 2000; ++i) {
+		const float angle = across(rng) * 6.2831853f;
+		world.create(Position{across(rng) * (width - 16.0f), across(rng) * (height - 16.0f)}, Velocity{std::cos(angle) * speed, std::sin(angle) * speed});
+	}
+
+	PixieJobPool pool;
+	PixieSystemScheduler systems;
+	systems.add("bounce", PixieAccess().write<Position, Velocity>(), [&](PixieWorld &w) {
+		const float dt = static_cast<float>(pacer.stepSeconds());
+		w.each<Position, Velocity>(pool, [dt](Position &position, Velocity &velocity) {
+			position.x += velocity.x * dt;
+			position.y += velocity.y * dt;
+			if (position.x < 0.0f || position.x > width - 16.0f)
+				velocity.x = -velocity.x;
+			if (position.y < 0.0f || position.y > height - 16.0f)
+				velocity.y = -velocity.y;
+		});
+	});
+
+	// a field of icons far larger than the window, the camera drifts over it and only what it sees is submitted
+	constexpr float fieldSize = 16384.0f;
+	std::vector<PixieRect> field(100000);
+	std::vector<uint32_t> fieldItems(field.size());
+	for (size_t i = 0; i < field.size(); ++i) {
+		field[i] = {across(rng) * fieldSize, across(rng) * fieldSize, 24.0f, 24.0f};
+		fieldItems[i] = static_cast<uint32_t>(i);
+	}
+	PixieSpatialGrid grid;
+	grid.insert(field.data(), fieldItems.data(), field.size(), nullptr);
+	std::vector<uint32_t> visibleField;
+	PixieRect camera = {0.0f, 0.0f, float(width), float(height)};
+
+	// a ring of icons spinning around a hub, composed and expanded as arrays
+	PixieTransformHierarchy orbit;
+	const uint32_t hub = orbit.add({1.0f, 0.0f, 0.0f, 1.0f, 512.0f, 160.0f});
+	PixieSpriteArrays orbiters;
+	for (uint32_t i = 0; i < 12; ++i) {
+		const float angle = 6.2831853f * static_cast<float>(i) / 12.0f;
+		const uint32_t node = orbit.add({std::cos(angle), std::sin(angle), -std::sin(angle), std::cos(angle), 96.0f * std::cos(angle), 96.0f * std::sin(angle)}, hub);
+		orbiters.push({-16.0f, -16.0f, 32.0f, 32.0f}, {0.0f, 0.0f, 1.0f, 1.0f}, 0xffffffff, node);
+	}
+	float spin = 0.0f;
 
-	constexpr int FPS = 60;
-	const double delay = 1000.0 / FPS;
+	// escape quits too, and every event's trip to the frame that showed it is measured
+	PixieInput input(clock);
+	input.setLatencyTracking(true);
 
-	SDL_Event ev;
-	bool shouldRun = true;
-	while (shouldRun) {
-		SDL_PollEvent(&ev);
-		switch (ev.type) {
-			case SDL_QUIT:
-				shouldRun = false;
-				break;
+	while (!input.state().quit && !input.state().pressed(SDL_SCANCODE_ESCAPE)) {
+		const uint32_t steps = pacer.beginFrame();
+
+		// drained after the pacer's wait, so the frame sees input as late as it can
+		drainSDLEvents(input, clock);
+		input.beginFrame();
+		PIXIE_ZONE("frame");
+		for (uint32_t i = 0; i < steps; ++i) {
+			previousX = currentX;
+			currentX += direction * speed * static_cast<float>(pacer.stepSeconds());
+			if (currentX < 640.0f || currentX > 896.0f)
+				direction = -direction;
+			systems.run(world, pool);
+			spin += static_cast<float>(pacer.stepSeconds());
+			camera.x = std::fmod(camera.x + 0.5f * speed * static_cast<float>(pacer.stepSeconds()), fieldSize - width);
+			camera.y = std::fmod(camera.y + 0.25f * speed * static_cast<float>(pacer.stepSeconds()), fieldSize - height);
 		}
-		auto end = std::chrono::steady_clock::now();
-		auto deltaTime = std::chrono::duration<double, std::milli>(end - begin);
-		end = begin;
+		const float x = previousX + (currentX - previousX) * static_cast<float>(pacer.alpha());
 
 		renderer.beginFrame(color);
-		
-		renderer.endFrame();
 
-		if (delay > deltaTime.count())
-			SDL_Delay(delay - deltaTime.count());
+		grid.query(camera, visibleField);
+		for (const uint32_t i : visibleField) {
+			const PixieRect &rect = field[i];
+			renderer.drawSprite(0, {rect.x - camera.x, rect.y - camera.y, rect.width, rect.height}, {0.0f, 0.0f, 1.0f, 1.0f}, 0xffffffff, PixieTransform2D::identity());
+		}
+
+		orbit.setLocal(hub, {std::cos(spin), std::sin(spin), -std::sin(spin), std::cos(spin), 512.0f, 160.0f});
+		orbit.compose();
+		renderer.drawSprites(renderer.textureSlot(streamed), orbiters, &orbit);
+
+		renderer.drawSprite(0, {384.0f, 256.0f, 256.0f, 256.0f}, {0.0f, 0.0f, 1.0f, 1.0f}, 0xffffffff, PixieTransform2D::identity());
+		renderer.drawSprite(renderer.textureSlot(streamed), {x, 320.0f, 128.0f, 128.0f}, {0.0f, 0.0f, 1.0f, 1.0f}, 0xffffffff, PixieTransform2D::identity());
+
+		world.each<const Position>([&](const Position &position) {
+			renderer.drawSprite(renderer.textureSlot(streamed), {position.x, position.y, 16.0f, 16.0f}, {0.0f, 0.0f, 1.0f, 1.0f}, 0xffffffff, PixieTransform2D::identity());
+		});
+
+		renderer.endFrame();
+		input.frameSubmitted();
 	}
 
+	const PixieFrameTimeStats frameTimes = pacer.stats();
+	std::printf("frames %llu, p50 %.2f ms, p99 %.2f ms, max %.2f ms, %llu hitches\n", static_cast<unsigned long long>(frameTimes.frames),
+		frameTimes.p50Ms, frameTimes.p99Ms, frameTimes.maxMs, static_cast<unsigned long long>(frameTimes.hitches));
+	const PixieInputLatencyStats latency = input.latencyStats();
+	std::printf("input latency over %llu events, p50 %.2f ms, p99 %.2f ms, max %.2f ms\n", static_cast<unsigned long long>(latency.samples), latency.p50Ms,
+		latency.p99Ms, latency.maxMs);
+	const PixieArenaStats frameMemory = renderer.frameMemoryStats();
+	std::printf("frame memory peak %zu bytes of %zu\n", frameMemory.peak, frameMemory.capacity);
+
+	PixieProfiler::exportChromeTrace("pixie-trace.json");
+
 	SDL_Quit();
 
 	return 0;
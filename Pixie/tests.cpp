@@ -0,0 +1,1038 @@
+#include "audio.hpp"
+#include "descriptors.hpp"
+#include "framepacer.hpp"
+#include "framering.hpp"
+#include "recorder.hpp"
+#include "shadercache.hpp"
+#include "texturefile.hpp"
+#include "upload.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// headless correctness checks for the cpu side, no window or gpu needed, bench is the throughput side of this
+// usage: tests [--filter <group>], exits 1 when any check failed
+
+using namespace pxe;
+
+static int checkCount = 0;
+static int failureCount = 0;
+
+// a failed check is reported and the run carries on, so one pass lists everything that broke
+#define CHECK(condition) check((condition), #condition, __FILE__, __LINE__)
+
+static void check(bool passed, const char *expression, const char *file, int line) {
+    checkCount++;
+    if (!passed) {
+        failureCount++;
+        std::fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expression);
+    }
+}
+
+static std::string readFile(const std::filesystem::path &path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+}
+
+template <typename Fn>
+static bool throws(Fn &&fn) {
+    try {
+        fn();
+    } catch (const std::exception &) {
+        return true;
+    }
+    return false;
+}
+
+static void writeFile(const std::filesystem::path &path, const std::string &contents) {
+    std::ofstream(path, std::ios::binary | std::ios::trunc) << contents;
+}
+
+static void testUploadAllocator() {
+    // rings are plain memory here, the renderer maps upload heaps instead
+    std::vector<std::unique_ptr<uint8_t[]>> memory;
+    const auto factory = [&](uint32_t ring, uint64_t size) {
+        CHECK(ring == memory.size());
+        memory.emplace_back(new uint8_t[size]);
+        return memory.back().get();
+    };
+    constexpr uint64_t ringSize = 65536;
+
+    // footprint helpers follow the d3d12 copy rules
+    CHECK(PixieUploadAllocator::rowPitch(1, 4) == 256);
+    CHECK(PixieUploadAllocator::rowPitch(64, 4) == 256);
+    CHECK(PixieUploadAllocator::rowPitch(65, 4) == 512);
+    CHECK(PixieUploadAllocator::textureSize(65, 2, 4) == 512 + 260);
+
+    // placement and pitch alignment, and the cpu pointer matches the offset
+    {
+        PixieUploadAllocator uploads(ringSize, 1, factory);
+        PixieUploadRegion region = {};
+        CHECK(uploads.allocate(100, PixieUploadAllocator::placementAlignment, region) && region.offset == 0);
+        CHECK(uploads.allocate(100, PixieUploadAllocator::placementAlignment, region) && region.offset == 512);
+        CHECK(uploads.allocate(10, PixieUploadAllocator::pitchAlignment, region) && region.offset == 768);
+        CHECK(uploads.allocate(3, 1, region) && region.offset == 778);
+        CHECK(uploads.allocate(4, PixieUploadAllocator::placementAlignment, region) && region.offset == 1024);
+        CHECK(region.ring == 0 && region.size == 4 && region.data == memory[0].get() + 1024);
+        CHECK(uploads.stats().bytesInUse == 1028);
+
+        std::mt19937 rng(3);
+        bool aligned = true;
+        for (uint64_t fence = 1; fence < 200; ++fence) {
+            const uint64_t alignment = uint64_t(1) << (rng() % 10);
+            if (uploads.allocate(1 + rng() % 5000, alignment, region))
+                aligned = aligned && region.offset % alignment == 0 && region.offset + region.size <= ringSize;
+            uploads.submit(fence);
+            uploads.retire(fence - 1);
+        }
+        CHECK(aligned);
+
+        CHECK(throws([&] { uploads.allocate(0, 256, region); }));
+        CHECK(throws([&] { uploads.allocate(16, 48, region); }));
+        CHECK(throws([&] { uploads.allocate(ringSize + 1, 256, region); }));
+        memory.clear();
+    }
+
+    // a region that doesn't fit before the end starts over at the front instead of straddling it, and only once
+    // the fence covering the front has retired. everything in between is tracked as in use
+    {
+        PixieUploadAllocator uploads(ringSize, 1, factory);
+        PixieUploadRegion region = {};
+        CHECK(uploads.allocate(40000, 512, region) && region.offset == 0);
+        uploads.submit(1);
+        CHECK(uploads.allocate(20000, 512, region) && region.offset == 40448);
+        uploads.submit(2);
+        CHECK(uploads.oldestPendingFence() == 1);
+
+        // full: the wrapped region would run into fence 1's bytes
+        CHECK(!uploads.allocate(10000, 512, region));
+        CHECK(uploads.stats().failedAllocations == 1);
+        uploads.retire(0);
+        CHECK(!uploads.allocate(10000, 512, region));
+        CHECK(uploads.stats().bytesInUse == 60448);
+
+        uploads.retire(1);
+        CHECK(uploads.oldestPendingFence() == 2);
+        CHECK(uploads.stats().bytesInUse == 20448);
+        CHECK(uploads.allocate(10000, 512, region) && region.offset == 0);
+        CHECK(region.data == memory[0].get());
+        // the skipped tail stays in use until the frame after it retires
+        CHECK(uploads.stats().bytesInUse == ringSize + 10000 - 40000);
+        uploads.submit(3);
+
+        uploads.retire(3);
+        CHECK(uploads.stats().bytesInUse == 0);
+        CHECK(uploads.oldestPendingFence() == 0);
+        CHECK(uploads.stats().highWaterMark == 60448); // both regions before the first retire
+        CHECK(uploads.stats().allocations == 3);
+        CHECK(uploads.stats().failedAllocations == 2);
+        memory.clear();
+    }
+
+    // with room for more rings a full one spills into a new one, and the high water mark spans them
+    {
+        PixieUploadAllocator uploads(ringSize, 2, factory);
+        PixieUploadRegion region = {};
+        CHECK(uploads.allocate(ringSize, 512, region) && region.ring == 0);
+        CHECK(uploads.allocate(ringSize / 2, 512, region) && region.ring == 1);
+        CHECK(uploads.stats().rings == 2 && memory.size() == 2);
+        CHECK(!uploads.allocate(ringSize / 2 + 1, 512, region));
+        CHECK(uploads.stats().highWaterMark == ringSize + ringSize / 2);
+        uploads.submit(1);
+        uploads.retire(1);
+        CHECK(uploads.stats().bytesInUse == 0);
+        CHECK(uploads.stats().highWaterMark == ringSize + ringSize / 2);
+        memory.clear();
+    }
+}
+
+static void testTextureFile() {
+    const auto path = std::filesystem::temp_directory_path() / "pixie_tests_texture.pxtex";
+    const std::vector<uint8_t> texels(16 * 16 * 4, 0x80);
+    const uint8_t *mips[] = {texels.data()};
+    CHECK(writeTextureFile(path.string(), PixieTextureLayout::make(PixieTextureFormat::RGBA8, 16, 16, 1), mips));
+
+    // the format sits after the magic and version, only the two 4 byte formats the layout knows load
+    const std::string original = readFile(path);
+    const auto withFormat = [&](uint32_t format) {
+        std::string bytes = original;
+        std::memcpy(&bytes[8], &format, sizeof(format));
+        writeFile(path, bytes);
+    };
+
+    withFormat(28);
+    CHECK(PixieTextureFile(path.string()).layout().format == PixieTextureFormat::RGBA8);
+    withFormat(29);
+    CHECK(PixieTextureFile(path.string()).layout().format == PixieTextureFormat::RGBA8_SRGB);
+    for (const uint32_t format : {0u, 10u, 27u, 30u, 87u, 0xffffffffu}) {
+        withFormat(format);
+        CHECK(throws([&] { PixieTextureFile file(path.string()); }));
+    }
+
+    std::filesystem::remove(path);
+}
+
+static void testShaderCache() {
+    // counts compiles, the bytecode is derived from the variant so a blob handed back for the wrong desc shows up
+    struct CountingCompiler final : PixieShaderCompiler {
+        std::atomic<int> compiles = 0;
+
+        static std::vector<uint8_t> bytecode(const PixieShaderDesc &desc) {
+            std::vector<uint8_t> bytes(1024 + desc.flags * 16);
+            uint32_t seed = desc.flags * 2654435761u;
+            for (const PixieShaderDefine &define : desc.defines) {
+                for (const char c : define.name + "=" + define.value)
+                    seed = seed * 31 + static_cast<uint8_t>(c);
+            }
+            for (uint8_t &byte : bytes) {
+                seed = seed * 1664525u + 1013904223u;
+                byte = static_cast<uint8_t>(seed >> 24);
+            }
+            return bytes;
+        }
+
+        std::string identity() const override { return "tests"; }
+        std::vector<uint8_t> compile(const PixieShaderDesc &desc) override {
+            compiles++;
+            return bytecode(desc);
+        }
+    } compiler;
+
+    const auto directory = std::filesystem::temp_directory_path() / "pixie_tests_shaders";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory);
+    writeFile(directory / "common.hlsli", "Texture2D g_texture : register(t0);\nSamplerState g_sampler : register(s0);\n");
+    writeFile(directory / "sprite.hlsl", "#include \"common.hlsli\"\nfloat4 PSMain(float2 uv : TEXCOORD) : SV_TARGET { return g_texture.Sample(g_sampler, uv); }\n");
+
+    const std::string source = (directory / "sprite.hlsl").string();
+    const std::string pack = (directory / "shaders.pxsc").string();
+    const PixieShaderDesc desc = {source, "PSMain", "ps_5_0", {{"TINT", "1"}}, 1};
+
+    const auto matches = [](PixieShaderBlob blob, const PixieShaderDesc &desc) {
+        const std::vector<uint8_t> expected = CountingCompiler::bytecode(desc);
+        return blob.data && blob.size == expected.size() && std::memcmp(blob.data, expected.data(), expected.size()) == 0;
+    };
+
+    // a second lookup is served from memory, and once flushed from the pack by a fresh cache
+    {
+        PixieShaderCache cache(compiler, pack);
+        CHECK(matches(cache.get(desc), desc));
+        CHECK(compiler.compiles == 1);
+        CHECK(matches(cache.get(desc), desc));
+        CHECK(compiler.compiles == 1);
+        CHECK(cache.stats().hits == 1 && cache.stats().misses == 1);
+        CHECK(cache.flush());
+    }
+    {
+        PixieShaderCache cache(compiler, pack);
+        CHECK(matches(cache.get(desc), desc));
+        CHECK(compiler.compiles == 1);
+        CHECK(cache.stats().hits == 1 && cache.stats().rejected == 0);
+    }
+
+    // anything that changes the compile output has to change the key
+    {
+        PixieShaderCache cache(compiler, pack);
+        const uint64_t original = cache.key(desc);
+
+        PixieShaderDesc changed = desc;
+        changed.defines[0].value = "2";
+        CHECK(cache.key(changed) != original);
+        CHECK(matches(cache.get(changed), changed));
+
+        changed = desc;
+        changed.defines.push_back({"FOG", "1"});
+        CHECK(cache.key(changed) != original);
+        CHECK(matches(cache.get(changed), changed));
+
+        changed = desc;
+        changed.flags = 2;
+        CHECK(cache.key(changed) != original);
+        CHECK(matches(cache.get(changed), changed));
+
+        changed = desc;
+        changed.entryPoint = "PSFog";
+        CHECK(cache.key(changed) != original);
+
+        CHECK(compiler.compiles == 4);
+        CHECK(cache.stats().misses == 3);
+        CHECK(cache.flush());
+    }
+    {
+        // source hashes are taken once per cache, so an edited include needs a fresh one like a real restart
+        PixieShaderCache before(compiler, pack);
+        const uint64_t original = before.key(desc);
+        writeFile(directory / "common.hlsli", "Texture2D g_texture : register(t1);\nSamplerState g_sampler : register(s0);\n");
+
+        PixieShaderCache cache(compiler, pack);
+        CHECK(cache.key(desc) != original);
+        CHECK(matches(cache.get(desc), desc));
+        CHECK(compiler.compiles == 5);
+        CHECK(cache.flush());
+    }
+
+    // a damaged pack is rebuilt from fresh compiles, never handed out
+    const auto damage = [&](auto &&edit) {
+        std::string bytes = readFile(pack);
+        edit(bytes);
+        writeFile(pack, bytes);
+    };
+    const auto rebuilds = [&](const char *what) {
+        const int compiles = compiler.compiles;
+        {
+            PixieShaderCache cache(compiler, pack);
+            const bool served = matches(cache.get(desc), desc);
+            if (!served)
+                std::fprintf(stderr, "wrong bytecode after %s\n", what);
+            CHECK(served);
+            CHECK(compiler.compiles == compiles + 1);
+            CHECK(cache.stats().rejected == 1);
+            CHECK(cache.flush());
+        }
+
+        // and the rebuilt pack is good again
+        PixieShaderCache cache(compiler, pack);
+        CHECK(matches(cache.get(desc), desc));
+        CHECK(compiler.compiles == compiles + 1);
+        CHECK(cache.stats().rejected == 0);
+    };
+
+    damage([](std::string &bytes) { bytes.resize(bytes.size() - 100); });
+    rebuilds("truncating the pack");
+    damage([](std::string &bytes) { bytes.resize(20); });
+    rebuilds("cutting the header short");
+    damage([](std::string &bytes) { bytes[40] ^= 0x10; }); // inside the entry table
+    rebuilds("a flipped bit in the table");
+
+    // a flipped bit in a blob only costs that blob. the pack holds this desc and its variants, find its bytes
+    {
+        const std::vector<uint8_t> expected = CountingCompiler::bytecode(desc);
+        std::string bytes = readFile(pack);
+        const size_t at = bytes.find(std::string(expected.begin(), expected.end()));
+        CHECK(at != std::string::npos);
+        if (at != std::string::npos) {
+            bytes[at + expected.size() / 2] ^= 0x01;
+            writeFile(pack, bytes);
+            rebuilds("a flipped bit in a blob");
+        }
+    }
+
+    // two writers flushing the same pack at once, whatever lands has to load clean. a lost race may drop one
+    // side's entries, those are just compiled again, but nothing that loads may be wrong
+    std::filesystem::remove(pack);
+    const auto variant = [&](int writer, int i) {
+        return PixieShaderDesc {source, "PSMain", "ps_5_0", {{"WRITER", std::to_string(writer)}, {"VARIANT", std::to_string(i)}}, static_cast<uint32_t>(i % 4)};
+    };
+    for (int round = 0; round < 8; ++round) {
+        PixieShaderCache first(compiler, pack);
+        PixieShaderCache second(compiler, pack);
+        for (int i = 0; i < 16; ++i) {
+            first.get(variant(0, round * 16 + i));
+            second.get(variant(1, round * 16 + i));
+        }
+
+        bool flushed[2] = {};
+        std::thread other([&] { flushed[1] = second.flush(); });
+        flushed[0] = first.flush();
+        other.join();
+        CHECK(flushed[0] || flushed[1]);
+
+        PixieShaderCache reader(compiler, pack);
+        const int compiles = compiler.compiles;
+        for (int writer = 0; writer < 2; ++writer) {
+            for (int i = 0; i < 16; ++i) {
+                const PixieShaderDesc shader = variant(writer, round * 16 + i);
+                CHECK(matches(reader.get(shader), shader));
+            }
+        }
+        CHECK(reader.stats().rejected == 0);
+        CHECK(compiler.compiles - compiles <= 16); // the last writer's entries always make it
+    }
+
+    std::filesystem::remove_all(directory);
+}
+
+static void testAudio() {
+    constexpr uint32_t rate = 48000;
+    constexpr float centre = 0.70710678f; // cos and sin of a quarter pi, equal power at pan 0
+
+    // ten whole periods of a cosine, so a looped copy is one smooth wave and a seam that reaches for the
+    // padding instead of frame 0 drops from near 0.5 towards silence
+    constexpr uint32_t period = 48;
+    std::vector<float> tone(period * 10);
+    for (size_t i = 0; i < tone.size(); ++i)
+        tone[i] = 0.5f * std::cos(float(i) * 6.28318531f / period);
+    const auto sound = std::make_shared<PixieSound>(rate, 1, tone.data(), static_cast<uint32_t>(tone.size()));
+
+    // a unity gain centred mono voice at the output rate is the source times the equal power gain on both sides
+    {
+        PixieAudioMixer mixer(rate, 4);
+        PixieOfflineAudioBackend output;
+        output.start(mixer);
+        mixer.play(sound);
+        output.render(static_cast<uint32_t>(tone.size()) + 64);
+
+        const std::vector<float> &samples = output.output();
+        float error = 0.0f;
+        for (size_t i = 0; i < tone.size(); ++i) {
+            error = std::max(error, std::fabs(samples[2 * i] - tone[i] * centre));
+            error = std::max(error, std::fabs(samples[2 * i + 1] - tone[i] * centre));
+        }
+        CHECK(error < 1e-6f);
+
+        // and silence once it ran off the end
+        bool silent = true;
+        for (size_t i = tone.size() * 2; i < samples.size(); ++i)
+            silent = silent && samples[i] == 0.0f;
+        CHECK(silent);
+        mixer.update();
+        CHECK(mixer.stats().voices == 0);
+    }
+
+    // looping goes over the seam like any other frame, at the native rate and resampled
+    for (const float pitch : {1.0f, 0.75f, 1.37f}) {
+        PixieAudioMixer mixer(rate, 4);
+        PixieOfflineAudioBackend output;
+        output.start(mixer);
+        PixieVoiceParams params;
+        params.pitch = pitch;
+        params.loop = true;
+        mixer.play(sound, params);
+        output.render(static_cast<uint32_t>(tone.size()) * 4);
+
+        // the steepest the wave gets between two output frames, plus room for the linear interpolation
+        const float limit = 0.5f * centre * 6.28318531f / period * pitch * 1.05f;
+        const std::vector<float> &samples = output.output();
+        float jump = 0.0f;
+        for (size_t i = 2; i < samples.size(); i += 2)
+            jump = std::max(jump, std::fabs(samples[i] - samples[i - 2]));
+        CHECK(jump <= limit);
+
+        if (pitch == 1.0f) {
+            float error = 0.0f;
+            for (size_t i = 0; i < samples.size() / 2; ++i)
+                error = std::max(error, std::fabs(samples[2 * i] - tone[i % tone.size()] * centre));
+            CHECK(error < 1e-6f);
+        }
+    }
+
+    // stop fades out over the next block and the voice is silent from the one after
+    {
+        std::vector<float> level(rate / 10, 0.5f);
+        const auto constant = std::make_shared<PixieSound>(rate, 1, level.data(), static_cast<uint32_t>(level.size()));
+
+        PixieAudioMixer mixer(rate, 4);
+        PixieOfflineAudioBackend output(PixieAudioMixer::blockFrames);
+        output.start(mixer);
+        PixieVoiceParams params;
+        params.loop = true;
+        const PixieVoiceHandle voice = mixer.play(constant, params);
+        output.render(PixieAudioMixer::blockFrames * 2);
+        CHECK(mixer.playing(voice));
+
+        mixer.stop(voice);
+        output.clear();
+        output.render(PixieAudioMixer::blockFrames * 3);
+        const std::vector<float> &samples = output.output();
+
+        bool falling = std::fabs(samples[0] - 0.5f * centre) < 1e-6f;
+        for (uint32_t i = 1; i < PixieAudioMixer::blockFrames; ++i)
+            falling = falling && samples[2 * i] < samples[2 * i - 2];
+        CHECK(falling);
+        CHECK(samples[2 * PixieAudioMixer::blockFrames - 2] <= 0.5f * centre / PixieAudioMixer::blockFrames + 1e-6f);
+
+        bool silent = true;
+        for (size_t i = 2 * PixieAudioMixer::blockFrames; i < samples.size(); ++i)
+            silent = silent && samples[i] == 0.0f;
+        CHECK(silent);
+
+        mixer.update();
+        CHECK(!mixer.playing(voice));
+    }
+
+    // every simd level mixes the same thing: mono and stereo, resampled, panned, looping and a gain ramp halfway
+    {
+        std::vector<float> stereo(44100 / 5 * 2);
+        for (size_t i = 0; i < stereo.size() / 2; ++i) {
+            stereo[2 * i] = 0.3f * std::sin(float(i) * 0.031f);
+            stereo[2 * i + 1] = 0.3f * std::sin(float(i) * 0.047f + 1.0f);
+        }
+        const auto music = std::make_shared<PixieSound>(44100, 2, stereo.data(), static_cast<uint32_t>(stereo.size() / 2));
+
+        const auto mix = [&](PixieSIMDLevel level) {
+            PixieAudioMixer mixer(rate, 32, 1024, level);
+            PixieOfflineAudioBackend output(480);
+            output.start(mixer);
+
+            std::vector<PixieVoiceHandle> handles;
+            for (uint32_t i = 0; i < 24; ++i) {
+                PixieVoiceParams params;
+                params.gain = 0.1f + 0.02f * i;
+                params.pan = float(i) / 12.0f - 1.0f;
+                params.pitch = i % 3 == 0 ? 1.0f : 0.8f + 0.03f * i;
+                params.loop = i % 2 == 0;
+                handles.push_back(mixer.play(i % 4 == 0 ? music : sound, params));
+            }
+            output.render(rate / 20);
+            for (size_t i = 0; i < handles.size(); i += 3)
+                mixer.setGain(handles[i], 0.05f);
+            mixer.setPan(handles[1], 0.5f);
+            mixer.setPitch(handles[2], 1.2f);
+            mixer.stop(handles[4]);
+            output.render(rate / 20);
+            return output.output();
+        };
+
+        const std::vector<float> reference = mix(PixieSIMDLevel::Scalar);
+        for (const PixieSIMDLevel level : {PixieSIMDLevel::SSE2, PixieSIMDLevel::AVX2}) {
+            if (level > detectSIMDLevel())
+                continue;
+
+            const std::vector<float> samples = mix(level);
+            float error = 0.0f;
+            for (size_t i = 0; i < samples.size(); ++i)
+                error = std::max(error, std::fabs(samples[i] - reference[i]));
+            CHECK(samples.size() == reference.size());
+            CHECK(error < 1e-5f);
+            if (error >= 1e-5f)
+                std::fprintf(stderr, "%s differs from scalar by %g\n", simdLevelName(level), error);
+        }
+    }
+}
+
+static void testCommandRecorder() {
+    // partition boundaries: nothing, fewer items than a job's minimum, splits that don't come out even
+    using Bounds = std::vector<size_t>;
+    CHECK(PixieCommandRecorder::partition(0, 4, 4) == Bounds({0}));
+    CHECK(PixieCommandRecorder::partition(3, 16, 4) == Bounds({0, 3}));
+    CHECK(PixieCommandRecorder::partition(16, 16, 4) == Bounds({0, 16}));
+    CHECK(PixieCommandRecorder::partition(10, 1, 2) == Bounds({0, 3, 6, 9, 10}));
+    CHECK(PixieCommandRecorder::partition(100, 40, 4) == Bounds({0, 40, 80, 100}));
+    CHECK(PixieCommandRecorder::partition(5, 1, 0) == Bounds({0, 3, 5})); // no threads counts as one
+    CHECK(PixieCommandRecorder::partition(4, 0, 8) == Bounds({0, 1, 2, 3, 4}));
+
+    // and in general: covers [0, itemCount) in order, every job but the last has at least the minimum, and
+    // there are never more jobs than the threads can use unless the minimum forces it
+    bool wellFormed = true;
+    for (size_t items = 0; items < 200; items += 7) {
+        for (const size_t minimum : {size_t(0), size_t(1), size_t(5), size_t(64)}) {
+            for (const size_t threads : {size_t(1), size_t(3), size_t(8)}) {
+                const Bounds bounds = PixieCommandRecorder::partition(items, minimum, threads);
+                wellFormed = wellFormed && bounds.front() == 0 && bounds.back() == items;
+                wellFormed = wellFormed && bounds.size() - 1 <= threads * PixieCommandRecorder::jobsPerThread;
+                for (size_t i = 1; i < bounds.size(); ++i) {
+                    wellFormed = wellFormed && bounds[i] > bounds[i - 1];
+                    if (i + 1 < bounds.size())
+                        wellFormed = wellFormed && bounds[i] - bounds[i - 1] >= minimum;
+                }
+            }
+        }
+    }
+    CHECK(wellFormed);
+
+    // writes down every backend call, recording threads included
+    struct MockBackend final : PixieRecordBackend {
+        std::mutex mutex;
+        uint32_t created = 0;
+        std::vector<int> state; // per context: 0 closed, 1 open
+        std::vector<std::vector<std::pair<size_t, size_t>>> recorded; // per context, ranges in the order they were recorded
+        std::vector<std::vector<uint32_t>> submissions;
+        bool misuse = false; // opened twice, closed while closed, recorded or submitted while open
+
+        uint32_t createContext() override {
+            std::lock_guard<std::mutex> lock(mutex);
+            state.push_back(0);
+            recorded.emplace_back();
+            return created++;
+        }
+        void openContext(uint32_t context) override {
+            std::lock_guard<std::mutex> lock(mutex);
+            misuse = misuse || state[context] != 0;
+            state[context] = 1;
+            recorded[context].clear();
+        }
+        void closeContext(uint32_t context) override {
+            std::lock_guard<std::mutex> lock(mutex);
+            misuse = misuse || state[context] != 1;
+            state[context] = 0;
+        }
+        void submitContexts(const uint32_t *contexts, size_t count) override {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (size_t i = 0; i < count; ++i)
+                misuse = misuse || state[contexts[i]] != 0;
+            submissions.emplace_back(contexts, contexts + count);
+        }
+        void write(uint32_t context, size_t begin, size_t end) {
+            std::lock_guard<std::mutex> lock(mutex);
+            misuse = misuse || state[context] != 1;
+            recorded[context].push_back({begin, end});
+        }
+    };
+
+    // whatever the thread count, one submission with the passes in the order they were queued and each pass's
+    // items in order across its contexts
+    for (const size_t workers : {size_t(1), size_t(3)}) {
+        MockBackend backend;
+        PixieCommandRecorder recorder(backend, workers);
+        CHECK(recorder.threadCount() == workers + 1);
+
+        for (uint32_t frame = 0; frame < 6; ++frame) {
+            recorder.beginFrame(frame % PixieFrameRing::maxFramesInFlight);
+            const size_t submissions = backend.submissions.size();
+            const auto pass = [&](size_t tag) {
+                return [&backend, tag](uint32_t context, size_t begin, size_t end) { backend.write(context, tag * 1000 + begin, tag * 1000 + end); };
+            };
+            recorder.record(pass(0));
+            recorder.record(37, 4, pass(1));
+            recorder.record(0, 1, pass(2)); // empty, no jobs
+            recorder.record(pass(3));
+            recorder.submit();
+
+            CHECK(backend.submissions.size() == submissions + 1);
+            const std::vector<uint32_t> &contexts = backend.submissions.back();
+            const Bounds bounds = PixieCommandRecorder::partition(37, 4, recorder.threadCount());
+            CHECK(contexts.size() == bounds.size() + 1);
+            CHECK(recorder.stats().jobs == contexts.size() && recorder.stats().passes == 4);
+
+            // read back in submission order, it has to be the passes one after the other with nothing missing
+            std::vector<std::pair<size_t, size_t>> stream;
+            for (const uint32_t context : contexts) {
+                CHECK(backend.recorded[context].size() == 1);
+                stream.insert(stream.end(), backend.recorded[context].begin(), backend.recorded[context].end());
+            }
+            std::vector<std::pair<size_t, size_t>> expected = {{0, 1}};
+            for (size_t i = 0; i + 1 < bounds.size(); ++i)
+                expected.push_back({1000 + bounds[i], 1000 + bounds[i + 1]});
+            expected.push_back({3000, 3001});
+            CHECK(stream == expected);
+        }
+
+        // contexts are made once per frame slot and reused after that
+        CHECK(backend.created == recorder.stats().contexts);
+        CHECK(backend.created == PixieFrameRing::maxFramesInFlight * backend.submissions.back().size());
+        CHECK(!backend.misuse);
+    }
+
+    // a throwing pass submits nothing, leaves no context open and doesn't wedge the next frame
+    {
+        MockBackend backend;
+        PixieCommandRecorder recorder(backend, 2);
+        recorder.beginFrame(0);
+        recorder.record(64, 1, [&](uint32_t context, size_t begin, size_t end) {
+            if (begin <= 20 && 20 < end)
+                throw std::runtime_error("recording failed");
+            backend.write(context, begin, end);
+        });
+
+        bool rethrown = false;
+        try {
+            recorder.submit();
+        } catch (const std::runtime_error &) {
+            rethrown = true;
+        }
+        CHECK(rethrown);
+        CHECK(backend.submissions.empty());
+        CHECK(std::count(backend.state.begin(), backend.state.end(), 1) == 0);
+
+        CHECK(!throws([&] { recorder.beginFrame(1); }));
+        recorder.record([&](uint32_t context, size_t begin, size_t end) { backend.write(context, begin, end); });
+        recorder.submit();
+        CHECK(backend.submissions.size() == 1 && backend.submissions[0].size() == 1);
+        CHECK(!backend.misuse);
+
+        CHECK(throws([&] { recorder.beginFrame(PixieFrameRing::maxFramesInFlight); }));
+        recorder.record([](uint32_t, size_t, size_t) {});
+        CHECK(throws([&] { recorder.beginFrame(0); })); // passes still queued
+    }
+}
+
+static void testDescriptors() {
+    // persistent handles: lowest index first, a full region fails, stale and double frees throw
+    {
+        PixieDescriptorAllocator descriptors(8, 0);
+        std::vector<PixieDescriptorHandle> handles;
+        for (uint32_t i = 0; i < 8; ++i) {
+            handles.push_back(descriptors.allocate());
+            CHECK(descriptors.index(handles.back()) == i);
+        }
+        CHECK(descriptors.allocate() == invalidDescriptor);
+        CHECK(descriptors.stats().failedAllocations == 1);
+        CHECK(descriptors.stats().persistentInUse == 8);
+
+        const PixieDescriptorHandle old = handles[3];
+        descriptors.free(old);
+        CHECK(!descriptors.valid(old));
+        CHECK(throws([&] { descriptors.free(old); }));
+        CHECK(throws([&] { descriptors.index(old); }));
+
+        // the slot comes back under a new generation, the old handle stays dead
+        const PixieDescriptorHandle reused = descriptors.allocate();
+        CHECK(reused.index() == old.index());
+        CHECK(reused.generation() != old.generation());
+        CHECK(descriptors.valid(reused));
+        CHECK(!descriptors.valid(old));
+        CHECK(throws([&] { descriptors.free(old); }));
+        CHECK(descriptors.valid(reused));
+
+        CHECK(throws([&] { descriptors.free(invalidDescriptor); }));
+        CHECK(throws([&] { descriptors.index(invalidDescriptor); }));
+        CHECK(descriptors.stats().persistentInUse == 8);
+        CHECK(descriptors.stats().persistentHighWater == 8);
+    }
+
+    // the transient ring: a range that would run past the end skips to the start, the skipped tail counts as
+    // in use, and nothing comes back until the frame that used it retires
+    {
+        PixieDescriptorAllocator descriptors(16, 64);
+        uint32_t first = 0;
+        CHECK(descriptors.allocateTransient(24, first) && first == 16);
+        CHECK(descriptors.allocateTransient(24, first) && first == 40);
+        CHECK(!descriptors.allocateTransient(24, first));
+        descriptors.submit(1);
+        descriptors.retire(0);
+        CHECK(!descriptors.allocateTransient(24, first));
+        descriptors.retire(1);
+        CHECK(descriptors.allocateTransient(24, first) && first == 16);
+        CHECK(descriptors.stats().transientInUse == 40);
+        descriptors.submit(2);
+        descriptors.retire(2);
+        CHECK(descriptors.stats().transientInUse == 0);
+        CHECK(descriptors.stats().transientHighWater == 48);
+        CHECK(descriptors.stats().failedAllocations == 2);
+        CHECK(throws([&] { descriptors.allocateTransient(0, first); }));
+        CHECK(throws([&] { descriptors.allocateTransient(65, first); }));
+    }
+
+    // frames of random ranges with the gpu two frames behind, no live range may overlap another or leave the ring
+    {
+        constexpr uint32_t transientCount = 256;
+        PixieDescriptorAllocator descriptors(16, transientCount);
+        std::vector<uint64_t> owner(transientCount, 0); // fence of the frame using each descriptor, 0 when free
+        std::mt19937 rng(7);
+
+        bool overlapped = false;
+        bool outside = false;
+        bool wrapped = false;
+        for (uint64_t fence = 1; fence <= 500; ++fence) {
+            for (int i = 0; i < 8; ++i) {
+                const uint32_t count = 1 + rng() % 24;
+                uint32_t first = 0;
+                if (!descriptors.allocateTransient(count, first))
+                    break;
+
+                outside = outside || first < 16 || first + count > 16 + transientCount;
+                for (uint32_t j = first - 16; j < first - 16 + count && j < transientCount; ++j) {
+                    overlapped = overlapped || owner[j] != 0;
+                    owner[j] = fence;
+                }
+                wrapped = wrapped || first == 16;
+            }
+            descriptors.submit(fence);
+
+            if (fence > 2) {
+                descriptors.retire(fence - 2);
+                for (uint64_t &used : owner) {
+                    if (used != 0 && used <= fence - 2)
+                        used = 0;
+                }
+            }
+        }
+        CHECK(!overlapped);
+        CHECK(!outside);
+        CHECK(wrapped);
+
+        descriptors.retire(500);
+        CHECK(descriptors.stats().transientInUse == 0);
+    }
+
+    // allocate and free from several threads at once, every slot is held by at most one of them at a time and
+    // everything is back at the end
+    {
+        constexpr uint32_t persistentCount = 64;
+        PixieDescriptorAllocator descriptors(persistentCount, 0);
+        std::unique_ptr<std::atomic<int>[]> held(new std::atomic<int>[persistentCount]);
+        for (uint32_t i = 0; i < persistentCount; ++i)
+            held[i] = 0;
+        std::atomic<int> shared = 0;
+        std::atomic<int> stale = 0;
+
+        std::vector<std::thread> threads;
+        for (uint32_t t = 0; t < 4; ++t) {
+            threads.emplace_back([&, t] {
+                std::mt19937 rng(t);
+                std::vector<PixieDescriptorHandle> mine;
+                for (int i = 0; i < 20000; ++i) {
+                    if (mine.empty() || (mine.size() < 24 && rng() % 2 == 0)) {
+                        const PixieDescriptorHandle handle = descriptors.allocate();
+                        if (handle == invalidDescriptor)
+                            continue;
+                        if (held[handle.index()].exchange(1) != 0)
+                            shared++;
+                        mine.push_back(handle);
+                    } else {
+                        const size_t pick = rng() % mine.size();
+                        const PixieDescriptorHandle handle = mine[pick];
+                        mine[pick] = mine.back();
+                        mine.pop_back();
+                        if (!descriptors.valid(handle))
+                            stale++;
+                        held[handle.index()] = 0;
+                        descriptors.free(handle);
+                    }
+                }
+                for (const PixieDescriptorHandle handle : mine) {
+                    held[handle.index()] = 0;
+                    descriptors.free(handle);
+                }
+            });
+        }
+        for (std::thread &thread : threads)
+            thread.join();
+
+        CHECK(shared == 0);
+        CHECK(stale == 0);
+        CHECK(descriptors.stats().persistentInUse == 0);
+        CHECK(descriptors.stats().persistentHighWater <= persistentCount);
+
+        // and the free list still holds every slot exactly once
+        std::vector<bool> seen(persistentCount, false);
+        bool repeated = false;
+        for (uint32_t i = 0; i < persistentCount; ++i) {
+            const PixieDescriptorHandle handle = descriptors.allocate();
+            CHECK(handle != invalidDescriptor);
+            if (handle == invalidDescriptor)
+                break;
+            repeated = repeated || seen[handle.index()];
+            seen[handle.index()] = true;
+        }
+        CHECK(!repeated);
+        CHECK(descriptors.allocate() == invalidDescriptor);
+    }
+}
+
+static void testFrameRing() {
+    // gpus `latency` frames behind the cpu, from keeping up to never finishing anything by itself
+    for (uint32_t inFlight = 1; inFlight <= PixieFrameRing::maxFramesInFlight; ++inFlight) {
+        for (const uint32_t latency : {0u, 1u, 2u, 3u, 1000u}) {
+            PixieMockQueue queue(latency);
+            PixieFrameRing frames(queue, inFlight);
+
+            constexpr uint32_t frameCount = 200;
+            uint64_t guards[PixieFrameRing::maxFramesInFlight] = {};
+            bool reusedEarly = false;
+            bool wrongSlot = false;
+            bool tooFarAhead = false;
+            for (uint32_t i = 0; i < frameCount; ++i) {
+                const uint32_t slot = frames.beginFrame();
+                wrongSlot = wrongSlot || slot != i % inFlight;
+
+                // whatever used this slot last is done on the gpu
+                reusedEarly = reusedEarly || queue.completedValue() < guards[slot];
+                // and the cpu never runs more than the ring's depth ahead of it
+                tooFarAhead = tooFarAhead || queue.signaled() - queue.completedValue() > inFlight - 1 || frames.stats().framesAhead > inFlight - 1;
+
+                guards[slot] = frames.endFrame();
+                CHECK(frames.slotFence(slot) == guards[slot]);
+            }
+            CHECK(!wrongSlot);
+            CHECK(!reusedEarly);
+            CHECK(!tooFarAhead);
+            CHECK(frames.stats().frames == frameCount);
+
+            // a gpu within the ring's depth never makes the cpu wait, one past it makes every reuse wait
+            if (latency < inFlight)
+                CHECK(frames.stats().waits == 0);
+            else
+                CHECK(frames.stats().waits == frameCount - inFlight);
+            CHECK(queue.stallCount() == frames.stats().waits);
+
+            frames.flush();
+            CHECK(queue.completedValue() == queue.signaled());
+        }
+    }
+
+    PixieMockQueue queue;
+    CHECK(throws([&] { PixieFrameRing(queue, 0); }));
+    CHECK(throws([&] { PixieFrameRing(queue, PixieFrameRing::maxFramesInFlight + 1); }));
+
+    PixieFrameRing frames(queue, 2);
+    CHECK(throws([&] { frames.endFrame(); }));
+    frames.beginFrame();
+    CHECK(throws([&] { frames.beginFrame(); }));
+}
+
+static void testFramePacer() {
+    constexpr uint64_t ms = 1000000;
+    const auto near = [](double a, double b) { return std::fabs(a - b) < 1e-9; };
+
+    // fixed steps at 100 Hz whatever the frames do, the remainder carries over as alpha
+    {
+        PixieManualClock clock;
+        PixieFramePacer pacer(clock, 100.0);
+        CHECK(pacer.beginFrame() == 0); // the first frame only starts the clock
+
+        clock.advance(25 * ms);
+        CHECK(pacer.beginFrame() == 2);
+        CHECK(near(pacer.alpha(), 0.5));
+        CHECK(near(pacer.frameMs(), 25.0));
+
+        clock.advance(5 * ms);
+        CHECK(pacer.beginFrame() == 1);
+        CHECK(near(pacer.alpha(), 0.0));
+
+        clock.advance(3 * ms);
+        CHECK(pacer.beginFrame() == 0);
+        CHECK(near(pacer.alpha(), 0.3));
+
+        // a long frame is cut to maxSteps and the rest is dropped rather than carried into the next frames
+        pacer.setMaxStepsPerFrame(3);
+        clock.advance(92 * ms);
+        CHECK(pacer.beginFrame() == 3);
+        CHECK(pacer.stats().droppedSteps == 6);
+        CHECK(near(pacer.alpha(), 0.0));
+
+        clock.advance(10 * ms);
+        CHECK(pacer.beginFrame() == 1);
+        CHECK(pacer.stats().droppedSteps == 6);
+        CHECK(pacer.stats().frames == 5);
+    }
+
+    // uncapped, a hitch is a frame over twice the recent median
+    {
+        PixieManualClock clock;
+        PixieFramePacer pacer(clock, 60.0);
+        pacer.beginFrame();
+        for (int i = 0; i < 20; ++i) {
+            clock.advance(10 * ms);
+            pacer.beginFrame();
+        }
+        CHECK(pacer.stats().hitches == 0);
+        clock.advance(19 * ms);
+        pacer.beginFrame();
+        CHECK(pacer.stats().hitches == 0);
+        clock.advance(25 * ms);
+        pacer.beginFrame();
+        CHECK(pacer.stats().hitches == 1);
+    }
+
+    // capped at 100 fps: the sleep stops short of the deadline and the spin lands on it, even with a timer that
+    // oversleeps by half a millisecond
+    {
+        PixieManualClock clock(ms / 2, 1000);
+        PixieFramePacer pacer(clock, 60.0, 100.0);
+        pacer.beginFrame();
+
+        clock.advance(3 * ms);
+        pacer.beginFrame();
+        CHECK(clock.now() == 10 * ms);
+        CHECK(near(pacer.frameMs(), 10.0));
+
+        bool onTime = true;
+        for (uint64_t frame = 2; frame < 50; ++frame) {
+            clock.advance((frame % 7) * ms);
+            pacer.beginFrame();
+            onTime = onTime && clock.now() == frame * 10 * ms;
+        }
+        CHECK(onTime);
+        CHECK(pacer.stats().hitches == 0);
+
+        // a frame more than a period late starts a new schedule from where it ended instead of rushing to catch up
+        const uint64_t late = clock.now() + 35 * ms;
+        clock.advance(35 * ms);
+        pacer.beginFrame();
+        CHECK(clock.now() == late);
+        CHECK(pacer.stats().hitches == 1);
+
+        clock.advance(ms);
+        pacer.beginFrame();
+        CHECK(clock.now() == late + 10 * ms);
+        CHECK(near(pacer.frameMs(), 10.0));
+
+        clock.advance(ms);
+        pacer.beginFrame();
+        CHECK(clock.now() == late + 20 * ms);
+    }
+
+    // percentiles read the upper edge of their 0.1 ms bucket, capped by the exact max
+    {
+        PixieManualClock clock;
+        PixieFramePacer pacer(clock, 60.0);
+        pacer.beginFrame();
+        CHECK(pacer.stats().maxMs == 0.0);
+
+        uint64_t total = 0;
+        const auto frame = [&](uint64_t ns) {
+            clock.advance(ns);
+            pacer.beginFrame();
+            total += ns;
+        };
+        for (int i = 0; i < 97; ++i)
+            frame(4950000);
+        frame(20050000);
+        frame(20050000);
+        frame(40050000);
+
+        const PixieFrameTimeStats stats = pacer.stats();
+        CHECK(stats.frames == 100);
+        CHECK(near(stats.p50Ms, 5.0));
+        CHECK(near(stats.p99Ms, 20.1));
+        CHECK(near(stats.maxMs, 40.05));
+        CHECK(near(stats.averageMs, double(total) * 1e-6 / 100));
+
+        // only the last historySize frames count, the slow ones age out
+        for (uint32_t i = 0; i < PixieFramePacer::historySize; ++i)
+            frame(4950000);
+        CHECK(near(pacer.stats().maxMs, 4.95));
+        CHECK(near(pacer.stats().p99Ms, 4.95));
+    }
+
+    PixieManualClock clock;
+    CHECK(throws([&] { PixieFramePacer(clock, 0.0); }));
+    CHECK(throws([&] { PixieFramePacer(clock, 60.0, -1.0); }));
+}
+
+int main(int argc, char **argv) {
+    const char *filter = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+            filter = argv[++i];
+    }
+
+    // same group names as bench, so --filter picks the same area in both
+    const struct {
+        const char *group;
+        void (*run)();
+    } groups[] = {
+        {"recorder", testCommandRecorder},
+        {"descriptors", testDescriptors},
+        {"framering", testFrameRing},
+        {"framepacer", testFramePacer},
+        {"upload", testUploadAllocator},
+        {"texturefile", testTextureFile},
+        {"shadercache", testShaderCache},
+        {"audio", testAudio},
+    };
+    for (const auto &group : groups) {
+        if (filter && !std::strstr(group.group, filter))
+            continue;
+        const int failures = failureCount;
+        group.run();
+        std::printf("%-20s %s\n", group.group, failureCount == failures ? "ok" : "FAILED");
+    }
+
+    std::printf("%d checks, %d failed\n", checkCount, failureCount);
+    return failureCount > 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,98 @@
+#include "mipgen.hpp"
+#include "surfaceconvert.hpp"
+#include "texturefile.hpp"
+#include <SDL.h>
+#include <SDL_image.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// offline texture cook, usage: texcook <image.png> <output.pxtex> [--srgb] [--no-mips] [--premultiply] [--filter box|kaiser|lanczos] [--alpha-cutoff <0-1>] [--linear-data]
+// decodes once here so the runtime only maps the result and copies it into staging
+
+using namespace pxe;
+
+static int usage(const char *program) {
+    std::fprintf(stderr, "usage: %s <image.png> <output.pxtex> [--srgb] [--no-mips] [--premultiply] [--filter box|kaiser|lanczos] [--alpha-cutoff <0-1>] [--linear-data]\n", program);
+    return EXIT_FAILURE;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 3)
+        return usage(argv[0]);
+
+    bool srgb = false;
+    bool mips = true;
+    PixieConvertOptions options; // premultiplies the stored values, sRGB or not
+    PixieMipSettings mipSettings;
+    // anything not understood stops the cook, a typo'd flag or a missing value would otherwise cook the wrong thing without a word
+    for (int i = 3; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--srgb") == 0)
+            srgb = true;
+        else if (std::strcmp(argv[i], "--no-mips") == 0)
+            mips = false;
+        else if (std::strcmp(argv[i], "--premultiply") == 0)
+            options.premultiply = true;
+        else if (std::strcmp(argv[i], "--linear-data") == 0)
+            mipSettings.srgb = false; // normal maps and masks, filtered as stored
+        else if (std::strcmp(argv[i], "--alpha-cutoff") == 0 && i + 1 < argc) {
+            char *end = nullptr;
+            mipSettings.alphaCutoff = std::strtof(argv[++i], &end);
+            if (end == argv[i] || *end != '\0' || !(mipSettings.alphaCutoff >= 0.0f && mipSettings.alphaCutoff <= 1.0f))
+                return usage(argv[0]);
+        } else if (std::strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            const std::string filter = argv[++i];
+            if (filter == "box")
+                mipSettings.filter = PixieMipFilter::Box;
+            else if (filter == "kaiser")
+                mipSettings.filter = PixieMipFilter::Kaiser;
+            else if (filter == "lanczos")
+                mipSettings.filter = PixieMipFilter::Lanczos;
+            else
+                return usage(argv[0]);
+        } else {
+            return usage(argv[0]);
+        }
+    }
+
+    const auto decodeBegin = std::chrono::steady_clock::now();
+    SDL_Surface *loaded = IMG_Load(argv[1]);
+    if (loaded == nullptr) {
+        std::fprintf(stderr, "failed to load %s: %s\n", argv[1], IMG_GetError());
+        return EXIT_FAILURE;
+    }
+
+    const auto width = static_cast<uint32_t>(loaded->w);
+    const auto height = static_cast<uint32_t>(loaded->h);
+
+    // whatever the png decoded to, rows come out as tightly packed R8G8B8A8
+    const auto converted = convertSurface(loaded, PixiePixelConverter(), options);
+    SDL_FreeSurface(loaded);
+
+    const auto cookBegin = std::chrono::steady_clock::now();
+    const uint32_t mipCount = mips ? PixieTextureLayout::fullMipCount(width, height) : 1;
+    mipSettings.premultiplied = options.premultiply;
+    const auto levels = PixieMipGenerator().generate(converted.data(), width, height, mipSettings, mipCount);
+
+    std::vector<const uint8_t *> texels = {reinterpret_cast<const uint8_t *>(converted.data())};
+    for (const auto &level : levels)
+        texels.push_back(reinterpret_cast<const uint8_t *>(level.texels.data()));
+
+    const auto layout = PixieTextureLayout::make(srgb ? PixieTextureFormat::RGBA8_SRGB : PixieTextureFormat::RGBA8, width, height, mipCount);
+    if (!writeTextureFile(argv[2], layout, texels.data())) {
+        std::fprintf(stderr, "failed to write %s\n", argv[2]);
+        return EXIT_FAILURE;
+    }
+    const auto cookEnd = std::chrono::steady_clock::now();
+
+    const auto decodeMs = std::chrono::duration<double, std::milli>(cookBegin - decodeBegin).count();
+    const auto cookMs = std::chrono::duration<double, std::milli>(cookEnd - cookBegin).count();
+    std::printf("%ux%u, %u mips, %llu bytes, decode %.2f ms, cook %.2f ms\n",
+        width, height, mipCount, static_cast<unsigned long long>(layout.dataSize), decodeMs, cookMs);
+
+    return 0;
+}
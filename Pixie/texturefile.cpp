@@ -0,0 +1,137 @@
+#include "texturefile.hpp"
+#include "upload.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace pxe {
+    // file layout: header, mip table, padding up to dataOffset, texel data
+    static const char textureMagic[4] = {'P', 'X', 'T', 'X'};
+    static const uint32_t textureVersion = 1;
+    static const uint32_t maxMips = 16;
+
+    struct TextureHeader {
+        char magic[4];
+        uint32_t version;
+        uint32_t format;
+        uint32_t width;
+        uint32_t height;
+        uint32_t mipCount;
+        uint64_t dataOffset;
+        uint64_t dataSize;
+    };
+
+    struct TextureMipRecord {
+        uint64_t offset;
+        uint32_t width;
+        uint32_t height;
+        uint32_t rowPitch;
+        uint32_t reserved;
+        uint64_t size;
+    };
+
+    static_assert(sizeof(TextureHeader) == 40 && sizeof(TextureMipRecord) == 32, "texture file layout changed");
+
+    static const uint32_t bytesPerTexel = 4;
+
+    uint32_t PixieTextureLayout::fullMipCount(uint32_t width, uint32_t height) {
+        uint32_t count = 1;
+        while ((width > 1 || height > 1) && count < maxMips) {
+            width = std::max(width / 2, 1u);
+            height = std::max(height / 2, 1u);
+            count++;
+        }
+        return count;
+    }
+
+    PixieTextureLayout PixieTextureLayout::make(PixieTextureFormat format, uint32_t width, uint32_t height, uint32_t mipCount) {
+        if (width == 0 || height == 0 || mipCount == 0 || mipCount > fullMipCount(width, height))
+            throw std::invalid_argument("PixieTextureLayout: bad texture dimensions");
+
+        PixieTextureLayout layout = {format, width, height, {}, 0};
+        uint64_t offset = 0;
+
+        for (uint32_t i = 0; i < mipCount; ++i) {
+            PixieTextureMip mip = {};
+            mip.offset = PixieUploadAllocator::alignUp(offset, PixieUploadAllocator::placementAlignment);
+            mip.width = std::max(width >> i, 1u);
+            mip.height = std::max(height >> i, 1u);
+            mip.rowPitch = PixieUploadAllocator::rowPitch(mip.width, bytesPerTexel);
+            mip.size = PixieUploadAllocator::textureSize(mip.width, mip.height, bytesPerTexel);
+
+            layout.mips.push_back(mip);
+            offset = mip.offset + mip.size;
+        }
+
+        layout.dataSize = offset;
+        return layout;
+    }
+
+    bool writeTextureFile(const std::string &path, const PixieTextureLayout &layout, const uint8_t *const *mipTexels) {
+        const uint64_t tableEnd = sizeof(TextureHeader) + layout.mips.size() * sizeof(TextureMipRecord);
+
+        TextureHeader header = {};
+        std::memcpy(header.magic, textureMagic, sizeof(textureMagic));
+        header.version = textureVersion;
+        header.format = static_cast<uint32_t>(layout.format);
+        header.width = layout.width;
+        header.height = layout.height;
+        header.mipCount = static_cast<uint32_t>(layout.mips.size());
+        header.dataOffset = PixieUploadAllocator::alignUp(tableEnd, PixieUploadAllocator::placementAlignment);
+        header.dataSize = layout.dataSize;
+
+        // build the file image in memory so it goes out in one write
+        std::vector<uint8_t> image(header.dataOffset + header.dataSize);
+        std::memcpy(image.data(), &header, sizeof(header));
+
+        for (size_t i = 0; i < layout.mips.size(); ++i) {
+            const auto &mip = layout.mips[i];
+            const TextureMipRecord record = {mip.offset, mip.width, mip.height, mip.rowPitch, 0, mip.size};
+            std::memcpy(image.data() + sizeof(header) + i * sizeof(record), &record, sizeof(record));
+
+            uint8_t *dst = image.data() + header.dataOffset + mip.offset;
+            const size_t rowBytes = static_cast<size_t>(mip.width) * bytesPerTexel;
+            for (uint32_t y = 0; y < mip.height; ++y)
+                std::memcpy(dst + static_cast<size_t>(y) * mip.rowPitch, mipTexels[i] + y * rowBytes, rowBytes);
+        }
+
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char *>(image.data()), static_cast<std::streamsize>(image.size()));
+        return static_cast<bool>(out);
+    }
+
+    PixieTextureFile::PixieTextureFile(const std::string &path)
+        : file(path)
+        , dataOffset(0) {
+
+        TextureHeader header = {};
+        if (file.size() < sizeof(header))
+            throw std::runtime_error("PixieTextureFile: truncated " + path);
+
+        std::memcpy(&header, file.data(), sizeof(header));
+        if (std::memcmp(header.magic, textureMagic, sizeof(textureMagic)) != 0 || header.version != textureVersion)
+            throw std::runtime_error("PixieTextureFile: not a version 1 texture " + path);
+
+        // the layout assumes 4 byte texels and the value goes straight to d3d, so anything else is refused here
+        const auto format = static_cast<PixieTextureFormat>(header.format);
+        if (format != PixieTextureFormat::RGBA8 && format != PixieTextureFormat::RGBA8_SRGB)
+            throw std::runtime_error("PixieTextureFile: unsupported format " + std::to_string(header.format) + " in " + path);
+
+        // rebuild the layout from the header and make sure the file agrees with it
+        textureLayout = PixieTextureLayout::make(format, header.width, header.height, header.mipCount);
+        if (header.dataSize != textureLayout.dataSize || header.dataOffset % PixieUploadAllocator::placementAlignment != 0 || file.size() < header.dataOffset + header.dataSize)
+            throw std::runtime_error("PixieTextureFile: size mismatch " + path);
+
+        for (uint32_t i = 0; i < header.mipCount; ++i) {
+            TextureMipRecord record;
+            std::memcpy(&record, file.data() + sizeof(header) + i * sizeof(record), sizeof(record));
+
+            const auto &mip = textureLayout.mips[i];
+            if (record.offset != mip.offset || record.rowPitch != mip.rowPitch || record.size != mip.size)
+                throw std::runtime_error("PixieTextureFile: mip table mismatch " + path);
+        }
+
+        dataOffset = header.dataOffset;
+    }
+} // namespace pxe
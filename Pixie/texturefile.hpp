@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "mappedfile.hpp"
+
+namespace pxe {
+    // values match DXGI_FORMAT so the renderer can pass them straight through
+    enum class PixieTextureFormat : uint32_t {
+        RGBA8 = 28, // DXGI_FORMAT_R8G8B8A8_UNORM
+        RGBA8_SRGB = 29 // DXGI_FORMAT_R8G8B8A8_UNORM_SRGB
+    };
+
+    // one mip as it sits in the file, offsets are from the start of the texel data
+    struct PixieTextureMip {
+        uint64_t offset;
+        uint32_t width;
+        uint32_t height;
+        uint32_t rowPitch;
+        uint64_t size;
+    };
+
+    // texel data laid out like D3D12 placed footprints, 512 aligned mips with 256 aligned rows,
+    // so the whole block can be copied into a staging region as is
+    struct PixieTextureLayout {
+        PixieTextureFormat format;
+        uint32_t width;
+        uint32_t height;
+        std::vector<PixieTextureMip> mips;
+        uint64_t dataSize;
+
+        static PixieTextureLayout make(PixieTextureFormat format, uint32_t width, uint32_t height, uint32_t mipCount);
+        static uint32_t fullMipCount(uint32_t width, uint32_t height);
+    };
+
+    // mipTexels[i] holds mip i tightly packed, returns false when the file can't be written
+    bool writeTextureFile(const std::string &path, const PixieTextureLayout &layout, const uint8_t *const *mipTexels);
+
+    // memory mapped .pxtex, nothing is decoded or copied on load
+    class PixieTextureFile {
+    public:
+        explicit PixieTextureFile(const std::string &path);
+
+        const PixieTextureLayout &layout() const { return textureLayout; }
+        const uint8_t *data() const { return file.data() + dataOffset; }
+        const uint8_t *mipData(uint32_t mip) const { return data() + textureLayout.mips[mip].offset; }
+
+    private:
+        PixieMappedFile file;
+        PixieTextureLayout textureLayout;
+        uint64_t dataOffset;
+    };
+} // namespace pxe
@@ -0,0 +1,292 @@
+#include "texturestream.hpp"
+#include "profiler.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace pxe {
+    static const uint32_t noTexture = UINT32_MAX;
+
+    PixieTextureStreamer::PixieTextureStreamer(PixieTextureDecoder decoder, PixieStreamSink &sink, const PixieStreamSettings &settings)
+        : decoder(std::move(decoder))
+        , sink(sink)
+        , settings(settings)
+        , lruHead(noTexture)
+        , lruTail(noTexture)
+        , frame(0)
+        , bytesResident(0)
+        , residentCount(0)
+        , loads(0)
+        , evictions(0)
+        , failures(0)
+        , latencies(latencyWindow, 0.0)
+        , latencyCount(0)
+        , nextTicket(1)
+        , queued(0)
+        , decoding(0)
+        , completed(nullptr)
+        , stopping(false)
+        , jobPool(std::max<size_t>(settings.threadCount, 1)) {
+
+        textures.reserve(settings.maxTextures);
+        liveTickets.assign(settings.maxTextures, 0);
+    }
+
+    PixieTextureStreamer::~PixieTextureStreamer() {
+        // queued decodes see the flag and skip straight to the end
+        stopping = true;
+        jobPool.wait();
+
+        for (Completion *c = completed.exchange(nullptr); c != nullptr;) {
+            Completion *next = c->next;
+            delete c;
+            c = next;
+        }
+        for (Completion *c : ready)
+            delete c;
+    }
+
+    PixieTextureHandle PixieTextureStreamer::registerTexture(const std::string &path) {
+        const auto found = handles.find(path);
+        if (found != handles.end())
+            return found->second;
+
+        if (textures.size() >= settings.maxTextures)
+            throw std::out_of_range("PixieTextureStreamer: too many textures");
+
+        const auto handle = static_cast<PixieTextureHandle>(textures.size());
+        textures.push_back({path, State::Unloaded, 0, 0, 0, {}, noTexture, noTexture});
+        handles.emplace(path, handle);
+        return handle;
+    }
+
+    void PixieTextureStreamer::request(PixieTextureHandle handle, int priority) {
+        Texture &texture = textures.at(handle);
+
+        switch (texture.state) {
+            case State::Unloaded:
+            case State::Failed:
+                texture.state = State::Requested;
+                texture.priority = priority;
+                texture.requested = std::chrono::steady_clock::now();
+                enqueue(handle, priority, false);
+                break;
+            case State::Requested:
+                if (priority > texture.priority) {
+                    texture.priority = priority;
+                    enqueue(handle, priority, true);
+                }
+                break;
+            default:
+                texture.priority = std::max(texture.priority, priority);
+                break;
+        }
+    }
+
+    bool PixieTextureStreamer::resolve(PixieTextureHandle handle) {
+        Texture &texture = textures.at(handle);
+        texture.lastUsed = frame;
+
+        if (texture.state == State::Resident) {
+            lruUnlink(handle);
+            lruPushFront(handle);
+            return true;
+        }
+
+        if (texture.state == State::Unloaded)
+            request(handle, texture.priority);
+        return false;
+    }
+
+    // a priority bump pushes a second entry with a newer ticket and the older one is skipped when popped,
+    // a load a worker has already taken can't be bumped any more
+    void PixieTextureStreamer::enqueue(PixieTextureHandle handle, int priority, bool bump) {
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            if (bump && liveTickets[handle] == 0)
+                return;
+
+            if (!bump)
+                queued++;
+            liveTickets[handle] = nextTicket++;
+            queue.push({priority, liveTickets[handle], handle, textures[handle].path});
+        }
+
+        jobPool.submit([this] { decodeNext(); });
+    }
+
+    // every queue push submits exactly one of these, so each entry is popped by someone
+    void PixieTextureStreamer::decodeNext() {
+        QueueEntry entry;
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            entry = queue.top();
+            queue.pop();
+
+            if (liveTickets[entry.handle] != entry.ticket)
+                return;
+
+            liveTickets[entry.handle] = 0;
+            queued--;
+            decoding++;
+        }
+
+        auto *completion = new Completion {entry.handle, false, 0, {}, nullptr};
+        if (!stopping) {
+            PIXIE_ZONE("PixieTextureStreamer::decode");
+            try {
+                completion->ok = decoder(entry.path, completion->texture) && !completion->texture.levels.empty();
+            } catch (const std::exception &) {
+                completion->ok = false;
+            }
+        }
+
+        for (const auto &level : completion->texture.levels)
+            completion->bytes += level.texels.size() * sizeof(uint32_t);
+
+        // multiple producers, one consumer that always takes the whole stack, so there's no aba to worry about
+        completion->next = completed.load(std::memory_order_relaxed);
+        while (!completed.compare_exchange_weak(completion->next, completion, std::memory_order_release, std::memory_order_relaxed)) {
+        }
+
+        decoding--;
+    }
+
+    void PixieTextureStreamer::update() {
+        frame++;
+
+        // the stack comes back newest first
+        std::vector<Completion *> arrived;
+        for (Completion *c = completed.exchange(nullptr, std::memory_order_acquire); c != nullptr; c = c->next)
+            arrived.push_back(c);
+
+        for (auto it = arrived.rbegin(); it != arrived.rend(); ++it) {
+            Completion *c = *it;
+            if (!c->ok || c->bytes > settings.budgetBytes) {
+                textures[c->handle].state = State::Failed;
+                failures++;
+                delete c;
+                continue;
+            }
+
+            textures[c->handle].state = State::Ready;
+            textures[c->handle].bytes = c->bytes;
+            ready.push_back(c);
+        }
+
+        // highest priority first, the rest waits for a later frame
+        std::stable_sort(ready.begin(), ready.end(), [this](const Completion *a, const Completion *b) {
+            return textures[a->handle].priority > textures[b->handle].priority;
+        });
+
+        uint64_t uploaded = 0;
+        size_t consumed = 0;
+        for (; consumed < ready.size(); ++consumed) {
+            Completion *c = ready[consumed];
+
+            // one upload always goes through so a texture bigger than the per frame cap still gets in
+            if (uploaded != 0 && uploaded + c->bytes > settings.uploadBytesPerUpdate)
+                break;
+            if (!makeRoom(c->bytes))
+                break;
+
+            Texture &texture = textures[c->handle];
+            sink.makeResident(c->handle, c->texture);
+
+            texture.state = State::Resident;
+            texture.lastUsed = frame;
+            lruPushFront(c->handle);
+            bytesResident += c->bytes;
+            residentCount++;
+            uploaded += c->bytes;
+            loads++;
+
+            latencies[latencyCount++ % latencyWindow] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - texture.requested).count();
+            delete c;
+        }
+        ready.erase(ready.begin(), ready.begin() + consumed);
+    }
+
+    // evicts from the cold end, anything used in the last evictionDelay frames may still be read by the gpu
+    bool PixieTextureStreamer::makeRoom(uint64_t bytes) {
+        while (bytesResident + bytes > settings.budgetBytes) {
+            if (lruTail == noTexture || textures[lruTail].lastUsed + settings.evictionDelay > frame)
+                return false;
+
+            const uint32_t victim = lruTail;
+            Texture &texture = textures[victim];
+            lruUnlink(victim);
+            sink.evict(victim);
+
+            texture.state = State::Unloaded;
+            bytesResident -= texture.bytes;
+            residentCount--;
+            evictions++;
+        }
+        return true;
+    }
+
+    void PixieTextureStreamer::waitIdle() {
+        jobPool.wait();
+    }
+
+    bool PixieTextureStreamer::isResident(PixieTextureHandle handle) const {
+        return textures.at(handle).state == State::Resident;
+    }
+
+    PixieStreamStats PixieTextureStreamer::stats() const {
+        PixieStreamStats result = {};
+        {
+            std::lock_guard<std::mutex> lock(queueMutex);
+            result.queueDepth = queued;
+        }
+        result.decoding = decoding;
+        result.readyToUpload = ready.size();
+        result.resident = residentCount;
+        result.bytesResident = bytesResident;
+        result.budgetBytes = settings.budgetBytes;
+        result.loads = loads;
+        result.evictions = evictions;
+        result.failures = failures;
+
+        const size_t count = std::min(latencyCount, latencyWindow);
+        if (count != 0) {
+            std::vector<double> sorted(latencies.begin(), latencies.begin() + count);
+            std::sort(sorted.begin(), sorted.end());
+            const auto percentile = [&](double p) { return sorted[std::min(count - 1, static_cast<size_t>(p * count))]; };
+            result.latencyP50Ms = percentile(0.50);
+            result.latencyP95Ms = percentile(0.95);
+            result.latencyP99Ms = percentile(0.99);
+        }
+
+        return result;
+    }
+
+    void PixieTextureStreamer::lruUnlink(uint32_t handle) {
+        Texture &texture = textures[handle];
+        if (texture.prev != noTexture)
+            textures[texture.prev].next = texture.next;
+        else if (lruHead == handle)
+            lruHead = texture.next;
+
+        if (texture.next != noTexture)
+            textures[texture.next].prev = texture.prev;
+        else if (lruTail == handle)
+            lruTail = texture.prev;
+
+        texture.prev = noTexture;
+        texture.next = noTexture;
+    }
+
+    void PixieTextureStreamer::lruPushFront(uint32_t handle) {
+        Texture &texture = textures[handle];
+        texture.prev = noTexture;
+        texture.next = lruHead;
+
+        if (lruHead != noTexture)
+            textures[lruHead].prev = handle;
+        lruHead = handle;
+
+        if (lruTail == noTexture)
+            lruTail = handle;
+    }
+} // namespace pxe
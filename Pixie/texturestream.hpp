@@ -0,0 +1,163 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "jobs.hpp"
+#include "mipgen.hpp"
+#include "texturefile.hpp"
+
+namespace pxe {
+    using PixieTextureHandle = uint32_t;
+    static const PixieTextureHandle invalidTextureHandle = UINT32_MAX;
+
+    // what a decoder hands back, the format says how the R8G8B8A8 texels are read (srgb or not)
+    struct PixieDecodedTexture {
+        PixieTextureFormat format = PixieTextureFormat::RGBA8;
+        std::vector<PixieMipLevel> levels; // level 0 first
+    };
+
+    // runs on a worker, fills the texture with its mip chain and returns false on failure
+    using PixieTextureDecoder = std::function<bool(const std::string &path, PixieDecodedTexture &texture)>;
+
+    // render thread side of residency, handles are dense so they can index descriptor slots directly
+    class PixieStreamSink {
+    public:
+        virtual ~PixieStreamSink() = default;
+        virtual void makeResident(PixieTextureHandle handle, const PixieDecodedTexture &texture) = 0;
+        virtual void evict(PixieTextureHandle handle) = 0;
+    };
+
+    struct PixieStreamSettings {
+        uint64_t budgetBytes = 256ull * 1024 * 1024;
+        uint64_t uploadBytesPerUpdate = 16ull * 1024 * 1024; // caps the copies one frame records
+        uint32_t maxTextures = 1024;
+        uint32_t evictionDelay = 4; // frames since last use before a texture can go, has to cover the frames in flight
+        size_t threadCount = 2;
+    };
+
+    struct PixieStreamStats {
+        size_t queueDepth; // requested, not picked up by a worker yet
+        size_t decoding;
+        size_t readyToUpload; // decoded, waiting on the upload or residency budget
+        size_t resident;
+        uint64_t bytesResident;
+        uint64_t budgetBytes;
+        uint64_t loads;
+        uint64_t evictions;
+        uint64_t failures;
+        double latencyP50Ms; // request to resident, over the last latencyWindow loads
+        double latencyP95Ms;
+        double latencyP99Ms;
+    };
+
+    // background decode with a byte budget, everything but the workers runs on the render thread
+    class PixieTextureStreamer {
+    public:
+        static const size_t latencyWindow = 1024;
+
+        PixieTextureStreamer(PixieTextureDecoder decoder, PixieStreamSink &sink, const PixieStreamSettings &settings = {});
+        ~PixieTextureStreamer();
+
+        PixieTextureStreamer(const PixieTextureStreamer &) = delete;
+        PixieTextureStreamer &operator=(const PixieTextureStreamer &) = delete;
+
+        // the same path always maps to the same handle
+        PixieTextureHandle registerTexture(const std::string &path);
+        // queues a load if the texture isn't resident, a higher priority moves a queued load forward
+        void request(PixieTextureHandle handle, int priority = 0);
+        // marks the texture used this frame and returns whether it's resident, a miss queues a load
+        bool resolve(PixieTextureHandle handle);
+
+        // once per frame: picks up finished decodes, makes them resident within budget and evicts cold textures
+        void update();
+        // blocks until every queued decode has finished, for loading screens and tests
+        void waitIdle();
+
+        bool isResident(PixieTextureHandle handle) const;
+        PixieStreamStats stats() const;
+
+    private:
+        enum class State {
+            Unloaded,
+            Requested, // queued or decoding
+            Ready, // decoded, waiting for update
+            Resident,
+            Failed
+        };
+
+        struct Texture {
+            std::string path;
+            State state;
+            int priority;
+            uint64_t bytes;
+            uint64_t lastUsed; // frame number
+            std::chrono::steady_clock::time_point requested;
+            uint32_t prev; // lru list, most recent at the head
+            uint32_t next;
+        };
+
+        struct QueueEntry {
+            int priority;
+            uint64_t ticket; // older first within a priority
+            PixieTextureHandle handle;
+            std::string path;
+
+            bool operator<(const QueueEntry &other) const {
+                return priority != other.priority ? priority < other.priority : ticket > other.ticket;
+            }
+        };
+
+        // decoded texture on its way back, pushed onto a lock-free stack that only update pops
+        struct Completion {
+            PixieTextureHandle handle;
+            bool ok;
+            uint64_t bytes;
+            PixieDecodedTexture texture;
+            Completion *next;
+        };
+
+        void enqueue(PixieTextureHandle handle, int priority, bool bump);
+        void decodeNext();
+        bool makeRoom(uint64_t bytes);
+        void lruUnlink(uint32_t handle);
+        void lruPushFront(uint32_t handle);
+
+        PixieTextureDecoder decoder;
+        PixieStreamSink &sink;
+        PixieStreamSettings settings;
+
+        // render thread
+        std::vector<Texture> textures;
+        std::unordered_map<std::string, PixieTextureHandle> handles;
+        std::vector<Completion *> ready;
+        uint32_t lruHead;
+        uint32_t lruTail;
+        uint64_t frame;
+        uint64_t bytesResident;
+        size_t residentCount;
+        uint64_t loads;
+        uint64_t evictions;
+        uint64_t failures;
+        std::vector<double> latencies;
+        size_t latencyCount;
+
+        // shared with the workers
+        mutable std::mutex queueMutex;
+        std::priority_queue<QueueEntry> queue; // may hold stale entries, only the latest ticket per handle is live
+        std::vector<uint64_t> liveTickets; // 0 once a worker has taken the load
+        uint64_t nextTicket;
+        size_t queued;
+        std::atomic<size_t> decoding;
+        std::atomic<Completion *> completed;
+        std::atomic<bool> stopping;
+
+        PixieJobPool jobPool; // last, so its workers are gone before anything they touch
+    };
+} // namespace pxe
@@ -0,0 +1,579 @@
+#include "transform2d.hpp"
+#include "profiler.hpp"
+#include <stdexcept>
+
+namespace pxe {
+    struct ComposeSpan {
+        const float *la;
+        const float *lb;
+        const float *lc;
+        const float *ld;
+        const float *ltx;
+        const float *lty;
+        float *wa;
+        float *wb;
+        float *wc;
+        float *wd;
+        float *wtx;
+        float *wty;
+        const int32_t *parents;
+        uint32_t count;
+    };
+
+    static void composeScalar(const ComposeSpan &span, uint32_t first, uint32_t last) {
+        for (uint32_t i = first; i < last; ++i) {
+            const int32_t p = span.parents[i];
+            if (p < 0) {
+                span.wa[i] = span.la[i];
+                span.wb[i] = span.lb[i];
+                span.wc[i] = span.lc[i];
+                span.wd[i] = span.ld[i];
+                span.wtx[i] = span.ltx[i];
+                span.wty[i] = span.lty[i];
+                continue;
+            }
+
+            const float pa = span.wa[p], pb = span.wb[p], pc = span.wc[p], pd = span.wd[p];
+            span.wa[i] = pa * span.la[i] + pc * span.lb[i];
+            span.wb[i] = pb * span.la[i] + pd * span.lb[i];
+            span.wc[i] = pa * span.lc[i] + pc * span.ld[i];
+            span.wd[i] = pb * span.lc[i] + pd * span.ld[i];
+            span.wtx[i] = pa * span.ltx[i] + pc * span.lty[i] + span.wtx[p];
+            span.wty[i] = pb * span.ltx[i] + pd * span.lty[i] + span.wty[p];
+        }
+    }
+
+    static void composeSSE2(const ComposeSpan &span) {
+        uint32_t i = 0;
+        for (; i + 4 <= span.count; i += 4) {
+            const int32_t *p = span.parents + i;
+            // a parent inside this block isn't composed yet
+            if (p[0] >= int32_t(i) || p[1] >= int32_t(i) || p[2] >= int32_t(i) || p[3] >= int32_t(i)) {
+                composeScalar(span, i, i + 4);
+                continue;
+            }
+
+            // no gather before avx2, roots read the identity
+            const auto fetch = [p](const float *column, float identity) {
+                return _mm_setr_ps(p[0] < 0 ? identity : column[p[0]], p[1] < 0 ? identity : column[p[1]], p[2] < 0 ? identity : column[p[2]],
+                    p[3] < 0 ? identity : column[p[3]]);
+            };
+            const __m128 pa = fetch(span.wa, 1.0f);
+            const __m128 pb = fetch(span.wb, 0.0f);
+            const __m128 pc = fetch(span.wc, 0.0f);
+            const __m128 pd = fetch(span.wd, 1.0f);
+            const __m128 ptx = fetch(span.wtx, 0.0f);
+            const __m128 pty = fetch(span.wty, 0.0f);
+
+            const __m128 la = _mm_loadu_ps(span.la + i);
+            const __m128 lb = _mm_loadu_ps(span.lb + i);
+            const __m128 lc = _mm_loadu_ps(span.lc + i);
+            const __m128 ld = _mm_loadu_ps(span.ld + i);
+            const __m128 ltx = _mm_loadu_ps(span.ltx + i);
+            const __m128 lty = _mm_loadu_ps(span.lty + i);
+
+            _mm_storeu_ps(span.wa + i, _mm_add_ps(_mm_mul_ps(pa, la), _mm_mul_ps(pc, lb)));
+            _mm_storeu_ps(span.wb + i, _mm_add_ps(_mm_mul_ps(pb, la), _mm_mul_ps(pd, lb)));
+            _mm_storeu_ps(span.wc + i, _mm_add_ps(_mm_mul_ps(pa, lc), _mm_mul_ps(pc, ld)));
+            _mm_storeu_ps(span.wd + i, _mm_add_ps(_mm_mul_ps(pb, lc), _mm_mul_ps(pd, ld)));
+            _mm_storeu_ps(span.wtx + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(pa, ltx), _mm_mul_ps(pc, lty)), ptx));
+            _mm_storeu_ps(span.wty + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(pb, ltx), _mm_mul_ps(pd, lty)), pty));
+        }
+        composeScalar(span, i, span.count);
+    }
+
+    PIXIE_TARGET_AVX2 static void composeAVX2(const ComposeSpan &span) {
+        const __m256i none = _mm256_set1_epi32(-1);
+        const __m256 one = _mm256_set1_ps(1.0f);
+        const __m256 zero = _mm256_setzero_ps();
+
+        uint32_t i = 0;
+        for (; i + 8 <= span.count; i += 8) {
+            const __m256i parent = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(span.parents + i));
+            const __m256i earlier = _mm256_cmpgt_epi32(_mm256_set1_epi32(int32_t(i)), parent);
+            if (_mm256_movemask_ps(_mm256_castsi256_ps(earlier)) != 0xff) {
+                _mm256_zeroupper();
+                composeScalar(span, i, i + 8);
+                continue;
+            }
+
+            // roots are masked off the gather and keep the identity
+            const __m256 hasParent = _mm256_castsi256_ps(_mm256_cmpgt_epi32(parent, none));
+            const __m256 pa = _mm256_mask_i32gather_ps(one, span.wa, parent, hasParent, 4);
+            const __m256 pb = _mm256_mask_i32gather_ps(zero, span.wb, parent, hasParent, 4);
+            const __m256 pc = _mm256_mask_i32gather_ps(zero, span.wc, parent, hasParent, 4);
+            const __m256 pd = _mm256_mask_i32gather_ps(one, span.wd, parent, hasParent, 4);
+            const __m256 ptx = _mm256_mask_i32gather_ps(zero, span.wtx, parent, hasParent, 4);
+            const __m256 pty = _mm256_mask_i32gather_ps(zero, span.wty, parent, hasParent, 4);
+
+            const __m256 la = _mm256_loadu_ps(span.la + i);
+            const __m256 lb = _mm256_loadu_ps(span.lb + i);
+            const __m256 lc = _mm256_loadu_ps(span.lc + i);
+            const __m256 ld = _mm256_loadu_ps(span.ld + i);
+            const __m256 ltx = _mm256_loadu_ps(span.ltx + i);
+            const __m256 lty = _mm256_loadu_ps(span.lty + i);
+
+            _mm256_storeu_ps(span.wa + i, _mm256_fmadd_ps(pa, la, _mm256_mul_ps(pc, lb)));
+            _mm256_storeu_ps(span.wb + i, _mm256_fmadd_ps(pb, la, _mm256_mul_ps(pd, lb)));
+            _mm256_storeu_ps(span.wc + i, _mm256_fmadd_ps(pa, lc, _mm256_mul_ps(pc, ld)));
+            _mm256_storeu_ps(span.wd + i, _mm256_fmadd_ps(pb, lc, _mm256_mul_ps(pd, ld)));
+            _mm256_storeu_ps(span.wtx + i, _mm256_fmadd_ps(pa, ltx, _mm256_fmadd_ps(pc, lty, ptx)));
+            _mm256_storeu_ps(span.wty + i, _mm256_fmadd_ps(pb, ltx, _mm256_fmadd_ps(pd, lty, pty)));
+        }
+        _mm256_zeroupper();
+        composeScalar(span, i, span.count);
+    }
+
+    void PixieTransformHierarchy::Columns::push(const PixieTransform2D &transform) {
+        a.push_back(transform.a);
+        b.push_back(transform.b);
+        c.push_back(transform.c);
+        d.push_back(transform.d);
+        tx.push_back(transform.tx);
+        ty.push_back(transform.ty);
+    }
+
+    void PixieTransformHierarchy::Columns::set(uint32_t index, const PixieTransform2D &transform) {
+        a[index] = transform.a;
+        b[index] = transform.b;
+        c[index] = transform.c;
+        d[index] = transform.d;
+        tx[index] = transform.tx;
+        ty[index] = transform.ty;
+    }
+
+    PixieTransform2D PixieTransformHierarchy::Columns::get(uint32_t index) const {
+        return {a[index], b[index], c[index], d[index], tx[index], ty[index]};
+    }
+
+    void PixieTransformHierarchy::Columns::clear() {
+        a.clear();
+        b.clear();
+        c.clear();
+        d.clear();
+        tx.clear();
+        ty.clear();
+    }
+
+    PixieTransformHierarchy::PixieTransformHierarchy(PixieSIMDLevel level)
+        : simdLevel(level) {
+    }
+
+    uint32_t PixieTransformHierarchy::add(const PixieTransform2D &local, uint32_t parent) {
+        const uint32_t node = size();
+        if (parent != noParent && parent >= node)
+            throw std::invalid_argument("PixieTransformHierarchy: parent has to be added before its children");
+        if (node == uint32_t(INT32_MAX))
+            throw std::length_error("PixieTransformHierarchy: too many nodes");
+
+        locals.push(local);
+        worlds.push(local);
+        parents.push_back(parent == noParent ? -1 : static_cast<int32_t>(parent));
+        return node;
+    }
+
+    void PixieTransformHierarchy::setLocal(uint32_t node, const PixieTransform2D &local) {
+        locals.set(node, local);
+    }
+
+    PixieTransform2D PixieTransformHierarchy::local(uint32_t node) const {
+        return locals.get(node);
+    }
+
+    PixieTransform2D PixieTransformHierarchy::world(uint32_t node) const {
+        return worlds.get(node);
+    }
+
+    void PixieTransformHierarchy::compose() {
+        PIXIE_ZONE("compose transforms");
+        const ComposeSpan span = {locals.a.data(), locals.b.data(), locals.c.data(), locals.d.data(), locals.tx.data(), locals.ty.data(), worlds.a.data(),
+            worlds.b.data(), worlds.c.data(), worlds.d.data(), worlds.tx.data(), worlds.ty.data(), parents.data(), size()};
+
+        switch (simdLevel) {
+            case PixieSIMDLevel::AVX2:
+                composeAVX2(span);
+                break;
+            case PixieSIMDLevel::SSE2:
+                composeSSE2(span);
+                break;
+            default:
+                composeScalar(span, 0, span.count);
+                break;
+        }
+    }
+
+    void PixieTransformHierarchy::clear() {
+        locals.clear();
+        worlds.clear();
+        parents.clear();
+    }
+
+    void PixieSpriteArrays::push(const PixieRect &rect, const PixieRect &uv, uint32_t spriteColor, uint32_t spriteTransform) {
+        x.push_back(rect.x);
+        y.push_back(rect.y);
+        width.push_back(rect.width);
+        height.push_back(rect.height);
+        u0.push_back(uv.x);
+        v0.push_back(uv.y);
+        u1.push_back(uv.x + uv.width);
+        v1.push_back(uv.y + uv.height);
+        color.push_back(spriteColor);
+        transform.push_back(spriteTransform);
+    }
+
+    void PixieSpriteArrays::reserve(size_t count) {
+        x.reserve(count);
+        y.reserve(count);
+        width.reserve(count);
+        height.reserve(count);
+        u0.reserve(count);
+        v0.reserve(count);
+        u1.reserve(count);
+        v1.reserve(count);
+        color.reserve(count);
+        transform.reserve(count);
+    }
+
+    void PixieSpriteArrays::clear() {
+        x.clear();
+        y.clear();
+        width.clear();
+        height.clear();
+        u0.clear();
+        v0.clear();
+        u1.clear();
+        v1.clear();
+        color.clear();
+        transform.clear();
+    }
+
+    struct ExpandSpan {
+        const PixieSpriteArrays *sprites;
+        const PixieTransformColumns *transforms;
+        float clipScaleX;
+        float clipScaleY;
+    };
+
+    // one sprite's corners, top left, top right, bottom right, bottom left
+    struct Quad {
+        float x[4];
+        float y[4];
+    };
+
+    static Quad quadScalar(const ExpandSpan &span, size_t i) {
+        const PixieSpriteArrays &sprites = *span.sprites;
+        float a = 1.0f, b = 0.0f, c = 0.0f, d = 1.0f, tx = 0.0f, ty = 0.0f;
+        if (span.transforms) {
+            const PixieTransformColumns &t = *span.transforms;
+            const uint32_t node = sprites.transform[i];
+            a = t.a[node];
+            b = t.b[node];
+            c = t.c[node];
+            d = t.d[node];
+            tx = t.tx[node];
+            ty = t.ty[node];
+        }
+
+        // fold the pixel to clip space mapping into the transform, like PixieSpriteBatch
+        a *= span.clipScaleX;
+        c *= span.clipScaleX;
+        tx = tx * span.clipScaleX - 1.0f;
+        b *= span.clipScaleY;
+        d *= span.clipScaleY;
+        ty = ty * span.clipScaleY + 1.0f;
+
+        // one corner transformed, the others are the rect's transformed edges added on
+        const float x0 = a * sprites.x[i] + c * sprites.y[i] + tx;
+        const float y0 = b * sprites.x[i] + d * sprites.y[i] + ty;
+        const float acrossX = a * sprites.width[i];
+        const float acrossY = b * sprites.width[i];
+        const float downX = c * sprites.height[i];
+        const float downY = d * sprites.height[i];
+
+        return {{x0, x0 + acrossX, x0 + acrossX + downX, x0 + downX}, {y0, y0 + acrossY, y0 + acrossY + downY, y0 + downY}};
+    }
+
+    static uint32_t unorm16(float value) {
+        const float clamped = value > 0.0f ? (value < 1.0f ? value : 1.0f) : 0.0f;
+        return static_cast<uint32_t>(clamped * 65535.0f + 0.5f);
+    }
+
+    static void expandScalar(const ExpandSpan &span, size_t first, size_t last, PixieVertexData *out) {
+        const PixieSpriteArrays &sprites = *span.sprites;
+        for (size_t i = first; i < last; ++i) {
+            const Quad quad = quadScalar(span, i);
+            const float u[4] = {sprites.u0[i], sprites.u1[i], sprites.u1[i], sprites.u0[i]};
+            const float v[4] = {sprites.v0[i], sprites.v0[i], sprites.v1[i], sprites.v1[i]};
+            PixieVertexData *vertex = out + (i - first) * 4;
+            for (int k = 0; k < 4; ++k)
+                vertex[k] = {{quad.x[k], quad.y[k], 0.0f}, {u[k], v[k]}, sprites.color[i]};
+        }
+    }
+
+    static void expandCompactScalar(const ExpandSpan &span, size_t first, size_t last, PixieCompactVertex *out) {
+        const PixieSpriteArrays &sprites = *span.sprites;
+        for (size_t i = first; i < last; ++i) {
+            const Quad quad = quadScalar(span, i);
+            const uint32_t u0 = unorm16(sprites.u0[i]), u1 = unorm16(sprites.u1[i]);
+            const uint32_t v0 = unorm16(sprites.v0[i]) << 16, v1 = unorm16(sprites.v1[i]) << 16;
+            const uint32_t uv[4] = {u0 | v0, u1 | v0, u1 | v1, u0 | v1};
+            PixieCompactVertex *vertex = out + (i - first) * 4;
+            for (int k = 0; k < 4; ++k)
+                vertex[k] = {{quad.x[k], quad.y[k]}, uv[k], sprites.color[i]};
+        }
+    }
+
+    // corners of 4 sprites a lane each
+    struct QuadsSSE2 {
+        __m128 x[4];
+        __m128 y[4];
+    };
+
+    static QuadsSSE2 quadsSSE2(const ExpandSpan &span, size_t i) {
+        const PixieSpriteArrays &sprites = *span.sprites;
+        __m128 a = _mm_set1_ps(1.0f), b = _mm_setzero_ps(), c = _mm_setzero_ps(), d = _mm_set1_ps(1.0f), tx = _mm_setzero_ps(), ty = _mm_setzero_ps();
+        if (span.transforms) {
+            const PixieTransformColumns &t = *span.transforms;
+            const uint32_t *n = sprites.transform.data() + i;
+            a = _mm_setr_ps(t.a[n[0]], t.a[n[1]], t.a[n[2]], t.a[n[3]]);
+            b = _mm_setr_ps(t.b[n[0]], t.b[n[1]], t.b[n[2]], t.b[n[3]]);
+            c = _mm_setr_ps(t.c[n[0]], t.c[n[1]], t.c[n[2]], t.c[n[3]]);
+            d = _mm_setr_ps(t.d[n[0]], t.d[n[1]], t.d[n[2]], t.d[n[3]]);
+            tx = _mm_setr_ps(t.tx[n[0]], t.tx[n[1]], t.tx[n[2]], t.tx[n[3]]);
+            ty = _mm_setr_ps(t.ty[n[0]], t.ty[n[1]], t.ty[n[2]], t.ty[n[3]]);
+        }
+
+        const __m128 scaleX = _mm_set1_ps(span.clipScaleX);
+        const __m128 scaleY = _mm_set1_ps(span.clipScaleY);
+        const __m128 one = _mm_set1_ps(1.0f);
+        a = _mm_mul_ps(a, scaleX);
+        c = _mm_mul_ps(c, scaleX);
+        tx = _mm_sub_ps(_mm_mul_ps(tx, scaleX), one);
+        b = _mm_mul_ps(b, scaleY);
+        d = _mm_mul_ps(d, scaleY);
+        ty = _mm_add_ps(_mm_mul_ps(ty, scaleY), one);
+
+        const __m128 x = _mm_loadu_ps(sprites.x.data() + i);
+        const __m128 y = _mm_loadu_ps(sprites.y.data() + i);
+        const __m128 width = _mm_loadu_ps(sprites.width.data() + i);
+        const __m128 height = _mm_loadu_ps(sprites.height.data() + i);
+
+        const __m128 x0 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, x), _mm_mul_ps(c, y)), tx);
+        const __m128 y0 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(b, x), _mm_mul_ps(d, y)), ty);
+        const __m128 acrossX = _mm_mul_ps(a, width);
+        const __m128 acrossY = _mm_mul_ps(b, width);
+        const __m128 downX = _mm_mul_ps(c, height);
+        const __m128 downY = _mm_mul_ps(d, height);
+
+        QuadsSSE2 quads;
+        quads.x[0] = x0;
+        quads.x[1] = _mm_add_ps(x0, acrossX);
+        quads.x[2] = _mm_add_ps(quads.x[1], downX);
+        quads.x[3] = _mm_add_ps(x0, downX);
+        quads.y[0] = y0;
+        quads.y[1] = _mm_add_ps(y0, acrossY);
+        quads.y[2] = _mm_add_ps(quads.y[1], downY);
+        quads.y[3] = _mm_add_ps(y0, downY);
+        return quads;
+    }
+
+    static __m128i unorm16SSE2(__m128 value) {
+        const __m128 clamped = _mm_min_ps(_mm_max_ps(value, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+        return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(clamped, _mm_set1_ps(65535.0f)), _mm_set1_ps(0.5f)));
+    }
+
+    static void expandSSE2(const ExpandSpan &span, size_t first, size_t last, PixieVertexData *out) {
+        const PixieSpriteArrays &sprites = *span.sprites;
+        size_t i = first;
+        for (; i + 4 <= last; i += 4) {
+            // positions come out as lanes, the 24 byte vertices are written from there
+            alignas(16) float x[4][4];
+            alignas(16) float y[4][4];
+            const QuadsSSE2 quads = quadsSSE2(span, i);
+            for (int k = 0; k < 4; ++k) {
+                _mm_store_ps(x[k], quads.x[k]);
+                _mm_store_ps(y[k], quads.y[k]);
+            }
+
+            for (int lane = 0; lane < 4; ++lane) {
+                const size_t s = i + lane;
+                const float u0 = sprites.u0[s], u1 = sprites.u1[s], v0 = sprites.v0[s], v1 = sprites.v1[s];
+                const uint32_t color = sprites.color[s];
+                PixieVertexData *vertex = out + (s - first) * 4;
+                vertex[0] = {{x[0][lane], y[0][lane], 0.0f}, {u0, v0}, color};
+                vertex[1] = {{x[1][lane], y[1][lane], 0.0f}, {u1, v0}, color};
+                vertex[2] = {{x[2][lane], y[2][lane], 0.0f}, {u1, v1}, color};
+                vertex[3] = {{x[3][lane], y[3][lane], 0.0f}, {u0, v1}, color};
+            }
+        }
+        expandScalar(span, i, last, out + (i - first) * 4);
+    }
+
+    static void expandCompactSSE2(const ExpandSpan &span, size_t first, size_t last, PixieCompactVertex *out) {
+        const PixieSpriteArrays &sprites = *span.sprites;
+        size_t i = first;
+        for (; i + 4 <= last; i += 4) {
+            const QuadsSSE2 quads = quadsSSE2(span, i);
+            const __m128i u0 = unorm16SSE2(_mm_loadu_ps(sprites.u0.data() + i));
+            const __m128i u1 = unorm16SSE2(_mm_loadu_ps(sprites.u1.data() + i));
+            const __m128i v0 = _mm_slli_epi32(unorm16SSE2(_mm_loadu_ps(sprites.v0.data() + i)), 16);
+            const __m128i v1 = _mm_slli_epi32(unorm16SSE2(_mm_loadu_ps(sprites.v1.data() + i)), 16);
+            const __m128i uv[4] = {_mm_or_si128(u0, v0), _mm_or_si128(u1, v0), _mm_or_si128(u1, v1), _mm_or_si128(u0, v1)};
+            const __m128 color = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i *>(sprites.color.data() + i)));
+
+            // x, y, uv, color rows turned into one vertex per register, then each sprite's four written in order
+            __m128 vertices[4][4];
+            for (int k = 0; k < 4; ++k) {
+                __m128 r0 = quads.x[k], r1 = quads.y[k], r2 = _mm_castsi128_ps(uv[k]), r3 = color;
+                _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+                vertices[k][0] = r0;
+                vertices[k][1] = r1;
+                vertices[k][2] = r2;
+                vertices[k][3] = r3;
+            }
+
+            float *dst = reinterpret_cast<float *>(out + (i - first) * 4);
+            for (int lane = 0; lane < 4; ++lane) {
+                for (int k = 0; k < 4; ++k)
+                    _mm_storeu_ps(dst + (lane * 4 + k) * 4, vertices[k][lane]);
+            }
+        }
+        expandCompactScalar(span, i, last, out + (i - first) * 4);
+    }
+
+    struct QuadsAVX2 {
+        __m256 x[4];
+        __m256 y[4];
+    };
+
+    PIXIE_TARGET_AVX2 static inline QuadsAVX2 quadsAVX2(const ExpandSpan &span, size_t i) {
+        const PixieSpriteArrays &sprites = *span.sprites;
+        __m256 a = _mm256_set1_ps(1.0f), b = _mm256_setzero_ps(), c = _mm256_setzero_ps(), d = _mm256_set1_ps(1.0f), tx = _mm256_setzero_ps(),
+               ty = _mm256_setzero_ps();
+        if (span.transforms) {
+            const PixieTransformColumns &t = *span.transforms;
+            const __m256i node = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(sprites.transform.data() + i));
+            a = _mm256_i32gather_ps(t.a, node, 4);
+            b = _mm256_i32gather_ps(t.b, node, 4);
+            c = _mm256_i32gather_ps(t.c, node, 4);
+            d = _mm256_i32gather_ps(t.d, node, 4);
+            tx = _mm256_i32gather_ps(t.tx, node, 4);
+            ty = _mm256_i32gather_ps(t.ty, node, 4);
+        }
+
+        const __m256 scaleX = _mm256_set1_ps(span.clipScaleX);
+        const __m256 scaleY = _mm256_set1_ps(span.clipScaleY);
+        const __m256 one = _mm256_set1_ps(1.0f);
+        a = _mm256_mul_ps(a, scaleX);
+        c = _mm256_mul_ps(c, scaleX);
+        tx = _mm256_fmsub_ps(tx, scaleX, one);
+        b = _mm256_mul_ps(b, scaleY);
+        d = _mm256_mul_ps(d, scaleY);
+        ty = _mm256_fmadd_ps(ty, scaleY, one);
+
+        const __m256 x = _mm256_loadu_ps(sprites.x.data() + i);
+        const __m256 y = _mm256_loadu_ps(sprites.y.data() + i);
+        const __m256 width = _mm256_loadu_ps(sprites.width.data() + i);
+        const __m256 height = _mm256_loadu_ps(sprites.height.data() + i);
+
+        const __m256 x0 = _mm256_fmadd_ps(a, x, _mm256_fmadd_ps(c, y, tx));
+        const __m256 y0 = _mm256_fmadd_ps(b, x, _mm256_fmadd_ps(d, y, ty));
+        const __m256 downX = _mm256_mul_ps(c, height);
+        const __m256 downY = _mm256_mul_ps(d, height);
+
+        QuadsAVX2 quads;
+        quads.x[0] = x0;
+        quads.x[1] = _mm256_fmadd_ps(a, width, x0);
+        quads.x[2] = _mm256_add_ps(quads.x[1], downX);
+        quads.x[3] = _mm256_add_ps(x0, downX);
+        quads.y[0] = y0;
+        quads.y[1] = _mm256_fmadd_ps(b, width, y0);
+        quads.y[2] = _mm256_add_ps(quads.y[1], downY);
+        quads.y[3] = _mm256_add_ps(y0, downY);
+        return quads;
+    }
+
+    PIXIE_TARGET_AVX2 static inline __m256i unorm16AVX2(__m256 value) {
+        const __m256 clamped = _mm256_min_ps(_mm256_max_ps(value, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+        return _mm256_cvttps_epi32(_mm256_fmadd_ps(clamped, _mm256_set1_ps(65535.0f), _mm256_set1_ps(0.5f)));
+    }
+
+    PIXIE_TARGET_AVX2 static void expandCompactAVX2(const ExpandSpan &span, size_t first, size_t last, PixieCompactVertex *out) {
+        const PixieSpriteArrays &sprites = *span.sprites;
+        size_t i = first;
+        for (; i + 8 <= last; i += 8) {
+            const QuadsAVX2 quads = quadsAVX2(span, i);
+            const __m256i u0 = unorm16AVX2(_mm256_loadu_ps(sprites.u0.data() + i));
+            const __m256i u1 = unorm16AVX2(_mm256_loadu_ps(sprites.u1.data() + i));
+            const __m256i v0 = _mm256_slli_epi32(unorm16AVX2(_mm256_loadu_ps(sprites.v0.data() + i)), 16);
+            const __m256i v1 = _mm256_slli_epi32(unorm16AVX2(_mm256_loadu_ps(sprites.v1.data() + i)), 16);
+            const __m256i uv[4] = {_mm256_or_si256(u0, v0), _mm256_or_si256(u1, v0), _mm256_or_si256(u1, v1), _mm256_or_si256(u0, v1)};
+            const __m256 color = _mm256_castsi256_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(sprites.color.data() + i)));
+
+            // per corner, x y uv color rows become one vertex per 128 bit half: sprite j in the low half, j + 4 in the high
+            __m256 vertices[4][4];
+            for (int k = 0; k < 4; ++k) {
+                const __m256 xy0 = _mm256_unpacklo_ps(quads.x[k], quads.y[k]);
+                const __m256 xy1 = _mm256_unpackhi_ps(quads.x[k], quads.y[k]);
+                const __m256 uc0 = _mm256_unpacklo_ps(_mm256_castsi256_ps(uv[k]), color);
+                const __m256 uc1 = _mm256_unpackhi_ps(_mm256_castsi256_ps(uv[k]), color);
+                vertices[k][0] = _mm256_shuffle_ps(xy0, uc0, _MM_SHUFFLE(1, 0, 1, 0));
+                vertices[k][1] = _mm256_shuffle_ps(xy0, uc0, _MM_SHUFFLE(3, 2, 3, 2));
+                vertices[k][2] = _mm256_shuffle_ps(xy1, uc1, _MM_SHUFFLE(1, 0, 1, 0));
+                vertices[k][3] = _mm256_shuffle_ps(xy1, uc1, _MM_SHUFFLE(3, 2, 3, 2));
+            }
+
+            // a sprite is corners 0 and 1 then 2 and 3, two 32 byte stores filling its cache line
+            float *dst = reinterpret_cast<float *>(out + (i - first) * 4);
+            for (int j = 0; j < 4; ++j) {
+                _mm256_storeu_ps(dst + j * 16, _mm256_permute2f128_ps(vertices[0][j], vertices[1][j], 0x20));
+                _mm256_storeu_ps(dst + j * 16 + 8, _mm256_permute2f128_ps(vertices[2][j], vertices[3][j], 0x20));
+            }
+            for (int j = 0; j < 4; ++j) {
+                _mm256_storeu_ps(dst + (j + 4) * 16, _mm256_permute2f128_ps(vertices[0][j], vertices[1][j], 0x31));
+                _mm256_storeu_ps(dst + (j + 4) * 16 + 8, _mm256_permute2f128_ps(vertices[2][j], vertices[3][j], 0x31));
+            }
+        }
+        _mm256_zeroupper();
+        expandCompactScalar(span, i, last, out + (i - first) * 4);
+    }
+
+    static ExpandSpan expandSpan(const PixieSpriteArrays &sprites, size_t first, size_t count, const PixieTransformColumns *transforms, float clipScaleX,
+        float clipScaleY) {
+        if (first > sprites.size() || count > sprites.size() - first)
+            throw std::out_of_range("expandSprites: range past the end of the sprites");
+        return {&sprites, transforms, clipScaleX, clipScaleY};
+    }
+
+    void expandSprites(const PixieSpriteArrays &sprites, size_t first, size_t count, const PixieTransformColumns *transforms, float clipScaleX,
+        float clipScaleY, PixieVertexData *out, PixieSIMDLevel level) {
+        const ExpandSpan span = expandSpan(sprites, first, count, transforms, clipScaleX, clipScaleY);
+        // no avx2 kernel for full vertices, they're written out a lane at a time either way and the wider quad math
+        // measured slower than sse2. the compact path is where avx2 pays
+        switch (level) {
+            case PixieSIMDLevel::AVX2:
+            case PixieSIMDLevel::SSE2:
+                expandSSE2(span, first, first + count, out);
+                break;
+            default:
+                expandScalar(span, first, first + count, out);
+                break;
+        }
+    }
+
+    void expandSpritesCompact(const PixieSpriteArrays &sprites, size_t first, size_t count, const PixieTransformColumns *transforms, float clipScaleX,
+        float clipScaleY, PixieCompactVertex *out, PixieSIMDLevel level) {
+        const ExpandSpan span = expandSpan(sprites, first, count, transforms, clipScaleX, clipScaleY);
+        switch (level) {
+            case PixieSIMDLevel::AVX2:
+                expandCompactAVX2(span, first, first + count, out);
+                break;
+            case PixieSIMDLevel::SSE2:
+                expandCompactSSE2(span, first, first + count, out);
+                break;
+            default:
+                expandCompactScalar(span, first, first + count, out);
+                break;
+        }
+    }
+} // namespace pxe
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "simd.hpp"
+#include "spritebatch.hpp"
+#include "vertex.hpp"
+
+namespace pxe {
+    // one PixieTransform2D field per array, what the batched kernels read
+    struct PixieTransformColumns {
+        const float *a;
+        const float *b;
+        const float *c;
+        const float *d;
+        const float *tx;
+        const float *ty;
+    };
+
+    // local 3x2 transforms with parents, composed into world transforms a whole array at a time.
+    // a parent has to be added before its children, so one front to back pass composes everything
+    class PixieTransformHierarchy {
+    public:
+        static const uint32_t noParent = UINT32_MAX;
+
+        explicit PixieTransformHierarchy(PixieSIMDLevel level = detectSIMDLevel());
+
+        uint32_t add(const PixieTransform2D &local, uint32_t parent = noParent);
+        void setLocal(uint32_t node, const PixieTransform2D &local);
+        PixieTransform2D local(uint32_t node) const;
+        // as of the last compose
+        PixieTransform2D world(uint32_t node) const;
+        uint32_t parent(uint32_t node) const { return parents[node] < 0 ? noParent : static_cast<uint32_t>(parents[node]); }
+
+        // world = parent's world after local, for every node. nodes whose parent sits in an earlier simd block compose
+        // 8 at a time, adding a level's nodes after the whole level above keeps every block on that path
+        void compose();
+
+        void clear();
+        uint32_t size() const { return static_cast<uint32_t>(parents.size()); }
+        PixieTransformColumns worldColumns() const { return {worlds.a.data(), worlds.b.data(), worlds.c.data(), worlds.d.data(), worlds.tx.data(), worlds.ty.data()}; }
+        void setSIMDLevel(PixieSIMDLevel level) { simdLevel = level; }
+        PixieSIMDLevel getSIMDLevel() const { return simdLevel; }
+
+    private:
+        struct Columns {
+            std::vector<float> a;
+            std::vector<float> b;
+            std::vector<float> c;
+            std::vector<float> d;
+            std::vector<float> tx;
+            std::vector<float> ty;
+
+            void push(const PixieTransform2D &transform);
+            void set(uint32_t index, const PixieTransform2D &transform);
+            PixieTransform2D get(uint32_t index) const;
+            void clear();
+        };
+
+        PixieSIMDLevel simdLevel;
+        Columns locals;
+        Columns worlds;
+        std::vector<int32_t> parents; // -1 for roots, signed so the simd paths can compare and gather with it
+    };
+
+    // sprites kept as columns, filled by game code and expanded into quads in one call
+    struct PixieSpriteArrays {
+        std::vector<float> x; // rect in the transform's space, pixels when there is none
+        std::vector<float> y;
+        std::vector<float> width;
+        std::vector<float> height;
+        std::vector<float> u0; // uv rect corners in [0, 1]
+        std::vector<float> v0;
+        std::vector<float> u1;
+        std::vector<float> v1;
+        std::vector<uint32_t> color; // R8G8B8A8
+        std::vector<uint32_t> transform; // node in the hierarchy the sprites are expanded with
+
+        void push(const PixieRect &rect, const PixieRect &uv, uint32_t color, uint32_t transform = 0);
+        void reserve(size_t count);
+        void clear();
+        size_t size() const { return x.size(); }
+    };
+
+    // sprites [first, first + count) to quads in PixieSpriteBatch's corner order, clip space positions with
+    // clipScale = (2 / viewport width, -2 / viewport height). transforms may be null for sprites already in pixels
+    void expandSprites(const PixieSpriteArrays &sprites, size_t first, size_t count, const PixieTransformColumns *transforms, float clipScaleX,
+        float clipScaleY, PixieVertexData *out, PixieSIMDLevel level = detectSIMDLevel());
+    // the same into 16 byte vertices, each sprite is one cache line written front to back so a write combined upload
+    // heap sees whole lines
+    void expandSpritesCompact(const PixieSpriteArrays &sprites, size_t first, size_t count, const PixieTransformColumns *transforms, float clipScaleX,
+        float clipScaleY, PixieCompactVertex *out, PixieSIMDLevel level = detectSIMDLevel());
+} // namespace pxe
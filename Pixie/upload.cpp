@@ -0,0 +1,110 @@
+#include "upload.hpp"
+#include <stdexcept>
+
+namespace pxe {
+    // ring sizes are kept to whole 64KB pages so any smaller power of two alignment survives the wrap
+    static const uint64_t ringGranularity = 65536;
+
+    PixieUploadAllocator::PixieUploadAllocator(uint64_t ringSize, uint32_t maxRings, RingFactory factory)
+        : ringBytes(alignUp(ringSize, ringGranularity))
+        , maxRings(maxRings)
+        , currentRing(0)
+        , factory(std::move(factory))
+        , uploadStats {} {
+
+        if (ringSize == 0 || maxRings == 0 || !this->factory)
+            throw std::invalid_argument("PixieUploadAllocator: needs at least one non-empty ring");
+
+        rings.reserve(maxRings);
+    }
+
+    bool PixieUploadAllocator::allocate(uint64_t size, uint64_t alignment, PixieUploadRegion &region) {
+        if (size == 0 || size > ringBytes || alignment == 0 || (alignment & (alignment - 1)) != 0 || alignment > ringGranularity)
+            throw std::invalid_argument("PixieUploadAllocator: bad allocation request");
+
+        // stay on the ring that worked last time so submissions touch as few rings as possible
+        if (!rings.empty() && allocateFrom(currentRing, size, alignment, region))
+            return true;
+
+        for (uint32_t i = 0; i < rings.size(); ++i) {
+            if (i != currentRing && allocateFrom(i, size, alignment, region)) {
+                currentRing = i;
+                return true;
+            }
+        }
+
+        if (rings.size() < maxRings) {
+            const auto index = static_cast<uint32_t>(rings.size());
+            rings.push_back({factory(index, ringBytes), 0, 0, {}});
+            uploadStats.rings = static_cast<uint32_t>(rings.size());
+
+            if (allocateFrom(index, size, alignment, region)) {
+                currentRing = index;
+                return true;
+            }
+        }
+
+        uploadStats.failedAllocations++;
+        return false;
+    }
+
+    void PixieUploadAllocator::submit(uint64_t fence) {
+        for (auto &ring : rings) {
+            const uint64_t covered = ring.inFlight.empty() ? ring.tail : ring.inFlight.back().second;
+            if (ring.head > covered)
+                ring.inFlight.emplace_back(fence, ring.head);
+        }
+    }
+
+    void PixieUploadAllocator::retire(uint64_t completedFence) {
+        for (auto &ring : rings) {
+            while (!ring.inFlight.empty() && ring.inFlight.front().first <= completedFence) {
+                ring.tail = ring.inFlight.front().second;
+                ring.inFlight.pop_front();
+            }
+        }
+
+        updateUsage();
+    }
+
+    uint64_t PixieUploadAllocator::oldestPendingFence() const {
+        uint64_t oldest = 0;
+        for (const auto &ring : rings) {
+            if (!ring.inFlight.empty() && (oldest == 0 || ring.inFlight.front().first < oldest))
+                oldest = ring.inFlight.front().first;
+        }
+        return oldest;
+    }
+
+    bool PixieUploadAllocator::allocateFrom(uint32_t index, uint64_t size, uint64_t alignment, PixieUploadRegion &region) {
+        Ring &ring = rings[index];
+
+        // a region never straddles the end, the leftover bytes are skipped and come back with the next retire
+        uint64_t start = alignUp(ring.head, alignment);
+        if (start % ringBytes + size > ringBytes)
+            start = alignUp(ring.head, ringBytes);
+
+        if (start + size - ring.tail > ringBytes)
+            return false;
+
+        ring.head = start + size;
+
+        const uint64_t offset = start % ringBytes;
+        region = {index, offset, size, ring.data + offset};
+
+        uploadStats.allocations++;
+        updateUsage();
+
+        return true;
+    }
+
+    void PixieUploadAllocator::updateUsage() {
+        uint64_t inUse = 0;
+        for (const auto &ring : rings)
+            inUse += ring.head - ring.tail;
+
+        uploadStats.bytesInUse = inUse;
+        if (inUse > uploadStats.highWaterMark)
+            uploadStats.highWaterMark = inUse;
+    }
+} // namespace pxe
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <vector>
+
+namespace pxe {
+    struct PixieUploadRegion {
+        uint32_t ring;
+        uint64_t offset; // from the start of the ring's buffer
+        uint64_t size;
+        uint8_t *data; // cpu address of offset
+    };
+
+    struct PixieUploadStats {
+        uint64_t allocations;
+        uint64_t failedAllocations; // every ring was full or still in flight
+        uint64_t bytesInUse;
+        uint64_t highWaterMark; // most bytes in use at once, padding included
+        uint32_t rings;
+    };
+
+    // sub-allocates upload memory from a few large rings, regions come back once the fence they were submitted with completes
+    class PixieUploadAllocator {
+    public:
+        static const uint64_t placementAlignment = 512; // D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT
+        static const uint64_t pitchAlignment = 256; // D3D12_TEXTURE_DATA_PITCH_ALIGNMENT
+
+        // creates ring n with size bytes and returns its persistently mapped memory
+        using RingFactory = std::function<uint8_t *(uint32_t ring, uint64_t size)>;
+
+        PixieUploadAllocator(uint64_t ringSize, uint32_t maxRings, RingFactory factory);
+
+        bool allocate(uint64_t size, uint64_t alignment, PixieUploadRegion &region);
+        // tag every region handed out since the last submit with the fence of the submission copying from it
+        void submit(uint64_t fence);
+        void retire(uint64_t completedFence);
+
+        // 0 when nothing is waiting on the gpu, otherwise the fence to wait on before allocate can succeed again
+        uint64_t oldestPendingFence() const;
+        uint64_t ringSize() const { return ringBytes; }
+        const PixieUploadStats &stats() const { return uploadStats; }
+
+        static uint64_t alignUp(uint64_t value, uint64_t alignment) { return (value + alignment - 1) & ~(alignment - 1); }
+        static uint32_t rowPitch(uint32_t width, uint32_t bytesPerPixel) { return static_cast<uint32_t>(alignUp(uint64_t(width) * bytesPerPixel, pitchAlignment)); }
+        // rows are pitch aligned, the last one only needs its own bytes like GetCopyableFootprints reports
+        static uint64_t textureSize(uint32_t width, uint32_t height, uint32_t bytesPerPixel) { return uint64_t(rowPitch(width, bytesPerPixel)) * (height - 1) + uint64_t(width) * bytesPerPixel; }
+
+    private:
+        struct Ring {
+            uint8_t *data;
+            uint64_t head; // total bytes handed out, positions only ever grow
+            uint64_t tail; // total bytes given back
+            std::deque<std::pair<uint64_t, uint64_t>> inFlight; // fence and the head it covers
+        };
+
+        bool allocateFrom(uint32_t index, uint64_t size, uint64_t alignment, PixieUploadRegion &region);
+        void updateUsage();
+
+        uint64_t ringBytes;
+        uint32_t maxRings;
+        uint32_t currentRing;
+        RingFactory factory;
+        std::vector<Ring> rings;
+        PixieUploadStats uploadStats;
+    };
+} // namespace pxe
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+
+namespace pxe {
+    // laid out like XMFLOAT2/XMFLOAT3 so vertex data can be built without DirectXMath
+    struct PixieFloat2 {
+        float x;
+        float y;
+    };
+
+    struct PixieFloat3 {
+        float x;
+        float y;
+        float z;
+    };
+
+    struct PixieVertexData {
+        PixieFloat3 position;
+        PixieFloat2 uv;
+        uint32_t color; // R8G8B8A8, taken from the first vertex of each triangle
+    };
+
+    // two thirds the size of PixieVertexData for sprites, whose z is always 0. what the d3d sprite ring holds,
+    // the software rasterizer keeps full vertices
+    struct PixieCompactVertex {
+        PixieFloat2 position;
+        uint32_t uv; // R16G16_UNORM, u in the low half
+        uint32_t color;
+    };
+
+    static_assert(sizeof(PixieCompactVertex) == 16, "four compact vertices fill one cache line");
+} // namespace pxe
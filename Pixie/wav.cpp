@@ -0,0 +1,369 @@
+#include "wav.hpp"
+#include "riff.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace pxe {
+    static const uint16_t formatPcm = 0x0001;
+    static const uint16_t formatFloat = 0x0003;
+    static const uint16_t formatImaAdpcm = 0x0011;
+    static const uint16_t formatExtensible = 0xfffe;
+    static const uint32_t adpcmBlockBytesPerChannel = 1024; // what most tools write for 44.1 kHz
+
+    static const int8_t imaIndexTable[16] = {-1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8};
+    static const int16_t imaStepTable[89] = {7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45, 50, 55, 60, 66, 73, 80, 88, 97, 107,
+        118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552,
+        1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+        15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767};
+
+    static uint16_t readU16(const uint8_t *p) {
+        uint16_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    static uint32_t readU32(const uint8_t *p) {
+        uint32_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    // one ima step, shared by the decoder and the encoder so both track the same predictor
+    static int32_t imaDecodeNibble(uint8_t nibble, int32_t &predictor, int32_t &index) {
+        const int32_t step = imaStepTable[index];
+        int32_t diff = step >> 3;
+        if (nibble & 1)
+            diff += step >> 2;
+        if (nibble & 2)
+            diff += step >> 1;
+        if (nibble & 4)
+            diff += step;
+        predictor = std::clamp(nibble & 8 ? predictor - diff : predictor + diff, -32768, 32767);
+        index = std::clamp(index + imaIndexTable[nibble], 0, 88);
+        return predictor;
+    }
+
+    static uint8_t imaEncodeSample(int32_t sample, int32_t &predictor, int32_t &index) {
+        int32_t diff = sample - predictor;
+        uint8_t nibble = 0;
+        if (diff < 0) {
+            nibble = 8;
+            diff = -diff;
+        }
+
+        int32_t step = imaStepTable[index];
+        for (uint8_t bit = 4; bit != 0; bit >>= 1) {
+            if (diff >= step) {
+                nibble |= bit;
+                diff -= step;
+            }
+            step >>= 1;
+        }
+
+        imaDecodeNibble(nibble, predictor, index);
+        return nibble;
+    }
+
+    static uint32_t adpcmFramesPerBlock(uint32_t blockAlign, uint32_t channels) {
+        // a header frame, then groups of 4 bytes holding 8 samples of one channel
+        return (blockAlign - 4 * channels) * 2 / channels + 1;
+    }
+
+    PixieWavDecoder::PixieWavDecoder(const std::string &path)
+        : file(path) {
+
+        parse(file.data(), file.size());
+    }
+
+    PixieWavDecoder::PixieWavDecoder(const uint8_t *data, size_t size) {
+        parse(data, size);
+    }
+
+    void PixieWavDecoder::parse(const uint8_t *data, size_t size) {
+        const PixieRiffReader riff(data, size);
+        const PixieRiffChunk *fmt = riff.find(riffId("fmt "));
+        const PixieRiffChunk *dataChunk = riff.find(riffId("data"));
+        if (riff.formType() != riffId("WAVE") || !fmt || !dataChunk || fmt->size < 16)
+            throw std::runtime_error("PixieWavDecoder: not a wav file");
+
+        uint16_t tag = readU16(fmt->data);
+        const uint32_t channels = readU16(fmt->data + 2);
+        const uint32_t blockAlign = readU16(fmt->data + 12);
+        const uint32_t bits = readU16(fmt->data + 14);
+        if (tag == formatExtensible && fmt->size >= 40)
+            tag = readU16(fmt->data + 24); // the sub format guid starts with the plain tag
+
+        wavFormat = {};
+        wavFormat.sampleRate = readU32(fmt->data + 4);
+        wavFormat.channels = channels;
+        wavFormat.blockAlign = blockAlign;
+        wavFormat.framesPerBlock = 1;
+        if (channels == 0 || channels > 8 || wavFormat.sampleRate == 0 || blockAlign == 0)
+            throw std::runtime_error("PixieWavDecoder: bad format chunk");
+
+        samples = dataChunk->data;
+        sampleBytes = dataChunk->size;
+        position = 0;
+        bufferedBlock = UINT64_MAX;
+
+        if (tag == formatImaAdpcm) {
+            if (bits != 4 || blockAlign % (4 * channels) != 0 || blockAlign <= 4 * channels)
+                throw std::runtime_error("PixieWavDecoder: bad ima adpcm block layout");
+
+            wavFormat.encoding = PixieWavEncoding::ImaAdpcm;
+            wavFormat.framesPerBlock = adpcmFramesPerBlock(blockAlign, channels);
+            if (fmt->size >= 20 && readU16(fmt->data + 16) >= 2 && readU16(fmt->data + 18) != wavFormat.framesPerBlock)
+                throw std::runtime_error("PixieWavDecoder: ima adpcm samples per block don't match the block size");
+
+            // a short last block holds as many whole groups as made it into the file
+            const size_t tail = sampleBytes % blockAlign;
+            wavFormat.frames = uint64_t(sampleBytes / blockAlign) * wavFormat.framesPerBlock;
+            if (tail >= 4 * channels)
+                wavFormat.frames += (tail - 4 * channels) / (4 * channels) * 8 + 1;
+
+            // fact has the exact length, the last block is padded out to whole groups
+            if (const PixieRiffChunk *fact = riff.find(riffId("fact")); fact && fact->size >= 4)
+                wavFormat.frames = std::min<uint64_t>(wavFormat.frames, readU32(fact->data));
+
+            blockBuffer.resize(size_t(wavFormat.framesPerBlock) * channels);
+            return;
+        }
+
+        if (tag == formatFloat && bits == 32)
+            wavFormat.encoding = PixieWavEncoding::Float32;
+        else if (tag == formatPcm && bits == 8)
+            wavFormat.encoding = PixieWavEncoding::Pcm8;
+        else if (tag == formatPcm && bits == 16)
+            wavFormat.encoding = PixieWavEncoding::Pcm16;
+        else if (tag == formatPcm && bits == 24)
+            wavFormat.encoding = PixieWavEncoding::Pcm24;
+        else if (tag == formatPcm && bits == 32)
+            wavFormat.encoding = PixieWavEncoding::Pcm32;
+        else
+            throw std::runtime_error("PixieWavDecoder: unsupported encoding");
+
+        if (blockAlign != channels * bits / 8)
+            throw std::runtime_error("PixieWavDecoder: block align doesn't match the sample size");
+        wavFormat.frames = sampleBytes / blockAlign;
+    }
+
+    uint32_t PixieWavDecoder::decode(float *out, uint32_t frames) {
+        const auto count = static_cast<uint32_t>(std::min<uint64_t>(frames, wavFormat.frames - position));
+        const size_t values = size_t(count) * wavFormat.channels;
+        const uint8_t *src = samples + position * wavFormat.blockAlign;
+
+        switch (wavFormat.encoding) {
+            case PixieWavEncoding::Pcm8:
+                for (size_t i = 0; i < values; ++i)
+                    out[i] = float(int32_t(src[i]) - 128) * (1.0f / 128.0f);
+                break;
+            case PixieWavEncoding::Pcm16:
+                for (size_t i = 0; i < values; ++i) {
+                    int16_t value;
+                    std::memcpy(&value, src + 2 * i, sizeof(value));
+                    out[i] = float(value) * (1.0f / 32768.0f);
+                }
+                break;
+            case PixieWavEncoding::Pcm24:
+                for (size_t i = 0; i < values; ++i) {
+                    const uint8_t *p = src + 3 * i;
+                    // assembled in the top three bytes so the shift back down extends the sign
+                    const auto value = static_cast<int32_t>(uint32_t(p[0]) << 8 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 24) >> 8;
+                    out[i] = float(value) * (1.0f / 8388608.0f);
+                }
+                break;
+            case PixieWavEncoding::Pcm32:
+                for (size_t i = 0; i < values; ++i) {
+                    int32_t value;
+                    std::memcpy(&value, src + 4 * i, sizeof(value));
+                    out[i] = float(value) * (1.0f / 2147483648.0f);
+                }
+                break;
+            case PixieWavEncoding::Float32:
+                std::memcpy(out, src, values * sizeof(float));
+                break;
+            case PixieWavEncoding::ImaAdpcm: {
+                uint32_t done = 0;
+                while (done < count) {
+                    const uint64_t block = (position + done) / wavFormat.framesPerBlock;
+                    const auto offset = static_cast<uint32_t>((position + done) % wavFormat.framesPerBlock);
+                    if (block != bufferedBlock)
+                        decodeBlock(block);
+
+                    const uint32_t take = std::min(count - done, wavFormat.framesPerBlock - offset);
+                    std::memcpy(out + size_t(done) * wavFormat.channels, blockBuffer.data() + size_t(offset) * wavFormat.channels,
+                        size_t(take) * wavFormat.channels * sizeof(float));
+                    done += take;
+                }
+                break;
+            }
+        }
+
+        position += count;
+        return count;
+    }
+
+    void PixieWavDecoder::decodeBlock(uint64_t block) {
+        const uint32_t channels = wavFormat.channels;
+        const uint8_t *bytes = samples + block * wavFormat.blockAlign;
+        const size_t available = std::min<size_t>(wavFormat.blockAlign, sampleBytes - block * wavFormat.blockAlign);
+
+        int32_t predictor[8];
+        int32_t index[8];
+        for (uint32_t c = 0; c < channels; ++c) {
+            predictor[c] = static_cast<int16_t>(readU16(bytes + 4 * c));
+            index[c] = std::min<int32_t>(bytes[4 * c + 2], 88);
+            blockBuffer[c] = float(predictor[c]) * (1.0f / 32768.0f);
+        }
+
+        // a short last block stops after its last whole group, frames() never reaches past it
+        const size_t groups = (available - 4 * channels) / (4 * channels);
+        const uint8_t *data = bytes + 4 * channels;
+        for (size_t group = 0; group < groups; ++group) {
+            for (uint32_t c = 0; c < channels; ++c) {
+                const uint8_t *packed = data + (group * channels + c) * 4;
+                float *dst = blockBuffer.data() + (1 + group * 8) * channels + c;
+                for (uint32_t i = 0; i < 8; ++i) {
+                    const uint8_t nibble = i & 1 ? packed[i / 2] >> 4 : packed[i / 2] & 0x0f;
+                    dst[size_t(i) * channels] = float(imaDecodeNibble(nibble, predictor[c], index[c])) * (1.0f / 32768.0f);
+                }
+            }
+        }
+
+        bufferedBlock = block;
+    }
+
+    void PixieWavDecoder::seek(uint64_t frame) {
+        position = std::min(frame, wavFormat.frames);
+    }
+
+    static void appendU16(std::vector<uint8_t> &out, uint16_t value) {
+        out.insert(out.end(), {uint8_t(value), uint8_t(value >> 8)});
+    }
+
+    static void appendU32(std::vector<uint8_t> &out, uint32_t value) {
+        out.insert(out.end(), {uint8_t(value), uint8_t(value >> 8), uint8_t(value >> 16), uint8_t(value >> 24)});
+    }
+
+    // the same power of two scale the decoder divides by, full scale positive clips one step short
+    static int32_t quantize(float value, double scale) {
+        return static_cast<int32_t>(std::clamp(std::round(double(value) * scale), -scale, scale - 1.0));
+    }
+
+    std::vector<uint8_t> encodeWav(const float *interleaved, uint64_t frames, uint32_t sampleRate, uint32_t channels, PixieWavEncoding encoding) {
+        if (channels == 0 || channels > 8 || sampleRate == 0)
+            throw std::invalid_argument("encodeWav: bad format");
+
+        std::vector<uint8_t> data;
+        const size_t values = size_t(frames) * channels;
+        uint32_t bits = 0;
+        uint32_t blockAlign = 0;
+        uint32_t framesPerBlock = 1;
+
+        switch (encoding) {
+            case PixieWavEncoding::Pcm8:
+                bits = 8;
+                for (size_t i = 0; i < values; ++i)
+                    data.push_back(static_cast<uint8_t>(quantize(interleaved[i], 128.0) + 128));
+                break;
+            case PixieWavEncoding::Pcm16:
+                bits = 16;
+                for (size_t i = 0; i < values; ++i)
+                    appendU16(data, static_cast<uint16_t>(quantize(interleaved[i], 32768.0)));
+                break;
+            case PixieWavEncoding::Pcm24:
+                bits = 24;
+                for (size_t i = 0; i < values; ++i) {
+                    const auto value = static_cast<uint32_t>(quantize(interleaved[i], 8388608.0));
+                    data.insert(data.end(), {uint8_t(value), uint8_t(value >> 8), uint8_t(value >> 16)});
+                }
+                break;
+            case PixieWavEncoding::Pcm32:
+                bits = 32;
+                for (size_t i = 0; i < values; ++i)
+                    appendU32(data, static_cast<uint32_t>(quantize(interleaved[i], 2147483648.0)));
+                break;
+            case PixieWavEncoding::Float32:
+                bits = 32;
+                data.resize(values * sizeof(float));
+                std::memcpy(data.data(), interleaved, data.size());
+                break;
+            case PixieWavEncoding::ImaAdpcm: {
+                bits = 4;
+                blockAlign = adpcmBlockBytesPerChannel * channels;
+                framesPerBlock = adpcmFramesPerBlock(blockAlign, channels);
+
+                int32_t predictor[8] = {};
+                int32_t index[8] = {};
+                for (uint64_t first = 0; first < frames; first += framesPerBlock) {
+                    const auto count = static_cast<uint32_t>(std::min<uint64_t>(framesPerBlock, frames - first));
+                    const float *block = interleaved + first * channels;
+
+                    // the header restarts the predictor exactly, the step index carries over from the last block
+                    for (uint32_t c = 0; c < channels; ++c) {
+                        predictor[c] = quantize(block[c], 32768.0);
+                        appendU16(data, static_cast<uint16_t>(predictor[c]));
+                        data.insert(data.end(), {uint8_t(index[c]), 0});
+                    }
+
+                    // padding past the end keeps encoding the last sample so the predictor doesn't jump
+                    const uint32_t groups = (count - 1 + 7) / 8;
+                    for (uint32_t group = 0; group < groups; ++group) {
+                        for (uint32_t c = 0; c < channels; ++c) {
+                            uint8_t packed[4] = {};
+                            for (uint32_t i = 0; i < 8; ++i) {
+                                const uint32_t frame = std::min(1 + group * 8 + i, count - 1);
+                                const uint8_t nibble = imaEncodeSample(quantize(block[size_t(frame) * channels + c], 32768.0), predictor[c], index[c]);
+                                packed[i / 2] |= i & 1 ? nibble << 4 : nibble;
+                            }
+                            data.insert(data.end(), packed, packed + 4);
+                        }
+                    }
+                }
+                break;
+            }
+        }
+
+        if (encoding != PixieWavEncoding::ImaAdpcm)
+            blockAlign = channels * bits / 8;
+
+        const bool adpcm = encoding == PixieWavEncoding::ImaAdpcm;
+        std::vector<uint8_t> out;
+        out.reserve(data.size() + 64);
+        out.insert(out.end(), {'R', 'I', 'F', 'F', 0, 0, 0, 0, 'W', 'A', 'V', 'E', 'f', 'm', 't', ' '});
+        appendU32(out, adpcm ? 20 : 16);
+        appendU16(out, adpcm ? formatImaAdpcm : encoding == PixieWavEncoding::Float32 ? formatFloat : formatPcm);
+        appendU16(out, static_cast<uint16_t>(channels));
+        appendU32(out, sampleRate);
+        appendU32(out, static_cast<uint32_t>(uint64_t(sampleRate) * blockAlign / framesPerBlock));
+        appendU16(out, static_cast<uint16_t>(blockAlign));
+        appendU16(out, static_cast<uint16_t>(bits));
+        if (adpcm) {
+            appendU16(out, 2);
+            appendU16(out, static_cast<uint16_t>(framesPerBlock));
+            out.insert(out.end(), {'f', 'a', 'c', 't'});
+            appendU32(out, 4);
+            appendU32(out, static_cast<uint32_t>(frames));
+        }
+
+        out.insert(out.end(), {'d', 'a', 't', 'a'});
+        appendU32(out, static_cast<uint32_t>(data.size()));
+        out.insert(out.end(), data.begin(), data.end());
+        if (data.size() & 1)
+            out.push_back(0);
+
+        const auto riffSize = static_cast<uint32_t>(out.size() - 8);
+        std::memcpy(out.data() + 4, &riffSize, sizeof(riffSize));
+        return out;
+    }
+
+    bool writeWavFile(const std::string &path, const float *interleaved, uint64_t frames, uint32_t sampleRate, uint32_t channels, PixieWavEncoding encoding) {
+        const std::vector<uint8_t> image = encodeWav(interleaved, frames, sampleRate, channels, encoding);
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char *>(image.data()), static_cast<std::streamsize>(image.size()));
+        return static_cast<bool>(out);
+    }
+} // namespace pxe
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "mappedfile.hpp"
+
+namespace pxe {
+    // pulls one track a few frames at a time, never touches more of its source than the frames asked for
+    class PixieAudioDecoder {
+    public:
+        virtual ~PixieAudioDecoder() = default;
+
+        virtual uint32_t sampleRate() const = 0;
+        virtual uint32_t channels() const = 0;
+        virtual uint64_t frames() const = 0;
+
+        // interleaved floats in [-1, 1], fewer than asked only at the end of the track
+        virtual uint32_t decode(float *out, uint32_t frames) = 0;
+        virtual void seek(uint64_t frame) = 0;
+        // heap the decoder keeps for itself, mapped pages belong to the os cache and aren't counted
+        virtual size_t memoryBytes() const = 0;
+    };
+
+    enum class PixieWavEncoding {
+        Pcm8,
+        Pcm16,
+        Pcm24,
+        Pcm32,
+        Float32,
+        ImaAdpcm // 4 bits a sample, a quarter of pcm16
+    };
+
+    struct PixieWavFormat {
+        PixieWavEncoding encoding;
+        uint32_t sampleRate;
+        uint32_t channels;
+        uint32_t blockAlign; // bytes per frame, or per adpcm block
+        uint32_t framesPerBlock; // 1 for pcm
+        uint64_t frames;
+    };
+
+    // pcm, float and ima adpcm wav straight from the mapped file, the data chunk is read in place
+    class PixieWavDecoder : public PixieAudioDecoder {
+    public:
+        explicit PixieWavDecoder(const std::string &path);
+        // memory the caller keeps alive for as long as the decoder
+        PixieWavDecoder(const uint8_t *data, size_t size);
+
+        uint32_t sampleRate() const override { return wavFormat.sampleRate; }
+        uint32_t channels() const override { return wavFormat.channels; }
+        uint64_t frames() const override { return wavFormat.frames; }
+        uint32_t decode(float *out, uint32_t frames) override;
+        void seek(uint64_t frame) override;
+        size_t memoryBytes() const override { return sizeof(*this) + blockBuffer.capacity() * sizeof(float); }
+
+        const PixieWavFormat &format() const { return wavFormat; }
+
+    private:
+        void parse(const uint8_t *data, size_t size);
+        void decodeBlock(uint64_t block);
+
+        PixieMappedFile file; // empty when decoding caller memory
+        PixieWavFormat wavFormat;
+        const uint8_t *samples; // the data chunk
+        size_t sampleBytes;
+        uint64_t position; // frames
+
+        // adpcm decodes a whole block at a time
+        std::vector<float> blockBuffer;
+        uint64_t bufferedBlock;
+    };
+
+    // interleaved floats to a wav image, for tools and tests. adpcm blocks hold 2041 frames
+    std::vector<uint8_t> encodeWav(const float *interleaved, uint64_t frames, uint32_t sampleRate, uint32_t channels, PixieWavEncoding encoding);
+    bool writeWavFile(const std::string &path, const float *interleaved, uint64_t frames, uint32_t sampleRate, uint32_t channels, PixieWavEncoding encoding);
+} // namespace pxe
@@ -0,0 +1,107 @@
+#pragma once
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+
+#include <windows.h>
+#include <xaudio2.h>
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+#include "audio.hpp"
+#include "utils.hpp"
+
+namespace pxe {
+    // one float stereo source voice fed from xaudio2's processing thread. a few periods stay queued, each one
+    // is rendered as the device finishes with it, so latency is about (bufferCount - 1) periods
+    class PixieXAudio2Backend final : public PixieAudioBackend, private IXAudio2VoiceCallback {
+    public:
+        static const uint32_t bufferCount = 3;
+
+        // 480 frames is 10 ms at 48 kHz
+        explicit PixieXAudio2Backend(IXAudio2 *xaudio, uint32_t periodFrames = 480)
+            : xaudio(xaudio)
+            , periodFrames(periodFrames)
+            , voice(nullptr)
+            , mixer(nullptr)
+            , stopping(false) {
+        }
+
+        ~PixieXAudio2Backend() override {
+            stop();
+        }
+
+        PixieXAudio2Backend(const PixieXAudio2Backend &) = delete;
+        PixieXAudio2Backend &operator=(const PixieXAudio2Backend &) = delete;
+
+        void start(PixieAudioMixer &target) override {
+            if (voice)
+                throw std::logic_error("PixieXAudio2Backend: already started");
+
+            // xaudio2 converts from the mixer's rate to the device's
+            WAVEFORMATEX format = {};
+            format.wFormatTag = WAVE_FORMAT_IEEE_FLOAT;
+            format.nChannels = PixieAudioMixer::outputChannels;
+            format.nSamplesPerSec = target.sampleRate();
+            format.wBitsPerSample = 32;
+            format.nBlockAlign = format.nChannels * format.wBitsPerSample / 8;
+            format.nAvgBytesPerSec = format.nSamplesPerSec * format.nBlockAlign;
+            throwIfFailed(xaudio->CreateSourceVoice(&voice, &format, 0, XAUDIO2_DEFAULT_FREQ_RATIO, this));
+
+            mixer = &target;
+            stopping.store(false, std::memory_order_relaxed);
+            for (uint32_t i = 0; i < bufferCount; ++i) {
+                buffers[i].resize(size_t(periodFrames) * PixieAudioMixer::outputChannels);
+                queue(i);
+            }
+            throwIfFailed(voice->Start(0));
+        }
+
+        void stop() override {
+            if (!voice)
+                return;
+
+            // flushing ends the queued buffers through OnBufferEnd, which mustn't queue them again
+            stopping.store(true, std::memory_order_relaxed);
+            voice->Stop(0);
+            voice->FlushSourceBuffers();
+            // waits for a callback that's still running
+            voice->DestroyVoice();
+            voice = nullptr;
+            mixer = nullptr;
+        }
+
+    private:
+        void queue(uint32_t index) {
+            std::vector<float> &buffer = buffers[index];
+            mixer->render(buffer.data(), periodFrames);
+
+            XAUDIO2_BUFFER submit = {};
+            submit.AudioBytes = static_cast<UINT32>(buffer.size() * sizeof(float));
+            submit.pAudioData = reinterpret_cast<const BYTE *>(buffer.data());
+            submit.pContext = reinterpret_cast<void *>(uintptr_t(index));
+            voice->SubmitSourceBuffer(&submit);
+        }
+
+        void STDMETHODCALLTYPE OnBufferEnd(void *context) override {
+            if (!stopping.load(std::memory_order_relaxed))
+                queue(static_cast<uint32_t>(reinterpret_cast<uintptr_t>(context)));
+        }
+
+        void STDMETHODCALLTYPE OnVoiceProcessingPassStart(UINT32) override {}
+        void STDMETHODCALLTYPE OnVoiceProcessingPassEnd() override {}
+        void STDMETHODCALLTYPE OnStreamEnd() override {}
+        void STDMETHODCALLTYPE OnBufferStart(void *) override {}
+        void STDMETHODCALLTYPE OnLoopEnd(void *) override {}
+        void STDMETHODCALLTYPE OnVoiceError(void *, HRESULT) override {}
+
+        IXAudio2 *xaudio;
+        uint32_t periodFrames;
+        IXAudio2SourceVoice *voice;
+        PixieAudioMixer *mixer;
+        std::atomic<bool> stopping;
+        std::vector<float> buffers[bufferCount];
+    };
+} // namespace pxe